@@ -30,6 +30,10 @@ public:
   /// Serializes a key (and optionally value) to an std::string using Protocol Buffers
   void Serialize(std::string*& messageString, const std::string& key, const std::string& operationType,
                  const std::string& dataSource, const std::string& object = std::string());
+
+  /// Serializes several keys to be answered in one reply to an std::string using Protocol Buffers
+  void Serialize(std::string*& messageString, const std::vector<std::string>& keys, const std::string& operationType,
+                 const std::string& dataSource);
 };
 }
 }
@@ -13,6 +13,8 @@
 namespace AliceO2 {
 namespace CDB {
 
+class Condition;
+
 class BackendOCDB : public Backend {
 
 private:
@@ -25,6 +27,9 @@ public:
 
   /// Parses an incoming message from the CCDB server and prints the metadata of the included object
   void UnPack(std::unique_ptr<FairMQMessage> msg);
+
+  /// Deserializes the condition of a reply, returns null for an empty reply. The caller owns the condition.
+  static Condition* UnPackCondition(void* data, size_t size);
 };
 }
 }
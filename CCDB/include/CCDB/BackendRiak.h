@@ -6,6 +6,7 @@
 #define ALICE_O2_BACKENDRIAK_H_
 
 #include "CCDB/Backend.h"
+#include "CCDB/ChunkedCompression.h"
 
 namespace AliceO2 {
 namespace CDB {
@@ -16,14 +17,17 @@ private:
   /// Deserializes a message and stores the value to an std::string using Protocol Buffers
   void Deserialize(const std::string& messageString, std::string& object);
 
-  /// Compresses uncompressed_string to compressed_string using zlib
+  /// Compresses uncompressed_string to compressed_string in independent chunks using zlib
   void Compress(const std::string& uncompressed_string, std::string& compressed_string);
 
-  /// Decompresses compressed_string to uncompressed_string using zlib
+  /// Decompresses compressed_string to uncompressed_string, chunked or compressed as a single zlib stream
   void Decompress(std::string& uncompressed_string, const std::string& compressed_string);
 
+  ChunkedCompression fCompression;
+
 public:
-  BackendRiak();
+  /// @param compressionLevel zlib level, from 1 (fastest) to 9 (smallest), -1 for the zlib default
+  BackendRiak(int compressionLevel = -1);
   virtual ~BackendRiak(){};
 
   /// Compresses and serializes an object prior to transmission to server
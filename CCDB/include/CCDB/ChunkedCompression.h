@@ -0,0 +1,71 @@
+/// \file ChunkedCompression.h
+/// \brief Definition of the ChunkedCompression class, the zlib compression of large objects in independent chunks
+
+#ifndef ALICEO2_CDB_CHUNKEDCOMPRESSION_H_
+#define ALICEO2_CDB_CHUNKEDCOMPRESSION_H_
+
+#include <cstddef>    // for size_t
+#include <string>     // for string
+#include "Rtypes.h"   // for Int_t, UInt_t, ULong64_t, Bool_t
+
+namespace AliceO2 {
+namespace CDB {
+
+/// Compression of an object cut into chunks compressed independently with zlib:
+///
+///     Header | Chunk[nChunks] | compressed chunks
+///
+/// The chunk table gives the position and sizes of each compressed chunk, so that the chunks are
+/// compressed and decompressed in parallel, each directly into its place in the output buffer
+/// allocated once, and that a byte range of the object is decompressed without the other chunks.
+class ChunkedCompression
+{
+  public:
+    /// @param level zlib compression level, from 1 (fastest) to 9 (smallest), -1 for the zlib default
+    /// @param chunkSize uncompressed size of the chunks
+    /// @param nThreads number of threads compressing or decompressing the chunks, 0 for one per core
+    explicit ChunkedCompression(Int_t level = -1, size_t chunkSize = 1 << 20, Int_t nThreads = 0);
+
+    /// Compresses the data, replaces the content of output
+    Bool_t compress(const char *data, size_t size, std::string &output) const;
+
+    /// Decompresses the whole object, replaces the content of output
+    Bool_t decompress(const char *data, size_t size, std::string &output) const;
+
+    /// Decompresses the bytes [offset, offset + length) of the object from the chunks covering them
+    Bool_t decompress(const char *data, size_t size, size_t offset, size_t length, std::string &output) const;
+
+    /// Checks the magic number of the compressed data
+    static Bool_t isChunked(const char *data, size_t size);
+
+    /// Size of the object before compression, 0 if the data are not valid
+    static size_t getUncompressedSize(const char *data, size_t size);
+
+  private:
+    struct Header {
+      char magic[4];
+      UInt_t nChunks;
+      ULong64_t chunkSize;
+      ULong64_t size;
+    };
+
+    struct Chunk {
+      ULong64_t offset; ///< of the compressed chunk from the beginning of the data
+      UInt_t compressedSize;
+      UInt_t size;
+    };
+
+    /// Reads the header and checks that the chunk table is consistent with the data
+    static Bool_t readHeader(const char *data, size_t size, Header &header);
+
+    /// Runs the task for the chunks [0, nChunks) on the threads, returns false if any task failed
+    template <typename Task>
+    Bool_t forEachChunk(UInt_t nChunks, Task task) const;
+
+    Int_t mLevel;
+    size_t mChunkSize;
+    Int_t mNumberOfThreads;
+};
+}
+}
+#endif
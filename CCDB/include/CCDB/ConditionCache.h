@@ -0,0 +1,141 @@
+/// \file ConditionCache.h
+/// \brief Definition of the ConditionCache class, the run range cache of the CDB Manager
+
+#ifndef ALICEO2_CDB_CONDITIONCACHE_H_
+#define ALICEO2_CDB_CONDITIONCACHE_H_
+
+#include <atomic>      // for atomic
+#include <cstddef>     // for size_t
+#include <cstdint>     // for uint64_t
+#include <map>         // for map
+#include <memory>      // for shared_ptr, unique_ptr
+#include <string>      // for string
+#include <tuple>       // for tuple
+#include <boost/thread/shared_mutex.hpp>
+#include "Rtypes.h"    // for Int_t
+
+namespace AliceO2 {
+namespace CDB {
+
+class Condition;
+class ConditionId;
+class IdPath;
+
+/// Cache of conditions retrieved for any run, not only for the current run of the Manager.
+/// The conditions are indexed by path, requested version and requested subversion. For each of
+/// these keys the cache holds disjoint run intervals, each of them with the condition answering
+/// the query for all runs of the interval:
+/// - a query with explicit version and subversion identifies one object, which answers for its
+///   whole run range of validity
+/// - a query for the latest (sub)version is only known to be answered by the returned object for
+///   the runs of the query, as newer objects may cover parts of the validity range. Consecutive
+///   runs answered by the same object are merged into one interval and share the object.
+///
+/// Both the number of intervals and the memory taken by their objects are bounded, the least
+/// recently used intervals are evicted first. The memory of an object is estimated by its
+/// streamed size when it is inserted; an object shared by the intervals of several keys is
+/// counted for each of them. The most recently used interval is never evicted: the Manager hands
+/// out the inserted objects as plain pointers, owned by the cache.
+/// Lookups take a shared lock and can proceed concurrently, insertions and evictions an exclusive
+/// one. The conditions are handed out as shared pointers, an evicted condition stays valid for
+/// its users until they release it.
+class ConditionCache
+{
+  public:
+    struct Statistics {
+      uint64_t hits;
+      uint64_t misses;
+      uint64_t insertions;
+      uint64_t evictions;
+      size_t intervals;
+      size_t bytes; ///< estimated memory of the cached objects
+    };
+
+    explicit ConditionCache(size_t capacity = 10000, size_t maxBytes = size_t(1) << 30);
+
+    ~ConditionCache();
+
+    ConditionCache(const ConditionCache &) = delete;
+
+    ConditionCache &operator=(const ConditionCache &) = delete;
+
+    /// Returns the condition answering the query, an empty pointer if the query is not covered
+    std::shared_ptr<Condition> get(const ConditionId &query);
+
+    /// Same as get, without counting a hit or a miss and without updating the last use
+    std::shared_ptr<Condition> peek(const ConditionId &query) const;
+
+    /// Stores the condition as answer to the query, replaces the intervals overlapping with it
+    /// @return the cached condition, an already cached object with the same id is kept and
+    ///         returned instead of the new one
+    std::shared_ptr<Condition> put(const ConditionId &query, const std::shared_ptr<Condition> &condition);
+
+    /// Removes all conditions of the path, which may contain wildcards
+    /// @return number of removed intervals
+    size_t remove(const IdPath &path);
+
+    void clear();
+
+    /// Maximum number of run intervals, evicts the surplus at once
+    void setCapacity(size_t capacity);
+
+    size_t getCapacity() const
+    {
+      return mCapacity;
+    }
+
+    /// Maximum estimated memory of the cached objects in bytes, evicts the surplus at once
+    void setMaxBytes(size_t maxBytes);
+
+    size_t getMaxBytes() const
+    {
+      return mMaxBytes;
+    }
+
+    /// Estimated memory of the condition: its streamed size
+    static size_t estimateSize(const Condition &condition);
+
+    Statistics getStatistics() const;
+
+  private:
+    /// path, requested version, requested subversion
+    typedef std::tuple<std::string, Int_t, Int_t> Key;
+
+    struct Interval {
+      Int_t lastRun;
+      std::shared_ptr<Condition> condition;
+      size_t bytes;
+      mutable std::atomic<uint64_t> lastUse; ///< updated by the readers under the shared lock
+    };
+
+    /// the intervals of a key by first run
+    typedef std::map<Int_t, std::unique_ptr<Interval>> IntervalMap;
+
+    static Key makeKey(const ConditionId &query);
+
+    /// the interval answering the query, nullptr if the query is not covered
+    const Interval *find(const ConditionId &query) const;
+
+    /// evicts the least recently used intervals until the cache holds at most targetSize intervals
+    /// and targetBytes bytes
+    void evict(size_t targetSize, size_t targetBytes);
+
+    /// evicts a fraction of the intervals at once if a bound is exceeded
+    void enforceBounds();
+
+    mutable boost::shared_mutex mMutex;
+    std::map<Key, IntervalMap> mIntervals;
+    size_t mSize;
+    size_t mCapacity;
+    size_t mBytes;
+    size_t mMaxBytes;
+    std::atomic<uint64_t> mClock; ///< source of the lastUse stamps
+
+    std::atomic<uint64_t> mHits;
+    std::atomic<uint64_t> mMisses;
+    std::atomic<uint64_t> mInsertions;
+    std::atomic<uint64_t> mEvictions;
+};
+}
+}
+#endif
@@ -0,0 +1,96 @@
+/// \file ConditionSnapshot.h
+/// \brief Definition of the ConditionSnapshot class, the memory mapped snapshot of the conditions of a run
+
+#ifndef ALICEO2_CDB_CONDITIONSNAPSHOT_H_
+#define ALICEO2_CDB_CONDITIONSNAPSHOT_H_
+
+#include <cstddef>    // for size_t
+#include <map>        // for map
+#include <string>     // for string
+#include "Rtypes.h"   // for Int_t, UInt_t, ULong64_t, Bool_t
+
+namespace AliceO2 {
+namespace CDB {
+
+class Condition;
+
+/// Snapshot of the conditions of one run in a single file, read through a read only memory
+/// mapping. The file holds the streamed conditions one after the other and an index of their
+/// offsets sorted by path:
+///
+///     Header | Record[nEntries] | paths | objects
+///
+/// Opening a snapshot maps the file without reading it, a condition is looked up by binary search
+/// in the mapped index and streamed from the mapped bytes when it is asked for. The pages of the
+/// file are shared by all processes of the node mapping it, the only memory per process is the
+/// one of the conditions actually used.
+class ConditionSnapshot
+{
+  public:
+    ConditionSnapshot();
+
+    ~ConditionSnapshot();
+
+    ConditionSnapshot(const ConditionSnapshot &) = delete;
+
+    ConditionSnapshot &operator=(const ConditionSnapshot &) = delete;
+
+    /// Writes the conditions by path to the file, via a temporary file renamed at the end so that
+    /// the processes mapping the file never see a partial snapshot
+    static Bool_t write(const char *fileName, Int_t run, const std::map<std::string, const Condition *> &conditions);
+
+    /// Checks the magic number at the beginning of the file
+    static Bool_t isSnapshotFile(const char *fileName);
+
+    Bool_t open(const char *fileName);
+
+    void close();
+
+    Bool_t isOpen() const
+    {
+      return mData != nullptr;
+    }
+
+    Int_t getRun() const;
+
+    UInt_t getNumberOfConditions() const;
+
+    /// Streams the condition of the path from the snapshot, returns null if the snapshot has none.
+    /// The caller owns the condition.
+    Condition *getCondition(const char *path) const;
+
+  private:
+    struct Header {
+      char magic[8];
+      Int_t run;
+      UInt_t nEntries;
+      ULong64_t fileSize;
+    };
+
+    struct Record {
+      ULong64_t pathOffset;
+      ULong64_t dataOffset;
+      ULong64_t dataSize;
+      UInt_t pathLength;
+      UInt_t reserved;
+    };
+
+    const Header *getHeader() const
+    {
+      return reinterpret_cast<const Header *>(mData);
+    }
+
+    const Record *getRecords() const
+    {
+      return reinterpret_cast<const Record *>(mData + sizeof(Header));
+    }
+
+    /// Checks that the index and the objects lie within the file
+    Bool_t isConsistent() const;
+
+    const char *mData;
+    size_t mSize;
+};
+}
+}
+#endif
@@ -8,29 +8,100 @@
 #ifndef ALICEO2_CDB_CONDITIONSMQCLIENT_H_
 #define ALICEO2_CDB_CONDITIONSMQCLIENT_H_
 
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "FairMQDevice.h"
 
 namespace AliceO2 {
 namespace CDB {
 
+class Condition;
+
+/// The OCDB conditions are requested in batches of keys, each batch in one request answered by a
+/// multipart reply. The requests are pipelined: up to pipeline-depth batches are in flight on the
+/// dealer socket data-get, the replies are matched to their batch by a tag and handed to the
+/// callbacks as they arrive.
+///
+/// The batches can be submitted from any thread, the device thread does all the socket I/O.
 class ConditionsMQClient : public FairMQDevice {
 public:
+  /// path and run of a condition
+  typedef std::pair<std::string, int> ConditionKey;
+
+  /// the conditions in the order of the keys, null for a key without condition
+  typedef std::vector<std::shared_ptr<Condition>> Conditions;
+
+  typedef std::function<void(const Conditions&)> Callback;
+
   ConditionsMQClient();
   virtual ~ConditionsMQClient();
 
+  /// Requests the conditions of the keys, the callback is called by the device thread when the
+  /// reply arrives or directly if all conditions were prefetched
+  void getConditions(const std::vector<ConditionKey>& keys, Callback callback);
+
+  std::future<Conditions> getConditions(const std::vector<ConditionKey>& keys);
+
+  /// Requests in the background the conditions of all paths requested so far for the run. The
+  /// conditions are kept for the last two runs prefetched, in the order of the calls, and answer
+  /// the later requests.
+  void prefetch(int run);
+
 protected:
   virtual void InitTask();
   virtual void Run();
 
 private:
+  struct Request {
+    std::vector<ConditionKey> keys;
+    Callback callback;
+  };
+
   int fRunId;
   std::string fParameterName;
   std::string fOperationType;
   std::string fDataSource;
   std::string fObjectPath;
+  int fBatchSize;
+  int fPipelineDepth;
+  int fCompressionLevel;
+
+  std::mutex fMutex;
+  std::deque<Request> fSubmitted; ///< batches not sent yet
+  bool fStopped;                  ///< the device thread does not send requests anymore
+  /// the paths requested so far, the calibration set prefetched for a new run
+  std::set<std::string> fCalibrationSet;
+  /// the prefetched conditions by run and path
+  std::map<int, std::map<std::string, std::shared_ptr<Condition>>> fPrefetched;
+  std::deque<int> fPrefetchOrder; ///< the prefetched runs, oldest prefetch first
+
+  /// the batches in flight by tag, accessed by the device thread only
+  std::map<uint64_t, Request> fPending;
+  uint64_t fNextTag;
+
+  /// Sends the submitted batches as long as the pipeline is not full
+  void sendRequests();
+
+  /// Matches a reply to its batch and calls the callback
+  void handleReply(FairMQParts& reply);
+
+  /// Answers the batches not sent or not replied to with null conditions
+  void cancelRequests();
+
+  /// Requests the conditions of the object path, one run after the other, prefetching the next run
+  void getObjectPathConditions();
 
+  /// Sends a request of the Riak backend or a PUT, one at a time
+  void processSequentially();
 };
 }
 }
@@ -8,16 +8,54 @@
 #ifndef ALICEO2_CDB_CONDITIONSMQSERVER_H_
 #define ALICEO2_CDB_CONDITIONSMQSERVER_H_
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "CCDB/Manager.h"
 #include "ParameterMQServer.h"
 
+class TMessage;
+
 namespace AliceO2 {
 namespace CDB {
 
+/// The OCDB requests are answered by a pool of workers, the device thread only receives the
+/// requests and sends the replies, as the sockets can't be shared between threads. The clients
+/// connect with req or dealer sockets to the router socket data-get. All frames of a request up
+/// to the last one, the identity of the client, the delimiter and the tag of a pipelining client,
+/// are sent back in front of the reply. A request with several keys is answered by a multipart
+/// reply with one part per key.
+///
+/// The serialized conditions are cached per path and run and shared by all clients asking for
+/// the same object: a repeated request is answered from the device thread without the Manager
+/// and without streaming the object again, concurrent requests for an object not yet cached
+/// wait for the one retrieval in flight. A cached response expires after response-cache-ttl
+/// seconds, the next request looks up the version valid in the storage: the response is kept if
+/// it is still the current version, otherwise the object cached by the Manager is dropped and
+/// the newer version is streamed.
 class ConditionsMQServer : public ParameterMQServer {
 public:
+  struct Statistics {
+    uint64_t requests = 0;     ///< keys requested
+    uint64_t batches = 0;      ///< requests with several keys
+    uint64_t cacheHits = 0;
+    uint64_t coalesced = 0;    ///< requests waiting for the retrieval of the same object
+    uint64_t retrievals = 0;   ///< requests handed to the workers
+    uint64_t revalidations = 0; ///< expired responses checked against the storage
+    uint64_t updates = 0;      ///< expired responses replaced by a newer version
+    uint64_t failures = 0;
+    uint64_t replies = 0;      ///< including the replies forwarded from the Riak broker
+    uint64_t latencySumUs = 0; ///< from the reception of a request to its reply
+    uint64_t latencyMaxUs = 0;
+  };
+
   ConditionsMQServer();
 
   virtual ~ConditionsMQServer();
@@ -26,16 +64,110 @@ public:
 
   virtual void InitTask();
 
+  Statistics getStatistics() const;
+
 private:
+  typedef std::chrono::steady_clock Clock;
+
+  /// A serialized condition, immutable and shared by the messages sending it
+  typedef std::shared_ptr<TMessage> Response;
+
+  /// A client waiting for the reply, identified by the envelope frames of its request
+  struct Client {
+    std::vector<std::unique_ptr<FairMQMessage>> envelope;
+    Clock::time_point received;
+  };
+
+  /// The keys of a request, replied to when the last of them is resolved
+  struct Batch {
+    Client client;
+    std::vector<Response> responses;
+    size_t pending;
+  };
+
+  /// A retrieval by the workers with the keys of the requests waiting for it
+  struct Retrieval {
+    std::string path;
+    int run;
+    std::vector<std::pair<std::shared_ptr<Batch>, size_t>> waiting;
+    Response response;
+    std::string id;         ///< condition id of the response, with its run range and version
+    Response staleResponse; ///< the expired cached response, kept if its version is still valid
+    std::string staleId;
+  };
+
+  /// A cached response by path and run, with the condition id it was resolved to
+  struct CachedResponse {
+    Response response;
+    std::string id;
+    Clock::time_point expires;
+  };
+
   Manager* fCdbManager;
 
-  void getFromOCDB(std::string key);
+  /// serializes the access to the Manager, which is not thread safe
+  std::mutex fCdbManagerMutex;
+
+  int fNumberOfWorkers;
+  size_t fResponseCacheSize;
+  Clock::duration fResponseCacheTtl;
+
+  std::vector<std::thread> fWorkers;
+  std::mutex fQueueMutex;
+  std::condition_variable fQueueCondition;
+  std::deque<std::shared_ptr<Retrieval>> fQueue;     ///< retrievals for the workers
+  std::deque<std::shared_ptr<Retrieval>> fCompleted; ///< retrievals for the device thread
+  bool fStopWorkers;
+
+  /// the retrievals in flight by path and run, accessed by the device thread only
+  std::map<std::string, std::shared_ptr<Retrieval>> fInFlight;
+
+  /// the serialized conditions by path and run, accessed by the device thread only
+  std::map<std::string, CachedResponse> fResponseCache;
+  std::deque<std::string> fResponseCacheOrder; ///< oldest first, for the eviction
+  /// the serialized conditions by condition id, shared between the runs of their validity range,
+  /// accessed under the Manager mutex
+  std::map<std::string, std::weak_ptr<TMessage>> fResponsesById;
+
+  /// clients of the Riak broker, whose req socket takes one request at a time
+  std::deque<std::pair<Client, std::unique_ptr<FairMQMessage>>> fBrokerQueue;
+  bool fBrokerBusy;
+
+  mutable std::mutex fStatisticsMutex;
+  Statistics fStatistics;
+
+  /// Resolves one key of the request from the cache or by a retrieval
+  void getFromOCDB(std::string key, const std::shared_ptr<Batch>& batch, size_t slot);
+
+  void resolve(Batch& batch, size_t slot, const Response& response);
+
+  void startWorkers();
+
+  void stopWorkers();
+
+  void workerLoop();
+
+  /// Retrieves and serializes the condition, called by the workers
+  void retrieve(Retrieval& retrieval);
+
+  /// Sends the replies of the completed retrievals
+  void completeRetrievals();
+
+  void cacheResponse(const std::string& key, const Response& response, const std::string& id);
+
+  std::unique_ptr<FairMQMessage> createMessage(const Response& response);
+
+  void reply(Client& client, std::vector<std::unique_ptr<FairMQMessage>>& payload);
+
+  void forwardToBroker();
+
+  void printStatistics() const;
 
   /// Parses a serialized message for a data source entry
   void ParseDataSource(std::string& dataSource, const std::string& data);
 
-  /// Deserializes a message and stores the value to an std::string using Protocol Buffers
-  void Deserialize(const std::string& messageString, std::string& key);
+  /// Deserializes a message and stores the keys to std::strings using Protocol Buffers
+  void Deserialize(const std::string& messageString, std::vector<std::string>& keys);
 };
 }
 }
@@ -14,6 +14,7 @@ class TObject;
 namespace AliceO2 { namespace CDB { class Condition; }}
 namespace AliceO2 { namespace CDB { class ConditionId; }}
 namespace AliceO2 { namespace CDB { class IdRunRange; }}
+namespace AliceO2 { namespace CDB { class LocalStorageIndex; }}
 
 namespace AliceO2 {
 namespace CDB {
@@ -75,6 +76,7 @@ class LocalStorage : public Storage
     void getEntriesForLevel1(const char *level0, const char *Level1, const ConditionId &query, TList *result);
 
     TString mBaseDirectory; // path of the DB folder
+    LocalStorageIndex *mIndex; //! index of the files of each path
 
   ClassDef(LocalStorage, 0) // access class to a DataBase in a local storage
 };
@@ -0,0 +1,93 @@
+/// \file LocalStorageIndex.h
+/// \brief Definition of the LocalStorageIndex class, the file index of the LocalStorage
+
+#ifndef ALICEO2_CDB_LOCALSTORAGEINDEX_H_
+#define ALICEO2_CDB_LOCALSTORAGEINDEX_H_
+
+#include <map>        // for map
+#include <string>     // for string
+#include <vector>     // for vector
+#include "Rtypes.h"   // for Int_t, Long_t, Bool_t
+#include "TString.h"  // for TString
+
+namespace AliceO2 {
+namespace CDB {
+
+class IdRunRange;
+
+/// Index of the condition files of a LocalStorage, replacing the scan of the path directory at
+/// every query. For each path the run ranges, versions and subversions parsed from the file
+/// names Run<first>_<last>_v<version>_s<subVersion>.root are kept in a table sorted by first run.
+/// The files valid for a run range start at or before its first run, found by binary search, and
+/// end at or after its last run, found through a tree of the highest last runs which skips the
+/// files ending earlier: a file valid for all runs does not make the other lookups linear.
+///
+/// A table is valid as long as the modification time of the path directory does not change, it
+/// is rebuilt otherwise. The tables are written to the folder .index of the storage, to be picked
+/// up by other jobs using the same storage. As the modification time has a resolution of one
+/// second, a table built in the same second as the last change of the directory is not trusted.
+class LocalStorageIndex
+{
+  public:
+    struct Entry {
+      Int_t firstRun;
+      Int_t lastRun;
+      Int_t version;
+      Int_t subVersion;
+    };
+
+    enum Status {
+      kFound,
+      kNotFound,
+      kAmbiguous,  ///< more than one file with the selected version and subversion
+      kNoDirectory
+    };
+
+    explicit LocalStorageIndex(const char *baseDirectory);
+
+    ~LocalStorageIndex();
+
+    /// Selects the file of the path valid for the run range, with the same rules as the directory
+    /// scan: the highest version and subversion if none is given, the highest subversion of the
+    /// version if only the version is given, the exact file otherwise
+    Status find(const TString &path, const IdRunRange &runRange, Int_t version, Int_t subVersion, Entry &result);
+
+    /// All files of the path
+    Status getEntries(const TString &path, std::vector<Entry> &entries);
+
+    /// Drops the table of a path after a file was written to its directory
+    void invalidate(const TString &path);
+
+    void clear();
+
+    /// Parses the file name, faster than the regular expression of LocalStorage::filenameToId
+    static Bool_t parseFilename(const char *filename, Entry &entry);
+
+  private:
+    struct PathIndex {
+      std::vector<Entry> entries;    ///< sorted by first run
+      std::vector<Int_t> maxLastRun; ///< segment tree of the highest last run, leaves from nLeaves on
+      size_t nLeaves = 0;            ///< entries rounded up to a power of 2
+      Long_t modTime = -1;           ///< modification time of the directory when scanned
+      Long_t scanTime = -1;          ///< time of the scan
+    };
+
+    /// The up to date table of the path, null if the directory does not exist
+    PathIndex *getPathIndex(const TString &path);
+
+    Bool_t scanDirectory(const TString &directory, PathIndex &index) const;
+
+    Bool_t readIndexFile(const TString &path, PathIndex &index) const;
+
+    void writeIndexFile(const TString &path, const PathIndex &index) const;
+
+    TString getIndexFileName(const TString &path) const;
+
+    static void sortEntries(PathIndex &index);
+
+    TString mBaseDirectory;
+    std::map<std::string, PathIndex> mPaths;
+};
+}
+}
+#endif
@@ -5,11 +5,16 @@
 #include <TMap.h>     // for TMap
 #include <TObject.h>  // for TObject
 #include <stddef.h>   // for NULL
+#include <map>        // for map
+#include <memory>     // for shared_ptr
+#include <string>     // for string
 #include "Rtypes.h"   // for Int_t, Bool_t, kFALSE, kTRUE, ClassDef, etc
 #include "TString.h"  // for TString
 
 class TFile;
 namespace AliceO2 { namespace CDB { class Condition; }}  // lines 20-20
+namespace AliceO2 { namespace CDB { class ConditionCache; }}
+namespace AliceO2 { namespace CDB { class ConditionSnapshot; }}
 namespace AliceO2 { namespace CDB { class ConditionId; }}  // lines 21-21
 namespace AliceO2 { namespace CDB { class ConditionMetaData; }}  // lines 24-24
 namespace AliceO2 { namespace CDB { class IdPath; }}  // lines 22-22
@@ -123,12 +128,22 @@ class Manager : public TObject
       return mOcdbUploadMode;
     }
 
+    /// With the cache flag set, the returned object is owned by the cache. An object of the current
+    /// run stays valid until the run is changed, an object of another run until it is evicted.
     Condition *getObject(const ConditionId &query, Bool_t forceCaching = kFALSE);
 
     Condition *getObject(const IdPath &path, Int_t runNumber = -1, Int_t version = -1, Int_t subVersion = -1);
 
     Condition *getObject(const IdPath &path, const IdRunRange &runRange, Int_t version = -1, Int_t subVersion = -1);
 
+    /// Same as getObject, the returned pointer keeps the object valid after it was evicted from the
+    /// cache or the run was changed, e.g. to use it without holding the lock serializing the Manager
+    std::shared_ptr<Condition> getSharedObject(const ConditionId &query);
+
+    /// ConditionId of the object valid for the query in its storage, ignoring the cached objects,
+    /// to tell whether a newer version was stored meanwhile. User must delete returned object!
+    ConditionId *getIdFromStorage(const ConditionId &query);
+
     Condition *getConditionFromSnapshot(const char *path);
 
     const char *getUri(const char *path);
@@ -197,6 +212,19 @@ class Manager : public TObject
 
     void unloadFromCache(const char *path);
 
+    /// Maximum number of run intervals held by the run range cache
+    void setCacheCapacity(size_t capacity);
+
+    size_t getCacheCapacity() const;
+
+    /// Maximum estimated memory of the objects held by the run range cache, in bytes
+    void setCacheMaxBytes(size_t maxBytes);
+
+    size_t getCacheMaxBytes() const;
+
+    /// Hits and misses of the run range cache, which serves the queries for any run
+    void getCacheStatistics(ULong64_t &hits, ULong64_t &misses, ULong64_t &evictions) const;
+
     const TMap *getConditionCache() const
     {
       return &mConditionCache;
@@ -210,6 +238,8 @@ class Manager : public TObject
 
     Bool_t initFromSnapshot(const char *snapshotFileName, Bool_t overwrite = kTRUE);
 
+    /// Reads the objects of the current run from the snapshot file, a ROOT file written by
+    /// dumpToSnapshotFile or a file written by dumpToMappedSnapshotFile, which is memory mapped
     Bool_t setSnapshotMode(const char *snapshotFileName = "OCDB.root");
 
     void unsetSnapshotMode()
@@ -221,6 +251,11 @@ class Manager : public TObject
 
     void dumpToLightSnapshotFile(const char *lightSnapshotFileName) const;
 
+    /// Writes all objects valid for the run, of the default and of the specific storages, to a snapshot
+    /// shared through a read only memory mapping by the processes reading it, the objects are streamed
+    /// from the mapping when first requested
+    Bool_t dumpToMappedSnapshotFile(const char *snapshotFileName, Int_t run = -1);
+
     Int_t getStartRunLHCPeriod();
 
     Int_t getEndRunLHCPeriod();
@@ -264,8 +299,13 @@ class Manager : public TObject
 
     void getLHCPeriodAgainstCvmfsFile(Int_t run, TString &lhcPeriod, Int_t &startRun, Int_t &endRun);
 
+    /// Closes the ROOT or mapped snapshot file, only one of them is open at a time
+    void closeSnapshot();
+
     void cacheCondition(const char *path, Condition *entry);
 
+    void cacheCondition(const char *path, const std::shared_ptr<Condition> &entry);
+
     StorageParameters *selectSpecificStorage(const TString &path);
 
     ConditionId *getId(const ConditionId &query);
@@ -277,7 +317,9 @@ class Manager : public TObject
     TList mFactories;       //! list of registered storage factories
     TMap mActiveStorages;   //! list of active storages
     TMap mSpecificStorages; //! list of detector-specific storages
-    TMap mConditionCache;       //! cache of the retrieved objects
+    TMap mConditionCache;       //! index of the objects retrieved for the current run, not owning the objects
+    std::map<std::string, std::shared_ptr<Condition>> mCurrentRunConditions; //! objects of the current run
+    ConditionCache *mRunRangeCache; //! owner of the objects retrieved for any run
 
     TList *mIds;       //! List of the retrieved object ConditionId's (to be streamed to file)
     TMap *mStorageMap; //! list of storages (to be streamed to file)
@@ -294,6 +336,7 @@ class Manager : public TObject
 
     Bool_t mSnapshotMode; //! flag saying if we are in snapshot mode
     TFile *mSnapshotFile;
+    ConditionSnapshot *mMappedSnapshot; //! snapshot in snapshot mode if not a ROOT file
     Bool_t mOcdbUploadMode; //! flag for uploads to Official CDBs (upload to cvmfs must follow upload
     // to AliEn)
 
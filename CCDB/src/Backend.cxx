@@ -23,3 +23,19 @@ void Backend::Serialize(std::string*& messageString, const std::string& key, con
 
   delete requestMessage;
 }
+
+void Backend::Serialize(std::string*& messageString, const std::vector<std::string>& keys,
+                        const std::string& operationType, const std::string& dataSource)
+{
+  messaging::RequestMessage* requestMessage = new messaging::RequestMessage;
+  requestMessage->set_command(operationType);
+  requestMessage->set_datasource(dataSource);
+
+  for (const auto& key : keys) {
+    requestMessage->add_keys(key);
+  }
+
+  requestMessage->SerializeToString(messageString);
+
+  delete requestMessage;
+}
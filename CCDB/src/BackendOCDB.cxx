@@ -30,8 +30,21 @@ void BackendOCDB::Pack(const std::string& path, const std::string& key, std::str
 
 void BackendOCDB::UnPack(std::unique_ptr<FairMQMessage> msg)
 {
-  WrapTMessage tmsg(msg->GetData(), msg->GetSize());
-  Condition* aCondition = (Condition*)(tmsg.ReadObject(tmsg.GetClass()));
+  Condition* aCondition = UnPackCondition(msg->GetData(), msg->GetSize());
+  if (!aCondition) {
+    LOG(ERROR) << "The server has no condition for the request";
+    return;
+  }
   LOG(DEBUG) << "Received a condition from the server:";
   aCondition->printConditionMetaData();
+  delete aCondition;
+}
+
+Condition* BackendOCDB::UnPackCondition(void* data, size_t size)
+{
+  if (size == 0) {
+    return nullptr;
+  }
+  WrapTMessage tmsg(data, size);
+  return (Condition*)(tmsg.ReadObject(tmsg.GetClass()));
 }
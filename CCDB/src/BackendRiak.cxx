@@ -12,51 +12,25 @@
 using namespace AliceO2::CDB;
 using namespace std;
 
-BackendRiak::BackendRiak() {}
-
-// Compression/decompression code taken from https://panthema.net/2007/0328-ZLibString.html
+BackendRiak::BackendRiak(int compressionLevel) : fCompression(compressionLevel) {}
 
 void BackendRiak::Compress(const std::string& uncompressed_string, std::string& compressed_string)
 {
-  // z_stream is zlib's control structure
-  z_stream zs;
-  memset(&zs, 0, sizeof(zs));
-
-  if (deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK) {
-    LOG(ERROR) << "deflateInit failed while compressing";
-  }
-
-  zs.next_in = (Bytef*)uncompressed_string.data();
-  zs.avail_in = uncompressed_string.size();
-
-  int ret;
-  char outbuffer[32768];
-  std::string outstring;
-
-  // Get the compressed bytes in blocks of 32768 bytes using repeated calls to deflate
-  do {
-    zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-    zs.avail_out = sizeof(outbuffer);
-
-    ret = deflate(&zs, Z_FINISH);
-
-    if (outstring.size() < zs.total_out) {
-      // append the block to the output string
-      outstring.append(outbuffer, zs.total_out - outstring.size());
-    }
-  } while (ret == Z_OK);
+  // the chunks are compressed in parallel directly into compressed_string
+  fCompression.compress(uncompressed_string.data(), uncompressed_string.size(), compressed_string);
+}
 
-  deflateEnd(&zs);
+// Compression/decompression code of a single stream taken from https://panthema.net/2007/0328-ZLibString.html
 
-  if (ret != Z_STREAM_END) {
-    LOG(ERROR) << "Exception during zlib compression: (" << ret << ") " << zs.msg;
+void BackendRiak::Decompress(std::string& uncompressed_string, const std::string& compressed_string)
+{
+  if (ChunkedCompression::isChunked(compressed_string.data(), compressed_string.size())) {
+    fCompression.decompress(compressed_string.data(), compressed_string.size(), uncompressed_string);
+    return;
   }
 
-  compressed_string.assign(outstring);
-}
+  // objects stored before the chunked format were compressed as a single stream
 
-void BackendRiak::Decompress(std::string& uncompressed_string, const std::string& compressed_string)
-{
   // z_stream is zlib's control structure
   z_stream zs;
   memset(&zs, 0, sizeof(zs));
@@ -70,7 +44,7 @@ void BackendRiak::Decompress(std::string& uncompressed_string, const std::string
 
   int ret;
   char outbuffer[32768];
-  std::string outstring;
+  uncompressed_string.clear();
 
   // Get the decompressed bytes in blocks of 32768 bytes using repeated calls to inflate
   do {
@@ -79,8 +53,8 @@ void BackendRiak::Decompress(std::string& uncompressed_string, const std::string
 
     ret = inflate(&zs, 0);
 
-    if (outstring.size() < zs.total_out) {
-      outstring.append(outbuffer, zs.total_out - outstring.size());
+    if (uncompressed_string.size() < zs.total_out) {
+      uncompressed_string.append(outbuffer, zs.total_out - uncompressed_string.size());
     }
   } while (ret == Z_OK);
 
@@ -89,8 +63,6 @@ void BackendRiak::Decompress(std::string& uncompressed_string, const std::string
   if (ret != Z_STREAM_END) {
     LOG(ERROR) << "Exception during zlib compression: (" << ret << ") " << zs.msg;
   }
-
-  uncompressed_string.assign(outstring);
 }
 
 void BackendRiak::Deserialize(const std::string& messageString, std::string& object)
@@ -98,7 +70,7 @@ void BackendRiak::Deserialize(const std::string& messageString, std::string& obj
   messaging::RequestMessage* requestMessage = new messaging::RequestMessage;
   requestMessage->ParseFromString(messageString);
 
-  object.assign(requestMessage->value());
+  object.swap(*requestMessage->mutable_value());
 
   delete requestMessage;
 }
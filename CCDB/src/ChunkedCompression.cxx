@@ -0,0 +1,180 @@
+/// \file ChunkedCompression.cxx
+/// \brief Implementation of the ChunkedCompression class, the zlib compression of large objects in independent chunks
+
+#include "CCDB/ChunkedCompression.h"
+#include <FairLogger.h>   // for LOG
+#include <zlib.h>         // for compress2, compressBound, uncompress
+#include <algorithm>      // for max, min
+#include <atomic>         // for atomic
+#include <cstring>        // for memcmp, memcpy, memmove
+#include <thread>         // for thread
+#include <vector>         // for vector
+
+using namespace AliceO2::CDB;
+
+namespace {
+const char sChunkedMagic[4] = {'O', '2', 'C', 'Z'};
+}
+
+ChunkedCompression::ChunkedCompression(Int_t level, size_t chunkSize, Int_t nThreads)
+  : mLevel(level < 0 ? Z_DEFAULT_COMPRESSION : std::min(level, Int_t(Z_BEST_COMPRESSION))),
+    mChunkSize(std::max<size_t>(std::min<size_t>(chunkSize, 1u << 30), 1 << 12)),
+    mNumberOfThreads(nThreads > 0 ? nThreads : std::max<Int_t>(std::thread::hardware_concurrency(), 1))
+{
+}
+
+template <typename Task>
+Bool_t ChunkedCompression::forEachChunk(UInt_t nChunks, Task task) const
+{
+  std::atomic<UInt_t> next(0);
+  std::atomic<bool> ok(true);
+  auto worker = [&]() {
+    for (UInt_t chunk = next++; chunk < nChunks; chunk = next++) {
+      if (!task(chunk)) {
+        ok = false;
+      }
+    }
+  };
+
+  // the calling thread takes its share of the chunks
+  std::vector<std::thread> threads;
+  UInt_t nThreads = std::min<UInt_t>(mNumberOfThreads, nChunks);
+  for (UInt_t i = 1; i < nThreads; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return ok;
+}
+
+Bool_t ChunkedCompression::compress(const char *data, size_t size, std::string &output) const
+{
+  UInt_t nChunks = (size + mChunkSize - 1) / mChunkSize;
+
+  // each chunk is compressed into a slot of the bound of its compressed size, the slots are
+  // compacted afterwards
+  size_t tableSize = sizeof(Header) + nChunks * sizeof(Chunk);
+  size_t slotSize = compressBound(mChunkSize);
+  output.resize(tableSize + nChunks * slotSize);
+  char *buffer = &output[0];
+
+  std::vector<Chunk> chunks(nChunks);
+  bool ok = forEachChunk(nChunks, [&](UInt_t i) {
+    Chunk &chunk = chunks[i];
+    chunk.size = std::min(mChunkSize, size - i * mChunkSize);
+    uLongf compressedSize = slotSize;
+    int status = compress2(reinterpret_cast<Bytef *>(buffer + tableSize + i * slotSize), &compressedSize,
+                           reinterpret_cast<const Bytef *>(data + i * mChunkSize), chunk.size, mLevel);
+    chunk.compressedSize = compressedSize;
+    return status == Z_OK;
+  });
+  if (!ok) {
+    LOG(ERROR) << "zlib compression failed" << FairLogger::endl;
+    output.clear();
+    return kFALSE;
+  }
+
+  size_t offset = tableSize;
+  for (UInt_t i = 0; i < nChunks; i++) {
+    memmove(buffer + offset, buffer + tableSize + i * slotSize, chunks[i].compressedSize);
+    chunks[i].offset = offset;
+    offset += chunks[i].compressedSize;
+  }
+
+  Header header;
+  memcpy(header.magic, sChunkedMagic, sizeof(sChunkedMagic));
+  header.nChunks = nChunks;
+  header.chunkSize = mChunkSize;
+  header.size = size;
+  memcpy(buffer, &header, sizeof(header));
+  memcpy(buffer + sizeof(Header), chunks.data(), nChunks * sizeof(Chunk));
+  output.resize(offset);
+  return kTRUE;
+}
+
+Bool_t ChunkedCompression::isChunked(const char *data, size_t size)
+{
+  return size >= sizeof(Header) && memcmp(data, sChunkedMagic, sizeof(sChunkedMagic)) == 0;
+}
+
+Bool_t ChunkedCompression::readHeader(const char *data, size_t size, Header &header)
+{
+  if (!isChunked(data, size)) {
+    return kFALSE;
+  }
+  // the data of a message are not necessarily aligned, the header and the chunks are copied
+  memcpy(&header, data, sizeof(header));
+  if (header.chunkSize == 0 || header.nChunks != (header.size + header.chunkSize - 1) / header.chunkSize ||
+      header.nChunks > (size - sizeof(Header)) / sizeof(Chunk)) {
+    return kFALSE;
+  }
+  for (UInt_t i = 0; i < header.nChunks; i++) {
+    Chunk chunk;
+    memcpy(&chunk, data + sizeof(Header) + i * sizeof(Chunk), sizeof(chunk));
+    if (chunk.offset > size || chunk.compressedSize > size - chunk.offset ||
+        chunk.size != std::min<ULong64_t>(header.chunkSize, header.size - i * header.chunkSize)) {
+      return kFALSE;
+    }
+  }
+  return kTRUE;
+}
+
+size_t ChunkedCompression::getUncompressedSize(const char *data, size_t size)
+{
+  Header header;
+  return readHeader(data, size, header) ? header.size : 0;
+}
+
+Bool_t ChunkedCompression::decompress(const char *data, size_t size, std::string &output) const
+{
+  return decompress(data, size, 0, getUncompressedSize(data, size), output);
+}
+
+Bool_t ChunkedCompression::decompress(const char *data, size_t size, size_t offset, size_t length,
+                                      std::string &output) const
+{
+  Header header;
+  if (!readHeader(data, size, header) || offset > header.size || length > header.size - offset) {
+    LOG(ERROR) << "Invalid chunked compressed data or range" << FairLogger::endl;
+    return kFALSE;
+  }
+  output.resize(length);
+  if (length == 0) {
+    return kTRUE;
+  }
+
+  // the chunks lying entirely in the range are decompressed in place, the first and last ones
+  // through a buffer if the range starts or ends within them
+  ULong64_t chunkSize = header.chunkSize;
+  UInt_t firstChunk = offset / chunkSize;
+  UInt_t lastChunk = (offset + length - 1) / chunkSize;
+  char *buffer = &output[0];
+  bool ok = forEachChunk(lastChunk - firstChunk + 1, [&](UInt_t i) {
+    UInt_t index = firstChunk + i;
+    Chunk chunk;
+    memcpy(&chunk, data + sizeof(Header) + index * sizeof(Chunk), sizeof(chunk));
+    ULong64_t chunkBegin = index * chunkSize;
+    ULong64_t begin = std::max<ULong64_t>(chunkBegin, offset);
+    ULong64_t end = std::min<ULong64_t>(chunkBegin + chunk.size, offset + length);
+    uLongf uncompressedSize = chunk.size;
+    int status;
+    if (begin == chunkBegin && end == chunkBegin + chunk.size) {
+      status = uncompress(reinterpret_cast<Bytef *>(buffer + (begin - offset)), &uncompressedSize,
+                          reinterpret_cast<const Bytef *>(data + chunk.offset), chunk.compressedSize);
+    } else {
+      std::vector<char> partial(chunk.size);
+      status = uncompress(reinterpret_cast<Bytef *>(partial.data()), &uncompressedSize,
+                          reinterpret_cast<const Bytef *>(data + chunk.offset), chunk.compressedSize);
+      memcpy(buffer + (begin - offset), partial.data() + (begin - chunkBegin), end - begin);
+    }
+    return status == Z_OK && uncompressedSize == chunk.size;
+  });
+  if (!ok) {
+    LOG(ERROR) << "zlib decompression failed" << FairLogger::endl;
+    output.clear();
+    return kFALSE;
+  }
+  return kTRUE;
+}
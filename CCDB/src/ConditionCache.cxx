@@ -0,0 +1,237 @@
+/// \file ConditionCache.cxx
+/// \brief Implementation of the ConditionCache class, the run range cache of the CDB Manager
+
+#include "CCDB/ConditionCache.h"
+#include <TBufferFile.h>          // for TBufferFile
+#include <algorithm>              // for max, min, sort
+#include <vector>                 // for vector
+#include "CCDB/Condition.h"       // for Condition
+#include "CCDB/ConditionId.h"     // for ConditionId
+#include "CCDB/IdPath.h"          // for IdPath
+
+using namespace AliceO2::CDB;
+
+ConditionCache::ConditionCache(size_t capacity, size_t maxBytes)
+  : mMutex(),
+    mIntervals(),
+    mSize(0),
+    mCapacity(std::max<size_t>(capacity, 1)),
+    mBytes(0),
+    mMaxBytes(maxBytes),
+    mClock(0),
+    mHits(0),
+    mMisses(0),
+    mInsertions(0),
+    mEvictions(0)
+{
+}
+
+ConditionCache::~ConditionCache()
+{
+}
+
+size_t ConditionCache::estimateSize(const Condition &condition)
+{
+  size_t bytes = sizeof(Condition);
+  if (condition.getObject()) {
+    TBufferFile buffer(TBuffer::kWrite);
+    buffer.WriteObject(condition.getObject());
+    bytes += buffer.Length();
+  }
+  return bytes;
+}
+
+ConditionCache::Key ConditionCache::makeKey(const ConditionId &query)
+{
+  return Key(query.getPathString().Data(), query.getVersion(), query.getSubVersion());
+}
+
+const ConditionCache::Interval *ConditionCache::find(const ConditionId &query) const
+{
+  auto key = mIntervals.find(makeKey(query));
+  if (key != mIntervals.end()) {
+    // the interval starting at or before the first run of the query
+    auto it = key->second.upper_bound(query.getFirstRun());
+    if (it != key->second.begin()) {
+      --it;
+      if (it->second->lastRun >= query.getLastRun()) {
+        return it->second.get();
+      }
+    }
+  }
+  return nullptr;
+}
+
+std::shared_ptr<Condition> ConditionCache::get(const ConditionId &query)
+{
+  boost::shared_lock<boost::shared_mutex> lock(mMutex);
+
+  const Interval *interval = find(query);
+  if (interval) {
+    interval->lastUse.store(++mClock, std::memory_order_relaxed);
+    ++mHits;
+    return interval->condition;
+  }
+  ++mMisses;
+  return std::shared_ptr<Condition>();
+}
+
+std::shared_ptr<Condition> ConditionCache::peek(const ConditionId &query) const
+{
+  boost::shared_lock<boost::shared_mutex> lock(mMutex);
+
+  const Interval *interval = find(query);
+  return interval ? interval->condition : std::shared_ptr<Condition>();
+}
+
+std::shared_ptr<Condition> ConditionCache::put(const ConditionId &query, const std::shared_ptr<Condition> &condition)
+{
+  if (!condition) {
+    return condition;
+  }
+
+  // an explicitly requested version is valid for the whole validity range of the object
+  Int_t firstRun = query.getFirstRun();
+  Int_t lastRun = query.getLastRun();
+  const ConditionId &id = condition->getId();
+  if (query.hasVersion() && query.hasSubVersion()) {
+    firstRun = std::min(firstRun, id.getFirstRun());
+    lastRun = std::max(lastRun, id.getLastRun());
+  }
+  // streamed outside of the lock
+  size_t bytes = estimateSize(*condition);
+
+  boost::unique_lock<boost::shared_mutex> lock(mMutex);
+  IntervalMap &intervals = mIntervals[makeKey(query)];
+
+  // the intervals overlapping with or adjacent to the new one: the ones holding an object with
+  // the same id are merged, the other overlapping ones are replaced
+  std::shared_ptr<Condition> cached = condition;
+  auto it = intervals.upper_bound(firstRun);
+  if (it != intervals.begin() && std::prev(it)->second->lastRun >= firstRun - 1) {
+    --it;
+  }
+  while (it != intervals.end() && it->first <= lastRun + 1) {
+    const Interval &interval = *it->second;
+    bool sameObject = interval.condition->getId().isEqual(&id);
+    bool overlapping = it->first <= lastRun && interval.lastRun >= firstRun;
+    if (sameObject) {
+      firstRun = std::min(firstRun, it->first);
+      lastRun = std::max(lastRun, interval.lastRun);
+      cached = interval.condition;
+      bytes = interval.bytes;
+    }
+    if (sameObject || overlapping) {
+      mBytes -= interval.bytes;
+      it = intervals.erase(it);
+      --mSize;
+    } else {
+      ++it;
+    }
+  }
+
+  std::unique_ptr<Interval> interval(new Interval);
+  interval->lastRun = lastRun;
+  interval->condition = cached;
+  interval->bytes = bytes;
+  interval->lastUse.store(++mClock, std::memory_order_relaxed);
+  intervals[firstRun] = std::move(interval);
+  ++mSize;
+  mBytes += bytes;
+  ++mInsertions;
+
+  enforceBounds();
+  return cached;
+}
+
+void ConditionCache::enforceBounds()
+{
+  if (mSize > mCapacity || mBytes > mMaxBytes) {
+    // evict a fraction at once, the search for the oldest intervals scans the whole cache
+    evict(mCapacity - mCapacity / 8, mMaxBytes - mMaxBytes / 8);
+  }
+}
+
+void ConditionCache::evict(size_t targetSize, size_t targetBytes)
+{
+  struct Candidate {
+    uint64_t lastUse;
+    std::map<Key, IntervalMap>::iterator key;
+    Int_t firstRun;
+    size_t bytes;
+  };
+
+  if (mSize <= targetSize && mBytes <= targetBytes) {
+    return;
+  }
+  std::vector<Candidate> candidates;
+  candidates.reserve(mSize);
+  for (auto key = mIntervals.begin(); key != mIntervals.end(); ++key) {
+    for (auto &interval : key->second) {
+      candidates.push_back(Candidate{interval.second->lastUse.load(std::memory_order_relaxed), key, interval.first,
+                                     interval.second->bytes});
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) { return a.lastUse < b.lastUse; });
+  // the most recently used interval is kept, put hands out its object
+  size_t nEvict = 0;
+  for (; nEvict + 1 < candidates.size() && (mSize > targetSize || mBytes > targetBytes); nEvict++) {
+    const Candidate &candidate = candidates[nEvict];
+    candidate.key->second.erase(candidate.firstRun);
+    mBytes -= candidate.bytes;
+    --mSize;
+  }
+  for (auto key = mIntervals.begin(); key != mIntervals.end();) {
+    key = key->second.empty() ? mIntervals.erase(key) : std::next(key);
+  }
+  mEvictions += nEvict;
+}
+
+size_t ConditionCache::remove(const IdPath &path)
+{
+  boost::unique_lock<boost::shared_mutex> lock(mMutex);
+
+  size_t removed = 0;
+  for (auto key = mIntervals.begin(); key != mIntervals.end();) {
+    if (path.isSupersetOf(IdPath(std::get<0>(key->first).c_str()))) {
+      removed += key->second.size();
+      for (const auto &interval : key->second) {
+        mBytes -= interval.second->bytes;
+      }
+      key = mIntervals.erase(key);
+    } else {
+      ++key;
+    }
+  }
+  mSize -= removed;
+  return removed;
+}
+
+void ConditionCache::clear()
+{
+  boost::unique_lock<boost::shared_mutex> lock(mMutex);
+  mIntervals.clear();
+  mSize = 0;
+  mBytes = 0;
+}
+
+void ConditionCache::setCapacity(size_t capacity)
+{
+  boost::unique_lock<boost::shared_mutex> lock(mMutex);
+  mCapacity = std::max<size_t>(capacity, 1);
+  evict(mCapacity, mMaxBytes);
+}
+
+void ConditionCache::setMaxBytes(size_t maxBytes)
+{
+  boost::unique_lock<boost::shared_mutex> lock(mMutex);
+  mMaxBytes = maxBytes;
+  evict(mCapacity, mMaxBytes);
+}
+
+ConditionCache::Statistics ConditionCache::getStatistics() const
+{
+  boost::shared_lock<boost::shared_mutex> lock(mMutex);
+  return Statistics{mHits.load(), mMisses.load(), mInsertions.load(), mEvictions.load(), mSize, mBytes};
+}
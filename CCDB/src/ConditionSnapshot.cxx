@@ -0,0 +1,208 @@
+/// \file ConditionSnapshot.cxx
+/// \brief Implementation of the ConditionSnapshot class, the memory mapped snapshot of the conditions of a run
+
+#include "CCDB/ConditionSnapshot.h"
+#include <FairLogger.h>         // for LOG
+#include <TBufferFile.h>        // for TBufferFile
+#include <TSystem.h>            // for TSystem, gSystem
+#include <fcntl.h>              // for open, O_RDONLY
+#include <sys/mman.h>           // for mmap, munmap, madvise
+#include <sys/stat.h>           // for fstat
+#include <unistd.h>             // for close
+#include <algorithm>            // for lower_bound, min
+#include <cstring>              // for memcmp, memcpy, strlen
+#include <fstream>              // for ifstream, ofstream
+#include <memory>               // for unique_ptr
+#include <vector>               // for vector
+#include "CCDB/Condition.h"     // for Condition
+
+using namespace AliceO2::CDB;
+
+namespace {
+const char sSnapshotMagic[8] = {'O', '2', 'C', 'D', 'B', 'S', 'N', '1'};
+
+/// the objects start at multiples of 8 bytes
+ULong64_t align(ULong64_t offset)
+{
+  return (offset + 7) & ~ULong64_t(7);
+}
+}
+
+ConditionSnapshot::ConditionSnapshot() : mData(nullptr), mSize(0)
+{
+}
+
+ConditionSnapshot::~ConditionSnapshot()
+{
+  close();
+}
+
+Bool_t ConditionSnapshot::write(const char *fileName, Int_t run,
+                                const std::map<std::string, const Condition *> &conditions)
+{
+  // the conditions are streamed once here, the readers stream them back from the mapped bytes
+  std::vector<std::unique_ptr<TBufferFile>> buffers;
+  std::vector<Record> records;
+  ULong64_t pathOffset = sizeof(Header) + conditions.size() * sizeof(Record);
+  for (const auto &condition : conditions) {
+    buffers.emplace_back(new TBufferFile(TBuffer::kWrite));
+    buffers.back()->WriteObject(condition.second);
+    Record record = Record();
+    record.pathOffset = pathOffset;
+    record.pathLength = condition.first.size();
+    record.dataSize = buffers.back()->Length();
+    records.push_back(record);
+    pathOffset += condition.first.size();
+  }
+  ULong64_t dataOffset = align(pathOffset);
+  for (auto &record : records) {
+    record.dataOffset = dataOffset;
+    dataOffset = align(dataOffset + record.dataSize);
+  }
+
+  Header header = Header();
+  memcpy(header.magic, sSnapshotMagic, sizeof(sSnapshotMagic));
+  header.run = run;
+  header.nEntries = records.size();
+  header.fileSize = dataOffset;
+
+  TString tmpFileName = Form("%s.%d", fileName, gSystem->GetPid());
+  {
+    std::ofstream file(tmpFileName.Data(), std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(Record));
+    for (const auto &condition : conditions) {
+      file.write(condition.first.data(), condition.first.size());
+    }
+    const char padding[8] = {0};
+    ULong64_t position = pathOffset;
+    for (size_t i = 0; i < records.size(); i++) {
+      file.write(padding, records[i].dataOffset - position);
+      file.write(buffers[i]->Buffer(), records[i].dataSize);
+      position = records[i].dataOffset + records[i].dataSize;
+    }
+    file.write(padding, header.fileSize - position);
+    if (!file) {
+      LOG(ERROR) << "Cannot write snapshot file " << tmpFileName.Data() << FairLogger::endl;
+      file.close();
+      gSystem->Unlink(tmpFileName);
+      return kFALSE;
+    }
+  }
+  if (gSystem->Rename(tmpFileName, fileName) != 0) {
+    LOG(ERROR) << "Cannot rename " << tmpFileName.Data() << " to " << fileName << FairLogger::endl;
+    gSystem->Unlink(tmpFileName);
+    return kFALSE;
+  }
+  LOG(INFO) << "Snapshot of " << records.size() << " conditions for run " << run << " written to " << fileName
+            << FairLogger::endl;
+  return kTRUE;
+}
+
+Bool_t ConditionSnapshot::isSnapshotFile(const char *fileName)
+{
+  std::ifstream file(fileName, std::ios::binary);
+  char magic[sizeof(sSnapshotMagic)];
+  return file.read(magic, sizeof(magic)) && memcmp(magic, sSnapshotMagic, sizeof(magic)) == 0;
+}
+
+Bool_t ConditionSnapshot::open(const char *fileName)
+{
+  close();
+
+  int fd = ::open(fileName, O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open snapshot file " << fileName << FairLogger::endl;
+    return kFALSE;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+    LOG(ERROR) << "Invalid snapshot file " << fileName << FairLogger::endl;
+    ::close(fd);
+    return kFALSE;
+  }
+
+  // a shared read only mapping: the pages are the ones of the page cache, common to all processes
+  void *data = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map snapshot file " << fileName << FairLogger::endl;
+    return kFALSE;
+  }
+  // the conditions are read one by one at arbitrary offsets
+  madvise(data, status.st_size, MADV_RANDOM);
+  mData = static_cast<const char *>(data);
+  mSize = status.st_size;
+
+  if (!isConsistent()) {
+    LOG(ERROR) << "Invalid snapshot file " << fileName << FairLogger::endl;
+    close();
+    return kFALSE;
+  }
+  LOG(INFO) << "Mapped snapshot of " << getNumberOfConditions() << " conditions for run " << getRun() << " from "
+            << fileName << FairLogger::endl;
+  return kTRUE;
+}
+
+Bool_t ConditionSnapshot::isConsistent() const
+{
+  const Header *header = getHeader();
+  if (memcmp(header->magic, sSnapshotMagic, sizeof(sSnapshotMagic)) != 0 || header->fileSize != mSize ||
+      header->nEntries > (mSize - sizeof(Header)) / sizeof(Record)) {
+    return kFALSE;
+  }
+  const Record *records = getRecords();
+  for (UInt_t i = 0; i < header->nEntries; i++) {
+    if (records[i].pathOffset + records[i].pathLength > mSize || records[i].dataOffset > mSize ||
+        records[i].dataSize > mSize - records[i].dataOffset) {
+      return kFALSE;
+    }
+  }
+  return kTRUE;
+}
+
+void ConditionSnapshot::close()
+{
+  if (mData) {
+    munmap(const_cast<char *>(mData), mSize);
+    mData = nullptr;
+    mSize = 0;
+  }
+}
+
+Int_t ConditionSnapshot::getRun() const
+{
+  return mData ? getHeader()->run : -1;
+}
+
+UInt_t ConditionSnapshot::getNumberOfConditions() const
+{
+  return mData ? getHeader()->nEntries : 0;
+}
+
+Condition *ConditionSnapshot::getCondition(const char *path) const
+{
+  if (!mData) {
+    return nullptr;
+  }
+
+  // the records are sorted by path, as the map they were written from
+  size_t pathLength = strlen(path);
+  auto comparePath = [this](const Record &record, const char *path, size_t pathLength) {
+    size_t length = std::min<size_t>(record.pathLength, pathLength);
+    int result = memcmp(mData + record.pathOffset, path, length);
+    return result != 0 ? result : (record.pathLength < pathLength ? -1 : record.pathLength > pathLength ? 1 : 0);
+  };
+  const Record *begin = getRecords();
+  const Record *end = begin + getHeader()->nEntries;
+  const Record *record = std::lower_bound(begin, end, path, [&](const Record &record, const char *path) {
+    return comparePath(record, path, pathLength) < 0;
+  });
+  if (record == end || comparePath(*record, path, pathLength) != 0) {
+    return nullptr;
+  }
+
+  // the buffer reads from the mapped bytes without copying nor owning them
+  TBufferFile buffer(TBuffer::kRead, record->dataSize, const_cast<char *>(mData + record->dataOffset), kFALSE);
+  return dynamic_cast<Condition *>(buffer.ReadObject(Condition::Class()));
+}
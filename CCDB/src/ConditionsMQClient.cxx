@@ -15,8 +15,13 @@
 #include <boost/thread.hpp>
 #include <boost/bind.hpp>
 
+#include <chrono>
+#include <cstring>
+#include <thread>
+
 #include "CCDB/BackendOCDB.h"
 #include "CCDB/BackendRiak.h"
+#include "CCDB/Condition.h"
 #include "CCDB/ConditionsMQClient.h"
 #include "FairMQLogger.h"
 #include "FairMQProgOptions.h"
@@ -26,7 +31,16 @@
 using namespace AliceO2::CDB;
 using namespace std;
 
-ConditionsMQClient::ConditionsMQClient() : fRunId(0), fParameterName() {}
+ConditionsMQClient::ConditionsMQClient()
+  : fRunId(0),
+    fParameterName(),
+    fBatchSize(64),
+    fPipelineDepth(8),
+    fCompressionLevel(-1),
+    fStopped(false),
+    fNextTag(0)
+{
+}
 
 ConditionsMQClient::~ConditionsMQClient() {}
 
@@ -38,9 +52,260 @@ void ConditionsMQClient::InitTask()
   fOperationType = fConfig->GetValue<string>("operation-type");
   fDataSource = fConfig->GetValue<string>("data-source");
   fObjectPath = fConfig->GetValue<string>("object-path");
+  fBatchSize = max(fConfig->GetValue<int>("batch-size"), 1);
+  fPipelineDepth = max(fConfig->GetValue<int>("pipeline-depth"), 1);
+  fCompressionLevel = fConfig->GetValue<int>("compression-level");
+}
+
+void ConditionsMQClient::getConditions(const vector<ConditionKey>& keys, Callback callback)
+{
+  Conditions conditions(keys.size());
+  bool prefetched = true;
+  {
+    lock_guard<mutex> lock(fMutex);
+    if (!fStopped) {
+      for (size_t i = 0; i < keys.size(); i++) {
+        fCalibrationSet.insert(keys[i].first);
+        auto run = fPrefetched.find(keys[i].second);
+        if (run != fPrefetched.end()) {
+          auto condition = run->second.find(keys[i].first);
+          if (condition != run->second.end()) {
+            conditions[i] = condition->second;
+            continue;
+          }
+        }
+        prefetched = false;
+      }
+      if (!prefetched) {
+        fSubmitted.push_back(Request{ keys, std::move(callback) });
+        return;
+      }
+    }
+  }
+  // all conditions prefetched, or null conditions once the device stopped
+  callback(conditions);
+}
+
+future<ConditionsMQClient::Conditions> ConditionsMQClient::getConditions(const vector<ConditionKey>& keys)
+{
+  auto promise = make_shared<std::promise<Conditions>>();
+  future<Conditions> result = promise->get_future();
+  getConditions(keys, [promise](const Conditions& conditions) { promise->set_value(conditions); });
+  return result;
+}
+
+void ConditionsMQClient::prefetch(int run)
+{
+  vector<ConditionKey> keys;
+  {
+    lock_guard<mutex> lock(fMutex);
+    if (fStopped || fPrefetched.count(run) > 0) {
+      return;
+    }
+    fPrefetched[run];
+    fPrefetchOrder.push_back(run);
+    while (fPrefetchOrder.size() > 2) {
+      fPrefetched.erase(fPrefetchOrder.front());
+      fPrefetchOrder.pop_front();
+    }
+    for (const auto& path : fCalibrationSet) {
+      keys.emplace_back(path, run);
+    }
+  }
+  if (keys.empty()) {
+    return;
+  }
+
+  LOG(DEBUG) << "Prefetching " << keys.size() << " conditions for run " << run;
+  getConditions(keys, [this, keys, run](const Conditions& conditions) {
+    lock_guard<mutex> lock(fMutex);
+    auto prefetched = fPrefetched.find(run);
+    if (prefetched == fPrefetched.end()) {
+      return;
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (conditions[i]) {
+        prefetched->second[keys[i].first] = conditions[i];
+      }
+    }
+  });
+}
+
+void ConditionsMQClient::sendRequests()
+{
+  BackendOCDB backend;
+
+  while (static_cast<int>(fPending.size()) < fPipelineDepth) {
+    Request request;
+    {
+      lock_guard<mutex> lock(fMutex);
+      if (fSubmitted.empty()) {
+        return;
+      }
+      request = std::move(fSubmitted.front());
+      fSubmitted.pop_front();
+    }
+
+    // the server expects the keys as "/DET/Calib/Histo/Run2008_2008"
+    vector<string> keys;
+    for (const auto& key : request.keys) {
+      keys.push_back(key.first + "/Run" + to_string(key.second) + "_" + to_string(key.second));
+    }
+    string* messageString = new string();
+    backend.Serialize(messageString, keys, "GET", fDataSource);
+
+    // dealer socket: the empty delimiter expected by the router, the tag and the request
+    uint64_t tag = fNextTag++;
+    FairMQParts parts;
+    parts.AddPart(NewMessage());
+    parts.AddPart(NewMessage(sizeof(tag)));
+    memcpy(parts.At(1)->GetData(), &tag, sizeof(tag));
+    parts.AddPart(NewMessage(const_cast<char*>(messageString->c_str()), messageString->length(), CustomCleanup,
+                             messageString));
+
+    if (Send(parts, "data-get") < 0) {
+      LOG(ERROR) << "Could not send a request of " << keys.size() << " conditions";
+      request.callback(Conditions(request.keys.size()));
+      continue;
+    }
+    fPending.emplace(tag, std::move(request));
+  }
+}
+
+void ConditionsMQClient::handleReply(FairMQParts& reply)
+{
+  if (reply.Size() < 2 || reply.At(1)->GetSize() != sizeof(uint64_t)) {
+    LOG(ERROR) << "Unexpected reply with " << reply.Size() << " parts";
+    return;
+  }
+  uint64_t tag;
+  memcpy(&tag, reply.At(1)->GetData(), sizeof(tag));
+  auto pending = fPending.find(tag);
+  if (pending == fPending.end()) {
+    LOG(ERROR) << "Reply to an unknown request " << tag;
+    return;
+  }
+  Request request = std::move(pending->second);
+  fPending.erase(pending);
+
+  // one part per key after the delimiter and the tag, an empty part for a key without condition
+  Conditions conditions(request.keys.size());
+  if (static_cast<size_t>(reply.Size() - 2) != request.keys.size()) {
+    LOG(ERROR) << "Reply with " << reply.Size() - 2 << " conditions to a request of " << request.keys.size();
+  } else {
+    for (size_t i = 0; i < conditions.size(); i++) {
+      FairMQMessage* part = reply.At(i + 2).get();
+      conditions[i].reset(BackendOCDB::UnPackCondition(part->GetData(), part->GetSize()));
+    }
+  }
+  request.callback(conditions);
+}
+
+void ConditionsMQClient::cancelRequests()
+{
+  deque<Request> submitted;
+  {
+    lock_guard<mutex> lock(fMutex);
+    fStopped = true;
+    submitted.swap(fSubmitted);
+    fPrefetched.clear();
+    fPrefetchOrder.clear();
+  }
+  for (auto& request : submitted) {
+    request.callback(Conditions(request.keys.size()));
+  }
+  for (auto& pending : fPending) {
+    pending.second.callback(Conditions(pending.second.keys.size()));
+  }
+  fPending.clear();
 }
 
 void ConditionsMQClient::Run()
+{
+  if (fDataSource != "OCDB" || fOperationType != "GET") {
+    processSequentially();
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock(fMutex);
+    fStopped = false;
+  }
+  thread producer(&ConditionsMQClient::getObjectPathConditions, this);
+
+  while (CheckCurrentState(RUNNING)) {
+    sendRequests();
+
+    // the submissions of the other threads can't wake up the socket, the timeout is kept short
+    FairMQParts reply;
+    if (Receive(reply, "data-get", 0, 5) > 0) {
+      handleReply(reply);
+    }
+  }
+
+  cancelRequests();
+  producer.join();
+}
+
+void ConditionsMQClient::getObjectPathConditions()
+{
+  boost::filesystem::path dataPath(fObjectPath);
+  if (!boost::filesystem::exists(dataPath) || !boost::filesystem::is_directory(dataPath)) {
+    LOG(ERROR) << "Path " << fObjectPath << " not existing or not a directory";
+    return;
+  }
+
+  // Traverse the filesystem and retrieve the path and run of each root file found, i.e.
+  // "<object-path>/DET/Calib/Histo/Run2008_2008_v1_s0.root" gives (/DET/Calib/Histo, 2008)
+  map<int, vector<string>> pathsByRun;
+  for (boost::filesystem::recursive_directory_iterator directoryIterator(dataPath), endIterator;
+       directoryIterator != endIterator; ++directoryIterator) {
+    if (boost::filesystem::is_regular_file(directoryIterator->status())) {
+      string str = directoryIterator->path().string();
+      str.erase(0, fObjectPath.length());
+      size_t pos = str.rfind("/");
+      if (pos == string::npos || str.compare(pos, 4, "/Run") != 0) {
+        continue;
+      }
+      pathsByRun[atoi(str.c_str() + pos + 4)].push_back(str.substr(0, pos));
+    }
+  }
+
+  for (auto run = pathsByRun.begin(); run != pathsByRun.end(); ++run) {
+    boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::local_time();
+
+    vector<future<Conditions>> replies;
+    for (size_t first = 0; first < run->second.size(); first += fBatchSize) {
+      vector<ConditionKey> keys;
+      for (size_t i = first; i < min(first + fBatchSize, run->second.size()); i++) {
+        keys.emplace_back(run->second[i], run->first);
+      }
+      replies.push_back(getConditions(keys));
+    }
+
+    // the calibration set of the next run is fetched while the conditions of this run are processed
+    if (next(run) != pathsByRun.end()) {
+      prefetch(next(run)->first);
+    }
+
+    size_t found = 0;
+    for (auto& reply : replies) {
+      for (const auto& condition : reply.get()) {
+        if (condition) {
+          LOG(DEBUG) << "Received a condition from the server:";
+          condition->printConditionMetaData();
+          found++;
+        }
+      }
+    }
+
+    boost::posix_time::ptime endTime = boost::posix_time::microsec_clock::local_time();
+    LOG(DEBUG) << "Run " << run->first << ": " << found << " of " << run->second.size() << " conditions in "
+               << replies.size() << " requests, time elapsed: " << (endTime - startTime).total_milliseconds() << "ms";
+  }
+}
+
+void ConditionsMQClient::processSequentially()
 {
   Backend* backend;
 
@@ -52,7 +317,7 @@ void ConditionsMQClient::Run()
     if (fDataSource == "OCDB") {
       backend = new BackendOCDB();
     } else if (fDataSource == "Riak") {
-      backend = new BackendRiak();
+      backend = new BackendRiak(fCompressionLevel);
     } else {
       LOG(ERROR) << "\"" << fDataSource << "\" is not a valid Data Source";
       return;
@@ -77,14 +342,17 @@ void ConditionsMQClient::Run()
             std::string* messageString = new string();
             backend->Serialize(messageString, key, fOperationType, fDataSource);
 
-            unique_ptr<FairMQMessage> request(fTransportFactory->CreateMessage(
-              const_cast<char*>(messageString->c_str()), messageString->length(), CustomCleanup, messageString));
-            unique_ptr<FairMQMessage> reply(fTransportFactory->CreateMessage());
+            // dealer socket: the empty delimiter expected by the router and the request
+            FairMQParts request;
+            request.AddPart(NewMessage());
+            request.AddPart(NewMessage(const_cast<char*>(messageString->c_str()), messageString->length(),
+                                       CustomCleanup, messageString));
+            FairMQParts reply;
 
-            if (fChannels.at("data-get").at(0).Send(request) > 0) {
-              if (fChannels.at("data-get").at(0).Receive(reply) > 0) {
-                LOG(DEBUG) << "Received a condition with a size of " << reply->GetSize();
-                backend->UnPack(std::move(reply));
+            if (Send(request, "data-get") > 0) {
+              if (Receive(reply, "data-get") > 0 && reply.Size() > 1) {
+                LOG(DEBUG) << "Received a condition with a size of " << reply.At(reply.Size() - 1)->GetSize();
+                backend->UnPack(std::move(reply.At(reply.Size() - 1)));
               }
             }
           } else if (fOperationType == "PUT") {
@@ -104,6 +372,8 @@ void ConditionsMQClient::Run()
       LOG(ERROR) << "Path " << fObjectPath << " not existing or not a directory";
     }
 
+    delete backend;
+
     boost::posix_time::ptime endTime = boost::posix_time::microsec_clock::local_time();
     LOG(DEBUG) << " Time elapsed: " << (endTime - startTime).total_milliseconds() << "ms";
   }
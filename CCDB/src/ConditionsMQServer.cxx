@@ -13,13 +13,17 @@
  */
 
 #include "TMessage.h"
+#include "TROOT.h"
 #include "Rtypes.h"
 
 #include "CCDB/Condition.h"
+#include "CCDB/ConditionId.h"
 #include "CCDB/ConditionsMQServer.h"
 #include "CCDB/IdPath.h"
 #include "FairMQLogger.h"
+#include "FairMQParts.h"
 #include "FairMQPoller.h"
+#include "FairMQProgOptions.h"
 
 // Google protocol buffers headers
 #include <google/protobuf/stubs/common.h>
@@ -27,12 +31,36 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
+
 using namespace AliceO2::CDB;
 using std::endl;
 using std::cout;
 using std::string;
 
-ConditionsMQServer::ConditionsMQServer() : ParameterMQServer(), fCdbManager(AliceO2::CDB::Manager::Instance()) {}
+ConditionsMQServer::ConditionsMQServer()
+  : ParameterMQServer(),
+    fCdbManager(AliceO2::CDB::Manager::Instance()),
+    fCdbManagerMutex(),
+    fNumberOfWorkers(4),
+    fResponseCacheSize(10000),
+    fResponseCacheTtl(std::chrono::seconds(60)),
+    fWorkers(),
+    fQueueMutex(),
+    fQueueCondition(),
+    fQueue(),
+    fCompleted(),
+    fStopWorkers(false),
+    fInFlight(),
+    fResponseCache(),
+    fResponseCacheOrder(),
+    fResponsesById(),
+    fBrokerQueue(),
+    fBrokerBusy(false),
+    fStatisticsMutex(),
+    fStatistics()
+{
+}
 
 void ConditionsMQServer::InitTask()
 {
@@ -53,9 +81,17 @@ void ConditionsMQServer::InitTask()
       fCdbManager->setDefaultStorage(GetProperty(OutputName, "").c_str());
     }
   }
+
+  fNumberOfWorkers = std::max(fConfig->GetValue<int>("workers"), 1);
+  fResponseCacheSize = std::max(fConfig->GetValue<int>("response-cache-size"), 1);
+  fResponseCacheTtl = std::chrono::seconds(std::max(fConfig->GetValue<int>("response-cache-ttl"), 0));
+
+  // the objects are streamed by the workers, the messages released by the transport threads
+  ROOT::EnableThreadSafety();
 }
 
-void free_tmessage(void* data, void* hint) { delete static_cast<TMessage*>(hint); }
+/// releases the reference of a message to a shared serialized condition
+void release_response(void* data, void* hint) { delete static_cast<std::shared_ptr<TMessage>*>(hint); }
 
 void ConditionsMQServer::ParseDataSource(std::string& dataSource, const std::string& data)
 {
@@ -69,12 +105,16 @@ void ConditionsMQServer::ParseDataSource(std::string& dataSource, const std::str
   delete msgReply;
 }
 
-void ConditionsMQServer::Deserialize(const std::string& messageString, std::string& object)
+void ConditionsMQServer::Deserialize(const std::string& messageString, std::vector<std::string>& keys)
 {
   messaging::RequestMessage* requestMessage = new messaging::RequestMessage;
   requestMessage->ParseFromString(messageString);
 
-  object.assign(requestMessage->key());
+  if (requestMessage->keys_size() > 0) {
+    keys.assign(requestMessage->keys().begin(), requestMessage->keys().end());
+  } else {
+    keys.assign(1, requestMessage->key());
+  }
 
   delete requestMessage;
 }
@@ -84,14 +124,27 @@ void ConditionsMQServer::Run()
   std::unique_ptr<FairMQPoller> poller(
     fTransportFactory->CreatePoller(fChannels, { "data-put", "data-get", "broker-get" }));
 
+  startWorkers();
+  Clock::time_point lastReport = Clock::now();
+
   while (CheckCurrentState(RUNNING)) {
 
-    poller->Poll(-1);
+    // the workers can't wake up the poller, it returns early while retrievals are in flight
+    poller->Poll(fInFlight.empty() ? 100 : 1);
 
     if (poller->CheckInput("data-get", 0)) {
-      std::unique_ptr<FairMQMessage> input(fTransportFactory->CreateMessage());
-
-      if (Receive(input, "data-get") > 0) {
+      // router socket: the identity of the client, an empty delimiter, optionally a tag and the request
+      FairMQParts request;
+
+      bool received = Receive(request, "data-get") > 0;
+      if (received && request.Size() < 3) {
+        LOG(ERROR) << "Unexpected request with " << request.Size() << " parts";
+      } else if (received) {
+        Client client{ {}, Clock::now() };
+        for (int i = 0; i < request.Size() - 1; i++) {
+          client.envelope.push_back(std::move(request.At(i)));
+        }
+        FairMQMessage* input = request.At(request.Size() - 1).get();
         std::string serialString(static_cast<char*>(input->GetData()), input->GetSize());
 
         //LOG(DEBUG) << "Received a GET client message: " << serialString;
@@ -100,14 +153,26 @@ void ConditionsMQServer::Run()
         ParseDataSource(dataSource, serialString);
 
         if (dataSource == "OCDB") {
-          // Retrieve the key from the serialized message
-          std::string key;
-          Deserialize(serialString, key);
-
-          getFromOCDB(key);
+          // Retrieve the keys from the serialized message
+          std::vector<std::string> keys;
+          Deserialize(serialString, keys);
+
+          std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+          batch->client = std::move(client);
+          batch->responses.resize(keys.size());
+          batch->pending = keys.size() + 1; // the reply is held back until all keys are handed out
+          if (keys.size() > 1) {
+            std::lock_guard<std::mutex> lock(fStatisticsMutex);
+            fStatistics.batches++;
+          }
+          for (size_t slot = 0; slot < keys.size(); slot++) {
+            getFromOCDB(keys[slot], batch, slot);
+          }
+          resolve(*batch, keys.size(), nullptr);
         } else if (dataSource == "Riak") {
           // No need to de-serialize, just forward message to the broker
-          fChannels.at("broker-get").at(0).Send(input);
+          fBrokerQueue.emplace_back(std::move(client), std::move(request.At(request.Size() - 1)));
+          forwardToBroker();
         }
       }
     }
@@ -138,14 +203,74 @@ void ConditionsMQServer::Run()
       if (Receive(input, "broker-get") > 0) {
         LOG(DEBUG) << "Received object from broker with a size of: " << input->GetSize();
 
-        fChannels.at("data-get").at(0).Send(input);
+        if (!fBrokerQueue.empty()) {
+          std::vector<std::unique_ptr<FairMQMessage>> payload;
+          payload.push_back(std::move(input));
+          reply(fBrokerQueue.front().first, payload);
+          fBrokerQueue.pop_front();
+        }
+        fBrokerBusy = false;
+        forwardToBroker();
+      }
+    }
+
+    completeRetrievals();
+
+    if (Clock::now() - lastReport > std::chrono::seconds(10)) {
+      printStatistics();
+      lastReport = Clock::now();
+    }
+  }
+
+  stopWorkers();
+  completeRetrievals();
+  printStatistics();
+}
+
+void ConditionsMQServer::startWorkers()
+{
+  fStopWorkers = false;
+  for (int i = 0; i < fNumberOfWorkers; i++) {
+    fWorkers.emplace_back(&ConditionsMQServer::workerLoop, this);
+  }
+}
+
+void ConditionsMQServer::stopWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(fQueueMutex);
+    fStopWorkers = true;
+  }
+  fQueueCondition.notify_all();
+  for (auto& worker : fWorkers) {
+    worker.join();
+  }
+  fWorkers.clear();
+}
+
+void ConditionsMQServer::workerLoop()
+{
+  while (true) {
+    std::shared_ptr<Retrieval> retrieval;
+    {
+      std::unique_lock<std::mutex> lock(fQueueMutex);
+      fQueueCondition.wait(lock, [this]() { return fStopWorkers || !fQueue.empty(); });
+      if (fQueue.empty()) {
+        return;
       }
+      retrieval = fQueue.front();
+      fQueue.pop_front();
     }
+
+    retrieve(*retrieval);
+
+    std::lock_guard<std::mutex> lock(fQueueMutex);
+    fCompleted.push_back(retrieval);
   }
 }
 
 // Query OCDB for the condition
-void ConditionsMQServer::getFromOCDB(std::string key)
+void ConditionsMQServer::getFromOCDB(std::string key, const std::shared_ptr<Batch>& batch, size_t slot)
 {
   // Change key from i.e. "/DET/Calib/Histo/Run2008_2008_v1_s0" to (DET/Calib/Histo, 2008)
   // FIXME: This will have to be changed in the future by adapting IdPath and getObject accordingly
@@ -155,24 +280,246 @@ void ConditionsMQServer::getFromOCDB(std::string key)
   std::size_t pos2 = key.find("_");
   int runId = atoi(key.substr(0, pos2).c_str());
 
-  Condition* aCondition = nullptr;
+  std::string cacheKey = identifier + "@" + std::to_string(runId);
+  {
+    std::lock_guard<std::mutex> lock(fStatisticsMutex);
+    fStatistics.requests++;
+  }
 
-  fCdbManager->setRun(runId);
-  aCondition = fCdbManager->getObject(IdPath(identifier), runId);
+  // answered from the cache without streaming the object again
+  auto cached = fResponseCache.find(cacheKey);
+  Response staleResponse;
+  std::string staleId;
+  if (cached != fResponseCache.end()) {
+    if (Clock::now() < cached->second.expires) {
+      {
+        std::lock_guard<std::mutex> lock(fStatisticsMutex);
+        fStatistics.cacheHits++;
+      }
+      resolve(*batch, slot, cached->second.response);
+      return;
+    }
+    // expired: the retrieval checks whether a newer version was stored meanwhile
+    staleResponse = cached->second.response;
+    staleId = cached->second.id;
+  }
 
-  if (aCondition) {
-    LOG(DEBUG) << "Sending following parameter to the client:";
-    aCondition->printConditionMetaData();
-    TMessage* tmsg = new TMessage(kMESS_OBJECT);
-    tmsg->WriteObject(aCondition);
+  // waiting for the retrieval in flight for the same object
+  auto inFlight = fInFlight.find(cacheKey);
+  if (inFlight != fInFlight.end()) {
+    {
+      std::lock_guard<std::mutex> lock(fStatisticsMutex);
+      fStatistics.coalesced++;
+    }
+    inFlight->second->waiting.emplace_back(batch, slot);
+    return;
+  }
+
+  std::shared_ptr<Retrieval> retrieval = std::make_shared<Retrieval>();
+  retrieval->path = identifier;
+  retrieval->run = runId;
+  retrieval->waiting.emplace_back(batch, slot);
+  retrieval->staleResponse = staleResponse;
+  retrieval->staleId = staleId;
+  fInFlight[cacheKey] = retrieval;
+  {
+    std::lock_guard<std::mutex> lock(fStatisticsMutex);
+    fStatistics.retrievals++;
+    fStatistics.revalidations += staleResponse ? 1 : 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(fQueueMutex);
+    fQueue.push_back(retrieval);
+  }
+  fQueueCondition.notify_one();
+}
 
-    std::unique_ptr<FairMQMessage> message(
-      fTransportFactory->CreateMessage(tmsg->Buffer(), tmsg->BufferSize(), free_tmessage, tmsg));
+void ConditionsMQServer::resolve(Batch& batch, size_t slot, const Response& response)
+{
+  if (slot < batch.responses.size()) {
+    batch.responses[slot] = response;
+  }
+  if (--batch.pending > 0) {
+    return;
+  }
+
+  // an empty part tells the client that the condition was not found
+  std::vector<std::unique_ptr<FairMQMessage>> payload;
+  for (const auto& partResponse : batch.responses) {
+    payload.emplace_back(partResponse ? createMessage(partResponse)
+                                      : std::unique_ptr<FairMQMessage>(fTransportFactory->CreateMessage()));
+  }
+  reply(batch.client, payload);
+}
 
-    fChannels.at("data-get").at(0).Send(message);
+void ConditionsMQServer::retrieve(Retrieval& retrieval)
+{
+  // the Manager is locked for the lookup only, the object is pinned and streamed outside of the lock
+  std::shared_ptr<Condition> aCondition;
+  std::string id;
+  {
+    std::lock_guard<std::mutex> lock(fCdbManagerMutex);
+    ConditionId query(IdPath(retrieval.path.c_str()), retrieval.run, retrieval.run, -1, -1);
+
+    if (retrieval.staleResponse) {
+      // the expired response is kept if its version is still the valid one in the storage
+      std::unique_ptr<ConditionId> current(fCdbManager->getIdFromStorage(query));
+      if (current && retrieval.staleId == current->ToString().Data()) {
+        retrieval.response = retrieval.staleResponse;
+        retrieval.id = retrieval.staleId;
+        return;
+      }
+      if (current) {
+        // a newer version was stored, the object cached by the Manager is outdated
+        fCdbManager->unloadFromCache(retrieval.path.c_str());
+        std::lock_guard<std::mutex> statisticsLock(fStatisticsMutex);
+        fStatistics.updates++;
+      }
+    }
+
+    // no setRun: the run range cache of the Manager serves the clients of all runs
+    try {
+      aCondition = fCdbManager->getSharedObject(query);
+    } catch (std::exception& e) {
+      LOG(ERROR) << e.what();
+    }
+
+    if (!aCondition) {
+      LOG(ERROR) << "Could not get a condition for \"" << retrieval.path << "\" and run " << retrieval.run << "!";
+      return;
+    }
+
+    // the same object is valid for other runs, it is streamed once
+    id = aCondition->getId().ToString().Data();
+    retrieval.id = id;
+    retrieval.response = fResponsesById[id].lock();
+    if (retrieval.response) {
+      return;
+    }
+  }
+
+  LOG(DEBUG) << "Sending following parameter to the client:";
+  aCondition->printConditionMetaData();
+  Response response = std::make_shared<TMessage>(kMESS_OBJECT);
+  response->WriteObject(aCondition.get());
+  response->SetLength();
+
+  std::lock_guard<std::mutex> lock(fCdbManagerMutex);
+  // another worker may have streamed the same object meanwhile, its message is shared
+  std::weak_ptr<TMessage>& shared = fResponsesById[id];
+  retrieval.response = shared.lock();
+  if (!retrieval.response) {
+    retrieval.response = response;
+    shared = response;
+  }
+
+  if (fResponsesById.size() > 2 * fResponseCacheSize) {
+    for (auto it = fResponsesById.begin(); it != fResponsesById.end();) {
+      it = it->second.expired() ? fResponsesById.erase(it) : std::next(it);
+    }
+  }
+}
+
+void ConditionsMQServer::completeRetrievals()
+{
+  std::deque<std::shared_ptr<Retrieval>> completed;
+  {
+    std::lock_guard<std::mutex> lock(fQueueMutex);
+    completed.swap(fCompleted);
+  }
+
+  for (auto& retrieval : completed) {
+    std::string cacheKey = retrieval->path + "@" + std::to_string(retrieval->run);
+    fInFlight.erase(cacheKey);
+    if (retrieval->response) {
+      cacheResponse(cacheKey, retrieval->response, retrieval->id);
+    } else {
+      std::lock_guard<std::mutex> lock(fStatisticsMutex);
+      fStatistics.failures += retrieval->waiting.size();
+    }
+
+    for (auto& waiting : retrieval->waiting) {
+      resolve(*waiting.first, waiting.second, retrieval->response);
+    }
+  }
+}
+
+void ConditionsMQServer::cacheResponse(const std::string& key, const Response& response, const std::string& id)
+{
+  // a ttl of 0 keeps the responses until they are evicted
+  Clock::time_point expires =
+    fResponseCacheTtl > Clock::duration::zero() ? Clock::now() + fResponseCacheTtl : Clock::time_point::max();
+  auto inserted = fResponseCache.insert(std::make_pair(key, CachedResponse{ response, id, expires }));
+  if (!inserted.second) {
+    // a revalidated response keeps its place in the order of the eviction
+    inserted.first->second = CachedResponse{ response, id, expires };
+    return;
+  }
+  fResponseCacheOrder.push_back(key);
+  while (fResponseCache.size() > fResponseCacheSize) {
+    fResponseCache.erase(fResponseCacheOrder.front());
+    fResponseCacheOrder.pop_front();
+  }
+}
+
+std::unique_ptr<FairMQMessage> ConditionsMQServer::createMessage(const Response& response)
+{
+  // no copy, the message holds a reference to the serialized condition until it is sent
+  return std::unique_ptr<FairMQMessage>(fTransportFactory->CreateMessage(
+    response->Buffer(), response->Length(), release_response, new Response(response)));
+}
+
+void ConditionsMQServer::reply(Client& client, std::vector<std::unique_ptr<FairMQMessage>>& payload)
+{
+  FairMQParts parts;
+  for (auto& frame : client.envelope) {
+    parts.AddPart(std::move(frame));
+  }
+  for (auto& part : payload) {
+    parts.AddPart(std::move(part));
+  }
+  Send(parts, "data-get");
+
+  uint64_t latencyUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - client.received).count();
+  std::lock_guard<std::mutex> lock(fStatisticsMutex);
+  fStatistics.replies++;
+  fStatistics.latencySumUs += latencyUs;
+  fStatistics.latencyMaxUs = std::max(fStatistics.latencyMaxUs, latencyUs);
+}
+
+void ConditionsMQServer::forwardToBroker()
+{
+  // the req socket of the broker takes the next request after the reply to the previous one
+  if (fBrokerBusy || fBrokerQueue.empty()) {
+    return;
+  }
+  std::unique_ptr<FairMQMessage>& request = fBrokerQueue.front().second;
+  if (fChannels.at("broker-get").at(0).Send(request) > 0) {
+    fBrokerBusy = true;
   } else {
-    LOG(ERROR) << "Could not get a condition for \"" << key << "\" and run " << runId << "!";
+    LOG(ERROR) << "Could not forward the request to the broker";
+    std::vector<std::unique_ptr<FairMQMessage>> payload;
+    payload.emplace_back(fTransportFactory->CreateMessage());
+    reply(fBrokerQueue.front().first, payload);
+    fBrokerQueue.pop_front();
   }
 }
 
+ConditionsMQServer::Statistics ConditionsMQServer::getStatistics() const
+{
+  std::lock_guard<std::mutex> lock(fStatisticsMutex);
+  return fStatistics;
+}
+
+void ConditionsMQServer::printStatistics() const
+{
+  Statistics statistics = getStatistics();
+  LOG(INFO) << "Requests: " << statistics.requests << " (" << statistics.batches << " batches), cache hits: " << statistics.cacheHits
+            << ", retrievals: " << statistics.retrievals << " (" << statistics.revalidations << " revalidations, "
+            << statistics.updates << " updates), coalesced: " << statistics.coalesced
+            << ", failures: " << statistics.failures << ", mean latency: "
+            << (statistics.replies > 0 ? statistics.latencySumUs / statistics.replies : 0)
+            << " us, max latency: " << statistics.latencyMaxUs << " us";
+}
+
 ConditionsMQServer::~ConditionsMQServer() { delete fCdbManager; }
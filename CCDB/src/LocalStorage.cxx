@@ -6,13 +6,15 @@
 #include <TObjString.h>         // for TObjString
 #include <TRegexp.h>            // for TRegexp
 #include <TSystem.h>            // for TSystem, gSystem
+#include <vector>               // for vector
 #include "CCDB/Condition.h"          // for Condition
+#include "CCDB/LocalStorageIndex.h"  // for LocalStorageIndex
 
 using namespace AliceO2::CDB;
 
 ClassImp(LocalStorage)
 
-LocalStorage::LocalStorage(const char *baseDir) : mBaseDirectory(baseDir)
+LocalStorage::LocalStorage(const char *baseDir) : mBaseDirectory(baseDir), mIndex(new LocalStorageIndex(baseDir))
 {
   // constructor
 
@@ -37,6 +39,7 @@ LocalStorage::LocalStorage(const char *baseDir) : mBaseDirectory(baseDir)
 LocalStorage::~LocalStorage()
 {
   // destructor
+  delete mIndex;
 }
 
 Bool_t LocalStorage::filenameToId(const char *filename, IdRunRange &runRange, Int_t &version, Int_t &subVersion)
@@ -119,40 +122,33 @@ Bool_t LocalStorage::prepareId(ConditionId &id)
     }
   }
 
-  const char *filename;
+  gSystem->FreeDirectory(dirPtr);
+
+  std::vector<LocalStorageIndex::Entry> entries; // the files of the path
+  mIndex->getEntries(id.getPathString(), entries);
+
   IdRunRange aIdRunRange;                         // the runRange got from filename
   IdRunRange lastIdRunRange(-1, -1);              // highest runRange found
-  Int_t aVersion, aSubVersion;                // the version subVersion got from filename
   Int_t lastVersion = 0, lastSubVersion = -1; // highest version and subVersion found
 
   if (!id.hasVersion()) { // version not specified: look for highest version & subVersion
 
-    while ((filename = gSystem->GetDirEntry(dirPtr))) { // loop on the files
-
-      TString aString(filename);
-      if (aString == "." || aString == "..") {
-        continue;
-      }
-
-      if (!filenameToId(filename, aIdRunRange, aVersion, aSubVersion)) {
-        LOG(DEBUG) << "Bad filename <" << filename << ">! I'll skip it." << FairLogger::endl;
-        continue;
-      }
-
+    for (const auto &entry : entries) { // loop on the files
+      aIdRunRange.setIdRunRange(entry.firstRun, entry.lastRun);
       if (!aIdRunRange.isOverlappingWith(id.getIdRunRange())) {
         continue;
       }
-      if (aVersion < lastVersion) {
+      if (entry.version < lastVersion) {
         continue;
       }
-      if (aVersion > lastVersion) {
+      if (entry.version > lastVersion) {
         lastSubVersion = -1;
       }
-      if (aSubVersion < lastSubVersion) {
+      if (entry.subVersion < lastSubVersion) {
         continue;
       }
-      lastVersion = aVersion;
-      lastSubVersion = aSubVersion;
+      lastVersion = entry.version;
+      lastSubVersion = entry.subVersion;
       lastIdRunRange = aIdRunRange;
     }
 
@@ -161,21 +157,11 @@ Bool_t LocalStorage::prepareId(ConditionId &id)
 
   } else { // version specified, look for highest subVersion only
 
-    while ((filename = gSystem->GetDirEntry(dirPtr))) { // loop on the files
-
-      TString aString(filename);
-      if (aString == "." || aString == "..") {
-        continue;
-      }
-
-      if (!filenameToId(filename, aIdRunRange, aVersion, aSubVersion)) {
-        LOG(DEBUG) << "Bad filename <" << filename << ">!I'll skip it." << FairLogger::endl;
-        continue;
-      }
-
-      if (aIdRunRange.isOverlappingWith(id.getIdRunRange()) && aVersion == id.getVersion() &&
-          aSubVersion > lastSubVersion) {
-        lastSubVersion = aSubVersion;
+    for (const auto &entry : entries) { // loop on the files
+      aIdRunRange.setIdRunRange(entry.firstRun, entry.lastRun);
+      if (aIdRunRange.isOverlappingWith(id.getIdRunRange()) && entry.version == id.getVersion() &&
+          entry.subVersion > lastSubVersion) {
+        lastSubVersion = entry.subVersion;
         lastIdRunRange = aIdRunRange;
       }
     }
@@ -183,8 +169,6 @@ Bool_t LocalStorage::prepareId(ConditionId &id)
     id.setSubVersion(lastSubVersion + 1);
   }
 
-  gSystem->FreeDirectory(dirPtr);
-
   TString lastStorage = id.getLastStorage();
   if (lastStorage.Contains(TString("grid"), TString::kIgnoreCase) && id.getSubVersion() > 0) {
     LOG(ERROR) << "GridStorage to LocalStorage Storage error! local object with version v" << id.getVersion() << "_s"
@@ -231,146 +215,33 @@ ConditionId *LocalStorage::getId(const ConditionId &query)
     return result;
   }
 
-  // otherwise browse in the local filesystem CDB storage
-  TString dirName = Form("%s/%s", mBaseDirectory.Data(), query.getPathString().Data());
+  // otherwise look up the index of the files in the local filesystem CDB storage
+  LocalStorageIndex::Entry entry;
+  LocalStorageIndex::Status status =
+    mIndex->find(query.getPathString(), query.getIdRunRange(), query.getVersion(), query.getSubVersion(), entry);
 
-  void *dirPtr = gSystem->OpenDirectory(dirName);
-  if (!dirPtr) {
+  if (status == LocalStorageIndex::kNoDirectory) {
     LOG(DEBUG) << "Directory <" << (query.getPathString()).Data() << "> not found" << FairLogger::endl;
     LOG(DEBUG) << "in DB folder " << mBaseDirectory.Data() << FairLogger::endl;
     return NULL;
   }
 
-  const char *filename;
+  if (status == LocalStorageIndex::kAmbiguous) {
+    LOG(ERROR) << "More than one object valid for run " << query.getFirstRun() << " version " << entry.version << "_"
+               << entry.subVersion << "!" << FairLogger::endl;
+    return NULL;
+  }
+
   ConditionId *result = new ConditionId();
   result->setPath(query.getPathString());
 
-  IdRunRange aIdRunRange;          // the runRange got from filename
-  Int_t aVersion, aSubVersion; // the version and subVersion got from filename
-
-  if (!query.hasVersion()) { // neither version and subversion specified -> look for highest version
-    // and subVersion
-
-    while ((filename = gSystem->GetDirEntry(dirPtr))) { // loop on files
-
-      TString aString(filename);
-      if (aString.BeginsWith('.')) {
-        continue;
-      }
-
-      if (!filenameToId(filename, aIdRunRange, aVersion, aSubVersion)) {
-        continue;
-      }
-      // aIdRunRange, aVersion, aSubVersion filled from filename
-
-      if (!aIdRunRange.isSupersetOf(query.getIdRunRange())) {
-        continue;
-      }
-      // aIdRunRange contains requested run!
-
-      LOG(DEBUG) << "Filename " << filename << " matches\n" << FairLogger::endl;
-
-      if (result->getVersion() < aVersion) {
-        result->setVersion(aVersion);
-        result->setSubVersion(aSubVersion);
-
-        result->setFirstRun(aIdRunRange.getFirstRun());
-        result->setLastRun(aIdRunRange.getLastRun());
-
-      } else if (result->getVersion() == aVersion && result->getSubVersion() < aSubVersion) {
-
-        result->setSubVersion(aSubVersion);
-
-        result->setFirstRun(aIdRunRange.getFirstRun());
-        result->setLastRun(aIdRunRange.getLastRun());
-      } else if (result->getVersion() == aVersion && result->getSubVersion() == aSubVersion) {
-        LOG(ERROR) << "More than one object valid for run " << query.getFirstRun() << " version " << aVersion << "_"
-                   << aSubVersion << "!" << FairLogger::endl;
-        gSystem->FreeDirectory(dirPtr);
-        delete result;
-        return NULL;
-      }
-    }
-
-  } else if (!query.hasSubVersion()) { // version specified but not subversion -> look for highest
-    // subVersion
-    result->setVersion(query.getVersion());
-
-    while ((filename = gSystem->GetDirEntry(dirPtr))) { // loop on files
-
-      TString aString(filename);
-      if (aString.BeginsWith('.')) {
-        continue;
-      }
-
-      if (!filenameToId(filename, aIdRunRange, aVersion, aSubVersion)) {
-        continue;
-      }
-      // aIdRunRange, aVersion, aSubVersion filled from filename
-
-      if (!aIdRunRange.isSupersetOf(query.getIdRunRange())) {
-        continue;
-      }
-      // aIdRunRange contains requested run!
-
-      if (query.getVersion() != aVersion) {
-        continue;
-      }
-      // aVersion is requested version!
-
-      if (result->getSubVersion() == aSubVersion) {
-        LOG(ERROR) << "More than one object valid for run " << query.getFirstRun() << " version " << aVersion << "_"
-                   << aSubVersion << "!" << FairLogger::endl;
-        gSystem->FreeDirectory(dirPtr);
-        delete result;
-        return NULL;
-      }
-      if (result->getSubVersion() < aSubVersion) {
-
-        result->setSubVersion(aSubVersion);
-
-        result->setFirstRun(aIdRunRange.getFirstRun());
-        result->setLastRun(aIdRunRange.getLastRun());
-      }
-    }
-
-  } else { // both version and subversion specified
-
-    // ConditionId dataId(queryId.getPathString(), -1, -1, -1, -1);
-    // Bool_t result;
-    while ((filename = gSystem->GetDirEntry(dirPtr))) { // loop on files
-
-      TString aString(filename);
-      if (aString.BeginsWith('.')) {
-        continue;
-      }
-
-      if (!filenameToId(filename, aIdRunRange, aVersion, aSubVersion)) {
-        LOG(DEBUG) << "Could not make id from file: " << filename << FairLogger::endl;
-        continue;
-      }
-      // aIdRunRange, aVersion, aSubVersion filled from filename
-
-      if (!aIdRunRange.isSupersetOf(query.getIdRunRange())) {
-        continue;
-      }
-      // aIdRunRange contains requested run!
-
-      if (query.getVersion() != aVersion || query.getSubVersion() != aSubVersion) {
-        continue;
-      }
-      // aVersion and aSubVersion are requested version and subVersion!
-
-      result->setVersion(aVersion);
-      result->setSubVersion(aSubVersion);
-      result->setFirstRun(aIdRunRange.getFirstRun());
-      result->setLastRun(aIdRunRange.getLastRun());
-      break;
-    }
+  if (status == LocalStorageIndex::kFound) {
+    result->setVersion(entry.version);
+    result->setSubVersion(entry.subVersion);
+    result->setFirstRun(entry.firstRun);
+    result->setLastRun(entry.lastRun);
   }
 
-  gSystem->FreeDirectory(dirPtr);
-
   return result;
 }
 
@@ -549,75 +420,27 @@ void LocalStorage::getEntriesForLevel1(const char *level0, const char *level1, c
 
       ConditionId entryId(entryPath, queryId.getIdRunRange(), queryId.getVersion(), queryId.getSubVersion());
 
-      // check filenames to see if any includes queryId.getIdRunRange()
-      void *level2DirPtr = gSystem->OpenDirectory(fullPath);
-      if (!level2DirPtr) {
-        LOG(DEBUG) << "Can't open level2 directory <" << fullPath.Data() << ">!" << FairLogger::endl;
-        return;
-      }
-      const char *level3;
-      Long_t file_flag = 0;
-      while ((level3 = gSystem->GetDirEntry(level2DirPtr))) {
-        TString fileName(level3);
-        TString fullFileName = Form("%s/%s", fullPath.Data(), level3);
-
-        Int_t file_res = gSystem->GetPathInfo(fullFileName.Data(), 0, (Long64_t *) 0, &file_flag, 0);
-
-        if (file_res) {
-          LOG(DEBUG) << "Error reading entry " << level2Str.Data() << " !" << FairLogger::endl;
-          continue;
-        }
-        if (file_flag) {
-          continue;
-        } // it is not a regular file!
-
-        // skip if result already contains an entry for this path
-        Bool_t alreadyLoaded = kFALSE;
-        Int_t nEntries = result->GetEntries();
-        for (int i = 0; i < nEntries; i++) {
-          Condition *lCondition = (Condition *) result->At(i);
-          ConditionId lId = lCondition->getId();
-          TString lIdPath = lId.getPathString();
-          if (lIdPath.EqualTo(entryPath.getPathString())) {
-            alreadyLoaded = kTRUE;
-            break;
-          }
+      // skip if result already contains an entry for this path
+      Bool_t alreadyLoaded = kFALSE;
+      Int_t nEntries = result->GetEntries();
+      for (int i = 0; i < nEntries; i++) {
+        Condition *lCondition = (Condition *) result->At(i);
+        if (lCondition->getId().getPathString().EqualTo(entryPath.getPathString())) {
+          alreadyLoaded = kTRUE;
+          break;
         }
-        if (alreadyLoaded)
-          continue;
+      }
+      if (alreadyLoaded) {
+        continue;
+      }
 
-        // skip filenames not matching the regex below
-        TRegexp re("^Run[0-9]+_[0-9]+_");
-        if (!fileName.Contains(re))
-          continue;
-        // Extract first- and last-run and version and subversion.
-        // This allows to avoid quering for a calibration path if we did not find a filename with
-        // run-range including the one specified in the query and
-        // with version, subversion matching the query
-        TString fn = fileName(3, fileName.Length() - 3);
-        TString firstRunStr = fn(0, fn.First('_'));
-        fn.Remove(0, firstRunStr.Length() + 1);
-        TString lastRunStr = fn(0, fn.First('_'));
-        fn.Remove(0, lastRunStr.Length() + 1);
-        TString versionStr = fn(1, fn.First('_') - 1);
-        fn.Remove(0, versionStr.Length() + 2);
-        TString subvStr = fn(1, fn.First('.') - 1);
-        Int_t firstRun = firstRunStr.Atoi();
-        Int_t lastRun = lastRunStr.Atoi();
-        IdRunRange rr(firstRun, lastRun);
-        Int_t version = versionStr.Atoi();
-        Int_t subVersion = subvStr.Atoi();
-
-        Condition *anCondition = 0;
-        Bool_t versionOK = kTRUE, subVersionOK = kTRUE;
-        if (queryId.hasVersion() && version != queryId.getVersion())
-          versionOK = kFALSE;
-        if (queryId.hasSubVersion() && subVersion != queryId.getSubVersion())
-          subVersionOK = kFALSE;
-        if (rr.isSupersetOf(queryId.getIdRunRange()) && versionOK && subVersionOK) {
-          anCondition = getCondition(entryId);
-          result->Add(anCondition);
-        }
+      // check the index to see if any file includes queryId.getIdRunRange() with version, subversion
+      // matching the query. This allows to avoid querying for a calibration path without such file
+      LocalStorageIndex::Entry entry;
+      LocalStorageIndex::Status status = mIndex->find(entryPath.getPathString(), queryId.getIdRunRange(),
+                                                      queryId.getVersion(), queryId.getSubVersion(), entry);
+      if (status == LocalStorageIndex::kFound || status == LocalStorageIndex::kAmbiguous) {
+        result->Add(getCondition(entryId));
       }
     }
   }
@@ -755,6 +578,7 @@ Bool_t LocalStorage::putCondition(Condition *entry, const char *mirrors)
     LOG(DEBUG) << "Can't write entry to file: " << filename.Data() << FairLogger::endl;
 
   file.Close();
+  mIndex->invalidate(id.getPathString());
   if (result) {
     if (!(id.getPathString().Contains("SHUTTLE/STATUS")))
       LOG(INFO) << "CDB object stored into file \"" << filename.Data() << "\"" << FairLogger::endl;
@@ -874,52 +698,17 @@ void LocalStorage::queryValidFiles()
             }
 
             if (mPathFilter.doesLevel2Contain(level2)) {
-              TString dirName = Form("%s/%s/%s/%s", mBaseDirectory.Data(), level0, level1, level2);
-
-              void *dirPtr = gSystem->OpenDirectory(dirName);
-
-              const char *filename;
-
-              IdRunRange aIdRunRange;                    // the runRange got from filename
-              IdRunRange hvIdRunRange;                   // the runRange of the highest version valid file
-              Int_t aVersion, aSubVersion;           // the version and subVersion got from filename
-              Int_t highestV = -1, highestSubV = -1; // the highest version and subVersion for this calibration type
-
-              while ((filename = gSystem->GetDirEntry(dirPtr))) { // loop on files
-
-                TString aString(filename);
-                if (aString.BeginsWith(".")) {
-                  continue;
-                }
-
-                if (!filenameToId(filename, aIdRunRange, aVersion, aSubVersion)) {
-                  continue;
-                }
-
-                IdRunRange runrg(mRun, mRun);
-                if (!aIdRunRange.isSupersetOf(runrg)) {
-                  continue;
-                }
-
-                // check to keep the highest version/subversion (in case of more than one)
-                if (aVersion > highestV) {
-                  highestV = aVersion;
-                  highestSubV = aSubVersion;
-                  hvIdRunRange = aIdRunRange;
-                } else if (aVersion == highestV) {
-                  if (aSubVersion > highestSubV) {
-                    highestSubV = aSubVersion;
-                    hvIdRunRange = aIdRunRange;
-                  }
-                }
-              }
-              if (highestV >= 0) {
-                IdPath validPath(level0, level1, level2);
-                ConditionId *validId = new ConditionId(validPath, hvIdRunRange, highestV, highestSubV);
+              IdPath validPath(level0, level1, level2);
+
+              // the highest version and subversion for this calibration type
+              LocalStorageIndex::Entry entry;
+              LocalStorageIndex::Status status =
+                mIndex->find(validPath.getPathString(), IdRunRange(mRun, mRun), -1, -1, entry);
+              if (status == LocalStorageIndex::kFound || status == LocalStorageIndex::kAmbiguous) {
+                IdRunRange hvIdRunRange(entry.firstRun, entry.lastRun);
+                ConditionId *validId = new ConditionId(validPath, hvIdRunRange, entry.version, entry.subVersion);
                 mValidFileIds.AddLast(validId);
               }
-
-              gSystem->FreeDirectory(dirPtr);
             }
           }
           gSystem->FreeDirectory(level1DirPtr);
@@ -0,0 +1,276 @@
+/// \file LocalStorageIndex.cxx
+/// \brief Implementation of the LocalStorageIndex class, the file index of the LocalStorage
+
+#include "CCDB/LocalStorageIndex.h"
+#include <FairLogger.h>        // for LOG
+#include <TSystem.h>           // for TSystem, gSystem, FileStat_t
+#include <algorithm>           // for sort, upper_bound, max
+#include <cstring>             // for memcmp, strcmp, strncmp, strlen
+#include <ctime>               // for time
+#include <fstream>             // for ifstream, ofstream
+#include "CCDB/IdRunRange.h"   // for IdRunRange
+
+using namespace AliceO2::CDB;
+
+namespace {
+const char sIndexMagic[8] = {'O', '2', 'C', 'D', 'B', 'I', 'X', '1'};
+
+/// parses the decimal digits at the position, advances the position
+Bool_t parseNumber(const char *&position, Int_t &value)
+{
+  const char *start = position;
+  Long64_t number = 0;
+  while (*position >= '0' && *position <= '9') {
+    number = number * 10 + (*position++ - '0');
+    if (number > kMaxInt) {
+      return kFALSE;
+    }
+  }
+  value = number;
+  return position != start;
+}
+
+Bool_t parseLiteral(const char *&position, const char *literal)
+{
+  size_t length = strlen(literal);
+  if (strncmp(position, literal, length) != 0) {
+    return kFALSE;
+  }
+  position += length;
+  return kTRUE;
+}
+
+/// calls visit(position) for the entries before end ending at or after lastRun, from the last
+/// one backwards, skipping the subtrees without such entries; stops when visit returns false
+template <typename Visitor>
+Bool_t visitCovering(const std::vector<Int_t> &tree, size_t node, size_t nodeBegin, size_t nodeEnd, size_t end,
+                     Int_t lastRun, Visitor &visit)
+{
+  if (nodeBegin >= end || tree[node] < lastRun) {
+    return kTRUE;
+  }
+  if (nodeEnd - nodeBegin == 1) {
+    return visit(nodeBegin);
+  }
+  size_t middle = (nodeBegin + nodeEnd) / 2;
+  return visitCovering(tree, 2 * node + 1, middle, nodeEnd, end, lastRun, visit) &&
+         visitCovering(tree, 2 * node, nodeBegin, middle, end, lastRun, visit);
+}
+}
+
+LocalStorageIndex::LocalStorageIndex(const char *baseDirectory) : mBaseDirectory(baseDirectory), mPaths()
+{
+}
+
+LocalStorageIndex::~LocalStorageIndex()
+{
+}
+
+Bool_t LocalStorageIndex::parseFilename(const char *filename, Entry &entry)
+{
+  // valid filename: Run#firstRun_#lastRun_v#version_s#subVersion.root
+  const char *position = filename;
+  return parseLiteral(position, "Run") && parseNumber(position, entry.firstRun) && parseLiteral(position, "_") &&
+         parseNumber(position, entry.lastRun) && parseLiteral(position, "_v") &&
+         parseNumber(position, entry.version) && parseLiteral(position, "_s") &&
+         parseNumber(position, entry.subVersion) && strcmp(position, ".root") == 0;
+}
+
+void LocalStorageIndex::sortEntries(PathIndex &index)
+{
+  std::sort(index.entries.begin(), index.entries.end(), [](const Entry &a, const Entry &b) {
+    return a.firstRun < b.firstRun || (a.firstRun == b.firstRun && a.lastRun < b.lastRun);
+  });
+  index.nLeaves = 1;
+  while (index.nLeaves < index.entries.size()) {
+    index.nLeaves *= 2;
+  }
+  index.maxLastRun.assign(2 * index.nLeaves, kMinInt);
+  for (size_t i = 0; i < index.entries.size(); i++) {
+    index.maxLastRun[index.nLeaves + i] = index.entries[i].lastRun;
+  }
+  for (size_t node = index.nLeaves - 1; node > 0; node--) {
+    index.maxLastRun[node] = std::max(index.maxLastRun[2 * node], index.maxLastRun[2 * node + 1]);
+  }
+}
+
+Bool_t LocalStorageIndex::scanDirectory(const TString &directory, PathIndex &index) const
+{
+  void *dirPtr = gSystem->OpenDirectory(directory);
+  if (!dirPtr) {
+    return kFALSE;
+  }
+  index.entries.clear();
+  const char *filename;
+  Entry entry;
+  while ((filename = gSystem->GetDirEntry(dirPtr))) {
+    if (parseFilename(filename, entry)) {
+      index.entries.push_back(entry);
+    }
+  }
+  gSystem->FreeDirectory(dirPtr);
+  sortEntries(index);
+  LOG(DEBUG) << "Indexed " << index.entries.size() << " files in " << directory.Data() << FairLogger::endl;
+  return kTRUE;
+}
+
+TString LocalStorageIndex::getIndexFileName(const TString &path) const
+{
+  // one file per path in the folder .index, which is skipped by the directory scans of the storage
+  TString fileName(path);
+  fileName.ReplaceAll("/", "*");
+  return mBaseDirectory + "/.index/" + fileName;
+}
+
+Bool_t LocalStorageIndex::readIndexFile(const TString &path, PathIndex &index) const
+{
+  std::ifstream file(getIndexFileName(path).Data(), std::ios::binary);
+  if (!file) {
+    return kFALSE;
+  }
+  char magic[sizeof(sIndexMagic)];
+  Long64_t modTime = 0, scanTime = 0;
+  UInt_t nEntries = 0;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char *>(&modTime), sizeof(modTime));
+  file.read(reinterpret_cast<char *>(&scanTime), sizeof(scanTime));
+  file.read(reinterpret_cast<char *>(&nEntries), sizeof(nEntries));
+  if (!file || memcmp(magic, sIndexMagic, sizeof(magic)) != 0 || nEntries > (1u << 24)) {
+    return kFALSE;
+  }
+  index.entries.resize(nEntries);
+  file.read(reinterpret_cast<char *>(index.entries.data()), nEntries * sizeof(Entry));
+  if (!file) {
+    return kFALSE;
+  }
+  index.modTime = modTime;
+  index.scanTime = scanTime;
+  sortEntries(index);
+  return kTRUE;
+}
+
+void LocalStorageIndex::writeIndexFile(const TString &path, const PathIndex &index) const
+{
+  // written to a temporary file and renamed, the jobs sharing the storage never see a partial file
+  TString fileName = getIndexFileName(path);
+  TString tmpFileName = fileName + Form(".%d", gSystem->GetPid());
+  gSystem->mkdir(mBaseDirectory + "/.index", kTRUE);
+  {
+    std::ofstream file(tmpFileName.Data(), std::ios::binary | std::ios::trunc);
+    Long64_t modTime = index.modTime, scanTime = index.scanTime;
+    UInt_t nEntries = index.entries.size();
+    file.write(sIndexMagic, sizeof(sIndexMagic));
+    file.write(reinterpret_cast<const char *>(&modTime), sizeof(modTime));
+    file.write(reinterpret_cast<const char *>(&scanTime), sizeof(scanTime));
+    file.write(reinterpret_cast<const char *>(&nEntries), sizeof(nEntries));
+    file.write(reinterpret_cast<const char *>(index.entries.data()), nEntries * sizeof(Entry));
+    if (!file) {
+      LOG(DEBUG) << "Can't write index file <" << tmpFileName.Data() << ">" << FairLogger::endl;
+      file.close();
+      gSystem->Unlink(tmpFileName);
+      return;
+    }
+  }
+  if (gSystem->Rename(tmpFileName, fileName) != 0) {
+    gSystem->Unlink(tmpFileName);
+  }
+}
+
+LocalStorageIndex::PathIndex *LocalStorageIndex::getPathIndex(const TString &path)
+{
+  TString directory = mBaseDirectory + '/' + path;
+  FileStat_t stat;
+  if (gSystem->GetPathInfo(directory, stat) != 0 || !R_ISDIR(stat.fMode)) {
+    mPaths.erase(path.Data());
+    return nullptr;
+  }
+
+  // a table is trusted if the directory was not modified since, and not in the second of the scan
+  auto isValid = [&stat](const PathIndex &index) {
+    return index.modTime == stat.fMtime && index.scanTime > index.modTime;
+  };
+
+  PathIndex &index = mPaths[path.Data()];
+  if (isValid(index)) {
+    return &index;
+  }
+  if (readIndexFile(path, index) && isValid(index)) {
+    return &index;
+  }
+
+  // the time is taken before the scan, a change during the scan leaves the table untrusted
+  index.scanTime = time(nullptr);
+  index.modTime = stat.fMtime;
+  if (!scanDirectory(directory, index)) {
+    mPaths.erase(path.Data());
+    return nullptr;
+  }
+  if (isValid(index)) {
+    writeIndexFile(path, index);
+  }
+  return &index;
+}
+
+LocalStorageIndex::Status LocalStorageIndex::find(const TString &path, const IdRunRange &runRange, Int_t version,
+                                                  Int_t subVersion, Entry &result)
+{
+  const PathIndex *index = getPathIndex(path);
+  if (!index) {
+    return kNoDirectory;
+  }
+
+  Int_t firstRun = runRange.getFirstRun();
+  Int_t lastRun = runRange.getLastRun();
+
+  // the candidates start at or before the first run of the query, the tree visits only the ones
+  // reaching the last run of the query
+  auto end = std::upper_bound(index->entries.begin(), index->entries.end(), firstRun,
+                              [](Int_t run, const Entry &entry) { return run < entry.firstRun; });
+  Status status = kNotFound;
+  auto select = [&](size_t position) -> Bool_t {
+    const Entry &entry = index->entries[position];
+    if (version >= 0 && entry.version != version) {
+      return kTRUE;
+    }
+    if (version >= 0 && subVersion >= 0) {
+      if (entry.subVersion == subVersion) {
+        result = entry;
+        status = kFound;
+        return kFALSE;
+      }
+      return kTRUE;
+    }
+    if (status == kNotFound || entry.version > result.version ||
+        (entry.version == result.version && entry.subVersion > result.subVersion)) {
+      result = entry;
+      status = kFound;
+    } else if (entry.version == result.version && entry.subVersion == result.subVersion) {
+      status = kAmbiguous;
+    }
+    return kTRUE;
+  };
+  visitCovering(index->maxLastRun, 1, 0, index->nLeaves, end - index->entries.begin(), lastRun, select);
+  return status;
+}
+
+LocalStorageIndex::Status LocalStorageIndex::getEntries(const TString &path, std::vector<Entry> &entries)
+{
+  const PathIndex *index = getPathIndex(path);
+  if (!index) {
+    return kNoDirectory;
+  }
+  entries = index->entries;
+  return entries.empty() ? kNotFound : kFound;
+}
+
+void LocalStorageIndex::invalidate(const TString &path)
+{
+  // the writes of other jobs in the same second can't be told apart from the own write, the
+  // table is rebuilt rather than updated. The index file is outdated by the modification time.
+  mPaths.erase(path.Data());
+}
+
+void LocalStorageIndex::clear()
+{
+  mPaths.clear();
+}
@@ -8,6 +8,8 @@
 #include <TSAXParser.h>    // for TSAXParser
 #include <TUUID.h>         // for TUUID
 #include "CCDB/Condition.h"     // for Condition
+#include "CCDB/ConditionCache.h" // for ConditionCache
+#include "CCDB/ConditionSnapshot.h" // for ConditionSnapshot
 #include "CCDB/FileStorage.h"   // for FileStorageFactory
 #include "CCDB/GridStorage.h"   // for GridStorageFactory
 #include "CCDB/LocalStorage.h"  // for LocalStorageFactory
@@ -64,9 +66,9 @@ void Manager::initFromCache(TMap *entryCache, Int_t run)
 
   while ((pair = dynamic_cast<TPair *>(iter.Next()))) {
     mConditionCache.Add(pair->Key(), pair->Value());
+    mCurrentRunConditions[pair->Key()->GetName()].reset(dynamic_cast<Condition *>(pair->Value()));
   }
   // mCondition is the new owner of the cache
-  mConditionCache.SetOwnerKeyValue(kTRUE, kTRUE);
   entryCache->SetOwnerKeyValue(kFALSE, kFALSE);
   LOG(INFO) << mConditionCache.GetEntries() << " cache entries have been loaded" << FairLogger::endl;
 }
@@ -138,6 +140,85 @@ void Manager::dumpToLightSnapshotFile(const char *lightSnapshotFileName) const
   delete f;
 }
 
+Bool_t Manager::dumpToMappedSnapshotFile(const char *snapshotFileName, Int_t run)
+{
+  // Write all objects valid for the run to a snapshot file read with setSnapshotMode: the objects
+  // of the default storage and of every specific storage, each path taken from the storage which
+  // serves it. The objects are streamed once into the file, the readers stream them from the
+  // mapped file. Fails without writing if one of the storages cannot be listed.
+
+  if (run < 0) {
+    run = mRun;
+  }
+  if (run < 0) {
+    LOG(ERROR) << "Run number neither specified nor set in Manager! Use Manager::setRun." << FairLogger::endl;
+    return kFALSE;
+  }
+  if (!mDefaultStorage) {
+    LOG(ERROR) << "No storage set!" << FairLogger::endl;
+    return kFALSE;
+  }
+
+  std::unique_ptr<TList> defaultObjects(mDefaultStorage->getAllObjects(ConditionId(IdPath("*"), run, run)));
+  if (!defaultObjects) {
+    return kFALSE;
+  }
+
+  std::map<std::string, const Condition *> conditions;
+  TIter iter(defaultObjects.get());
+  Condition *entry = 0;
+  while ((entry = dynamic_cast<Condition *>(iter.Next()))) {
+    TString path = entry->getId().getPathString();
+    if (selectSpecificStorage(path)) {
+      // owned by the cache, or to be released below if the cache is off
+      entry = getObject(IdPath(path), run);
+      if (!entry) {
+        continue;
+      }
+    }
+    conditions[path.Data()] = entry;
+  }
+
+  // the paths of a specific storage need not exist in the default one
+  Bool_t complete = kTRUE;
+  TIter specificIter(&mSpecificStorages);
+  TObjString *calibType = 0;
+  while ((calibType = (TObjString *) specificIter.Next())) {
+    StorageParameters *aPar = (StorageParameters *) mSpecificStorages.GetValue(calibType);
+    Storage *aStorage = getStorage(aPar);
+    std::unique_ptr<TList> specificObjects(
+      aStorage ? aStorage->getAllObjects(ConditionId(IdPath(calibType->GetName()), run, run)) : nullptr);
+    if (!specificObjects) {
+      LOG(ERROR) << "Cannot list the objects of " << calibType->GetName() << " in the specific storage "
+                 << aPar->getUri().Data() << FairLogger::endl;
+      complete = kFALSE;
+      break;
+    }
+    TIter specificObjectsIter(specificObjects.get());
+    while ((entry = dynamic_cast<Condition *>(specificObjectsIter.Next()))) {
+      TString path = entry->getId().getPathString();
+      // a more specific storage may serve the path instead
+      if (conditions.count(path.Data()) || selectSpecificStorage(path) != aPar) {
+        continue;
+      }
+      entry = getObject(IdPath(path), run);
+      if (entry) {
+        conditions[path.Data()] = entry;
+      }
+    }
+  }
+
+  Bool_t written = complete && ConditionSnapshot::write(snapshotFileName, run, conditions);
+  if (!mCache) {
+    for (auto &condition : conditions) {
+      if (!defaultObjects->FindObject(condition.second)) {
+        delete condition.second;
+      }
+    }
+  }
+  return written;
+}
+
 Bool_t Manager::initFromSnapshot(const char *snapshotFileName, Bool_t overwrite)
 {
   // initialize manager from a CDB snapshot, that is add the entries
@@ -244,6 +325,7 @@ Bool_t Manager::initFromSnapshot(const char *snapshotFileName, Bool_t overwrite)
         unloadFromCache(path.Data());
       }
       mConditionCache.Add(pair->Key(), pair->Value());
+      mCurrentRunConditions[path.Data()].reset(dynamic_cast<Condition *>(pair->Value()));
       mIds->Add(id);
       nAdded++;
     } else {
@@ -252,6 +334,7 @@ Bool_t Manager::initFromSnapshot(const char *snapshotFileName, Bool_t overwrite)
                      << "\". Not adding this object from snapshot" << FairLogger::endl;
       } else {
         mConditionCache.Add(pair->Key(), pair->Value());
+        mCurrentRunConditions[path.Data()].reset(dynamic_cast<Condition *>(pair->Value()));
         mIds->Add(id);
         nAdded++;
       }
@@ -259,7 +342,6 @@ Bool_t Manager::initFromSnapshot(const char *snapshotFileName, Bool_t overwrite)
   }
 
   // mCondition is the new owner of the cache
-  mConditionCache.SetOwnerKeyValue(kTRUE, kTRUE);
   entriesMap->SetOwnerKeyValue(kFALSE, kFALSE);
   mIds->SetOwner(kTRUE);
   idsList->SetOwner(kFALSE);
@@ -287,6 +369,8 @@ Manager::Manager()
     mActiveStorages(),
     mSpecificStorages(),
     mConditionCache(),
+    mCurrentRunConditions(),
+    mRunRangeCache(new ConditionCache()),
     mIds(0),
     mStorageMap(0),
     mDefaultStorage(NULL),
@@ -298,6 +382,7 @@ Manager::Manager()
     mLock(kFALSE),
     mSnapshotMode(kFALSE),
     mSnapshotFile(0),
+    mMappedSnapshot(new ConditionSnapshot()),
     mOcdbUploadMode(kFALSE),
     mRaw(kFALSE),
     mCvmfsOcdb(""),
@@ -311,7 +396,8 @@ Manager::Manager()
   mActiveStorages.SetOwner(1);
   mSpecificStorages.SetOwner(1);
   mConditionCache.SetName("CDBConditionCache");
-  mConditionCache.SetOwnerKeyValue(kTRUE, kTRUE);
+  // the objects are owned by mCurrentRunConditions and mRunRangeCache
+  mConditionCache.SetOwnerKeyValue(kTRUE, kFALSE);
 
   mStorageMap = new TMap();
   mStorageMap->SetOwner(1);
@@ -323,6 +409,7 @@ Manager::~Manager()
 {
   // destructor
   clearCache();
+  delete mRunRangeCache;
   destroyActiveStorages();
   mFactories.Delete();
   mdrainStorage = 0x0;
@@ -333,10 +420,8 @@ Manager::~Manager()
   mIds = 0;
   delete mOfficialStorageParameters;
   delete mReferenceStorageParameters;
-  if (mSnapshotMode) {
-    mSnapshotFile->Close();
-    mSnapshotFile = 0;
-  }
+  closeSnapshot();
+  delete mMappedSnapshot;
 }
 
 void Manager::putActiveStorage(StorageParameters *param, Storage *storage)
@@ -981,15 +1066,19 @@ Condition *Manager::getObject(const ConditionId &queryId, Bool_t forceCaching)
   if (mLock && !(mRun >= queryId.getFirstRun() && mRun <= queryId.getLastRun()))
     LOG(FATAL) << "Lock is ON: cannot use different run number than the internal one!" << FairLogger::endl;
 
-  if (mCache && !(mRun >= queryId.getFirstRun() && mRun <= queryId.getLastRun()))
-    LOG(WARNING) << "Run number explicitly set in query: CDB cache temporarily disabled!" << FairLogger::endl;
-
   Condition *entry = 0;
 
-  // first look into map of cached objects
+  // first look into map of cached objects of the current run, then into the cache of all runs
   if (mCache && queryId.getFirstRun() == mRun) {
     entry = (Condition *) mConditionCache.GetValue(queryId.getPathString());
   }
+  if (!entry && mCache) {
+    std::shared_ptr<Condition> cached = mRunRangeCache->get(queryId);
+    if (cached && queryId.getFirstRun() == mRun) {
+      cacheCondition(queryId.getPathString(), cached);
+    }
+    entry = cached.get();
+  }
   if (entry) {
     LOG(DEBUG) << "Object " << queryId.getPathString().Data() << " retrieved from cache !!" << FairLogger::endl;
     return entry;
@@ -1005,7 +1094,9 @@ Condition *Manager::getObject(const ConditionId &queryId, Bool_t forceCaching)
         LOG(INFO) << "Object \"" << queryId.getPathString().Data() << "\" retrieved from the snapshot."
                   << FairLogger::endl;
         if (queryId.getFirstRun() == mRun) { // no need to check mCache, mSnapshotMode not possible otherwise
-          cacheCondition(queryId.getPathString(), entry);
+          std::shared_ptr<Condition> cached = mRunRangeCache->put(queryId, std::shared_ptr<Condition>(entry));
+          cacheCondition(queryId.getPathString(), cached);
+          entry = cached.get();
         }
 
         if (!mIds->Contains(&entry->getId())) {
@@ -1049,8 +1140,13 @@ Condition *Manager::getObject(const ConditionId &queryId, Bool_t forceCaching)
   }
   entry = aStorage->getObject(finalQueryId);
 
-  if (entry && mCache && (queryId.getFirstRun() == mRun || forceCaching)) {
-    cacheCondition(queryId.getPathString(), entry);
+  if (entry && mCache) {
+    // an object already cached for a neighbouring run range is kept, the new copy is released
+    std::shared_ptr<Condition> cached = mRunRangeCache->put(queryId, std::shared_ptr<Condition>(entry));
+    if (queryId.getFirstRun() == mRun || forceCaching) {
+      cacheCondition(queryId.getPathString(), cached);
+    }
+    entry = cached.get();
   }
 
   if (entry && !mIds->Contains(&entry->getId())) {
@@ -1060,10 +1156,42 @@ Condition *Manager::getObject(const ConditionId &queryId, Bool_t forceCaching)
   return entry;
 }
 
+std::shared_ptr<Condition> Manager::getSharedObject(const ConditionId &query)
+{
+  Condition *entry = getObject(query);
+  if (!entry || !mCache) {
+    // without the cache the caller owns the object
+    return std::shared_ptr<Condition>(entry);
+  }
+  auto current = mCurrentRunConditions.find(query.getPathString().Data());
+  if (current != mCurrentRunConditions.end() && current->second.get() == entry) {
+    return current->second;
+  }
+  std::shared_ptr<Condition> cached = mRunRangeCache->peek(query);
+  if (cached.get() != entry) {
+    LOG(ERROR) << "Object " << query.getPathString().Data() << " not found in the cache" << FairLogger::endl;
+    return std::shared_ptr<Condition>();
+  }
+  return cached;
+}
+
 Condition *Manager::getConditionFromSnapshot(const char *path)
 {
   // get the entry from the open snapshot file
 
+  if (mMappedSnapshot->isOpen()) {
+    if (mMappedSnapshot->getRun() != mRun) {
+      LOG(DEBUG) << "The snapshot is for run " << mMappedSnapshot->getRun() << ", not for run " << mRun
+                 << FairLogger::endl;
+      return 0;
+    }
+    Condition *entry = mMappedSnapshot->getCondition(path);
+    if (!entry) {
+      LOG(DEBUG) << "Cannot get a CDB entry for \"" << path << "\" from snapshot file" << FairLogger::endl;
+    }
+    return entry;
+  }
+
   TString sPath(path);
   sPath.ReplaceAll("/", "*");
   if (!mSnapshotFile) {
@@ -1100,9 +1228,24 @@ Bool_t Manager::setSnapshotMode(const char *snapshotFileName)
     }
   }
 
+  // getConditionFromSnapshot reads from the mapped snapshot if it is open, the previous snapshot
+  // is closed whatever the kind of the new one
+  closeSnapshot();
+
+  // a mapped snapshot is read in place, without opening a ROOT file
+  if (!snapshotFile.BeginsWith("alien://") && ConditionSnapshot::isSnapshotFile(snapshotFileName)) {
+    if (!mMappedSnapshot->open(snapshotFileName)) {
+      return kFALSE;
+    }
+    LOG(INFO) << "The CDB manager is set in snapshot mode!" << FairLogger::endl;
+    mSnapshotMode = kTRUE;
+    return kTRUE;
+  }
+
   mSnapshotFile = TFile::Open(snapshotFileName);
   if (!mSnapshotFile || mSnapshotFile->IsZombie()) {
     LOG(ERROR) << "Cannot open file " << snapshotFileName << FairLogger::endl;
+    closeSnapshot();
     return kFALSE;
   }
 
@@ -1111,6 +1254,16 @@ Bool_t Manager::setSnapshotMode(const char *snapshotFileName)
   return kTRUE;
 }
 
+void Manager::closeSnapshot()
+{
+  if (mSnapshotFile) {
+    mSnapshotFile->Close();
+    delete mSnapshotFile;
+    mSnapshotFile = 0;
+  }
+  mMappedSnapshot->close();
+}
+
 const char *Manager::getUri(const char *path)
 {
   // return the URI of the storage where to look for path
@@ -1209,15 +1362,17 @@ ConditionId *Manager::getId(const ConditionId &query)
     return NULL;
   }
 
-  if (mCache && query.getFirstRun() != mRun)
-    LOG(WARNING) << "Run number explicitly set in query: CDB cache temporarily disabled!" << FairLogger::endl;
-
   Condition *entry = 0;
 
-  // first look into map of cached objects
+  // first look into map of cached objects of the current run, then into the cache of all runs
   if (mCache && query.getFirstRun() == mRun) {
     entry = (Condition *) mConditionCache.GetValue(query.getPathString());
   }
+  std::shared_ptr<Condition> cached;
+  if (!entry && mCache) {
+    cached = mRunRangeCache->get(query);
+    entry = cached.get();
+  }
 
   if (entry) {
     LOG(DEBUG) << "Object " << query.getPathString().Data() << " retrieved from cache !!" << FairLogger::endl;
@@ -1225,6 +1380,24 @@ ConditionId *Manager::getId(const ConditionId &query)
   }
 
   // Condition is not in cache -> retrieve it from CDB and cache it!!
+  return getIdFromStorage(query);
+}
+
+ConditionId *Manager::getIdFromStorage(const ConditionId &query)
+{
+  // get the ConditionId of the valid object from its storage, without looking into the caches
+  // User must delete returned object!
+
+  if (!mDefaultStorage) {
+    LOG(ERROR) << "No storage set!" << FairLogger::endl;
+    return NULL;
+  }
+
+  if (!query.isValid() || !query.isSpecified()) {
+    LOG(ERROR) << "Invalid or unspecified query: " << query.ToString().Data() << FairLogger::endl;
+    return NULL;
+  }
+
   Storage *aStorage = 0;
   StorageParameters *aPar = selectSpecificStorage(query.getPathString());
 
@@ -1382,7 +1555,8 @@ TList *Manager::getAllObjects(const ConditionId &query)
       mIds->Add(entry->getId().Clone());
     }
     if (mCache && (query.getFirstRun() == mRun)) {
-      cacheCondition(entry->getId().getPathString(), entry);
+      // the entries are owned by the returned list, the cache keeps its own copies
+      cacheCondition(entry->getId().getPathString(), dynamic_cast<Condition *>(entry->Clone()));
     }
   }
 
@@ -1483,7 +1657,19 @@ const char *Manager::getMirrorSEs() const
 
 void Manager::cacheCondition(const char *path, Condition *entry)
 {
-  // cache  Condition. Cache is valid until run number is changed.
+  // cache  Condition for the current run, the cache takes ownership of the entry
+
+  if (mConditionCache.GetValue(path)) {
+    LOG(DEBUG) << "Object " << path << " already in cache !!" << FairLogger::endl;
+    delete entry;
+    return;
+  }
+  cacheCondition(path, std::shared_ptr<Condition>(entry));
+}
+
+void Manager::cacheCondition(const char *path, const std::shared_ptr<Condition> &entry)
+{
+  // cache  Condition for the current run. Cache is valid until run number is changed.
 
   Condition *chkCondition = dynamic_cast<Condition *>(mConditionCache.GetValue(path));
 
@@ -1494,10 +1680,39 @@ void Manager::cacheCondition(const char *path, Condition *entry)
     LOG(DEBUG) << "Caching entry " << path << FairLogger::endl;
   }
 
-  mConditionCache.Add(new TObjString(path), entry);
+  mConditionCache.Add(new TObjString(path), entry.get());
+  mCurrentRunConditions[path] = entry;
   LOG(DEBUG) << "Cache entries: " << mConditionCache.GetEntries() << FairLogger::endl;
 }
 
+void Manager::setCacheCapacity(size_t capacity)
+{
+  mRunRangeCache->setCapacity(capacity);
+}
+
+size_t Manager::getCacheCapacity() const
+{
+  return mRunRangeCache->getCapacity();
+}
+
+void Manager::setCacheMaxBytes(size_t maxBytes)
+{
+  mRunRangeCache->setMaxBytes(maxBytes);
+}
+
+size_t Manager::getCacheMaxBytes() const
+{
+  return mRunRangeCache->getMaxBytes();
+}
+
+void Manager::getCacheStatistics(ULong64_t &hits, ULong64_t &misses, ULong64_t &evictions) const
+{
+  ConditionCache::Statistics statistics = mRunRangeCache->getStatistics();
+  hits = statistics.hits;
+  misses = statistics.misses;
+  evictions = statistics.evictions;
+}
+
 void Manager::print(Option_t * /*option*/) const
 {
   // Print list of active storages and their URIs
@@ -1508,6 +1723,15 @@ void Manager::print(Option_t * /*option*/) const
     output += "NOT ";
   }
   output += Form("ACTIVE; Number of active storages: %d\n", mActiveStorages.GetEntries());
+  if (mCache) {
+    ConditionCache::Statistics statistics = mRunRangeCache->getStatistics();
+    output += Form("\t*** Cache: %lu run intervals (capacity %lu), %lu of %lu bytes, %llu hits, %llu misses, "
+                   "%llu evictions\n",
+                   (unsigned long) statistics.intervals, (unsigned long) mRunRangeCache->getCapacity(),
+                   (unsigned long) statistics.bytes, (unsigned long) mRunRangeCache->getMaxBytes(),
+                   (unsigned long long) statistics.hits, (unsigned long long) statistics.misses,
+                   (unsigned long long) statistics.evictions);
+  }
 
   if (mDefaultStorage) {
     output += Form("\t*** Default Storage URI: \"%s\"\n", mDefaultStorage->getUri().Data());
@@ -1530,7 +1754,8 @@ void Manager::print(Option_t * /*option*/) const
 void Manager::setRun(Int_t run)
 {
   // Sets current run number.
-  // When the run number changes the caching is cleared.
+  // When the run number changes the index of the current run is cleared, the objects stay
+  // in the run range cache.
 
   if (mRun == run) {
     return;
@@ -1555,7 +1780,8 @@ void Manager::setRun(Int_t run)
       return;
     }
   }
-  clearCache();
+  mConditionCache.DeleteKeys();
+  mCurrentRunConditions.clear();
   queryStorages();
 }
 
@@ -1578,7 +1804,9 @@ void Manager::clearCache()
   delete mConditionCache.Remove(key);
   }
   */
-  mConditionCache.DeleteAll();
+  mConditionCache.DeleteKeys();
+  mCurrentRunConditions.clear();
+  mRunRangeCache->clear();
   LOG(DEBUG) << "After deleting - Cache entries: " << mConditionCache.GetEntries() << FairLogger::endl;
 }
 
@@ -1596,12 +1824,14 @@ void Manager::unloadFromCache(const char *path)
   if (!queryPath.isValid()) {
     return;
   }
+  size_t removedIntervals = mRunRangeCache->remove(queryPath);
 
   if (!queryPath.isWildcard()) { // path is not wildcard, get it directly from the cache and unload it!
     if (mConditionCache.Contains(path)) {
       LOG(DEBUG) << "Unloading object \"" << path << "\" from cache and from list of ids" << FairLogger::endl;
       TObjString pathStr(path);
       delete mConditionCache.Remove(&pathStr);
+      mCurrentRunConditions.erase(path);
       // we do not remove from the list of ConditionId's (it's not very coherent but we leave the
       // id for the benefit of the userinfo)
       /*
@@ -1611,7 +1841,7 @@ void Manager::unloadFromCache(const char *path)
          if(queryPath.isSupersetOf(id->getPath()))
          delete mIds->Remove(id);
          }*/
-    } else {
+    } else if (!removedIntervals) {
       LOG(WARNING) << "Cache does not contain object \"" << path << "\"!" << FairLogger::endl;
     }
     LOG(DEBUG) << "Cache entries: " << mConditionCache.GetEntries() << FairLogger::endl;
@@ -1630,6 +1860,7 @@ void Manager::unloadFromCache(const char *path)
                  << FairLogger::endl;
       TObjString pathStr(entryPath.getPathString());
       delete mConditionCache.Remove(&pathStr);
+      mCurrentRunConditions.erase(entryPath.getPathString().Data());
       removed++;
 
       // we do not remove from the list of ConditionId's (it's not very coherent but we leave the
@@ -12,7 +12,11 @@ void addCustomOptions(bpo::options_description& options)
   options.add_options()("parameter-name", bpo::value<string>()->default_value("DET/Calib/Histo"), "Parameter Name")(
     "operation-type", bpo::value<string>()->default_value("GET"), "Operation Type")(
     "data-source", bpo::value<string>()->default_value("OCDB"), "Data Source")(
-    "object-path", bpo::value<string>()->default_value("OCDB"), "Object Path");
+    "object-path", bpo::value<string>()->default_value("OCDB"), "Object Path")(
+    "batch-size", bpo::value<int>()->default_value(64), "Number of conditions requested in one message")(
+    "pipeline-depth", bpo::value<int>()->default_value(8), "Number of requests in flight")(
+    "compression-level", bpo::value<int>()->default_value(-1),
+    "zlib compression level of the Riak objects, 1 (fastest) to 9 (smallest), -1 for the default");
 }
 
 FairMQDevice* getDevice(const FairMQProgOptions& config) { return new ConditionsMQClient(); }
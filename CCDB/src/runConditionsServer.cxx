@@ -16,7 +16,12 @@ void addCustomOptions(bpo::options_description& options)
     "second-input-type", bpo::value<std::string>()->default_value("ROOT"), "Second input file type (ROOT/ASCII)")(
     "output-name", bpo::value<std::string>()->default_value(""), "Output file name")(
     "output-type", bpo::value<std::string>()->default_value("ROOT"), "Output file type")(
-    "channel-name", bpo::value<std::string>()->default_value("ROOT"), "Output channel name");
+    "channel-name", bpo::value<std::string>()->default_value("ROOT"), "Output channel name")(
+    "workers", bpo::value<int>()->default_value(4), "Number of threads retrieving the conditions")(
+    "response-cache-size", bpo::value<int>()->default_value(10000),
+    "Number of serialized conditions kept for repeated requests")(
+    "response-cache-ttl", bpo::value<int>()->default_value(60),
+    "Seconds after which a kept condition is checked for a newer version, 0 to keep it until evicted");
 }
 
 FairMQDevice* getDevice(const FairMQProgOptions& config) { return new ConditionsMQServer(); }
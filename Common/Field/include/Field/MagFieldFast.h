@@ -0,0 +1,159 @@
+/// \file MagFieldFast.h
+/// \brief Definition of the MagFieldFast: light-weight single precision field query for tracking
+
+#ifndef ALICEO2_FIELD_MAGFIELDFAST_H_
+#define ALICEO2_FIELD_MAGFIELDFAST_H_
+
+#include <array>                        // for array
+#include <cmath>                        // for sqrt, atan2
+#include <cstdint>                      // for uint64_t
+#include <memory>                       // for shared_ptr
+#include "Field/MagneticFieldMapFile.h" // for MagneticFieldMapFile, MapFileLayout
+
+namespace AliceO2 {
+namespace Field {
+
+class MagneticField;
+class MagneticWrapperChebyshev;
+
+/// Single precision facade to the measured field map, meant for the field queries along the
+/// trajectories in the tracking. The evaluation is done on the flat image of the map
+/// (see MagneticFieldMapFile), which needs no scratch buffers, so the same instance can be queried
+/// from many threads. Every thread caches the last used parameterization piece per region, so the
+/// segment lookup is skipped as long as the consecutive queries stay in the same box, which is
+/// the typical pattern of the track propagation.
+/// The scaling factors are taken at the construction time. Outside of the region covered by the
+/// measured map (i.e. where MagneticField uses the machine field) zero field is returned, same as
+/// MagneticField::getBz. The units are kiloGauss and cm.
+class MagFieldFast
+{
+  public:
+    /// Uses the map and current scaling factors of the field
+    MagFieldFast(const MagneticField& field);
+
+    /// Uses the map with given scaling factors for the solenoid and dipole
+    MagFieldFast(const MagneticWrapperChebyshev& map, float factorSol = 1.f, float factorDip = 1.f);
+
+    /// Returns Bz at the point in cartesian coordinates
+    float getBz(float x, float y, float z) const
+    {
+      if (z > mSolenoidMinZ) {
+        if (z >= mMaxZ) {
+          return 0.f;
+        }
+        const float rphiz[3] = { std::sqrt(x * x + y * y), std::atan2(y, x), z };
+        const MapFileLayout::ParamRecord* par = findSegment(MapFileLayout::kSolenoid, rphiz);
+        return par ? mFactorSolenoid * mMap->Eval(*par, rphiz, 2) : 0.f;
+      }
+      if (z <= mMinZ) {
+        return 0.f;
+      }
+      const float xyz[3] = { x, y, z };
+      const MapFileLayout::ParamRecord* par = findSegment(MapFileLayout::kDipole, xyz);
+      return par ? getFactor(z) * mMap->Eval(*par, xyz, 2) : 0.f;
+    }
+
+    /// Returns Bz at the point in cartesian coordinates
+    float getBz(const std::array<float, 3>& xyz) const
+    {
+      return getBz(xyz[0], xyz[1], xyz[2]);
+    }
+
+    /// Fills the field components at the point in cartesian coordinates
+    void getBxyz(float x, float y, float z, float* b) const
+    {
+      b[0] = b[1] = b[2] = 0.f;
+      if (z > mSolenoidMinZ) {
+        if (z >= mMaxZ) {
+          return;
+        }
+        const float r = std::sqrt(x * x + y * y);
+        const float rphiz[3] = { r, std::atan2(y, x), z };
+        const MapFileLayout::ParamRecord* par = findSegment(MapFileLayout::kSolenoid, rphiz);
+        if (!par) {
+          return;
+        }
+        float brphiz[3];
+        mMap->Eval(*par, rphiz, brphiz);
+        // rotate the cylindrical components to cartesian frame
+        const float cs = r > 0.f ? x / r : 1.f, sn = r > 0.f ? y / r : 0.f;
+        b[0] = mFactorSolenoid * (brphiz[0] * cs - brphiz[1] * sn);
+        b[1] = mFactorSolenoid * (brphiz[0] * sn + brphiz[1] * cs);
+        b[2] = mFactorSolenoid * brphiz[2];
+        return;
+      }
+      if (z <= mMinZ) {
+        return;
+      }
+      const float xyz[3] = { x, y, z };
+      const MapFileLayout::ParamRecord* par = findSegment(MapFileLayout::kDipole, xyz);
+      if (!par) {
+        return;
+      }
+      mMap->Eval(*par, xyz, b);
+      const float fc = getFactor(z);
+      for (int i = 3; i--;) {
+        b[i] *= fc;
+      }
+    }
+
+    /// Fills the field components at the point in cartesian coordinates
+    void getBxyz(const std::array<float, 3>& xyz, std::array<float, 3>& b) const
+    {
+      getBxyz(xyz[0], xyz[1], xyz[2], b.data());
+    }
+
+    float getFactorSolenoid() const
+    {
+      return mFactorSolenoid;
+    }
+
+    float getFactorDipole() const
+    {
+      return mFactorDipole;
+    }
+
+  private:
+    /// Last used parameterization piece of the solenoid and dipole regions for the current thread
+    struct SegmentCache {
+      uint64_t owner = 0;                                         ///< id of the instance which filled the cache
+      const MapFileLayout::ParamRecord* pieces[2] = { nullptr, nullptr }; ///< solenoid and dipole pieces
+    };
+
+    void init(float factorSol, float factorDip);
+
+    float getFactor(float z) const
+    {
+      return (z > mSolenoidToDipoleZ || mDipoleOff) ? mFactorSolenoid : mFactorDipole;
+    }
+
+    /// Returns the piece containing the point, trying first the one cached by the thread
+    const MapFileLayout::ParamRecord* findSegment(MapFileLayout::Region reg, const float* pnt) const
+    {
+      const SegmentCache& cache = sCache;
+      const MapFileLayout::ParamRecord* par = cache.pieces[reg == MapFileLayout::kDipole];
+      if (cache.owner == mId && par && MagneticFieldMapFile::isInside(*par, pnt)) {
+        return par;
+      }
+      return lookupSegment(reg, pnt);
+    }
+
+    /// Full lookup of the piece containing the point, updates the cache of the thread
+    const MapFileLayout::ParamRecord* lookupSegment(MapFileLayout::Region reg, const float* pnt) const;
+
+    std::shared_ptr<const MagneticFieldMapFile> mMap; ///< flat image of the measured map
+    uint64_t mId;                                     ///< unique id of the instance, to validate the caches
+    float mFactorSolenoid;                            ///< multiplicative factor for the solenoid
+    float mFactorDipole;                              ///< multiplicative factor for the dipole
+    float mSolenoidMinZ;                              ///< min Z of the solenoid parameterization
+    float mMinZ;                                      ///< min Z of the measured map
+    float mMaxZ;                                      ///< max Z of the measured map
+    float mSolenoidToDipoleZ;                         ///< Z of transition from the solenoid to dipole factor
+    bool mDipoleOff;                                  ///< dipole is off, solenoid factor is used everywhere
+
+    static thread_local SegmentCache sCache; ///< per thread cache of the last used pieces
+};
+}
+}
+
+#endif
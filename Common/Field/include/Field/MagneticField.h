@@ -272,6 +272,8 @@ class MagneticField : public FairField
    private:
     MagneticField(const MagneticField &src);
 
+    friend class MagFieldFast;
+
 
     
     ClassDef(AliceO2::Field::MagneticField,
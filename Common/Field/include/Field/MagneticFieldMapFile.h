@@ -0,0 +1,277 @@
+/// \file MagneticFieldMapFile.h
+/// \brief Definition of the flat binary container for the Chebyshev parameterizations of the mag.field
+
+#ifndef ALICEO2_FIELD_MAGNETICFIELDMAPFILE_H_
+#define ALICEO2_FIELD_MAGNETICFIELDMAPFILE_H_
+
+#include <cmath>   // for sqrt, atan2, cos, sin
+#include <cstddef> // for size_t
+#include <cstdint> // for uint16_t, uint32_t, uint64_t, int32_t
+#include <string>  // for string
+#include <vector>  // for vector
+
+namespace AliceO2 {
+namespace Field {
+
+/// Layout of the flat binary image of MagneticWrapperChebyshev.
+/// The file starts with the Header, followed by the lookup tables of every region, the ParamRecord
+/// (one per Chebyshev3D piece), the CalcRecord (one per output dimension of every piece) and the
+/// coefficient blocks. All references between the blocks are byte offsets from the beginning of the
+/// file, every block is aligned to Alignment bytes, so the image is position independent and can be
+/// used in place once mapped to memory.
+namespace MapFileLayout {
+constexpr char Magic[8] = { 'O', '2', 'C', 'H', 'E', 'B', '3', 'D' };
+constexpr uint32_t Version = 1;
+constexpr uint64_t Alignment = 8;
+constexpr int NameLength = 64;
+
+/// Parameterized regions, in the order they are stored in the header
+enum Region : uint32_t { kSolenoid = 0, kTPCIntegral, kTPCRatIntegral, kDipole, kNRegions };
+
+/// Image of the Chebyshev3DCalc: 1D output component of the single parameterization piece
+struct CalcRecord {
+  int32_t numberOfRows;           ///< number of significant rows in the 3D coeffs matrix
+  int32_t numberOfColumns;        ///< max number of significant cols in the 3D coeffs matrix
+  int32_t numberOfElementsBound2D;///< number of elements of the 2D boundary matrices
+  int32_t numberOfCoefficients;   ///< total number of coefficients
+  uint64_t columnsAtRow;          ///< offset of uint16_t[numberOfRows]
+  uint64_t columnAtRowBeginning;  ///< offset of uint16_t[numberOfRows]
+  uint64_t coefficientBound2D0;   ///< offset of uint16_t[numberOfElementsBound2D]
+  uint64_t coefficientBound2D1;   ///< offset of uint16_t[numberOfElementsBound2D]
+  uint64_t coefficients;          ///< offset of float[numberOfCoefficients]
+};
+
+/// Image of the Chebyshev3D: single parameterization piece with 3 output dimensions
+struct ParamRecord {
+  float minBoundaries[3];         ///< min boundaries in each dimension
+  float maxBoundaries[3];         ///< max boundaries in each dimension
+  float boundaryMappingScale[3];  ///< scale for boundary mapping to [-1:1] interval
+  float boundaryMappingOffset[3]; ///< offset for boundary mapping to [-1:1] interval
+  uint64_t calc[3];               ///< offsets of the CalcRecord for each output dimension
+};
+
+/// Segmentation lookup tables of the region, see MagneticWrapperChebyshev::buildTable.
+/// For the dipole the P and R segments stand for the Y and X ones.
+struct RegionRecord {
+  int32_t numberOfParameterizations; ///< total number of pieces
+  int32_t numberOfZSegments;         ///< number of distinct Z segments
+  int32_t numberOfPSegments;         ///< number of distinct P segments
+  int32_t numberOfRSegments;         ///< number of distinct R segments
+  float minZ;                        ///< min Z of the parameterization
+  float maxZ;                        ///< max Z of the parameterization
+  float maxR;                        ///< max radius of the parameterization
+  int32_t reserved;
+  uint64_t coordinatesSegmentsZ;     ///< offset of float[numberOfZSegments]
+  uint64_t coordinatesSegmentsP;     ///< offset of float[numberOfPSegments]
+  uint64_t coordinatesSegmentsR;     ///< offset of float[numberOfRSegments]
+  uint64_t beginningOfSegmentsP;     ///< offset of int32_t[numberOfZSegments]
+  uint64_t numberOfSegmentsP;        ///< offset of int32_t[numberOfZSegments]
+  uint64_t beginningOfSegmentsR;     ///< offset of int32_t[numberOfPSegments]
+  uint64_t numberOfSegmentsR;        ///< offset of int32_t[numberOfPSegments]
+  uint64_t segmentId;                ///< offset of int32_t[numberOfRSegments]
+  uint64_t parameterizations;        ///< offset of ParamRecord[numberOfParameterizations]
+};
+
+struct Header {
+  char magic[8];                     ///< Magic
+  uint32_t version;                  ///< Version
+  uint32_t headerSize;               ///< sizeof(Header), for consistency check
+  uint64_t fileSize;                 ///< total size of the image
+  char name[NameLength];             ///< name of the field map
+  RegionRecord regions[kNRegions];   ///< lookup tables of all regions
+};
+
+inline uint64_t align(uint64_t offset)
+{
+  return (offset + Alignment - 1) & ~(Alignment - 1);
+}
+}
+
+/// Read-only view of the flat binary image of MagneticWrapperChebyshev (see MapFileLayout).
+/// The image is mmap-ed read-only and shared, so the pages are shared by all processes on a node
+/// which use the same map, and the field is evaluated directly from the mapped memory.
+/// The image can be also built in memory and adopted, see MagneticWrapperChebyshev::fillMappedImage.
+/// Contrary to Chebyshev3D the evaluation does not need any scratch buffer, hence it is thread safe.
+class MagneticFieldMapFile
+{
+  public:
+    MagneticFieldMapFile() = default;
+    ~MagneticFieldMapFile();
+
+    MagneticFieldMapFile(const MagneticFieldMapFile&) = delete;
+    MagneticFieldMapFile& operator=(const MagneticFieldMapFile&) = delete;
+
+    /// Maps the file and validates its content, on failure the reason is stored in the error
+    bool open(const char* fileName, std::string* error = nullptr);
+
+    /// Takes over the image built in memory and validates it
+    bool adopt(std::vector<char>&& image, std::string* error = nullptr);
+
+    /// Unmaps the file or releases the adopted image
+    void close();
+
+    bool isOpen() const
+    {
+      return mBase != nullptr;
+    }
+
+    const char* getName() const
+    {
+      return header().name;
+    }
+
+    size_t getSize() const
+    {
+      return mSize;
+    }
+
+    const MapFileLayout::Header& header() const
+    {
+      return *reinterpret_cast<const MapFileLayout::Header*>(mBase);
+    }
+
+    const MapFileLayout::RegionRecord& getRegion(MapFileLayout::Region reg) const
+    {
+      return header().regions[reg];
+    }
+
+    int getNumberOfParameterizations(MapFileLayout::Region reg) const
+    {
+      return getRegion(reg).numberOfParameterizations;
+    }
+
+    const MapFileLayout::ParamRecord& getParameterization(MapFileLayout::Region reg, int ipar) const
+    {
+      return at<MapFileLayout::ParamRecord>(getRegion(reg).parameterizations)[ipar];
+    }
+
+    /// Computes field in cartesian coordinates, same as MagneticWrapperChebyshev::Field
+    void Field(const double* xyz, double* b) const;
+
+    /// Computes Bz in cartesian coordinates, same as MagneticWrapperChebyshev::getBz
+    double getBz(const double* xyz) const;
+
+    /// Computes Solenoid field in cylindrical coordinates
+    void fieldCylindricalSolenoid(const double* rphiz, double* b) const;
+
+    /// Computes Solenoid Bz in cylindrical coordinates
+    double fieldCylindricalSolenoidBz(const double* rphiz) const;
+
+    /// Computes field integral in TPC region in cylindrical coordinates
+    void getTPCIntegralCylindrical(const double* rphiz, double* b) const;
+
+    /// Computes field ratios integral in TPC region in cylindrical coordinates
+    void getTPCRatIntegralCylindrical(const double* rphiz, double* b) const;
+
+    /// Finds the segment containing point (in the region coordinates).
+    /// If it is outside it finds the closest segment
+    int findSegment(MapFileLayout::Region reg, const double* pnt) const;
+
+    /// Checks if the point is inside of the fitted box
+    template <typename T>
+    static bool isInside(const MapFileLayout::ParamRecord& par, const T* pnt)
+    {
+      for (int i = 3; i--;) {
+        if (par.minBoundaries[i] > pnt[i] || pnt[i] > par.maxBoundaries[i]) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /// Evaluates all 3 output dimensions of the parameterization piece
+    template <typename T>
+    void Eval(const MapFileLayout::ParamRecord& par, const T* pnt, T* res) const
+    {
+      float x[3];
+      mapToInternal(par, pnt, x);
+      for (int i = 3; i--;) {
+        res[i] = evaluateCalc(at<MapFileLayout::CalcRecord>(par.calc[i])[0], x);
+      }
+    }
+
+    /// Evaluates idim-th output dimension of the parameterization piece
+    template <typename T>
+    T Eval(const MapFileLayout::ParamRecord& par, const T* pnt, int idim) const
+    {
+      float x[3];
+      mapToInternal(par, pnt, x);
+      return evaluateCalc(at<MapFileLayout::CalcRecord>(par.calc[idim])[0], x);
+    }
+
+  private:
+    template <typename T>
+    const T* at(uint64_t offset) const
+    {
+      return reinterpret_cast<const T*>(mBase + offset);
+    }
+
+    /// Checks that all blocks referred by the header are inside of the image, and that the segment,
+    /// parameterization and coefficient indices stored in the blocks stay within the referred tables
+    bool validate(std::string& error) const;
+
+    template <typename T>
+    static void mapToInternal(const MapFileLayout::ParamRecord& par, const T* pnt, float* x)
+    {
+      for (int i = 3; i--;) {
+        x[i] = (pnt[i] - par.boundaryMappingOffset[i]) * par.boundaryMappingScale[i];
+      }
+    }
+
+    /// Evaluates 1D Chebyshev parameterization, x is the argument mapped to [-1:1] interval
+    static float chebyshevEvaluation1D(float x, const float* array, int ncf)
+    {
+      if (ncf <= 0) {
+        return 0;
+      }
+      float b0, b1, b2, x2 = x + x;
+      b0 = array[--ncf];
+      b1 = b2 = 0;
+      for (int i = ncf; i--;) {
+        b2 = b1;
+        b1 = b0;
+        b0 = array[i] + x2 * b1 - b2;
+      }
+      return b0 - x * b1;
+    }
+
+    /// Evaluates the Chebyshev3DCalc image. The 2D and 1D summations are done by Clenshaw recurrences
+    /// running along with the loops over the rows and columns, which reproduces the arithmetic of the
+    /// Chebyshev3DCalc::Eval without its temporary arrays.
+    float evaluateCalc(const MapFileLayout::CalcRecord& calc, const float* par) const
+    {
+      if (!calc.numberOfRows) {
+        return 0.;
+      }
+      const uint16_t* colsAtRow = at<uint16_t>(calc.columnsAtRow);
+      const uint16_t* colAtRowBg = at<uint16_t>(calc.columnAtRowBeginning);
+      const uint16_t* bound0 = at<uint16_t>(calc.coefficientBound2D0);
+      const uint16_t* bound1 = at<uint16_t>(calc.coefficientBound2D1);
+      const float* coefs = at<float>(calc.coefficients);
+      const float x0 = par[0], x0x2 = x0 + x0, x1 = par[1], x1x2 = x1 + x1;
+      float r0 = 0, r1 = 0, r2;
+      for (int id0 = calc.numberOfRows; id0--;) {
+        int nCLoc = colsAtRow[id0]; // number of significant coefs on this row
+        int col0 = colAtRowBg[id0]; // beginning of local column in the 2D boundary matrix
+        float c0 = 0, c1 = 0, c2;
+        for (int id1 = nCLoc; id1--;) {
+          int id = id1 + col0, ncfRC = bound0[id];
+          c2 = c1;
+          c1 = c0;
+          c0 = (ncfRC ? chebyshevEvaluation1D(par[2], coefs + bound1[id], ncfRC) : 0.f) + x1x2 * c1 - c2;
+        }
+        r2 = r1;
+        r1 = r0;
+        r0 = (nCLoc > 0 ? c0 - x1 * c1 : 0.f) + x0x2 * r1 - r2;
+      }
+      return r0 - x0 * r1;
+    }
+
+    const char* mBase = nullptr;   ///< beginning of the mapped image
+    size_t mSize = 0;              ///< size of the mapped image
+    std::vector<char> mOwnedImage; ///< adopted image, if not mapped from the file
+};
+}
+}
+
+#endif
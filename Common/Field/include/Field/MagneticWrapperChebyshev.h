@@ -8,6 +8,9 @@
 #include <TMath.h>                      // for ATan2, Cos, Sin, Sqrt
 #include <TNamed.h>                     // for TNamed
 #include <TObjArray.h>                  // for TObjArray
+#include <memory>                       // for shared_ptr
+#include <vector>                       // for vector
+#include "Field/MagneticFieldMapFile.h" // for MagneticFieldMapFile
 #include "MathUtils/Chebyshev3D.h"      // for Chebyshev3D
 #include "MathUtils/Chebyshev3DCalc.h"  // for _INC_CREATION_Chebyshev3D_
 #include "Rtypes.h"                     // for Double_t, Int_t, Float_t, etc
@@ -38,6 +41,9 @@ namespace Field {
 ///  getTPCIntegral(double* xyz, double* bxyz);  for cartesian frame
 ///  or getTPCIntegralCylindrical(Double_t *rphiz, Double_t *b); for cylindrical frame
 ///  The units are kiloGauss and cm.
+///  Instead of ROOT streaming the parameterization can be attached to its flat binary image
+///  (see MagneticFieldMapFile) with loadMappedData. In this mode the field is evaluated directly from
+///  the mapped memory and the Chebyshev3D pieces are not available. The image is produced by saveMappedData.
 class MagneticWrapperChebyshev : public TNamed
 {
 
@@ -114,7 +120,7 @@ class MagneticWrapperChebyshev : public TNamed
 
     Float_t getMinZ() const
     {
-      return mParameterizationDipole ? getMinZDip() : getMinZSol();
+      return (mParameterizationDipole || hasMappedDipole()) ? getMinZDip() : getMinZSol();
     }
 
     Float_t getMinZSol() const
@@ -195,6 +201,30 @@ class MagneticWrapperChebyshev : public TNamed
     /// Prints info
     virtual void Print(Option_t * = "") const;
 
+    /// Fills the flat binary image of the parameterization (see MagneticFieldMapFile)
+    Bool_t fillMappedImage(std::vector<char> &image) const;
+
+    /// Returns the flat binary view of the parameterization: the mapped one if attached by loadMappedData,
+    /// otherwise the one built in memory. Contrary to the Chebyshev3D pieces it can be evaluated concurrently.
+    std::shared_ptr<const MagneticFieldMapFile> getMappedView() const;
+
+    /// Writes the parameterization to the flat binary image which can be used by loadMappedData
+    Bool_t saveMappedData(const char *outfile) const;
+
+    /// Attaches to the flat binary image of the parameterization, all previous content is cleared
+    Bool_t loadMappedData(const char *inpfile);
+
+    /// Returns the mapped image if the parameterization was attached by loadMappedData
+    const MagneticFieldMapFile *getMappedData() const
+    {
+      return mMappedData.get();
+    }
+
+    Bool_t hasMappedDipole() const
+    {
+      return mMappedData && mMappedData->getNumberOfParameterizations(MapFileLayout::kDipole) > 0;
+    }
+
     /// Computes field in cartesian coordinates. If point is outside of the parameterized region
     /// it gets it at closest valid point
     virtual void Field(const Double_t *xyz, Double_t *b) const;
@@ -403,6 +433,7 @@ class MagneticWrapperChebyshev : public TNamed
     Float_t mMaxDipoleZ;     ///< Max Z of Dipole parameterization
     TObjArray *mParameterizationDipole; ///< Parameterization pieces for Dipole field
 
+    std::shared_ptr<const MagneticFieldMapFile> mMappedData; //! mapped flat image, if used instead of the pieces
     FairLogger *mLogger; //!
     ClassDef(AliceO2::Field::MagneticWrapperChebyshev,
     2) // Wrapper class for the set of Chebishev parameterizations of Alice mag.field
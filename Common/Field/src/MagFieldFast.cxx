@@ -0,0 +1,69 @@
+/// \file MagFieldFast.cxx
+/// \brief Implementation of the MagFieldFast: light-weight single precision field query for tracking
+
+#include "Field/MagFieldFast.h"
+#include <atomic>                           // for atomic
+#include "Field/MagneticField.h"            // for MagneticField
+#include "Field/MagneticWrapperChebyshev.h" // for MagneticWrapperChebyshev
+
+using namespace AliceO2::Field;
+using namespace AliceO2::Field::MapFileLayout;
+
+thread_local MagFieldFast::SegmentCache MagFieldFast::sCache;
+
+namespace {
+std::atomic<uint64_t> sInstanceCounter(0);
+}
+
+MagFieldFast::MagFieldFast(const MagneticField& field)
+  : mMap(field.getMeasuredMap() ? field.getMeasuredMap()->getMappedView() : nullptr),
+    mSolenoidToDipoleZ(MagneticField::sSolenoidToDipoleZ),
+    mDipoleOff(field.mDipoleOnOffFlag)
+{
+  init(field.mMultipicativeFactorSolenoid, field.mMultipicativeFactorDipole);
+}
+
+MagFieldFast::MagFieldFast(const MagneticWrapperChebyshev& map, float factorSol, float factorDip)
+  : mMap(map.getMappedView()), mSolenoidToDipoleZ(MagneticField::sSolenoidToDipoleZ), mDipoleOff(false)
+{
+  init(factorSol, factorDip);
+}
+
+void MagFieldFast::init(float factorSol, float factorDip)
+{
+  mId = ++sInstanceCounter;
+  mFactorSolenoid = factorSol;
+  mFactorDipole = factorDip;
+  // without the map every query falls outside of the measured region
+  mSolenoidMinZ = mMinZ = mMaxZ = 1e30f;
+  if (!mMap) {
+    return;
+  }
+  const RegionRecord& sol = mMap->getRegion(kSolenoid);
+  const RegionRecord& dip = mMap->getRegion(kDipole);
+  mSolenoidMinZ = sol.minZ;
+  mMaxZ = sol.maxZ;
+  mMinZ = dip.numberOfParameterizations > 0 ? dip.minZ : sol.minZ;
+}
+
+const ParamRecord* MagFieldFast::lookupSegment(Region reg, const float* pnt) const
+{
+  const double pntd[3] = { pnt[0], pnt[1], pnt[2] };
+  int id = mMap->findSegment(reg, pntd);
+  if (id < 0) {
+    return nullptr;
+  }
+  const ParamRecord* par = &mMap->getParameterization(reg, id);
+#ifndef _BRING_TO_BOUNDARY_ // exact matching to fitted volume is requested
+  if (!MagneticFieldMapFile::isInside(*par, pnt)) {
+    return nullptr;
+  }
+#endif
+  SegmentCache& cache = sCache;
+  if (cache.owner != mId) {
+    cache = SegmentCache();
+    cache.owner = mId;
+  }
+  cache.pieces[reg == kDipole] = par;
+  return par;
+}
@@ -6,6 +6,7 @@
 #include <TFile.h>                     // for TFile
 #include <TPRegexp.h>                  // for TPRegexp
 #include <TSystem.h>                   // for TSystem, gSystem
+#include <string.h>                    // for strcmp
 #include "FairLogger.h"                // for FairLogger, MESSAGE_ORIGIN
 #include "FairParamList.h"
 #include "FairRun.h"
@@ -210,6 +211,21 @@ Bool_t MagneticField::loadParameterization()
   }
 
   char *fname = gSystem->ExpandPathName(getDataFileName());
+
+  // flat binary image of single parameterization, mapped in memory instead of being streamed
+  if (TString(fname).EndsWith(".bin")) {
+    mMeasuredMap = std::unique_ptr<MagneticWrapperChebyshev>(new MagneticWrapperChebyshev());
+    if (!mMeasuredMap->loadMappedData(fname)) {
+      mLogger->Fatal(MESSAGE_ORIGIN, "Failed to map magnetic field data file %s\n", fname);
+    }
+    if (strcmp(mMeasuredMap->GetName(), getParameterName())) {
+      mLogger->Fatal(MESSAGE_ORIGIN, "Field image %s contains %s instead of %s\n", fname, mMeasuredMap->GetName(),
+                     getParameterName());
+    }
+    delete[] fname;
+    return kTRUE;
+  }
+
   TFile *file = TFile::Open(fname);
   if (!file) {
     mLogger->Fatal(MESSAGE_ORIGIN, "Failed to open magnetic field data file %s\n", fname);
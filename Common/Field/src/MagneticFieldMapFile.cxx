@@ -0,0 +1,342 @@
+/// \file MagneticFieldMapFile.cxx
+/// \brief Implementation of the flat binary container for the Chebyshev parameterizations of the mag.field
+
+#include "Field/MagneticFieldMapFile.h"
+#include <fcntl.h>     // for open, O_RDONLY
+#include <sys/mman.h>  // for mmap, munmap, madvise
+#include <sys/stat.h>  // for fstat
+#include <unistd.h>    // for close
+#include <algorithm>   // for upper_bound, max
+#include <cstring>     // for memcmp
+
+using namespace AliceO2::Field;
+using namespace AliceO2::Field::MapFileLayout;
+
+MagneticFieldMapFile::~MagneticFieldMapFile()
+{
+  close();
+}
+
+bool MagneticFieldMapFile::open(const char* fileName, std::string* error)
+{
+  close();
+  std::string reason;
+  int fd = ::open(fileName, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    reason = "cannot open file";
+  } else if (static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    reason = "file is too short";
+  } else {
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      reason = "mmap failed";
+    } else {
+      // the whole map is needed anyway, ask the kernel to read it ahead
+      madvise(addr, st.st_size, MADV_WILLNEED);
+      mBase = static_cast<const char*>(addr);
+      mSize = st.st_size;
+    }
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  if (mBase && !validate(reason)) {
+    close();
+  }
+  if (!mBase && error) {
+    *error = std::string(fileName) + ": " + reason;
+  }
+  return mBase != nullptr;
+}
+
+bool MagneticFieldMapFile::adopt(std::vector<char>&& image, std::string* error)
+{
+  close();
+  std::string reason = "image is too short";
+  mOwnedImage.swap(image);
+  if (mOwnedImage.size() >= sizeof(Header)) {
+    mBase = mOwnedImage.data();
+    mSize = mOwnedImage.size();
+    if (!validate(reason)) {
+      close();
+    }
+  }
+  if (!mBase && error) {
+    *error = reason;
+  }
+  return mBase != nullptr;
+}
+
+void MagneticFieldMapFile::close()
+{
+  if (mBase && mOwnedImage.empty()) {
+    munmap(const_cast<char*>(mBase), mSize);
+  }
+  std::vector<char>().swap(mOwnedImage);
+  mBase = nullptr;
+  mSize = 0;
+}
+
+bool MagneticFieldMapFile::validate(std::string& error) const
+{
+  const Header& hdr = header();
+  if (memcmp(hdr.magic, Magic, sizeof(Magic)) != 0) {
+    error = "not a Chebyshev field map image";
+    return false;
+  }
+  if (hdr.version != Version || hdr.headerSize != sizeof(Header)) {
+    error = "unsupported image version " + std::to_string(hdr.version);
+    return false;
+  }
+  if (hdr.fileSize != mSize) {
+    error = "image size mismatch, the file is truncated";
+    return false;
+  }
+  // the counts are signed in the layout, a negative one must not wrap around
+  auto inside = [this](uint64_t offset, int64_t count, size_t size) {
+    return count >= 0 && offset % Alignment == 0 && offset <= mSize && uint64_t(count) <= (mSize - offset) / size;
+  };
+  // every table entry [begin, begin + max(n, 1)) must stay in the table of the given size, the lookups
+  // access the first entry of the range even if it is empty
+  auto inRange = [](int64_t begin, int64_t n, int64_t size) {
+    return begin >= 0 && n >= 0 && begin + std::max<int64_t>(n, 1) <= size;
+  };
+  for (int ireg = 0; ireg < int(kNRegions); ireg++) {
+    const RegionRecord& reg = hdr.regions[ireg];
+    if (reg.numberOfParameterizations <= 0) {
+      continue;
+    }
+    if (!inside(reg.coordinatesSegmentsZ, reg.numberOfZSegments, sizeof(float)) ||
+        !inside(reg.coordinatesSegmentsP, reg.numberOfPSegments, sizeof(float)) ||
+        !inside(reg.coordinatesSegmentsR, reg.numberOfRSegments, sizeof(float)) ||
+        !inside(reg.beginningOfSegmentsP, reg.numberOfZSegments, sizeof(int32_t)) ||
+        !inside(reg.numberOfSegmentsP, reg.numberOfZSegments, sizeof(int32_t)) ||
+        !inside(reg.beginningOfSegmentsR, reg.numberOfPSegments, sizeof(int32_t)) ||
+        !inside(reg.numberOfSegmentsR, reg.numberOfPSegments, sizeof(int32_t)) ||
+        !inside(reg.segmentId, reg.numberOfRSegments, sizeof(int32_t)) ||
+        !inside(reg.parameterizations, reg.numberOfParameterizations, sizeof(ParamRecord))) {
+      error = "corrupted lookup table of region " + std::to_string(ireg);
+      return false;
+    }
+    // the indices followed by findSegment
+    bool indicesValid = reg.numberOfZSegments > 0;
+    const int32_t* begSegP = at<int32_t>(reg.beginningOfSegmentsP);
+    const int32_t* nSegP = at<int32_t>(reg.numberOfSegmentsP);
+    for (int iz = 0; indicesValid && iz < reg.numberOfZSegments; iz++) {
+      indicesValid = inRange(begSegP[iz], nSegP[iz], reg.numberOfPSegments);
+    }
+    const int32_t* begSegR = at<int32_t>(reg.beginningOfSegmentsR);
+    const int32_t* nSegR = at<int32_t>(reg.numberOfSegmentsR);
+    for (int ip = 0; indicesValid && ip < reg.numberOfPSegments; ip++) {
+      indicesValid = inRange(begSegR[ip], nSegR[ip], reg.numberOfRSegments);
+    }
+    const int32_t* segId = at<int32_t>(reg.segmentId);
+    for (int ir = 0; indicesValid && ir < reg.numberOfRSegments; ir++) {
+      indicesValid = inRange(segId[ir], 1, reg.numberOfParameterizations);
+    }
+    if (!indicesValid) {
+      error = "segment index out of range in the lookup table of region " + std::to_string(ireg);
+      return false;
+    }
+    for (int ipar = 0; ipar < reg.numberOfParameterizations; ipar++) {
+      const ParamRecord& par = at<ParamRecord>(reg.parameterizations)[ipar];
+      for (int idim = 0; idim < 3; idim++) {
+        if (!inside(par.calc[idim], 1, sizeof(CalcRecord))) {
+          error = "corrupted parameterization " + std::to_string(ipar) + " of region " + std::to_string(ireg);
+          return false;
+        }
+        const CalcRecord& calc = at<CalcRecord>(par.calc[idim])[0];
+        if (!inside(calc.columnsAtRow, calc.numberOfRows, sizeof(uint16_t)) ||
+            !inside(calc.columnAtRowBeginning, calc.numberOfRows, sizeof(uint16_t)) ||
+            !inside(calc.coefficientBound2D0, calc.numberOfElementsBound2D, sizeof(uint16_t)) ||
+            !inside(calc.coefficientBound2D1, calc.numberOfElementsBound2D, sizeof(uint16_t)) ||
+            !inside(calc.coefficients, calc.numberOfCoefficients, sizeof(float))) {
+          error = "corrupted coefficients of parameterization " + std::to_string(ipar) + " of region " +
+                  std::to_string(ireg);
+          return false;
+        }
+        // the indices followed by evaluateCalc
+        bool indicesValid = true;
+        const uint16_t* colsAtRow = at<uint16_t>(calc.columnsAtRow);
+        const uint16_t* colAtRowBg = at<uint16_t>(calc.columnAtRowBeginning);
+        for (int irow = 0; indicesValid && irow < calc.numberOfRows; irow++) {
+          indicesValid = colAtRowBg[irow] + colsAtRow[irow] <= calc.numberOfElementsBound2D;
+        }
+        const uint16_t* bound0 = at<uint16_t>(calc.coefficientBound2D0);
+        const uint16_t* bound1 = at<uint16_t>(calc.coefficientBound2D1);
+        for (int iel = 0; indicesValid && iel < calc.numberOfElementsBound2D; iel++) {
+          indicesValid = bound1[iel] + bound0[iel] <= calc.numberOfCoefficients;
+        }
+        if (!indicesValid) {
+          error = "coefficient index out of range in parameterization " + std::to_string(ipar) + " of region " +
+                  std::to_string(ireg);
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int MagneticFieldMapFile::findSegment(Region ireg, const double* pnt) const
+{
+  const RegionRecord& reg = getRegion(ireg);
+  if (reg.numberOfParameterizations <= 0) {
+    return -1;
+  }
+  const float* segZ = at<float>(reg.coordinatesSegmentsZ);
+  const float* segP = at<float>(reg.coordinatesSegmentsP);
+  const float* segR = at<float>(reg.coordinatesSegmentsR);
+  const int32_t* begSegP = at<int32_t>(reg.beginningOfSegmentsP);
+  const int32_t* nSegP = at<int32_t>(reg.numberOfSegmentsP);
+  const int32_t* begSegR = at<int32_t>(reg.beginningOfSegmentsR);
+  const int32_t* nSegR = at<int32_t>(reg.numberOfSegmentsR);
+  const int32_t* segId = at<int32_t>(reg.segmentId);
+
+  // same as TMath::BinarySearch: last Z segment starting below the point
+  int rid, pid, zid = std::upper_bound(segZ, segZ + reg.numberOfZSegments, float(pnt[2])) - segZ - 1;
+  if (zid < 0) {
+    zid = 0;
+  }
+
+  bool reCheck = false;
+  while (1) {
+    int psegBeg = begSegP[zid];
+    for (pid = 0; pid < nSegP[zid]; pid++) {
+      if (pnt[1] < segP[psegBeg + pid]) {
+        break;
+      }
+    }
+    if (--pid < 0) {
+      pid = 0;
+    }
+    pid += psegBeg;
+
+    int rsegBeg = begSegR[pid];
+    for (rid = 0; rid < nSegR[pid]; rid++) {
+      if (pnt[0] < segR[rsegBeg + rid]) {
+        break;
+      }
+    }
+    if (--rid < 0) {
+      rid = 0;
+    }
+    rid += rsegBeg;
+
+    // to make sure that due to the precision problems we did not pick the next Zbin
+    if (!reCheck && (pnt[2] - segZ[zid] < 3.e-5) && zid &&
+        !isInside(getParameterization(ireg, segId[rid]), pnt)) { // check the previous Z bin
+      zid--;
+      reCheck = true;
+      continue;
+    }
+    break;
+  }
+  return segId[rid];
+}
+
+void MagneticFieldMapFile::Field(const double* xyz, double* b) const
+{
+#ifndef _BRING_TO_BOUNDARY_ // exact matching to fitted volume is requested
+  b[0] = b[1] = b[2] = 0;
+#endif
+
+  if (xyz[2] > getRegion(kSolenoid).minZ) {
+    double rphiz[3] = { std::sqrt(xyz[0] * xyz[0] + xyz[1] * xyz[1]), std::atan2(xyz[1], xyz[0]), xyz[2] };
+    fieldCylindricalSolenoid(rphiz, b);
+    // convert field to cartesian system
+    double btr = std::sqrt(b[0] * b[0] + b[1] * b[1]);
+    double psiPLUSphi = std::atan2(b[1], b[0]) + rphiz[1];
+    b[0] = btr * std::cos(psiPLUSphi);
+    b[1] = btr * std::sin(psiPLUSphi);
+    return;
+  }
+
+  int iddip = findSegment(kDipole, xyz);
+  if (iddip < 0) {
+    return;
+  }
+  const ParamRecord& par = getParameterization(kDipole, iddip);
+#ifndef _BRING_TO_BOUNDARY_
+  if (!isInside(par, xyz)) {
+    return;
+  }
+#endif
+  Eval(par, xyz, b);
+}
+
+double MagneticFieldMapFile::getBz(const double* xyz) const
+{
+  if (xyz[2] > getRegion(kSolenoid).minZ) {
+    double rphiz[3] = { std::sqrt(xyz[0] * xyz[0] + xyz[1] * xyz[1]), std::atan2(xyz[1], xyz[0]), xyz[2] };
+    return fieldCylindricalSolenoidBz(rphiz);
+  }
+
+  int iddip = findSegment(kDipole, xyz);
+  if (iddip < 0) {
+    return 0.;
+  }
+  const ParamRecord& par = getParameterization(kDipole, iddip);
+#ifndef _BRING_TO_BOUNDARY_
+  if (!isInside(par, xyz)) {
+    return 0.;
+  }
+#endif
+  return Eval(par, xyz, 2);
+}
+
+void MagneticFieldMapFile::fieldCylindricalSolenoid(const double* rphiz, double* b) const
+{
+  int id = findSegment(kSolenoid, rphiz);
+  if (id < 0) {
+    return;
+  }
+  const ParamRecord& par = getParameterization(kSolenoid, id);
+#ifndef _BRING_TO_BOUNDARY_ // exact matching to fitted volume is requested
+  if (!isInside(par, rphiz)) {
+    return;
+  }
+#endif
+  Eval(par, rphiz, b);
+}
+
+double MagneticFieldMapFile::fieldCylindricalSolenoidBz(const double* rphiz) const
+{
+  int id = findSegment(kSolenoid, rphiz);
+  if (id < 0) {
+    return 0.;
+  }
+  const ParamRecord& par = getParameterization(kSolenoid, id);
+#ifndef _BRING_TO_BOUNDARY_
+  return isInside(par, rphiz) ? Eval(par, rphiz, 2) : 0;
+#else
+  return Eval(par, rphiz, 2);
+#endif
+}
+
+void MagneticFieldMapFile::getTPCIntegralCylindrical(const double* rphiz, double* b) const
+{
+  int id = findSegment(kTPCIntegral, rphiz);
+  if (id >= 0 && id < getNumberOfParameterizations(kTPCIntegral)) {
+    const ParamRecord& par = getParameterization(kTPCIntegral, id);
+    if (isInside(par, rphiz)) {
+      Eval(par, rphiz, b);
+      return;
+    }
+  }
+  b[0] = b[1] = b[2] = 0;
+}
+
+void MagneticFieldMapFile::getTPCRatIntegralCylindrical(const double* rphiz, double* b) const
+{
+  int id = findSegment(kTPCRatIntegral, rphiz);
+  if (id >= 0 && id < getNumberOfParameterizations(kTPCRatIntegral)) {
+    const ParamRecord& par = getParameterization(kTPCRatIntegral, id);
+    if (isInside(par, rphiz)) {
+      Eval(par, rphiz, b);
+      return;
+    }
+  }
+  b[0] = b[1] = b[2] = 0;
+}
@@ -8,6 +8,8 @@
 #include <TSystem.h>     // for TSystem, gSystem
 #include <stdio.h>       // for printf, fprintf, fclose, fopen, FILE
 #include <string.h>      // for memcpy
+#include <utility>       // for move
+#include <vector>        // for vector
 #include "FairLogger.h"  // for FairLogger, MESSAGE_ORIGIN
 #include "TMath.h"       // for BinarySearch, Sort
 #include "TMathBase.h"   // for Abs
@@ -17,6 +19,7 @@
 
 using namespace AliceO2::Field;
 using namespace AliceO2::MathUtils;
+using namespace AliceO2::Field::MapFileLayout;
 
 ClassImp(MagneticWrapperChebyshev)
 
@@ -282,6 +285,9 @@ void MagneticWrapperChebyshev::copyFrom(const MagneticWrapperChebyshev &src)
       mParameterizationDipole->AddAtAndExpand(new Chebyshev3D(*src.getParameterDipole(i)), i);
     }
   }
+
+  // the mapped image is read-only, hence it can be shared
+  mMappedData = src.mMappedData;
 }
 
 MagneticWrapperChebyshev &MagneticWrapperChebyshev::operator=(const MagneticWrapperChebyshev &rhs)
@@ -405,10 +411,17 @@ void MagneticWrapperChebyshev::Clear(const Option_t *)
   mNumberOfDistinctXSegmentsDipole = 0;
   mMinDipoleZ = 1e6;
   mMaxDipoleZ = -1e6;
+
+  mMappedData.reset();
 }
 
 void MagneticWrapperChebyshev::Field(const Double_t *xyz, Double_t *b) const
 {
+  if (mMappedData) {
+    mMappedData->Field(xyz, b);
+    return;
+  }
+
   Double_t rphiz[3];
 
 #ifndef _BRING_TO_BOUNDARY_ // exact matching to fitted volume is requested
@@ -438,6 +451,10 @@ void MagneticWrapperChebyshev::Field(const Double_t *xyz, Double_t *b) const
 
 Double_t MagneticWrapperChebyshev::getBz(const Double_t *xyz) const
 {
+  if (mMappedData) {
+    return mMappedData->getBz(xyz);
+  }
+
   Double_t rphiz[3];
 
   if (xyz[2] > mMinZSolenoid) {
@@ -497,10 +514,220 @@ void MagneticWrapperChebyshev::Print(Option_t *) const
       getParameterDipole(i)->Print();
     }
   }
+
+  if (mMappedData) {
+    printf("Parameterization is mapped from flat image of %zu bytes: %d SOL, %d TPC, %d TPCRat, %d DIP pieces\n",
+           mMappedData->getSize(), mMappedData->getNumberOfParameterizations(kSolenoid),
+           mMappedData->getNumberOfParameterizations(kTPCIntegral),
+           mMappedData->getNumberOfParameterizations(kTPCRatIntegral),
+           mMappedData->getNumberOfParameterizations(kDipole));
+  }
+}
+
+namespace {
+/// Appends the block to the flat image at the aligned position, returns its offset
+uint64_t appendBlock(std::vector<char> &image, const void *data, size_t size)
+{
+  uint64_t offset = align(image.size());
+  image.resize(offset + size);
+  if (data && size) {
+    memcpy(&image[offset], data, size);
+  }
+  return offset;
+}
+}
+
+Bool_t MagneticWrapperChebyshev::fillMappedImage(std::vector<char> &image) const
+{
+  image.clear();
+  if (mMappedData) {
+    const char *base = reinterpret_cast<const char *>(&mMappedData->header());
+    image.assign(base, base + mMappedData->getSize());
+    return kTRUE;
+  }
+
+  struct {
+    Int_t nPar, nZ, nP, nR;
+    Float_t minZ, maxZ, maxR;
+    const Float_t *segZ, *segP, *segR;
+    const Int_t *begSegP, *nSegP, *begSegR, *nSegR, *segId;
+    const TObjArray *params;
+  } source[kNRegions] = {
+    { mNumberOfParameterizationSolenoid, mNumberOfDistinctZSegmentsSolenoid, mNumberOfDistinctPSegmentsSolenoid,
+      mNumberOfDistinctRSegmentsSolenoid, mMinZSolenoid, mMaxZSolenoid, mMaxRadiusSolenoid,
+      mCoordinatesSegmentsZSolenoid, mCoordinatesSegmentsPSolenoid, mCoordinatesSegmentsRSolenoid,
+      mBeginningOfSegmentsPSolenoid, mNumberOfSegmentsPSolenoid, mBeginningOfSegmentsRSolenoid,
+      mNumberOfRSegmentsSolenoid, mSegmentIdSolenoid, mParameterizationSolenoid },
+    { mNumberOfParameterizationTPC, mNumberOfDistinctZSegmentsTPC, mNumberOfDistinctPSegmentsTPC,
+      mNumberOfDistinctRSegmentsTPC, mMinZTPC, mMaxZTPC, mMaxRadiusTPC, mCoordinatesSegmentsZTPC,
+      mCoordinatesSegmentsPTPC, mCoordinatesSegmentsRTPC, mBeginningOfSegmentsPTPC, mNumberOfSegmentsPTPC,
+      mBeginningOfSegmentsRTPC, mNumberOfRSegmentsTPC, mSegmentIdTPC, mParameterizationTPC },
+    { mNumberOfParameterizationTPCRat, mNumberOfDistinctZSegmentsTPCRat, mNumberOfDistinctPSegmentsTPCRat,
+      mNumberOfDistinctRSegmentsTPCRat, mMinZTPCRat, mMaxZTPCRat, mMaxRadiusTPCRat, mCoordinatesSegmentsZTPCRat,
+      mCoordinatesSegmentsPTPCRat, mCoordinatesSegmentsRTPCRat, mBeginningOfSegmentsPTPCRat,
+      mNumberOfSegmentsPTPCRat, mBeginningOfSegmentsRTPCRat, mNumberOfRSegmentsTPCRat, mSegmentIdTPCRat,
+      mParameterizationTPCRat },
+    { mNumberOfParameterizationDipole, mNumberOfDistinctZSegmentsDipole, mNumberOfDistinctYSegmentsDipole,
+      mNumberOfDistinctXSegmentsDipole, mMinDipoleZ, mMaxDipoleZ, 0.f, mCoordinatesSegmentsZDipole,
+      mCoordinatesSegmentsYDipole, mCoordinatesSegmentsXDipole, mBeginningOfSegmentsYDipole,
+      mNumberOfSegmentsYDipole, mBeginningOfSegmentsXDipole, mNumberOfSegmentsXDipole, mSegmentIdDipole,
+      mParameterizationDipole }
+  };
+
+  Header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, Magic, sizeof(Magic));
+  hdr.version = Version;
+  hdr.headerSize = sizeof(Header);
+  strncpy(hdr.name, GetName(), NameLength - 1);
+  image.resize(sizeof(Header));
+
+  for (int ireg = 0; ireg < int(kNRegions); ireg++) {
+    const auto &src = source[ireg];
+    RegionRecord &reg = hdr.regions[ireg];
+    reg.numberOfParameterizations = src.nPar;
+    reg.numberOfZSegments = src.nZ;
+    reg.numberOfPSegments = src.nP;
+    reg.numberOfRSegments = src.nR;
+    reg.minZ = src.minZ;
+    reg.maxZ = src.maxZ;
+    reg.maxR = src.maxR;
+    if (src.nPar < 1) {
+      continue;
+    }
+    reg.coordinatesSegmentsZ = appendBlock(image, src.segZ, sizeof(Float_t) * src.nZ);
+    reg.coordinatesSegmentsP = appendBlock(image, src.segP, sizeof(Float_t) * src.nP);
+    reg.coordinatesSegmentsR = appendBlock(image, src.segR, sizeof(Float_t) * src.nR);
+    reg.beginningOfSegmentsP = appendBlock(image, src.begSegP, sizeof(Int_t) * src.nZ);
+    reg.numberOfSegmentsP = appendBlock(image, src.nSegP, sizeof(Int_t) * src.nZ);
+    reg.beginningOfSegmentsR = appendBlock(image, src.begSegR, sizeof(Int_t) * src.nP);
+    reg.numberOfSegmentsR = appendBlock(image, src.nSegR, sizeof(Int_t) * src.nP);
+    reg.segmentId = appendBlock(image, src.segId, sizeof(Int_t) * src.nR);
+    reg.parameterizations = appendBlock(image, nullptr, sizeof(ParamRecord) * src.nPar);
+
+    for (int ipar = 0; ipar < src.nPar; ipar++) {
+      const Chebyshev3D *cheb = (const Chebyshev3D *) src.params->UncheckedAt(ipar);
+      if (cheb->getOutputArrayDimension() != 3) {
+        mLogger->Error(MESSAGE_ORIGIN, "Piece %d of region %d has %d output dimensions instead of 3", ipar, ireg,
+                       cheb->getOutputArrayDimension());
+        return kFALSE;
+      }
+      ParamRecord par;
+      memset(&par, 0, sizeof(par));
+      for (int i = 3; i--;) {
+        par.minBoundaries[i] = cheb->getBoundMin(i);
+        par.maxBoundaries[i] = cheb->getBoundMax(i);
+        par.boundaryMappingScale[i] = cheb->getBoundaryMappingScale(i);
+        par.boundaryMappingOffset[i] = cheb->getBoundaryMappingOffset(i);
+      }
+      for (int idim = 0; idim < 3; idim++) {
+        const Chebyshev3DCalc *calc = cheb->getChebyshevCalc(idim);
+        CalcRecord rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.numberOfRows = calc->getNumberOfRows();
+        rec.numberOfColumns = calc->getNumberOfColumns();
+        rec.numberOfElementsBound2D = calc->getNumberOfElementsBound2D();
+        rec.numberOfCoefficients = calc->getNumberOfCoefficients();
+        rec.columnsAtRow = appendBlock(image, calc->getNumberOfColumnsAtRow(), sizeof(UShort_t) * rec.numberOfRows);
+        rec.columnAtRowBeginning = appendBlock(image, calc->getColAtRowBg(), sizeof(UShort_t) * rec.numberOfRows);
+        rec.coefficientBound2D0 =
+          appendBlock(image, calc->getCoefficientBound2D0(), sizeof(UShort_t) * rec.numberOfElementsBound2D);
+        rec.coefficientBound2D1 =
+          appendBlock(image, calc->getCoefficientBound2D1(), sizeof(UShort_t) * rec.numberOfElementsBound2D);
+        rec.coefficients = appendBlock(image, calc->getCoefficients(), sizeof(Float_t) * rec.numberOfCoefficients);
+        par.calc[idim] = appendBlock(image, &rec, sizeof(rec));
+      }
+      memcpy(&image[reg.parameterizations + ipar * sizeof(ParamRecord)], &par, sizeof(par));
+    }
+  }
+  image.resize(align(image.size()));
+  hdr.fileSize = image.size();
+  memcpy(&image[0], &hdr, sizeof(hdr));
+  return kTRUE;
+}
+
+std::shared_ptr<const MagneticFieldMapFile> MagneticWrapperChebyshev::getMappedView() const
+{
+  if (mMappedData) {
+    return mMappedData;
+  }
+  std::shared_ptr<MagneticFieldMapFile> view = std::make_shared<MagneticFieldMapFile>();
+  std::vector<char> image;
+  std::string error;
+  if (!fillMappedImage(image) || !view->adopt(std::move(image), &error)) {
+    mLogger->Error(MESSAGE_ORIGIN, "Failed to build flat image of magnetic field %s %s", GetName(), error.c_str());
+    return nullptr;
+  }
+  return view;
+}
+
+Bool_t MagneticWrapperChebyshev::saveMappedData(const char *outfile) const
+{
+  std::vector<char> image;
+  if (!fillMappedImage(image)) {
+    return kFALSE;
+  }
+
+  // write to the temporary file and rename it, so that processes which have the old image mapped are not affected
+  TString strf = outfile;
+  gSystem->ExpandPathName(strf);
+  TString tmpName = strf + ".tmp";
+  FILE *stream = fopen(tmpName, "wb");
+  if (!stream) {
+    mLogger->Error(MESSAGE_ORIGIN, "Failed to open %s for writing", tmpName.Data());
+    return kFALSE;
+  }
+  bool ok = fwrite(image.data(), 1, image.size(), stream) == image.size();
+  ok = (fclose(stream) == 0) && ok;
+  if (!ok || rename(tmpName, strf) != 0) {
+    mLogger->Error(MESSAGE_ORIGIN, "Failed to write magnetic field image to %s", strf.Data());
+    remove(tmpName);
+    return kFALSE;
+  }
+  mLogger->Info(MESSAGE_ORIGIN, "Saved magnetic field \"%s\" image of %zu bytes to %s", GetName(), image.size(),
+                strf.Data());
+  return kTRUE;
+}
+
+Bool_t MagneticWrapperChebyshev::loadMappedData(const char *inpfile)
+{
+  TString strf = inpfile;
+  gSystem->ExpandPathName(strf);
+  std::shared_ptr<MagneticFieldMapFile> mapped = std::make_shared<MagneticFieldMapFile>();
+  std::string error;
+  if (!mapped->open(strf.Data(), &error)) {
+    mLogger->Error(MESSAGE_ORIGIN, "Failed to map magnetic field data %s", error.c_str());
+    return kFALSE;
+  }
+
+  Clear();
+  SetName(mapped->getName());
+  const RegionRecord &sol = mapped->getRegion(kSolenoid);
+  mMinZSolenoid = sol.minZ;
+  mMaxZSolenoid = sol.maxZ;
+  mMaxRadiusSolenoid = sol.maxR;
+  const RegionRecord &tpc = mapped->getRegion(kTPCIntegral);
+  mMinZTPC = tpc.minZ;
+  mMaxZTPC = tpc.maxZ;
+  mMaxRadiusTPC = tpc.maxR;
+  const RegionRecord &tpcRat = mapped->getRegion(kTPCRatIntegral);
+  mMinZTPCRat = tpcRat.minZ;
+  mMaxZTPCRat = tpcRat.maxZ;
+  mMaxRadiusTPCRat = tpcRat.maxR;
+  const RegionRecord &dip = mapped->getRegion(kDipole);
+  mMinDipoleZ = dip.minZ;
+  mMaxDipoleZ = dip.maxZ;
+  mMappedData = mapped;
+
+  mLogger->Info(MESSAGE_ORIGIN, "Mapped magnetic field \"%s\" from %s", GetName(), strf.Data());
+  return kTRUE;
 }
 
 Int_t MagneticWrapperChebyshev::findDipoleSegment(const Double_t *xyz) const
 {
+  if (mMappedData) {
+    return mMappedData->findSegment(kDipole, xyz);
+  }
   if (!mNumberOfParameterizationDipole) {
     return -1;
   }
@@ -547,6 +774,9 @@ Int_t MagneticWrapperChebyshev::findDipoleSegment(const Double_t *xyz) const
 
 Int_t MagneticWrapperChebyshev::findSolenoidSegment(const Double_t *rpz) const
 {
+  if (mMappedData) {
+    return mMappedData->findSegment(kSolenoid, rpz);
+  }
   if (!mNumberOfParameterizationSolenoid) {
     return -1;
   }
@@ -591,6 +821,9 @@ Int_t MagneticWrapperChebyshev::findSolenoidSegment(const Double_t *rpz) const
 
 Int_t MagneticWrapperChebyshev::findTPCSegment(const Double_t *rpz) const
 {
+  if (mMappedData) {
+    return mMappedData->findSegment(kTPCIntegral, rpz);
+  }
   if (!mNumberOfParameterizationTPC) {
     return -1;
   }
@@ -636,6 +869,9 @@ Int_t MagneticWrapperChebyshev::findTPCSegment(const Double_t *rpz) const
 
 Int_t MagneticWrapperChebyshev::findTPCRatSegment(const Double_t *rpz) const
 {
+  if (mMappedData) {
+    return mMappedData->findSegment(kTPCRatIntegral, rpz);
+  }
   if (!mNumberOfParameterizationTPCRat) {
     return -1;
   }
@@ -726,6 +962,10 @@ void MagneticWrapperChebyshev::getTPCRatIntegral(const Double_t *xyz, Double_t *
 
 void MagneticWrapperChebyshev::fieldCylindricalSolenoid(const Double_t *rphiz, Double_t *b) const
 {
+  if (mMappedData) {
+    mMappedData->fieldCylindricalSolenoid(rphiz, b);
+    return;
+  }
   int id = findSolenoidSegment(rphiz);
   if (id < 0) {
     return;
@@ -742,6 +982,9 @@ void MagneticWrapperChebyshev::fieldCylindricalSolenoid(const Double_t *rphiz, D
 
 Double_t MagneticWrapperChebyshev::fieldCylindricalSolenoidBz(const Double_t *rphiz) const
 {
+  if (mMappedData) {
+    return mMappedData->fieldCylindricalSolenoidBz(rphiz);
+  }
   int id = findSolenoidSegment(rphiz);
   if (id < 0) {
     return 0.;
@@ -756,6 +999,10 @@ Double_t MagneticWrapperChebyshev::fieldCylindricalSolenoidBz(const Double_t *rp
 
 void MagneticWrapperChebyshev::getTPCIntegralCylindrical(const Double_t *rphiz, Double_t *b) const
 {
+  if (mMappedData) {
+    mMappedData->getTPCIntegralCylindrical(rphiz, b);
+    return;
+  }
   int id = findTPCSegment(rphiz);
   if (id < 0) {
     b[0] = b[1] = b[2] = 0;
@@ -777,6 +1024,10 @@ void MagneticWrapperChebyshev::getTPCIntegralCylindrical(const Double_t *rphiz,
 
 void MagneticWrapperChebyshev::getTPCRatIntegralCylindrical(const Double_t *rphiz, Double_t *b) const
 {
+  if (mMappedData) {
+    mMappedData->getTPCRatIntegralCylindrical(rphiz, b);
+    return;
+  }
   int id = findTPCRatSegment(rphiz);
   if (id < 0) {
     b[0] = b[1] = b[2] = 0;
@@ -8,6 +8,8 @@
 #include <TNamed.h>           // for TNamed
 #include <TObjArray.h>        // for TObjArray
 #include <stdio.h>            // for FILE, stdout
+#include <functional>         // for function
+#include <vector>             // for vector
 #include "MathUtils/Chebyshev3DCalc.h"  // for Chebyshev3DCalc, etc
 #include "Rtypes.h"           // for Float_t, Int_t, Double_t, Bool_t, etc
 #include "TString.h"          // for TString
@@ -174,6 +176,21 @@ class Chebyshev3D : public TNamed
       return mPrecision;
     }
 
+    Int_t getOutputArrayDimension() const
+    {
+      return mOutputArrayDimension;
+    }
+
+    Float_t getBoundaryMappingScale(int i) const
+    {
+      return mBoundaryMappingScale[i];
+    }
+
+    Float_t getBoundaryMappingOffset(int i) const
+    {
+      return mBoundaryMappingOffset[i];
+    }
+
     void shiftBound(int id, float dif);
 
     void loadData(const char *inpFile);
@@ -192,6 +209,23 @@ class Chebyshev3D : public TNamed
     void evaluateUserFunction(const Float_t* x, Float_t* res);
     TH1* TestRMS(int idim, int npoints = 1000, TH1* histo = 0);
     static Int_t calculateChebyshevCoefficients(const Float_t* funval, int np, Float_t* outCoefs, Float_t prec = -1);
+
+    /// Sets the number of threads used by the fit, 0 (default) stands for all cores.
+    /// The fit result does not depend on the number of threads.
+    static void setNumberOfThreads(Int_t n)
+    {
+      sNumberOfThreads = n;
+    }
+    static Int_t getNumberOfThreads();
+
+    /// Declares that the user function given by the pointer can be called concurrently, so that the grid
+    /// is sampled on all threads. Otherwise the function is called serially, the fit itself is always parallel.
+    /// Since no global state is used by the fit, different pieces of a map can be also created concurrently
+    /// in separate threads, provided the function is thread safe. The macro functions are always called serially.
+    static void setThreadSafeUserFunction(Bool_t v = kTRUE)
+    {
+      sThreadSafeUserFunction = v;
+    }
 #endif
 
   protected:
@@ -206,6 +240,12 @@ class Chebyshev3D : public TNamed
     void defineGrid(const Int_t* npoints);
     Int_t chebyshevFit(); // fit all output dimensions
     Int_t chebyshevFit(int dmOut);
+    void sampleUserFunction(std::vector<Float_t>& values);
+    Int_t fitSampledFunction(const std::vector<Float_t>& values, const std::vector<int>& dims);
+    Int_t storeSignificantCoefficients(Float_t* coefs3D, Chebyshev3DCalc* cheb) const;
+    static void chebyshevTransform(const Float_t* funval, int np, Float_t* outCoefs, const Float_t* cosines);
+    static void fillChebyshevCosines(int np, std::vector<Float_t>& cosines);
+    static void runInParallel(int ntasks, int nthreads, const std::function<void(int)>& task);
     void setPrecision(float prec)
     {
       mPrecision = prec;
@@ -240,9 +280,12 @@ class Chebyshev3D : public TNamed
     Int_t mTemporaryChebyshevGridOffs[3]; //! start of grid for each dimension
     TString mUserFunctionName; //! name of user macro containing the function of  "void (*fcn)(float*,float*)" format
     TMethodCall *mUserMacro;   //! Pointer to MethodCall for function from user macro
+    void (*mUserFunction)(float*, float*); //! Pointer on user function (faster alternative to TMethodCall)
     FairLogger *mLogger;       //!
 
     static const Float_t sMinimumPrecision; ///< minimum precision allowed
+    static Int_t sNumberOfThreads;          ///< number of threads used by the fit, 0 for all cores
+    static Bool_t sThreadSafeUserFunction;  ///< user function can be sampled concurrently
 
     ClassDef(AliceO2::MathUtils::Chebyshev3D,
     2) // Chebyshev parametrization for 3D->N function
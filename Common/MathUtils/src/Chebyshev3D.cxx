@@ -11,6 +11,9 @@
 #include <TString.h>          // for TString
 #include <TSystem.h>          // for TSystem, gSystem
 #include <stdio.h>            // for printf, fprintf, FILE, fclose, fflush, etc
+#include <algorithm>          // for max, copy
+#include <atomic>             // for atomic
+#include <thread>             // for thread, hardware_concurrency
 #include "MathUtils/Chebyshev3DCalc.h"  // for Chebyshev3DCalc, etc
 #include "FairLogger.h"       // for FairLogger, MESSAGE_ORIGIN
 #include "TMathBase.h"        // for Max, Abs
@@ -24,6 +27,9 @@ ClassImp(Chebyshev3D)
   const
 Float_t Chebyshev3D::sMinimumPrecision = 1.e-12f;
 
+Int_t Chebyshev3D::sNumberOfThreads = 0;
+Bool_t Chebyshev3D::sThreadSafeUserFunction = kFALSE;
+
 Chebyshev3D::Chebyshev3D()
   : mOutputArrayDimension(0),
     mPrecision(sMinimumPrecision),
@@ -33,6 +39,7 @@ Chebyshev3D::Chebyshev3D()
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mUserFunction(0),
     mLogger(FairLogger::GetLogger())
 {
   // Default constructor
@@ -54,6 +61,7 @@ Chebyshev3D::Chebyshev3D(const Chebyshev3D &src)
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(src.mUserFunctionName),
     mUserMacro(0),
+    mUserFunction(src.mUserFunction),
     mLogger(FairLogger::GetLogger())
 {
   // read coefs from text file
@@ -83,6 +91,7 @@ Chebyshev3D::Chebyshev3D(const char *inpFile)
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mUserFunction(0),
     mLogger(FairLogger::GetLogger())
 {
   // read coefs from text file
@@ -104,6 +113,7 @@ Chebyshev3D::Chebyshev3D(FILE *stream)
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mUserFunction(0),
     mLogger(FairLogger::GetLogger())
 {
   // read coefs from stream
@@ -128,6 +138,7 @@ Chebyshev3D::Chebyshev3D(const char* funName, int dimOut, const Float_t* bmin, c
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mUserFunction(0),
     mLogger(FairLogger::GetLogger())
 {
   if (dimOut < 1) {
@@ -159,6 +170,7 @@ Chebyshev3D::Chebyshev3D(void (*ptr)(float*, float*), int dimOut, const Float_t*
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mUserFunction(0),
     mLogger(FairLogger::GetLogger())
 {
   if (dimOut < 1) {
@@ -190,6 +202,7 @@ Chebyshev3D::Chebyshev3D(void (*ptr)(float*, float*), int dimOut, const Float_t*
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mUserFunction(0),
     mLogger(FairLogger::GetLogger())
 {
   if (dimOut < 1) {
@@ -226,6 +239,7 @@ Chebyshev3D::Chebyshev3D(void (*ptr)(float*, float*), int dimOut, const Float_t*
     mTemporaryChebyshevGrid(0),
     mUserFunctionName(""),
     mUserMacro(0),
+    mUserFunction(0),
     mLogger(FairLogger::GetLogger())
 {
   if (dimOut != 3) {
@@ -269,6 +283,7 @@ Chebyshev3D &Chebyshev3D::operator=(const Chebyshev3D &rhs)
     mMaxCoefficients = rhs.mMaxCoefficients;
     mUserFunctionName = rhs.mUserFunctionName;
     mUserMacro = 0;
+    mUserFunction = rhs.mUserFunction;
     for (int i = 3; i--;) {
       mMinBoundaries[i] = rhs.mMinBoundaries[i];
       mMaxBoundaries[i] = rhs.mMaxBoundaries[i];
@@ -340,14 +355,11 @@ void Chebyshev3D::prepareBoundaries(const Float_t *bmin, const Float_t *bmax)
 
 #ifdef _INC_CREATION_Chebyshev3D_
 
-// Pointer on user function (faster altrnative to TMethodCall)
-void (*gUsrFunChebyshev3D)(float*, float*);
-
 void Chebyshev3D::evaluateUserFunction()
 {
   // call user supplied function
-  if (gUsrFunChebyshev3D) {
-    gUsrFunChebyshev3D(mTemporaryCoefficient, mTemporaryUserResults);
+  if (mUserFunction) {
+    mUserFunction(mTemporaryCoefficient, mTemporaryUserResults);
   }
   else {
     mUserMacro->Execute();
@@ -357,7 +369,7 @@ void Chebyshev3D::evaluateUserFunction()
 void Chebyshev3D::setuserFunction(const char* name)
 {
   // load user macro with function definition and compile it
-  gUsrFunChebyshev3D = 0;
+  mUserFunction = 0;
   mUserFunctionName = name;
   gSystem->ExpandPathName(mUserFunctionName);
 
@@ -397,7 +409,7 @@ void Chebyshev3D::setuserFunction(void (*ptr)(float*, float*))
   }
   mUserMacro = 0;
   mUserFunctionName = "";
-  gUsrFunChebyshev3D = ptr;
+  mUserFunction = ptr;
 }
 #endif
 
@@ -409,8 +421,8 @@ void Chebyshev3D::evaluateUserFunction(const Float_t* x, Float_t* res)
     mTemporaryCoefficient[i] = x[i];
   }
 
-  if (gUsrFunChebyshev3D) {
-    gUsrFunChebyshev3D(mTemporaryCoefficient, mTemporaryUserResults);
+  if (mUserFunction) {
+    mUserFunction(mTemporaryCoefficient, mTemporaryUserResults);
   } else {
     mUserMacro->Execute();
   }
@@ -426,21 +438,15 @@ Int_t Chebyshev3D::calculateChebyshevCoefficients(const Float_t* funval, int np,
 {
   // Calculate Chebyshev coeffs using precomputed function values at np roots.
   // If prec>0, estimate the highest coeff number providing the needed precision
-  double sm;                        // do summations in double to minimize the roundoff error
-  for (int ic = 0; ic < np; ic++) { // compute coeffs
-    sm = 0;
-    for (int ir = 0; ir < np; ir++) {
-      float rt = TMath::Cos(ic * (ir + 0.5) * TMath::Pi() / np);
-      sm += funval[ir] * rt;
-    }
-    outCoefs[ic] = Float_t(sm * ((ic == 0) ? 1. / np : 2. / np));
-  }
+  std::vector<Float_t> cosines;
+  fillChebyshevCosines(np, cosines);
+  chebyshevTransform(funval, np, outCoefs, cosines.data());
 
   if (prec <= 0) {
     return np;
   }
 
-  sm = 0;
+  double sm = 0;
   int cfMax = 0;
   for (cfMax = np; cfMax--;) {
     sm += TMath::Abs(outCoefs[cfMax]);
@@ -455,6 +461,78 @@ Int_t Chebyshev3D::calculateChebyshevCoefficients(const Float_t* funval, int np,
 }
 #endif
 
+#ifdef _INC_CREATION_Chebyshev3D_
+void Chebyshev3D::chebyshevTransform(const Float_t* funval, int np, Float_t* outCoefs, const Float_t* cosines)
+{
+  // Calculate Chebyshev coeffs using precomputed function values at np roots and the cosines table
+  // filled by fillChebyshevCosines
+  double sm;                        // do summations in double to minimize the roundoff error
+  for (int ic = 0; ic < np; ic++) { // compute coeffs
+    sm = 0;
+    const Float_t* rt = cosines + ic * np;
+    for (int ir = 0; ir < np; ir++) {
+      sm += funval[ir] * rt[ir];
+    }
+    outCoefs[ic] = Float_t(sm * ((ic == 0) ? 1. / np : 2. / np));
+  }
+}
+#endif
+
+#ifdef _INC_CREATION_Chebyshev3D_
+void Chebyshev3D::fillChebyshevCosines(int np, std::vector<Float_t>& cosines)
+{
+  // cos(ic*(ir+0.5)*pi/np) for all ic,ir < np, stored row-wise in ic
+  cosines.resize(np * np);
+  for (int ic = 0; ic < np; ic++) {
+    for (int ir = 0; ir < np; ir++) {
+      cosines[ic * np + ir] = TMath::Cos(ic * (ir + 0.5) * TMath::Pi() / np);
+    }
+  }
+}
+#endif
+
+#ifdef _INC_CREATION_Chebyshev3D_
+Int_t Chebyshev3D::getNumberOfThreads()
+{
+  // number of threads to use for the fit, all cores if not set explicitly
+  if (sNumberOfThreads > 0) {
+    return sNumberOfThreads;
+  }
+  int ncores = std::thread::hardware_concurrency();
+  return ncores > 0 ? ncores : 1;
+}
+#endif
+
+#ifdef _INC_CREATION_Chebyshev3D_
+void Chebyshev3D::runInParallel(int ntasks, int nthreads, const std::function<void(int)>& task)
+{
+  // execute task(0)...task(ntasks-1) on up to nthreads threads
+  if (nthreads > ntasks) {
+    nthreads = ntasks;
+  }
+  if (nthreads < 2) {
+    for (int i = 0; i < ntasks; i++) {
+      task(i);
+    }
+    return;
+  }
+  std::atomic<int> next(0);
+  auto worker = [&]() {
+    for (int i; (i = next++) < ntasks;) {
+      task(i);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int i = nthreads - 1; i--;) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& thr : pool) {
+    thr.join();
+  }
+}
+#endif
+
 #ifdef _INC_CREATION_Chebyshev3D_
 void Chebyshev3D::defineGrid(const Int_t* npoints)
 {
@@ -493,12 +571,14 @@ void Chebyshev3D::defineGrid(const Int_t* npoints)
 #ifdef _INC_CREATION_Chebyshev3D_
 Int_t Chebyshev3D::chebyshevFit()
 {
-  // prepare parameterization for all output dimensions
-  int ir = 0;
+  // prepare parameterization for all output dimensions, the function is sampled only once for all of them
+  std::vector<Float_t> values;
+  sampleUserFunction(values);
+  std::vector<int> dims;
   for (int i = mOutputArrayDimension; i--;) {
-    ir += chebyshevFit(i);
+    dims.push_back(i);
   }
-  return ir;
+  return fitSampledFunction(values, dims);
 }
 #endif
 
@@ -506,44 +586,58 @@ Int_t Chebyshev3D::chebyshevFit()
 Int_t Chebyshev3D::chebyshevFit(int dmOut)
 {
   // prepare paramaterization of 3D function for dmOut-th dimension
-  int maxDim = 0;
-  for (int i = 0; i < 3; i++) {
-    if (maxDim < mNumberOfPoints[i]) {
-      maxDim = mNumberOfPoints[i];
-    }
-  }
-  Float_t* fvals = new Float_t[mNumberOfPoints[0]];
-  Float_t* tmpCoef3D = new Float_t[mNumberOfPoints[0] * mNumberOfPoints[1] * mNumberOfPoints[2]];
-  Float_t* tmpCoef2D = new Float_t[mNumberOfPoints[0] * mNumberOfPoints[1]];
-  Float_t* tmpCoef1D = new Float_t[maxDim];
+  std::vector<Float_t> values;
+  sampleUserFunction(values);
+  return fitSampledFunction(values, std::vector<int>(1, dmOut));
+}
+#endif
 
-  // 1D Cheb.fit for 0-th dimension at current steps of remaining dimensions
-  int ncmax = 0;
+#ifdef _INC_CREATION_Chebyshev3D_
+void Chebyshev3D::sampleUserFunction(std::vector<Float_t>& values)
+{
+  // compute the user function at all nodes of the grid, for all output dimensions at once.
+  // The value of dm-th output at node (id0,id1,id2) is stored at values[dm*ntot + id0 + n0*(id1 + n1*id2)]
+  const int n0 = mNumberOfPoints[0], n1 = mNumberOfPoints[1], n2 = mNumberOfPoints[2];
+  const int nslice = n0 * n1, ntot = nslice * n2;
+  values.resize(ntot * mOutputArrayDimension);
+
+  if (sThreadSafeUserFunction && mUserFunction) {
+    // the function can be called concurrently: every Z slice of the grid is sampled by its own task
+    printf("Sampling %d points on %d threads\n", ntot, getNumberOfThreads());
+    runInParallel(n2, getNumberOfThreads(), [&](int id2) {
+      std::vector<Float_t> res(mOutputArrayDimension);
+      Float_t x[3];
+      x[2] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[2] + id2];
+      for (int id1 = n1; id1--;) {
+        x[1] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[1] + id1];
+        for (int id0 = n0; id0--;) {
+          x[0] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[0] + id0];
+          mUserFunction(x, res.data());
+          for (int dm = mOutputArrayDimension; dm--;) {
+            values[dm * ntot + id0 + n0 * (id1 + n1 * id2)] = res[dm];
+          }
+        }
+      }
+    });
+    return;
+  }
 
-  printf("Dim%d : 00.00%% Done", dmOut);
+  printf("Sampling : 00.00%% Done");
   fflush(stdout);
-  Chebyshev3DCalc* cheb = getChebyshevCalc(dmOut);
-
-  Float_t prec = cheb->getPrecision(); 
-  if (prec<sMinimumPrecision) prec = mPrecision;         // no specific precision for this dim.
-  Float_t rTiny = 0.1 * prec / Float_t(maxDim); // neglect coefficient below this threshold
-
-  float ncals2count = mNumberOfPoints[2] * mNumberOfPoints[1] * mNumberOfPoints[0];
   float ncals = 0;
   float frac = 0;
   float fracStep = 0.001;
-
-  for (int id2 = mNumberOfPoints[2]; id2--;) {
+  for (int id2 = n2; id2--;) {
     mTemporaryCoefficient[2] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[2] + id2];
-
-    for (int id1 = mNumberOfPoints[1]; id1--;) {
+    for (int id1 = n1; id1--;) {
       mTemporaryCoefficient[1] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[1] + id1];
-
-      for (int id0 = mNumberOfPoints[0]; id0--;) {
+      for (int id0 = n0; id0--;) {
         mTemporaryCoefficient[0] = mTemporaryChebyshevGrid[mTemporaryChebyshevGridOffs[0] + id0];
-        evaluateUserFunction(); // compute function values at Chebyshev roots of 0-th dimension
-        fvals[id0] = mTemporaryUserResults[dmOut];
-        float fr = (++ncals) / ncals2count;
+        evaluateUserFunction();
+        for (int dm = mOutputArrayDimension; dm--;) {
+          values[dm * ntot + id0 + n0 * (id1 + n1 * id2)] = mTemporaryUserResults[dm];
+        }
+        float fr = (++ncals) / ntot;
         if (fr - frac >= fracStep) {
           frac = fr;
           printf("\b\b\b\b\b\b\b\b\b\b\b");
@@ -551,46 +645,94 @@ Int_t Chebyshev3D::chebyshevFit(int dmOut)
           fflush(stdout);
         }
       }
-      int nc = calculateChebyshevCoefficients(fvals, mNumberOfPoints[0], tmpCoef1D, prec);
-      for (int id0 = mNumberOfPoints[0]; id0--;) {
-        tmpCoef2D[id1 + id0 * mNumberOfPoints[1]] = tmpCoef1D[id0];
-      }
-      if (ncmax < nc) {
-        ncmax = nc; // max coefs to be kept in dim0 to guarantee needed precision
-      }
     }
-    // once each 1d slice of given 2d slice is parametrized, parametrize the Cheb.coeffs
-    for (int id0 = mNumberOfPoints[0]; id0--;) {
-      calculateChebyshevCoefficients(tmpCoef2D + id0 * mNumberOfPoints[1], mNumberOfPoints[1], tmpCoef1D, -1);
-      for (int id1 = mNumberOfPoints[1]; id1--;) {
-        tmpCoef3D[id2 + mNumberOfPoints[2] * (id1 + id0 * mNumberOfPoints[1])] = tmpCoef1D[id1];
+  }
+  printf("\b\b\b\b\b\b\b\b\b\b\b\b");
+  printf("100.00%% Done\n");
+}
+#endif
+
+#ifdef _INC_CREATION_Chebyshev3D_
+Int_t Chebyshev3D::fitSampledFunction(const std::vector<Float_t>& values, const std::vector<int>& dims)
+{
+  // prepare paramaterization of requested output dimensions from the function values on the grid.
+  // The work is split in tasks writing to disjoint parts of the buffers, so the result does not depend
+  // on the number of threads
+  const int n0 = mNumberOfPoints[0], n1 = mNumberOfPoints[1], n2 = mNumberOfPoints[2];
+  const int ntot = n0 * n1 * n2, ndims = dims.size();
+  const int nthreads = getNumberOfThreads();
+
+  // cosines of the Chebyshev transforms along each dimension
+  std::vector<Float_t> cosines[3];
+  for (int id = 3; id--;) {
+    fillChebyshevCosines(mNumberOfPoints[id], cosines[id]);
+  }
+  std::vector<Float_t> coefs3D(ntot * ndims);
+
+  // 1D Cheb.fit for 0-th dimension at current steps of remaining dimensions, then parametrize the
+  // Cheb.coeffs of each 2D slice
+  runInParallel(ndims * n2, nthreads, [&](int task) {
+    const int idim = task / n2, id2 = task % n2;
+    const Float_t* fvals = &values[dims[idim] * ntot];
+    Float_t* tmpCoef3D = &coefs3D[idim * ntot];
+    std::vector<Float_t> tmpCoef2D(n0 * n1), tmpCoef1D(std::max(n0, n1));
+    for (int id1 = n1; id1--;) {
+      chebyshevTransform(fvals + n0 * (id1 + n1 * id2), n0, tmpCoef1D.data(), cosines[0].data());
+      for (int id0 = n0; id0--;) {
+        tmpCoef2D[id1 + id0 * n1] = tmpCoef1D[id0];
       }
     }
-  }
-  // now fit the last dimensions Cheb.coefs
-  for (int id0 = mNumberOfPoints[0]; id0--;) {
-    for (int id1 = mNumberOfPoints[1]; id1--;) {
-      calculateChebyshevCoefficients(tmpCoef3D + mNumberOfPoints[2] * (id1 + id0 * mNumberOfPoints[1]),
-                                     mNumberOfPoints[2], tmpCoef1D, -1);
-      for (int id2 = mNumberOfPoints[2]; id2--;) {
-        tmpCoef3D[id2 + mNumberOfPoints[2] * (id1 + id0 * mNumberOfPoints[1])] = tmpCoef1D[id2]; // store on place
+    for (int id0 = n0; id0--;) {
+      chebyshevTransform(&tmpCoef2D[id0 * n1], n1, tmpCoef1D.data(), cosines[1].data());
+      for (int id1 = n1; id1--;) {
+        tmpCoef3D[id2 + n2 * (id1 + id0 * n1)] = tmpCoef1D[id1];
       }
     }
-  }
+  });
 
-  // now find 2D surface which separates significant coefficients of 3D matrix from nonsignificant ones (up to
-  // prec)
-  UShort_t* tmpCoefSurf = new UShort_t[mNumberOfPoints[0] * mNumberOfPoints[1]];
-  for (int id0 = mNumberOfPoints[0]; id0--;) {
-    for (int id1 = mNumberOfPoints[1]; id1--;) {
-      tmpCoefSurf[id1 + id0 * mNumberOfPoints[1]] = 0;
+  // now fit the last dimensions Cheb.coefs
+  runInParallel(ndims * n0, nthreads, [&](int task) {
+    const int idim = task / n0, id0 = task % n0;
+    Float_t* tmpCoef3D = &coefs3D[idim * ntot];
+    std::vector<Float_t> tmpCoef1D(n2);
+    for (int id1 = n1; id1--;) {
+      Float_t* cf = tmpCoef3D + n2 * (id1 + id0 * n1);
+      chebyshevTransform(cf, n2, tmpCoef1D.data(), cosines[2].data());
+      std::copy(tmpCoef1D.begin(), tmpCoef1D.end(), cf); // store on place
     }
+  });
+
+  // truncate and store the coefficients of every output dimension
+  std::vector<Int_t> nCoefs(ndims);
+  runInParallel(ndims, nthreads, [&](int idim) {
+    nCoefs[idim] = storeSignificantCoefficients(&coefs3D[idim * ntot], getChebyshevCalc(dims[idim]));
+  });
+  mMaxCoefficients = nCoefs.back();
+  return ndims;
+}
+#endif
+
+#ifdef _INC_CREATION_Chebyshev3D_
+Int_t Chebyshev3D::storeSignificantCoefficients(Float_t* tmpCoef3D, Chebyshev3DCalc* cheb) const
+{
+  // find the 2D surface which separates significant coefficients of the 3D matrix from nonsignificant ones
+  // (up to prec) and fill the parameterization with the significant ones. Returns the number of stored coeffs.
+  const int n0 = mNumberOfPoints[0], n1 = mNumberOfPoints[1], n2 = mNumberOfPoints[2];
+  const int maxDim = std::max(n0, std::max(n1, n2));
+  Float_t prec = cheb->getPrecision();
+  if (prec < sMinimumPrecision) {
+    prec = mPrecision; // no specific precision for this dim.
   }
+  Float_t rTiny = 0.1 * prec / Float_t(maxDim); // neglect coefficient below this threshold
+
+  // single pass over the matrix: the residual accumulated over already scanned columns decides where the
+  // significant coefficients of the current one end
+  std::vector<UShort_t> tmpCoefSurf(n0 * n1, 0);
   Double_t resid = 0;
-  for (int id0 = mNumberOfPoints[0]; id0--;) {
-    for (int id1 = mNumberOfPoints[1]; id1--;) {
-      for (int id2 = mNumberOfPoints[2]; id2--;) {
-        int id = id2 + mNumberOfPoints[2] * (id1 + id0 * mNumberOfPoints[1]);
+  for (int id0 = n0; id0--;) {
+    for (int id1 = n1; id1--;) {
+      for (int id2 = n2; id2--;) {
+        int id = id2 + n2 * (id1 + id0 * n1);
         Float_t cfa = TMath::Abs(tmpCoef3D[id]);
         if (cfa < rTiny) {
           tmpCoef3D[id] = 0;
@@ -602,30 +744,18 @@ Int_t Chebyshev3D::chebyshevFit(int dmOut)
         }
         // otherwise go back 1 step
         resid -= cfa;
-        tmpCoefSurf[id1 + id0 * mNumberOfPoints[1]] = id2 + 1; // how many coefs to keep
+        tmpCoefSurf[id1 + id0 * n1] = id2 + 1; // how many coefs to keep
         break;
       }
     }
   }
 
-  // printf("\n\nCoeffs\n");
-  // int cnt = 0;
-  // for (int id0=0;id0<mNumberOfPoints[0];id0++) {
-  //  for (int id1=0;id1<mNumberOfPoints[1];id1++) {
-  //    for (int id2=0;id2<mNumberOfPoints[2];id2++) {
-  // printf("%2d%2d%2d %+.4e |",id0,id1,id2,tmpCoef3D[cnt++]);
-  //    }
-  //    printf("\n");
-  //  }
-  //  printf("\n");
-  //}
-
   // see if there are rows to reject, find max.significant column at each row
-  int nRows = mNumberOfPoints[0];
-  UShort_t* tmpCols = new UShort_t[nRows];
-  for (int id0 = mNumberOfPoints[0]; id0--;) {
-    int id1 = mNumberOfPoints[1];
-    while (id1 > 0 && tmpCoefSurf[(id1 - 1) + id0 * mNumberOfPoints[1]] == 0) {
+  int nRows = n0;
+  std::vector<UShort_t> tmpCols(nRows);
+  for (int id0 = n0; id0--;) {
+    int id1 = n1;
+    while (id1 > 0 && tmpCoefSurf[(id1 - 1) + id0 * n1] == 0) {
       id1--;
     }
     tmpCols[id0] = id1;
@@ -652,27 +782,25 @@ Int_t Chebyshev3D::chebyshevFit(int dmOut)
     }
   }
   cheb->initializeColumns(nCols);
-  delete[] tmpCols;
 
   // create the 2D matrix defining the boundary of significance for 3D coeffs.matrix
   // and count the number of siginifacnt coefficients
   cheb->initializeElementBound2D(nElemBound2D);
   UShort_t* coefBound2D0 = cheb->getCoefficientBound2D0();
   UShort_t* coefBound2D1 = cheb->getCoefficientBound2D1();
-  mMaxCoefficients = 0; // redefine number of coeffs
+  int nCoefs = 0;
   for (int id0 = 0; id0 < nRows; id0++) {
     int nCLoc = nColsAtRow[id0];
     int col0 = colAtRowBg[id0];
     for (int id1 = 0; id1 < nCLoc; id1++) {
-      coefBound2D0[col0 + id1] =
-        tmpCoefSurf[id1 + id0 * mNumberOfPoints[1]]; // number of coefs to store for 3-d dimension
-      coefBound2D1[col0 + id1] = mMaxCoefficients;
-      mMaxCoefficients += coefBound2D0[col0 + id1];
+      coefBound2D0[col0 + id1] = tmpCoefSurf[id1 + id0 * n1]; // number of coefs to store for 3-d dimension
+      coefBound2D1[col0 + id1] = nCoefs;
+      nCoefs += coefBound2D0[col0 + id1];
     }
   }
 
   // create final compressed 3D matrix for significant coeffs
-  cheb->initializeCoefficients(mMaxCoefficients);
+  cheb->initializeCoefficients(nCoefs);
   Float_t* coefs = cheb->getCoefficients();
   int count = 0;
   for (int id0 = 0; id0 < nRows; id0++) {
@@ -681,28 +809,11 @@ Int_t Chebyshev3D::chebyshevFit(int dmOut)
     for (int id1 = 0; id1 < ncLoc; id1++) {
       int ncf2 = coefBound2D0[col0 + id1];
       for (int id2 = 0; id2 < ncf2; id2++) {
-        coefs[count++] = tmpCoef3D[id2 + mNumberOfPoints[2] * (id1 + id0 * mNumberOfPoints[1])];
+        coefs[count++] = tmpCoef3D[id2 + n2 * (id1 + id0 * n1)];
       }
     }
   }
-
-  // printf("\n\nNewSurf\n");
-  // for (int id0=0;id0<mNumberOfPoints[0];id0++) {
-  //  for (int id1=0;id1<mNumberOfPoints[1];id1++) {
-  //    printf("(%2d %2d) %2d |",id0,id1,tmpCoefSurf[id1+id0*mNumberOfPoints[1]]);
-  //  }
-  //  printf("\n");
-  //}
-
-  delete[] tmpCoefSurf;
-  delete[] tmpCoef1D;
-  delete[] tmpCoef2D;
-  delete[] tmpCoef3D;
-  delete[] fvals;
-
-  printf("\b\b\b\b\b\b\b\b\b\b\b\b");
-  printf("100.00%% Done\n");
-  return 1;
+  return nCoefs;
 }
 #endif
 
@@ -855,7 +966,7 @@ TH1* Chebyshev3D::TestRMS(int idim, int npoints, TH1* histo)
   // fills the difference between the original function and parameterization (for idim-th component of the output)
   // to supplied histogram. Calculations are done in npoints random points.
   // If the hostgram was not supplied, it will be created. It is up to the user to delete it!
-  if (!mUserMacro) {
+  if (!mUserMacro && !mUserFunction) {
     printf("No user function is set\n");
     return 0;
   }
@@ -1001,9 +1112,9 @@ int* Chebyshev3D::getNcNeeded(float xyz[3], int DimVar, float mn, float mx, floa
 {
   // estimate needed number of chebyshev coefs for given function description in DimVar dimension
   // The values for two other dimensions must be set beforehand
-  static int retNC[3];
-  static int npChLast = 0;
-  static float* gridVal = 0, *coefs = 0;
+  thread_local static int retNC[3];
+  thread_local static int npChLast = 0;
+  thread_local static float* gridVal = 0, *coefs = 0;
   if (npCheck < 3) {
     npCheck = 3;
   }
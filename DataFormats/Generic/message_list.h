@@ -28,6 +28,70 @@
 namespace AliceO2 {
 namespace Format {
 
+/**
+ * dataKey identifies a data block by data origin, description and sub
+ * specification, the key of the secondary index of @ref messageList.
+ * The strings are stored zero padded to the fixed width of the header fields.
+ */
+struct dataKey {
+  char mDataOrigin[3+1];
+  char mDataDescriptor[15+1];
+  int64_t mSubSpec;
+
+  dataKey(const char* origin, const char* description, int64_t subSpec = 0) : mSubSpec(subSpec) {
+    memset(mDataOrigin, 0, sizeof(mDataOrigin));
+    memset(mDataDescriptor, 0, sizeof(mDataDescriptor));
+    strncpy(mDataOrigin, origin, sizeof(mDataOrigin));
+    strncpy(mDataDescriptor, description, sizeof(mDataDescriptor));
+  }
+
+  /** same data origin and description, any sub specification */
+  bool sameBlockType(const dataKey& other) const {
+    return memcmp(mDataOrigin, other.mDataOrigin, sizeof(mDataOrigin)) == 0 &&
+      memcmp(mDataDescriptor, other.mDataDescriptor, sizeof(mDataDescriptor)) == 0;
+  }
+  bool operator==(const dataKey& other) const {
+    return mSubSpec == other.mSubSpec && sameBlockType(other);
+  }
+
+  /** hash of data origin and description */
+  uint64_t blockTypeHash() const {
+    uint64_t words[(sizeof(mDataOrigin) + sizeof(mDataDescriptor)) / sizeof(uint64_t)];
+    memcpy(words, mDataOrigin, sizeof(words));
+    uint64_t hash = 0;
+    for (unsigned i = 0; i < sizeof(words) / sizeof(uint64_t); i++) {
+      hash = mix(hash ^ words[i]);
+    }
+    return hash;
+  }
+  /** hash of the full key */
+  uint64_t hash() const {
+    return mix(blockTypeHash() ^ static_cast<uint64_t>(mSubSpec));
+  }
+
+  static uint64_t mix(uint64_t value) {
+    // finalizer of MurmurHash3, every input bit affects every output bit
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+  }
+};
+
+/**
+ * extraction of the dataKey from the header of type HdrT
+ * The default works for headers with the members mDataOrigin, mDataDescriptor
+ * and mSubSpec, other header types need a specialization.
+ */
+template<class HdrT>
+struct dataKeyTraits {
+  static dataKey get(const HdrT& hdr) {
+    return dataKey(hdr.mDataOrigin, hdr.mDataDescriptor, hdr.mSubSpec);
+  }
+};
+
 // Ideally it does not matter for the implementation of the container class
 // whether the type is the message container or the pointer to the payload
 template<class MsgT, class HdrT>
@@ -40,7 +104,7 @@ class messageList {
   /// apply a selection of elements
   typedef std::function<bool(const HdrT& hdr)> HdrComparison;
 
-  messageList() {}
+  messageList() : mDataArray(), mLinks(), mKeyIndex(), mBlockTypeIndex() {}
   messageList(const messageList& other); // not yet implemented
   messageList& operator=(const messageList& other); // not yet implemented
   ~messageList() {}
@@ -57,14 +121,26 @@ class messageList {
     // TODO: consistency check
     mDataArray.push_back(messagePair(*srcHeader, payloadMsg));
 
+    // append the block to the chains of its key and of its block type
+    dataKey key = dataKeyTraits<HdrT>::get(*srcHeader);
+    uint32_t position = mDataArray.size() - 1;
+    mLinks.push_back(indexLinks());
+    indexInsert(mKeyIndex, key, key.hash(), &dataKey::operator==, &indexLinks::mNextWithKey, position);
+    indexInsert(mBlockTypeIndex, key, key.blockTypeHash(), &dataKey::sameBlockType, &indexLinks::mNextWithBlockType, position);
+
     return mDataArray.size();
   }
   /** number of data blocks in the list */
   size_t size() {return mDataArray.size();}
   /** clear the list */
-  void clear() {mDataArray.clear();}
+  void clear() {
+    mDataArray.clear();
+    mLinks.clear();
+    mKeyIndex.clear();
+    mBlockTypeIndex.clear();
+  }
   /** check if list is empty */
-  bool empty() {mDataArray.empty();}
+  bool empty() {return mDataArray.empty();}
 
   /**
    * messagePair describes the two sequential message parts for header and payload
@@ -87,6 +163,19 @@ class messageList {
     }
   };
   typedef typename std::vector<messagePair>::iterator pairIt_t;
+
+  /**
+   * links of the secondary index, parallel to the data array: position of
+   * the next block with the same key and with the same block type
+   */
+  struct indexLinks {
+    uint32_t mNextWithKey;
+    uint32_t mNextWithBlockType;
+
+    indexLinks() : mNextWithKey(kInvalidPosition), mNextWithBlockType(kInvalidPosition) {}
+  };
+  typedef uint32_t indexLinks::*chain_t;
+  static const uint32_t kInvalidPosition = ~uint32_t(0);
   // TODO: operators inside a class can only have one parameter
   // check whether to create a functor class
   //bool operator==(const messageList::pairIt_t& first, const messageList::pairIt_t& second) {
@@ -102,7 +191,9 @@ class messageList {
    * Implementation of navigation through the list and access to elements.
    *
    * An optional comparison metric @ref HdrComparison can be used to provide
-   * a selection of elements.
+   * a selection of elements. Iterators returned by the queries of the
+   * secondary index follow the chain of the matching blocks instead of
+   * checking every element.
    */
   class iterator {
    public:
@@ -114,14 +205,33 @@ class messageList {
       : mDataIterator(dataIterator)
       , mEnd(iteratorRange)
       , mHdrSelection(hdrsel)
+      , mLinks(nullptr)
+      , mChain(nullptr)
     { }
     iterator(const pairIt_t& dataIterator)
       : mDataIterator(dataIterator)
       , mEnd(dataIterator)
       , mHdrSelection(HdrComparison())
+      , mLinks(nullptr)
+      , mChain(nullptr)
+    { }
+    iterator(const pairIt_t& dataIterator, const pairIt_t& iteratorRange,
+	     const std::vector<indexLinks>& links, chain_t chain)
+      : mDataIterator(dataIterator)
+      , mEnd(iteratorRange)
+      , mHdrSelection(HdrComparison())
+      , mLinks(&links)
+      , mChain(chain)
     { }
     // prefix increment
     self_type& operator++() {
+      if (mLinks) {
+	// the array is not modified while iterating, so the data iterator
+	// can be moved directly to the position of the next block in the chain
+	uint32_t next = (*mLinks)[mDataIterator - (mEnd - mLinks->size())].*mChain;
+	mDataIterator = next != kInvalidPosition ? mEnd - (mLinks->size() - next) : mEnd;
+	return *this;
+      }
       while (++mDataIterator != mEnd) {
 	// operator bool() of std::function is used to determine whether
 	// a selector is set or not, the default is not callable.
@@ -153,6 +263,8 @@ class messageList {
     pairIt_t mDataIterator;
     pairIt_t mEnd;
     HdrComparison mHdrSelection;
+    const std::vector<indexLinks>* mLinks; // set when following a chain of the index
+    chain_t mChain;
   };
 
   /** to be defined
@@ -172,12 +284,93 @@ class messageList {
     return ret;
   }
 
+  /**
+   * blocks with the data origin, description and sub specification, in the
+   * order they have been added; the lookup in the secondary index is O(1)
+   * and the increment of the returned iterator goes directly to the next
+   * matching block
+   */
+  iterator begin(const char* origin, const char* description, int64_t subSpec) {
+    dataKey key(origin, description, subSpec);
+    return chainBegin(indexFind(mKeyIndex, key, key.hash(), &dataKey::operator==), &indexLinks::mNextWithKey);
+  }
+
+  /** blocks with the data origin and description, any sub specification */
+  iterator begin(const char* origin, const char* description) {
+    dataKey key(origin, description);
+    return chainBegin(indexFind(mBlockTypeIndex, key, key.blockTypeHash(), &dataKey::sameBlockType), &indexLinks::mNextWithBlockType);
+  }
+
   iterator end() {
     return iterator(mDataArray.end());
   }
 
  private:
+  typedef bool (dataKey::*keyComparison_t)(const dataKey&) const;
+
+  /**
+   * slot of the open addressing hash table of the secondary index, refers
+   * to the first and the last block of one chain
+   */
+  struct indexSlot {
+    uint64_t mHash;
+    uint32_t mHead;
+    uint32_t mTail;
+  };
+
+  iterator chainBegin(uint32_t head, chain_t chain) {
+    if (head == kInvalidPosition) return end();
+    return iterator(mDataArray.begin() + head, mDataArray.end(), mLinks, chain);
+  }
+
+  /** position of the slot of the key, or of the empty slot where it goes */
+  size_t indexProbe(const std::vector<indexSlot>& table, const dataKey& key, uint64_t hash, keyComparison_t equal) const {
+    size_t mask = table.size() - 1;
+    size_t slot = hash & mask;
+    while (table[slot].mHead != kInvalidPosition &&
+	   (table[slot].mHash != hash ||
+	    !(dataKeyTraits<HdrT>::get(mDataArray[table[slot].mHead].mHeader).*equal)(key))) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  uint32_t indexFind(const std::vector<indexSlot>& table, const dataKey& key, uint64_t hash, keyComparison_t equal) const {
+    if (table.empty()) return kInvalidPosition;
+    return table[indexProbe(table, key, hash, equal)].mHead;
+  }
+
+  void indexInsert(std::vector<indexSlot>& table, const dataKey& key, uint64_t hash, keyComparison_t equal,
+		   chain_t chain, uint32_t position) {
+    // the table is at most half full; as the array, it grows by doubling,
+    // which keeps the insertion amortized O(1). The chains are not touched
+    // by the rehashing, only their slots move.
+    if (table.size() < 2 * mDataArray.size()) {
+      std::vector<indexSlot> grown(table.empty() ? 16 : 2 * table.size(), indexSlot{0, kInvalidPosition, kInvalidPosition});
+      for (const indexSlot& entry : table) {
+	if (entry.mHead == kInvalidPosition) continue;
+	size_t slot = entry.mHash & (grown.size() - 1);
+	while (grown[slot].mHead != kInvalidPosition) slot = (slot + 1) & (grown.size() - 1);
+	grown[slot] = entry;
+      }
+      table.swap(grown);
+    }
+    indexSlot& entry = table[indexProbe(table, key, hash, equal)];
+    if (entry.mHead == kInvalidPosition) {
+      entry = indexSlot{hash, position, position};
+    } else {
+      mLinks[entry.mTail].*chain = position;
+      entry.mTail = position;
+    }
+  }
+
   std::vector<messagePair> mDataArray;
+  // secondary index: chains of the blocks with the same key and with the same
+  // block type, linked through the positions in mLinks, and the hash tables
+  // of their heads
+  std::vector<indexLinks> mLinks;
+  std::vector<indexSlot> mKeyIndex;
+  std::vector<indexSlot> mBlockTypeIndex;
 };
 
 }; // namespace Format
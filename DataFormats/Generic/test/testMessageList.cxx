@@ -11,6 +11,7 @@
 
 #include <cstring> // memset
 #include <iostream>
+#include <vector>
 
 using namespace AliceO2;
 using namespace Format;
@@ -27,6 +28,21 @@ struct SimpleHeader_t {
   SimpleHeader_t(uint32_t _id, uint32_t _spec) : id(_id), specification(_spec) {}
 };
 
+// the simple header has no data origin and description, the id is used
+// as description for the index
+namespace AliceO2 {
+namespace Format {
+template<>
+struct dataKeyTraits<SimpleHeader_t> {
+  static dataKey get(const SimpleHeader_t& hdr) {
+    char description[16] = {0};
+    memcpy(description, &hdr.id, sizeof(hdr.id));
+    return dataKey("", description, hdr.specification);
+  }
+};
+}
+}
+
 // print operator for the simple header
 std::ostream& operator<<(std::ostream& stream, SimpleHeader_t header) {
   stream << "Header ID: " << header.id << std::endl;
@@ -119,5 +135,62 @@ int main(int argc, char** argv)
   print_list(msglist, [](const TestMsgList_t::header_type& hdr){return hdr.specification==0xf00;} );
   std::cout << std::endl;
 
-  return 0;
+  // selection of blocks by the secondary index
+  typedef messageList<SimpleMsg_t, DataHeader_t> DataList_t;
+  DataList_t datalist;
+  const unsigned nBlocks = 300;
+  std::vector<DataHeader_t> headers(nBlocks);
+  std::vector<SimpleMsg_t> headerMsgs(nBlocks);
+  std::vector<SimpleMsg_t> payloadMsgs(nBlocks);
+  for (unsigned i = 0; i < nBlocks; i++) {
+    DataHeader_t& hdr = headers[i];
+    memset(&hdr, 0, sizeof(hdr));
+    strcpy(hdr.mDataOrigin, i % 2 ? "TPC" : "ITS");
+    strcpy(hdr.mDataDescriptor, i % 3 ? "CLUSTERS" : "TRACKS");
+    hdr.mSubSpec = i % 5;
+    hdr.mPayloadSize = i;
+    headerMsgs[i] = reinterpret_cast<SimpleMsg_t>(&hdr);
+    payloadMsgs[i] = reinterpret_cast<SimpleMsg_t>(payload1);
+    datalist.add(headerMsgs[i], payloadMsgs[i]);
+  }
+
+  // every query must give the blocks selected by the linear scan, in the same order
+  const char* origins[] = {"TPC", "ITS", "TOF"};
+  const char* descriptions[] = {"CLUSTERS", "TRACKS"};
+  for (const char* origin : origins) {
+    for (const char* description : descriptions) {
+      for (int64_t subSpec = -1; subSpec < 6; subSpec++) {
+	auto select = [&](const DataHeader_t& hdr) {
+	  return strcmp(hdr.mDataOrigin, origin) == 0 && strcmp(hdr.mDataDescriptor, description) == 0 &&
+	    (subSpec < 0 || hdr.mSubSpec == subSpec);
+	};
+	DataList_t::iterator indexed = subSpec < 0 ?
+	  datalist.begin(origin, description) : datalist.begin(origin, description, subSpec);
+	DataList_t::iterator scanned = datalist.begin(select);
+	for (; scanned != datalist.end() && indexed != datalist.end(); ++scanned, ++indexed) {
+	  if (scanned.size() != indexed.size()) break;
+	}
+	if (scanned != datalist.end() || indexed != datalist.end()) {
+	  std::cerr << "index query " << origin << "/" << description << "/" << subSpec
+		    << " does not match the linear scan" << std::endl;
+	  iResult = -1;
+	}
+      }
+    }
+  }
+
+  // the simple header uses the specialization of the key traits
+  SimpleList_t::iterator it = input.begin("", "\x02", 0xf00);
+  if (it == input.end() || static_cast<SimpleHeader_t>(it).id != 2 || ++it != input.end()) {
+    std::cerr << "index query of the simple list failed" << std::endl;
+    iResult = -1;
+  }
+
+  datalist.clear();
+  if (!datalist.empty() || datalist.begin("TPC", "CLUSTERS") != datalist.end()) {
+    std::cerr << "list not empty after clear" << std::endl;
+    iResult = -1;
+  }
+
+  return iResult;
 }
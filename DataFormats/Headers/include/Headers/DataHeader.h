@@ -21,6 +21,7 @@
 #define ALICEO2_BASE_DATA_HEADER_
 
 #include <cstdint>
+#include <cstring>
 #include <stdio.h>
 #include <iostream>
 #include <memory>
@@ -387,6 +388,41 @@ const HeaderType* get(const byte* buffer, size_t /*len*/=0) {
   return nullptr;
 }
 
+//__________________________________________________________________________________________________
+/// @class BlockAllocator
+/// @brief pool of fixed size slabs backing the header blocks
+/// Header blocks are small and short lived: one is created for every message part and
+/// released by the transport, typically in a different thread, when the part is sent.
+/// Buffers of up to sSlabSize bytes are therefore taken from a pool of slabs instead of the heap:
+/// every thread keeps a free list of slabs, and exchanges batches of them with a
+/// common depot when it runs empty or overflows, so a slab freed by the transport thread
+/// travels back to the producing thread in batches, with one lock per batch.
+/// The free slabs are linked through their own storage, so releasing never allocates.
+/// Bigger buffers are allocated on the heap. Both kinds are released with release(),
+/// also while the thread or the program ends, the buffers then go back to the heap.
+class BlockAllocator {
+public:
+  /// usable size of a slab, bigger blocks are allocated on the heap
+  static constexpr size_t sSlabSize = 512;
+
+  /// get a buffer of at least size bytes
+  static byte* allocate(size_t size);
+  /// return a buffer obtained from allocate(), can be called from any thread
+  static void release(byte* buffer) noexcept;
+
+  /// switch the pooling on or off (e.g. for memory checkers), the buffers
+  /// allocated before are released correctly in either case
+  static void setPooling(bool enable) noexcept;
+  static bool getPooling() noexcept;
+};
+
+/// deleter returning the buffer to the BlockAllocator
+struct BlockDeleter {
+  void operator()(byte* buffer) const noexcept {
+    BlockAllocator::release(buffer);
+  }
+};
+
 //__________________________________________________________________________________________________
 /// @struct Block
 /// @brief a move-only header block with serialized headers
@@ -402,12 +438,10 @@ const HeaderType* get(const byte* buffer, size_t /*len*/=0) {
 ///   - return is a unique_ptr holding the serialized buffer ready to be shipped.
 struct Block {
 
-  // This is ugly and needs fixing BUT:
-  // we need a static deleter for fairmq.
-  // TODO: template the class with allocators
-  //
-  using Buffer = std::unique_ptr<byte[]>;
-  static std::default_delete<byte[]> sDeleter;
+  // the buffer comes from the BlockAllocator, fairmq needs a static
+  // deleter to give it back when the message is sent
+  using Buffer = std::unique_ptr<byte[], BlockDeleter>;
+  static BlockDeleter sDeleter;
   static void freefn(void* /*data*/, void* hint) {
     Block::sDeleter(static_cast<byte*>(hint));
   }
@@ -426,7 +460,7 @@ struct Block {
   template<typename... Headers>
   Block(Headers... headers)
     : bufferSize{size(headers...)}
-    , buffer{new byte[bufferSize]}
+    , buffer{BlockAllocator::allocate(bufferSize)}
   {
     inject(buffer.get(), headers...);
   }
@@ -442,7 +476,7 @@ struct Block {
   static Block compose(const Args... args) {
     Block b;
     b.bufferSize = size(args...);
-    b.buffer.reset(new byte[b.bufferSize]);
+    b.buffer.reset(BlockAllocator::allocate(b.bufferSize));
     inject(b.buffer.get(), args...);
     return b;
   }
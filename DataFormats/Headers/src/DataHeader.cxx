@@ -13,6 +13,9 @@
 #include "Headers/DataHeader.h"
 #include <cstdio> // printf
 #include <cstring> // strncpy
+#include <atomic>
+#include <mutex>
+#include <new> // placement new
 
 //the answer to life and everything
 const uint32_t AliceO2::Header::BaseHeader::sMagicString = String2<uint32_t>("O2O2");
@@ -42,7 +45,8 @@ const AliceO2::Header::DataDescription AliceO2::Header::gDataDescriptionConfig
 const AliceO2::Header::DataDescription AliceO2::Header::gDataDescriptionInfo    ("INFO           ");
 
 //definitions for Block statics
-std::default_delete<byte[]> AliceO2::Header::Block::sDeleter;
+AliceO2::Header::BlockDeleter AliceO2::Header::Block::sDeleter;
+constexpr size_t AliceO2::Header::BlockAllocator::sSlabSize;
 
 //storage for BaseHeader static members, all invalid
 const uint32_t AliceO2::Header::BaseHeader::sVersion = AliceO2::Header::gInvalidToken32;
@@ -278,3 +282,207 @@ void AliceO2::Header::hexDump (const char* desc, const void* voidaddr, size_t le
   printf ("  %s\n", buff);
 }
 
+//__________________________________________________________________________________________________
+// BlockAllocator internals
+namespace {
+// every buffer starts with a prefix telling if it is a pooled slab,
+// the size keeps the headers aligned as with plain new
+constexpr size_t gSlabPrefix = 16;
+// number of slabs moved at once between a thread and the depot
+constexpr size_t gSlabBatch = 64;
+// max number of slabs kept by a thread and of batches kept by the depot
+constexpr size_t gMaxThreadSlabs = 4 * gSlabBatch;
+constexpr size_t gMaxDepotBatches = 64;
+
+std::atomic<bool> gPoolingEnabled{true};
+
+byte* newBuffer(size_t size, bool pooled)
+{
+  byte* raw = new byte[gSlabPrefix + size];
+  *reinterpret_cast<uint64_t*>(raw) = pooled;
+  return raw + gSlabPrefix;
+}
+
+bool isPooled(const byte* buffer)
+{
+  return *reinterpret_cast<const uint64_t*>(buffer - gSlabPrefix);
+}
+
+void deleteBuffer(byte* buffer)
+{
+  delete[] (buffer - gSlabPrefix);
+}
+
+// a free slab, linked through its own storage so that releasing never allocates;
+// the first slab of a batch also links the batches in the depot
+struct FreeSlab {
+  FreeSlab* next;
+  FreeSlab* nextBatch;
+  size_t count; ///< number of slabs in the batch, set in its first slab
+};
+static_assert(sizeof(FreeSlab) <= AliceO2::Header::BlockAllocator::sSlabSize, "a free slab must fit into a slab");
+
+FreeSlab* toFreeSlab(byte* slab)
+{
+  return new (slab) FreeSlab{ nullptr, nullptr, 0 };
+}
+
+void deleteSlabs(FreeSlab* slab)
+{
+  while (slab) {
+    FreeSlab* next = slab->next;
+    deleteBuffer(reinterpret_cast<byte*>(slab));
+    slab = next;
+  }
+}
+
+// the common store of free slabs, in batches; it is never destroyed, as threads may still
+// hand over their slabs while the static objects are torn down
+struct SlabDepot {
+  std::mutex mutex;
+  FreeSlab* batches = nullptr;
+  size_t numBatches = 0;
+
+  static SlabDepot& instance()
+  {
+    // constructed in place without allocating, as release() may be the first to use it
+    alignas(SlabDepot) static unsigned char storage[sizeof(SlabDepot)];
+    static SlabDepot* depot = new (storage) SlabDepot;
+    return *depot;
+  }
+
+  /// take over a batch, deletes it if the depot is full
+  void put(FreeSlab* batch, size_t count)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (numBatches < gMaxDepotBatches) {
+        batch->count = count;
+        batch->nextBatch = batches;
+        batches = batch;
+        numBatches++;
+        return;
+      }
+    }
+    deleteSlabs(batch);
+  }
+
+  /// take a batch, returns nullptr if the depot is empty
+  FreeSlab* get(size_t& count)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    FreeSlab* batch = batches;
+    if (batch) {
+      batches = batch->nextBatch;
+      numBatches--;
+      count = batch->count;
+    }
+    return batch;
+  }
+};
+
+// the free slabs of a thread, trivially destructible so that it stays usable until the thread
+// ends; the slabs are handed over to the depot by the CacheFlusher of the thread
+struct SlabCache {
+  FreeSlab* slabs;
+  size_t count;
+  enum State : uint8_t { kUnused, kActive, kFlushed } state;
+
+  /// hand the first batch over to the depot
+  void spill()
+  {
+    FreeSlab* batch = slabs;
+    FreeSlab* last = batch;
+    size_t n = 1;
+    for (; n < gSlabBatch && last->next; ++n) {
+      last = last->next;
+    }
+    slabs = last->next;
+    last->next = nullptr;
+    count -= n;
+    SlabDepot::instance().put(batch, n);
+  }
+
+  /// the cache of the calling thread, nullptr once the thread has flushed it
+  static SlabCache* instance();
+};
+
+thread_local SlabCache tSlabCache = { nullptr, 0, SlabCache::kUnused };
+
+struct CacheFlusher {
+  ~CacheFlusher()
+  {
+    while (tSlabCache.slabs) {
+      tSlabCache.spill();
+    }
+    // the buffers released later in this thread go directly to the heap
+    tSlabCache.state = SlabCache::kFlushed;
+  }
+};
+
+SlabCache* SlabCache::instance()
+{
+  if (tSlabCache.state == kActive) {
+    return &tSlabCache;
+  }
+  if (tSlabCache.state == kFlushed) {
+    return nullptr;
+  }
+  static thread_local CacheFlusher flusher;
+  (void)flusher;
+  SlabDepot::instance();
+  tSlabCache.state = kActive;
+  return &tSlabCache;
+}
+}
+
+//__________________________________________________________________________________________________
+byte* AliceO2::Header::BlockAllocator::allocate(size_t size)
+{
+  if (size > sSlabSize || !gPoolingEnabled.load(std::memory_order_relaxed)) {
+    return newBuffer(size, false);
+  }
+  SlabCache* cache = SlabCache::instance();
+  if (!cache) {
+    return newBuffer(size, false);
+  }
+  if (!cache->slabs) {
+    cache->slabs = SlabDepot::instance().get(cache->count);
+    if (!cache->slabs) {
+      return newBuffer(sSlabSize, true);
+    }
+  }
+  FreeSlab* slab = cache->slabs;
+  cache->slabs = slab->next;
+  cache->count--;
+  return reinterpret_cast<byte*>(slab);
+}
+
+//__________________________________________________________________________________________________
+void AliceO2::Header::BlockAllocator::release(byte* buffer) noexcept
+{
+  if (!buffer) return;
+  SlabCache* cache = isPooled(buffer) ? SlabCache::instance() : nullptr;
+  if (!cache) {
+    deleteBuffer(buffer);
+    return;
+  }
+  FreeSlab* slab = toFreeSlab(buffer);
+  slab->next = cache->slabs;
+  cache->slabs = slab;
+  if (++cache->count > gMaxThreadSlabs) {
+    cache->spill();
+  }
+}
+
+//__________________________________________________________________________________________________
+void AliceO2::Header::BlockAllocator::setPooling(bool enable) noexcept
+{
+  gPoolingEnabled = enable;
+}
+
+//__________________________________________________________________________________________________
+bool AliceO2::Header::BlockAllocator::getPooling() noexcept
+{
+  return gPoolingEnabled;
+}
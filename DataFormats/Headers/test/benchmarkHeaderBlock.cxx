@@ -0,0 +1,112 @@
+/// @copyright
+/// © Copyright 2014 Copyright Holders of the ALICE O2 collaboration.
+/// See https://aliceinfo.cern.ch/AliceO2 for details on the Copyright holders.
+/// This software is distributed under the terms of the
+/// GNU General Public License version 3 (GPL Version 3).
+///
+/// License text in a separate file.
+///
+/// In applying this license, CERN does not waive the privileges and immunities
+/// granted to it by virtue of its status as an Intergovernmental Organization
+/// or submit itself to any jurisdiction.
+
+/// @brief benchmark of the header block allocation, heap vs. BlockAllocator pool
+///
+/// Emulates the header block path of O2Device::AddMessage: a producer thread composes
+/// header blocks and hands the buffers over, a second thread (the transport) releases
+/// them via Block::freefn. Also the single thread compose/release cycle is measured.
+/// usage: benchmarkHeaderBlock [number of messages]
+
+#include "Headers/DataHeader.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace AliceO2::Header;
+
+namespace {
+/// minimal single producer single consumer queue standing in for the transport
+class HandOverQueue {
+public:
+  HandOverQueue() : mSlots(1024, nullptr), mHead(0), mTail(0) {}
+
+  void push(byte* buffer) {
+    size_t head = mHead.load(std::memory_order_relaxed);
+    while (head - mTail.load(std::memory_order_acquire) == mSlots.size()) {
+      std::this_thread::yield();
+    }
+    mSlots[head % mSlots.size()] = buffer;
+    mHead.store(head + 1, std::memory_order_release);
+  }
+
+  byte* pop() {
+    size_t tail = mTail.load(std::memory_order_relaxed);
+    while (mHead.load(std::memory_order_acquire) == tail) {
+      std::this_thread::yield();
+    }
+    byte* buffer = mSlots[tail % mSlots.size()];
+    mTail.store(tail + 1, std::memory_order_release);
+    return buffer;
+  }
+
+private:
+  std::vector<byte*> mSlots;
+  std::atomic<size_t> mHead;
+  std::atomic<size_t> mTail;
+};
+
+Block makeBlock(uint64_t i) {
+  DataHeader dh;
+  dh.dataDescription = gDataDescriptionRawData;
+  dh.dataOrigin = gDataOriginTPC;
+  dh.subSpecification = i;
+  dh.payloadSize = 1024;
+  return Block{dh, NameHeader<16>{"benchmark"}};
+}
+
+double singleThread(uint64_t nMessages) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < nMessages; ++i) {
+    Block block = makeBlock(i);
+    byte* buffer = block.buffer.release();
+    Block::freefn(buffer, buffer);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return nMessages / elapsed.count();
+}
+
+double crossThread(uint64_t nMessages) {
+  HandOverQueue queue;
+  auto start = std::chrono::steady_clock::now();
+  std::thread transport([&queue, nMessages]() {
+    for (uint64_t i = 0; i < nMessages; ++i) {
+      byte* buffer = queue.pop();
+      Block::freefn(buffer, buffer);
+    }
+  });
+  for (uint64_t i = 0; i < nMessages; ++i) {
+    Block block = makeBlock(i);
+    queue.push(block.buffer.release());
+  }
+  transport.join();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return nMessages / elapsed.count();
+}
+}
+
+int main(int argc, char** argv) {
+  uint64_t nMessages = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+  printf("%llu header blocks of %zu bytes\n", (unsigned long long)nMessages,
+         makeBlock(0).size());
+  printf("%-10s %20s %20s\n", "allocator", "same thread [msg/s]", "cross thread [msg/s]");
+  for (bool pooling : {false, true}) {
+    BlockAllocator::setPooling(pooling);
+    singleThread(nMessages / 10); // warm up
+    double single = singleThread(nMessages);
+    double cross = crossThread(nMessages);
+    printf("%-10s %20.4g %20.4g\n", pooling ? "pool" : "heap", single, cross);
+  }
+  return 0;
+}
@@ -22,6 +22,38 @@ namespace AliceO2 {
 
       BOOST_CHECK(desc2 == "ITSRAW");
     }
+
+    BOOST_AUTO_TEST_CASE(Block_test)
+    {
+      DataHeader dh;
+      dh.dataDescription = gDataDescriptionRawData;
+      dh.subSpecification = 42;
+      NameHeader<16> nh("block");
+      for (bool pooling : {true, false}) {
+        BlockAllocator::setPooling(pooling);
+        Block block{dh, nh};
+        BOOST_CHECK(block.size() == dh.size() + nh.size());
+        const DataHeader* h = get<DataHeader>(block.data());
+        BOOST_REQUIRE(h != nullptr);
+        BOOST_CHECK(h->subSpecification == 42);
+        BOOST_CHECK(h->next() != nullptr);
+        BOOST_CHECK(get<NameHeader<0>>(block.data()) != nullptr);
+
+        // a released pooled slab is reused for the next block
+        byte* buffer = block.buffer.release();
+        Block::freefn(buffer, buffer);
+        Block again{dh};
+        if (pooling) {
+          BOOST_CHECK(again.data() == buffer);
+        }
+      }
+      BlockAllocator::setPooling(true);
+
+      // blocks bigger than a slab are served by the heap
+      std::string big(BlockAllocator::sSlabSize + 1, 'x');
+      Block large = Block::compose(dh, big);
+      BOOST_CHECK(large.size() == dh.size() + big.size());
+    }
   } 
 }
 
@@ -9,24 +9,15 @@
 #define ALICEO2_DEVICES_EPNRECEIVER_H_
 
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
-#include <chrono>
+#include <memory>
 
 #include "FairMQDevice.h"
 
+#include "FLP2EPNex_distributed/TimeFrameBuilder.h"
+
 namespace AliceO2 {
 namespace Devices {
 
-/// Container for (sub-)timeframes
-
-struct TFBuffer
-{
-  FairMQParts parts;
-  std::chrono::steady_clock::time_point start;
-  std::chrono::steady_clock::time_point end;
-};
-
 /// Receives sub-timeframes from the flpSenders and merges these into full timeframes.
 
 class EPNReceiver : public FairMQDevice
@@ -41,7 +32,10 @@ class EPNReceiver : public FairMQDevice
     virtual void InitTask();
 
     /// Prints the contents of the timeframe container
-    void PrintBuffer(const std::unordered_map<uint16_t, TFBuffer> &buffer) const;
+    void PrintBuffer() const;
+
+    /// Prints the counters and latency of the timeframe building
+    void PrintStats() const;
 
     /// Discared incomplete timeframes after \p fBufferTimeoutInMs.
     void DiscardIncompleteTimeframes();
@@ -50,11 +44,11 @@ class EPNReceiver : public FairMQDevice
     /// Overloads the Run() method of FairMQDevice
     virtual void Run();
 
-    std::unordered_map<uint16_t, TFBuffer> fTimeframeBuffer; ///< Stores (sub-)timeframes
-    std::unordered_set<uint16_t> fDiscardedSet; ///< Set containing IDs of dropped timeframes
+    std::unique_ptr<TimeFrameBuilder> fTimeframeBuilder; ///< Collects (sub-)timeframes
 
     int fNumFLPs; ///< Number of flpSenders
     int fBufferTimeoutInMs; ///< Time after which incomplete timeframes are dropped
+    int fNumTimeframeSlots; ///< Max number of timeframes under construction
     int fTestMode; ///< Run the device in test mode (only syncSampler+flpSender+epnReceiver)
 
     std::string fInChannelName;
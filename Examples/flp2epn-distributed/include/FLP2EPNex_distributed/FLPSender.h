@@ -10,10 +10,16 @@
 
 #include <string>
 #include <queue>
-#include <unordered_map>
+#include <vector>
+#include <memory>
 #include <chrono>
+#include <atomic>
 
 #include "FairMQDevice.h"
+#include "O2Device/SharedMemoryRegion.h"
+
+#include "FLP2EPNex_distributed/LatencyHistogram.h"
+#include "FLP2EPNex_distributed/TrafficShaping.h"
 
 namespace AliceO2 {
 namespace Devices {
@@ -22,7 +28,12 @@ namespace Devices {
 ///
 /// Sub-timeframes are received from the previous step (or generated in test-mode)
 /// and are sent to epnReceivers. Target epnReceiver is determined from the timeframe ID:
-/// targetEpnReceiver = timeframeId % numEPNs (numEPNs is same for every flpSender, although some may be inactive).
+/// targetEpnReceiver = timeframeId % numEPNs (numEPNs is same for every flpSender, although some may be inactive),
+/// unless the flpSyncSampler assigns the epnReceiver together with the ID (test mode).
+/// The sub-timeframes wait in a queue per epnReceiver until the SendPacer lets them go.
+/// In regular mode the payloads can come through a shared memory region of the producer on the same node:
+/// only their descriptors are received, the payloads are sent from the region without a copy
+/// and their slots are released when the transport is done with them.
 
 class FLPSender : public FairMQDevice
 {
@@ -41,16 +52,46 @@ class FLPSender : public FairMQDevice
     virtual void Run();
 
   private:
-    /// Sends the "oldest" element from the sub-timeframe container
-    void sendFrontData();
+    /// Stores the sub-timeframe in the buffer of the epnReceiver
+    void bufferData(FairMQParts&& parts, int direction);
+
+    /// Sends all buffered sub-timeframes accepted by the pacer
+    void sendReadyData();
+
+    /// Sends the "oldest" element from the sub-timeframe container of the epnReceiver
+    void sendFrontData(int direction, std::chrono::steady_clock::time_point now);
+
+    /// Prints the throughput and the buffering latency of the pacing policy
+    void PrintStats() const;
+
+    /// Attaches to the shared memory region of the producer, waits until it is available.
+    /// The previous mapping is kept until the messages pointing into it are released.
+    bool attachRegion();
+
+    /// Free function of the messages pointing into the region, hint is the FLPSender
+    static void releasePayload(void* data, void* hint);
+
+    AliceO2::Base::SharedMemoryRegion fRegion; ///< Region of the payloads (declared before the buffers which point into it)
+    std::atomic<int> fRegionMessages; ///< Messages pointing into the region, not yet released by the transport
+    std::string fRegionName; ///< Name of the shared memory region, empty if the payloads come in the messages
+
+    std::vector<std::queue<FairMQParts>> fSTFBuffer; ///< Buffer for sub-timeframes, per epnReceiver
+    std::vector<std::queue<std::chrono::steady_clock::time_point>> fArrivalTime; ///< Stores arrival times of sub-timeframes
+    int fNumBuffered; ///< Number of buffered sub-timeframes
 
-    std::queue<FairMQParts> fSTFBuffer; ///< Buffer for sub-timeframes
-    std::queue<std::chrono::steady_clock::time_point> fArrivalTime; ///< Stores arrival times of sub-timeframes
+    std::unique_ptr<SendPacer> fPacer; ///< Decides when the buffered sub-timeframes are sent
+    LatencyHistogram fSendLatency; ///< Time spent by the sub-timeframes in the buffer
+    uint64_t fSentBytes; ///< Size of the sent sub-timeframe bodies
+    std::chrono::steady_clock::time_point fFirstArrival;
+    std::chrono::steady_clock::time_point fLastSend;
 
     int fNumEPNs; ///< Number of epnReceivers
     unsigned int fIndex; ///< Index of the flpSender among other flpSenders
     unsigned int fSendOffset; ///< Offset for staggering output
     unsigned int fSendDelay; ///< Delay for staggering output
+    std::string fPacing; ///< Name of the pacing policy
+    double fSendRate; ///< Rate limit per epnReceiver in bytes per second (token bucket pacing)
+    double fSendBurst; ///< Max burst per epnReceiver in bytes (token bucket pacing)
 
     int fEventSize; ///< Size of the sub-timeframe body (only for test mode)
     int fTestMode; ///< Run the device in test mode (only syncSampler+flpSender+epnReceiver)
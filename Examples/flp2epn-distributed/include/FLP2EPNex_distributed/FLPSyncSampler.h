@@ -14,9 +14,14 @@
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <mutex>
+#include <memory>
 
 #include "FairMQDevice.h"
 
+#include "FLP2EPNex_distributed/LatencyHistogram.h"
+#include "FLP2EPNex_distributed/TrafficShaping.h"
+
 namespace AliceO2 {
 namespace Devices {
 
@@ -28,7 +33,9 @@ struct timeframeDuration
     std::chrono::steady_clock::time_point end;
 };
 
-/// Publishes timeframes IDs for flpSenders (used only in test mode)
+/// Publishes timeframes IDs for flpSenders (used only in test mode).
+/// With a scheduler configured, the target epnReceiver of every timeframe is chosen here and published
+/// together with the ID, the acknowledgements of the epnReceivers return their credits.
 
 class FLPSyncSampler : public FairMQDevice
 {
@@ -45,6 +52,9 @@ class FLPSyncSampler : public FairMQDevice
     /// Listens for acknowledgements from the epnReceivers when they collected full timeframe
     void ListenForAcks();
 
+    /// Prints the throughput and the roundtrip time distribution of the scheduling policy
+    void PrintStats() const;
+
   protected:
     /// Overloads the InitTask() method of FairMQDevice
     virtual void InitTask();
@@ -59,7 +69,20 @@ class FLPSyncSampler : public FairMQDevice
     int fMaxEvents; ///< Maximum number of events to send (0 - unlimited)
     int fStoreRTTinFile; ///< Store round trip time measurements in a file.
     int fEventCounter; ///< Controls the send rate of the timeframe IDs
+    int fDrainTimeoutInMs; ///< Time to wait for the outstanding acknowledgements after the last event
+    uint64_t fNumPublished; ///< Number of published timeframe IDs
+    std::atomic<uint64_t> fNumAcknowledged; ///< Number of acknowledged timeframes
     uint16_t fTimeFrameId;
+    int fNumEPNs; ///< Number of epnReceivers, 0 to let the flpSenders choose them
+    std::string fSchedulerName; ///< Name of the EPN assignment policy
+    int fEPNCredits; ///< Max number of unacknowledged timeframes per epnReceiver (0 - unlimited)
+    int fCreditTimeoutInMs; ///< Time after which the credit of an unacknowledged timeframe is reclaimed
+    std::unique_ptr<EPNScheduler> fScheduler; ///< Assigns the timeframes to the epnReceivers
+    std::mutex fSchedulerMutex; ///< Protects the scheduler, which is also updated by the ack listener
+    LatencyHistogram fRTT; ///< Roundtrip times of the acknowledged timeframes
+    std::chrono::steady_clock::time_point fFirstSent;
+    std::chrono::steady_clock::time_point fLastAck;
+    std::chrono::steady_clock::duration fThrottledTime; ///< Time spent waiting for credits
     std::thread fAckListener;
     std::thread fResetEventCounter;
     std::atomic<bool> fLeaving;
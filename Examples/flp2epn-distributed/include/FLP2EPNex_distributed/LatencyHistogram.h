@@ -0,0 +1,68 @@
+/**
+ * LatencyHistogram.h
+ *
+ * @brief Latency distribution with power of 2 bins, for the transport statistics
+ */
+
+#ifndef ALICEO2_DEVICES_LATENCYHISTOGRAM_H_
+#define ALICEO2_DEVICES_LATENCYHISTOGRAM_H_
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace AliceO2 {
+namespace Devices {
+
+/// Counts latencies in power of 2 bins of microseconds: bin i counts latencies in [2^(i-1), 2^i) us.
+/// Cheap enough to be filled on the data path, precise enough for the median and the tail.
+struct LatencyHistogram {
+  static constexpr int sNumBins = 32;
+
+  uint64_t count = 0;
+  uint64_t sumUs = 0;
+  uint64_t maxUs = 0;
+  std::array<uint64_t, sNumBins> bins{};
+
+  void add(uint64_t latencyUs)
+  {
+    int bin = 0;
+    while (bin < sNumBins - 1 && (uint64_t(1) << bin) <= latencyUs) {
+      bin++;
+    }
+    bins[bin]++;
+    count++;
+    sumUs += latencyUs;
+    maxUs = std::max(maxUs, latencyUs);
+  }
+
+  void add(std::chrono::steady_clock::duration latency)
+  {
+    add(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+  }
+
+  uint64_t meanUs() const
+  {
+    return count > 0 ? sumUs / count : 0;
+  }
+
+  /// Upper edge of the bin containing the given quantile (0..1), in microseconds
+  uint64_t quantileUs(double quantile) const
+  {
+    uint64_t target = quantile * count;
+    uint64_t sum = 0;
+    for (int bin = 0; bin < sNumBins; ++bin) {
+      sum += bins[bin];
+      if (sum > target) {
+        return uint64_t(1) << bin;
+      }
+    }
+    return maxUs;
+  }
+};
+
+} // namespace Devices
+} // namespace AliceO2
+
+#endif
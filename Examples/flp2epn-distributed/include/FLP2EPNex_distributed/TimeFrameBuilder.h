@@ -0,0 +1,160 @@
+/**
+ * TimeFrameBuilder.h
+ *
+ * @brief Assembly of full timeframes from the sub-timeframes of all FLPs
+ */
+
+#ifndef ALICEO2_DEVICES_TIMEFRAMEBUILDER_H_
+#define ALICEO2_DEVICES_TIMEFRAMEBUILDER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "FairMQMessage.h"
+#include "FairMQParts.h"
+
+#include "FLP2EPNex_distributed/LatencyHistogram.h"
+
+namespace AliceO2 {
+namespace Devices {
+
+/// Collects the sub-timeframes of the FLPs into full timeframes.
+///
+/// The timeframes under construction live in a fixed ring of preallocated slots,
+/// the slot of a timeframe is given by its ID (id % capacity), so there are no
+/// allocations or map lookups on the receive path. Every slot keeps a bitmap of
+/// the FLPs already received, which catches duplicated sub-timeframes.
+/// Incomplete timeframes are expired through a hashed timer wheel with 1 ms ticks:
+/// each slot is linked into the bucket of its deadline, so adding, completing and
+/// expiring a timeframe are O(1), independently of the number of pending ones.
+/// A discarded timeframe leaves a tombstone in its slot, so that its late parts are
+/// recognized and dropped until the slot is reused.
+/// The capacity must exceed the number of timeframes in flight, otherwise the
+/// oldest timeframe is evicted when its slot is needed for a new ID.
+class TimeFrameBuilder
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Outcome of adding a sub-timeframe
+    enum Result {
+      kAdded,     ///< stored, the timeframe is still incomplete
+      kCompleted, ///< the timeframe is complete and was moved to the output
+      kDuplicate, ///< the timeframe already has a part from this FLP, the part is dropped
+      kLate,      ///< the timeframe was already discarded, the part is dropped
+      kInvalid    ///< the FLP index is out of range, the part is dropped
+    };
+
+    /// Counters and latency distribution (time from the first to the last sub-timeframe)
+    struct Stats {
+      uint64_t completed = 0;   ///< complete timeframes
+      uint64_t timedOut = 0;    ///< timeframes discarded after the timeout
+      uint64_t evicted = 0;     ///< timeframes discarded because their slot was needed
+      uint64_t duplicates = 0;  ///< duplicated sub-timeframes
+      uint64_t lateParts = 0;   ///< sub-timeframes of already discarded timeframes
+      uint64_t invalid = 0;     ///< sub-timeframes with invalid FLP index
+      LatencyHistogram latency; ///< building time of the complete timeframes
+    };
+
+    /// \param numFLPs number of sub-timeframes making a full timeframe
+    /// \param timeoutMs time after the first sub-timeframe after which an incomplete timeframe is discarded
+    /// \param capacity number of slots, rounded up to a power of 2
+    TimeFrameBuilder(int numFLPs, int timeoutMs, int capacity = 1024);
+
+    TimeFrameBuilder(const TimeFrameBuilder&) = delete;
+    TimeFrameBuilder& operator=(const TimeFrameBuilder&) = delete;
+
+    /// Adds a sub-timeframe. If it completes the timeframe, the parts of all FLPs
+    /// are appended to \p timeframe in the order of the FLP index.
+    Result add(uint16_t id, int flpIndex, FairMQMessagePtr&& part, Clock::time_point now, FairMQParts& timeframe);
+
+    /// Discards the timeframes which are incomplete after the timeout.
+    /// Calls onExpired(id, numberOfReceivedParts) for each of them.
+    template <typename F>
+    void expire(Clock::time_point now, F onExpired)
+    {
+      int64_t nowTick = tick(now);
+      if (nowTick <= mCurrentTick) {
+        return;
+      }
+      // after a long pause one turn of the wheel visits all buckets
+      int64_t turn = mWheel.size();
+      int64_t first = nowTick - mCurrentTick > turn ? nowTick - turn + 1 : mCurrentTick + 1;
+      for (int64_t t = first; t <= nowTick; ++t) {
+        int32_t idx = mWheel[t & mWheelMask];
+        while (idx >= 0) {
+          Slot& slot = mSlots[idx];
+          int32_t next = slot.next;
+          if (slot.deadlineTick <= nowTick) {
+            onExpired(slot.id, slot.received);
+            discard(idx);
+            mStats.timedOut++;
+          }
+          idx = next;
+        }
+      }
+      mCurrentTick = nowTick;
+    }
+
+    /// Calls f(id, numberOfReceivedParts) for every timeframe under construction
+    template <typename F>
+    void forEachPending(F f) const
+    {
+      for (const Slot& slot : mSlots) {
+        if (slot.state == Slot::kBuilding) {
+          f(slot.id, slot.received);
+        }
+      }
+    }
+
+    int getNumberOfPending() const
+    {
+      return mNumPending;
+    }
+
+    const Stats& getStats() const
+    {
+      return mStats;
+    }
+
+  private:
+    struct Slot {
+      enum State { kFree, kBuilding, kDiscarded };
+      State state = kFree;
+      uint16_t id = 0;
+      int received = 0;
+      Clock::time_point first;
+      int64_t deadlineTick = 0;
+      int32_t prev = -1; ///< neighbours in the timer wheel bucket
+      int32_t next = -1;
+      std::vector<uint64_t> flpMask;
+      std::vector<FairMQMessagePtr> parts;
+    };
+
+    int64_t tick(Clock::time_point t) const
+    {
+      return std::chrono::duration_cast<std::chrono::milliseconds>(t - mEpoch).count();
+    }
+
+    void link(int32_t idx);
+    void unlink(int32_t idx);
+    /// drops the parts of the slot and leaves a tombstone
+    void discard(int32_t idx);
+
+    int mNumFLPs;
+    int mTimeoutMs;
+    int mNumPending;
+    uint32_t mSlotMask;
+    uint64_t mWheelMask;
+    int64_t mCurrentTick; ///< last tick processed by expire
+    Clock::time_point mEpoch;
+    std::vector<Slot> mSlots;
+    std::vector<int32_t> mWheel; ///< first slot in each bucket, -1 for empty bucket
+    Stats mStats;
+};
+
+} // namespace Devices
+} // namespace AliceO2
+
+#endif
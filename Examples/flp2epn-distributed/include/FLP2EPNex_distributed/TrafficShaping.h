@@ -0,0 +1,183 @@
+/**
+ * TrafficShaping.h
+ *
+ * @brief Scheduling policies for the distribution of the sub-timeframes to the EPNs
+ */
+
+#ifndef ALICEO2_DEVICES_TRAFFICSHAPING_H_
+#define ALICEO2_DEVICES_TRAFFICSHAPING_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace AliceO2 {
+namespace Devices {
+
+/// Timeframe ID published by the flpSyncSampler, together with the EPN chosen for it.
+/// The ID comes first, so the flpSenders can also read the bare ID sent without the assignment.
+struct TimeframeAssignment {
+  uint16_t timeFrameId;
+  uint16_t epnIndex;
+};
+
+/// Decides when a buffered sub-timeframe may leave the flpSender.
+/// The flpSender keeps one queue per EPN and asks the pacer about the front of every queue.
+class SendPacer
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    virtual ~SendPacer() = default;
+
+    virtual const char* getName() const = 0;
+
+    /// Can a sub-timeframe of \p bytes which arrived at \p arrival be sent to the EPN now?
+    virtual bool isReady(int epn, size_t bytes, Clock::time_point arrival, Clock::time_point now) = 0;
+
+    /// Called after the sub-timeframe was sent
+    virtual void onSent(int /*epn*/, size_t /*bytes*/, Clock::time_point /*now*/) {}
+
+    /// Creates the pacer by name ("staggered" or "token-bucket"), nullptr for an unknown name
+    /// \param sendOffset, sendDelay staggering: each sub-timeframe is delayed by sendOffset * sendDelay ms
+    /// \param rate, burst token bucket: rate in bytes per second and bucket size in bytes, per EPN
+    static std::unique_ptr<SendPacer> create(const std::string& name, int numEPNs, unsigned int sendOffset,
+                                             unsigned int sendDelay, double rate, double burst);
+};
+
+/// Fixed delay after the arrival (the original flpSender behaviour).
+/// FLPs with different offsets send the same timeframe at different times, which spreads the incast on the EPN.
+class StaggeredPacer : public SendPacer
+{
+  public:
+    StaggeredPacer(unsigned int sendOffset, unsigned int sendDelay);
+
+    virtual const char* getName() const { return "staggered"; }
+    virtual bool isReady(int epn, size_t bytes, Clock::time_point arrival, Clock::time_point now);
+
+  private:
+    Clock::duration mDelay;
+};
+
+/// Token bucket per EPN: the traffic to every EPN is limited to the rate, with bursts up to the bucket size.
+/// A sub-timeframe larger than the bucket is sent once the bucket is full, the debt is paid by the following ones.
+class TokenBucketPacer : public SendPacer
+{
+  public:
+    TokenBucketPacer(int numEPNs, double rate, double burst);
+
+    virtual const char* getName() const { return "token-bucket"; }
+    virtual bool isReady(int epn, size_t bytes, Clock::time_point arrival, Clock::time_point now);
+    virtual void onSent(int epn, size_t bytes, Clock::time_point now);
+
+  private:
+    struct Bucket {
+      double tokens;
+      Clock::time_point refilled;
+    };
+
+    void refill(Bucket& bucket, Clock::time_point now) const;
+
+    double mRate;  ///< bytes per second
+    double mBurst; ///< bucket size in bytes
+    std::vector<Bucket> mBuckets;
+};
+
+/// Chooses the EPN for every timeframe (in the flpSyncSampler, so that all FLPs follow the same decision)
+/// and enforces the credit based flow control: every EPN has a limited number of credits, one is taken
+/// by each assigned timeframe and returned by its acknowledgement. If the EPN has no credit left, the
+/// timeframe is not assigned, which throttles the publishing of the timeframe IDs.
+/// Credits of timeframes not acknowledged within the timeout (discarded by the EPN) are reclaimed.
+class EPNScheduler
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+      uint64_t assigned = 0;     ///< timeframes assigned
+      uint64_t acknowledged = 0; ///< timeframes acknowledged by the EPNs
+      uint64_t reclaimed = 0;    ///< credits reclaimed after the timeout
+      uint64_t throttled = 0;    ///< assignments refused for lack of credits
+      std::vector<uint64_t> assignedPerEPN;
+    };
+
+    /// \param credits max number of unacknowledged timeframes per EPN, 0 for no limit
+    /// \param creditTimeoutMs time after which the credit of an unacknowledged timeframe is reclaimed
+    EPNScheduler(int numEPNs, int credits, int creditTimeoutMs);
+    virtual ~EPNScheduler() = default;
+
+    virtual const char* getName() const = 0;
+
+    /// Returns the EPN for the timeframe, or -1 if the timeframe can not be sent now for lack of credits
+    int assign(uint16_t id, Clock::time_point now);
+
+    /// Returns the credit of the timeframe
+    void acknowledge(uint16_t id);
+
+    int getNumberOfEPNs() const { return mOutstanding.size(); }
+
+    /// Number of unacknowledged timeframes of the EPN
+    int getOutstanding(int epn) const { return mOutstanding[epn]; }
+
+    const Stats& getStats() const { return mStats; }
+
+    /// Creates the scheduler by name ("round-robin" or "least-loaded"), nullptr for an unknown name
+    static std::unique_ptr<EPNScheduler> create(const std::string& name, int numEPNs, int credits,
+                                                int creditTimeoutMs);
+
+  protected:
+    /// Returns the preferred EPN for the timeframe
+    virtual int select(uint16_t id) const = 0;
+
+    bool hasCredit(int epn) const { return mCredits <= 0 || mOutstanding[epn] < mCredits; }
+
+  private:
+    struct Assignment {
+      uint16_t id;
+      Clock::time_point deadline;
+    };
+
+    void reclaim(Clock::time_point now);
+
+    int mCredits;
+    Clock::duration mCreditTimeout;
+    std::vector<int> mOutstanding; ///< unacknowledged timeframes per EPN
+    std::vector<int16_t> mEPNOfId; ///< EPN of every unacknowledged timeframe ID, -1 if none
+    std::vector<Clock::time_point> mDeadlineOfId; ///< credit deadline of every assigned timeframe ID
+    std::deque<Assignment> mPending; ///< assignments in the order of their deadlines
+    Stats mStats;
+};
+
+/// Static assignment id % numEPNs (the original behaviour), waits for the credit of that EPN
+class RoundRobinScheduler : public EPNScheduler
+{
+  public:
+    using EPNScheduler::EPNScheduler;
+
+    virtual const char* getName() const { return "round-robin"; }
+
+  protected:
+    virtual int select(uint16_t id) const;
+};
+
+/// Assigns the timeframe to the EPN with the fewest unacknowledged timeframes, so a slow EPN
+/// gets less work. Ties are broken starting from id % numEPNs, to keep the load even.
+class LeastLoadedScheduler : public EPNScheduler
+{
+  public:
+    using EPNScheduler::EPNScheduler;
+
+    virtual const char* getName() const { return "least-loaded"; }
+
+  protected:
+    virtual int select(uint16_t id) const;
+};
+
+} // namespace Devices
+} // namespace AliceO2
+
+#endif
@@ -17,6 +17,7 @@ void addCustomOptions(bpo::options_description& options)
   options.add_options()
     ("buffer-timeout", bpo::value<int>()->default_value(1000), "Buffer timeout in milliseconds")
     ("num-flps", bpo::value<int>()->required(), "Number of FLPs")
+    ("tf-slots", bpo::value<int>()->default_value(1024), "Max number of timeframes under construction")
     ("test-mode", bpo::value<int>()->default_value(0), "Run in test mode")
     ("in-chan-name", bpo::value<std::string>()->default_value("stf2"), "Name of the input channel (sub-time frames)")
     ("out-chan-name", bpo::value<std::string>()->default_value("tf"), "Name of the output channel (time frames)")
@@ -21,6 +21,10 @@ void addCustomOptions(bpo::options_description& options)
     ("test-mode", bpo::value<int>()->default_value(0), "Run in test mode")
     ("send-offset", bpo::value<int>()->default_value(0), "Offset for staggered sending")
     ("send-delay", bpo::value<int>()->default_value(8), "Delay for staggered sending")
+    ("pacing", bpo::value<std::string>()->default_value("staggered"), "Pacing of the output: staggered or token-bucket")
+    ("send-rate", bpo::value<float>()->default_value(0), "Rate limit per EPN in MB/s (token-bucket pacing)")
+    ("send-burst", bpo::value<float>()->default_value(0), "Max burst per EPN in MB (token-bucket pacing)")
+    ("shm-region", bpo::value<std::string>()->default_value(""), "Name of the shared memory region of the payloads, regular mode (empty - payloads in the messages)")
     ("in-chan-name", bpo::value<std::string>()->default_value("stf1"), "Name of the input channel (sub-time frames)")
     ("out-chan-name", bpo::value<std::string>()->default_value("stf2"), "Name of the output channel (sub-time frames)");
 }
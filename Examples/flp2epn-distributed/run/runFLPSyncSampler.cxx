@@ -17,7 +17,12 @@ void addCustomOptions(bpo::options_description& options)
   options.add_options()
     ("event-rate", bpo::value<int>()->default_value(0), "Event rate limit in maximum number of events per second")
     ("max-events", bpo::value<int>()->default_value(0), "Maximum number of events to send (0 - unlimited)")
+    ("drain-timeout", bpo::value<int>()->default_value(0), "Time in ms to wait for the outstanding acknowledgements after the last event")
     ("store-rtt-in-file", bpo::value<int>()->default_value(0), "Store round trip time measurements in a file (1/0)")
+    ("num-epns", bpo::value<int>()->default_value(0), "Number of EPNs, to assign the timeframes in the sampler (0 - assigned by the FLPs)")
+    ("scheduler", bpo::value<std::string>()->default_value("round-robin"), "EPN assignment: round-robin or least-loaded")
+    ("epn-credits", bpo::value<int>()->default_value(0), "Max number of unacknowledged timeframes per EPN (0 - unlimited)")
+    ("credit-timeout", bpo::value<int>()->default_value(1000), "Time in ms after which the credit of an unacknowledged timeframe is reclaimed")
     ("ack-chan-name", bpo::value<std::string>()->default_value("ack"), "Name of the acknowledgement channel")
     ("out-chan-name", bpo::value<std::string>()->default_value("stf1"), "Name of the output channel (sub-time frames)");
 }
@@ -23,10 +23,10 @@ struct f2eHeader {
 };
 
 EPNReceiver::EPNReceiver()
-  : fTimeframeBuffer()
-  , fDiscardedSet()
+  : fTimeframeBuilder()
   , fNumFLPs(0)
   , fBufferTimeoutInMs(5000)
+  , fNumTimeframeSlots(1024)
   , fTestMode(0)
   , fInChannelName()
   , fOutChannelName()
@@ -42,13 +42,16 @@ void EPNReceiver::InitTask()
 {
   fNumFLPs = fConfig->GetValue<int>("num-flps");
   fBufferTimeoutInMs = fConfig->GetValue<int>("buffer-timeout");
+  fNumTimeframeSlots = fConfig->GetValue<int>("tf-slots");
   fTestMode = fConfig->GetValue<int>("test-mode");
   fInChannelName = fConfig->GetValue<string>("in-chan-name");
   fOutChannelName = fConfig->GetValue<string>("out-chan-name");
   fAckChannelName = fConfig->GetValue<string>("ack-chan-name");
+
+  fTimeframeBuilder.reset(new TimeFrameBuilder(fNumFLPs, fBufferTimeoutInMs, fNumTimeframeSlots));
 }
 
-void EPNReceiver::PrintBuffer(const unordered_map<uint16_t, TFBuffer>& buffer) const
+void EPNReceiver::PrintBuffer() const
 {
   string header = "===== ";
 
@@ -60,30 +63,31 @@ void EPNReceiver::PrintBuffer(const unordered_map<uint16_t, TFBuffer>& buffer) c
   }
   LOG(INFO) << header;
 
-  for (auto& it : buffer) {
-    string stars = "";
-    for (unsigned int j = 1; j <= (it.second).parts.Size(); ++j) {
-      stars += "*";
-    }
-    LOG(INFO) << setw(4) << it.first << ": " << stars;
+  fTimeframeBuilder->forEachPending([](uint16_t id, int received) {
+    LOG(INFO) << setw(4) << id << ": " << string(received, '*');
+  });
+}
+
+void EPNReceiver::PrintStats() const
+{
+  const TimeFrameBuilder::Stats& stats = fTimeframeBuilder->getStats();
+  LOG(INFO) << "Timeframes: " << stats.completed << " complete, " << stats.timedOut << " timed out, "
+            << stats.evicted << " evicted, " << fTimeframeBuilder->getNumberOfPending() << " pending";
+  LOG(INFO) << "Sub-timeframes dropped: " << stats.lateParts << " late, " << stats.duplicates << " duplicated, "
+            << stats.invalid << " invalid";
+  if (stats.completed > 0) {
+    LOG(INFO) << "Timeframe building latency [us]: mean " << stats.latency.meanUs()
+              << ", median < " << stats.latency.quantileUs(0.5) << ", 99% < " << stats.latency.quantileUs(0.99)
+              << ", max " << stats.latency.maxUs;
   }
 }
 
 void EPNReceiver::DiscardIncompleteTimeframes()
 {
-  auto it = fTimeframeBuffer.begin();
-
-  while (it != fTimeframeBuffer.end()) {
-    if (duration_cast<milliseconds>(steady_clock::now() - (it->second).start).count() > fBufferTimeoutInMs) {
-      LOG(WARN) << "Timeframe #" << it->first << " incomplete after " << fBufferTimeoutInMs << " milliseconds, discarding";
-      fDiscardedSet.insert(it->first);
-      fTimeframeBuffer.erase(it++);
-      LOG(WARN) << "Number of discarded timeframes: " << fDiscardedSet.size();
-    } else {
-      // LOG(INFO) << "Timeframe #" << it->first << " within timeout, buffering...";
-      ++it;
-    }
-  }
+  fTimeframeBuilder->expire(steady_clock::now(), [this](uint16_t id, int received) {
+    LOG(WARN) << "Timeframe #" << id << " incomplete (" << received << "/" << fNumFLPs << " parts) after "
+              << fBufferTimeoutInMs << " milliseconds, discarding";
+  });
 }
 
 void EPNReceiver::Run()
@@ -116,25 +120,19 @@ void EPNReceiver::Run()
       // }
       // end DEBUG
 
-      if (fDiscardedSet.find(id) == fDiscardedSet.end())
-      {
-        if (fTimeframeBuffer.find(id) == fTimeframeBuffer.end())
-        {
-          // if this is the first part with this ID, save the receive time.
-          fTimeframeBuffer[id].start = steady_clock::now();
-        }
-        // if the received ID has not previously been discarded,
-        // store the data part in the buffer
-        fTimeframeBuffer[id].parts.AddPart(move(parts.At(1)));
-        // PrintBuffer(fTimeframeBuffer);
-      }
-      else
-      {
+      FairMQParts timeframe;
+      TimeFrameBuilder::Result result =
+        fTimeframeBuilder->add(id, header.flpIndex, move(parts.At(1)), steady_clock::now(), timeframe);
+      // PrintBuffer();
+
+      if (result == TimeFrameBuilder::kLate) {
         // if received ID has been previously discarded.
         LOG(WARN) << "Received part from an already discarded timeframe with id " << id;
-      }
-
-      if (fTimeframeBuffer[id].parts.Size() == fNumFLPs) {
+      } else if (result == TimeFrameBuilder::kDuplicate) {
+        LOG(WARN) << "Received duplicated part of timeframe #" << id << " from FLP" << header.flpIndex;
+      } else if (result == TimeFrameBuilder::kInvalid) {
+        LOG(ERROR) << "Received part of timeframe #" << id << " from unknown FLP" << header.flpIndex;
+      } else if (result == TimeFrameBuilder::kCompleted) {
         if (fTestMode > 0) {
           // Send an acknowledgement back to the sampler to measure the round trip time
           unique_ptr<FairMQMessage> ack(NewMessage(sizeof(uint16_t)));
@@ -148,21 +146,19 @@ void EPNReceiver::Run()
         {
           // LOG(INFO) << "Collected all parts for timeframe #" << id;
           // when all parts are collected send them to the output channel
-          Send(fTimeframeBuffer[id].parts, fOutChannelName);
+          Send(timeframe, fOutChannelName);
         }
-
-        // fTimeframeBuffer[id].end = steady_clock::now();
-
-        fTimeframeBuffer.erase(id);
       }
 
-      // LOG(WARN) << "Buffer size: " << fTimeframeBuffer.size();
+      // LOG(WARN) << "Buffer size: " << fTimeframeBuilder->getNumberOfPending();
     }
 
     // check if any incomplete timeframes in the buffer are older than timeout period, and discard them if they are
     DiscardIncompleteTimeframes();
   }
 
+  PrintStats();
+
   // DEBUG: save
   // if (fTestMode > 0) {
   //   std::time_t t = system_clock::to_time_t(system_clock::now());
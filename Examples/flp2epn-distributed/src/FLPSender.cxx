@@ -7,6 +7,8 @@
 
 #include <cstdint> // UINT64_MAX
 #include <cassert>
+#include <iomanip>
+#include <thread>
 
 #include "FairMQLogger.h"
 #include "FairMQMessage.h"
@@ -18,6 +20,7 @@
 using namespace std;
 using namespace std::chrono;
 using namespace AliceO2::Devices;
+using AliceO2::Base::RegionDescriptor;
 
 struct f2eHeader {
   uint16_t timeFrameId;
@@ -25,12 +28,24 @@ struct f2eHeader {
 };
 
 FLPSender::FLPSender()
-  : fSTFBuffer()
+  : fRegion()
+  , fRegionMessages(0)
+  , fRegionName()
+  , fSTFBuffer()
   , fArrivalTime()
+  , fNumBuffered(0)
+  , fPacer()
+  , fSendLatency()
+  , fSentBytes(0)
+  , fFirstArrival()
+  , fLastSend()
   , fNumEPNs(0)
   , fIndex(0)
   , fSendOffset(0)
   , fSendDelay(8)
+  , fPacing("staggered")
+  , fSendRate(0)
+  , fSendBurst(0)
   , fEventSize(10000)
   , fTestMode(0)
   , fTimeFrameId(0)
@@ -51,8 +66,28 @@ void FLPSender::InitTask()
   fTestMode = fConfig->GetValue<int>("test-mode");
   fSendOffset = fConfig->GetValue<int>("send-offset");
   fSendDelay = fConfig->GetValue<int>("send-delay");
+  fPacing = fConfig->GetValue<string>("pacing");
+  fSendRate = fConfig->GetValue<float>("send-rate") * 1e6;
+  fSendBurst = fConfig->GetValue<float>("send-burst") * 1e6;
   fInChannelName = fConfig->GetValue<string>("in-chan-name");
   fOutChannelName = fConfig->GetValue<string>("out-chan-name");
+  fRegionName = fTestMode > 0 ? "" : fConfig->GetValue<string>("shm-region");
+
+  if (fPacing == "token-bucket" && (fSendRate <= 0 || fSendBurst <= 0)) {
+    LOG(ERROR) << "Token bucket pacing requires positive send-rate and send-burst, falling back to staggered sending";
+    fPacing = "staggered";
+  }
+  fPacer = SendPacer::create(fPacing, fNumEPNs, fSendOffset, fSendDelay, fSendRate, fSendBurst);
+  if (!fPacer) {
+    LOG(ERROR) << "Unknown pacing policy '" << fPacing << "', falling back to staggered sending";
+    fPacer = SendPacer::create("staggered", fNumEPNs, fSendOffset, fSendDelay, fSendRate, fSendBurst);
+  }
+
+  fSTFBuffer = vector<queue<FairMQParts>>(fNumEPNs);
+  fArrivalTime = vector<queue<steady_clock::time_point>>(fNumEPNs);
+  fNumBuffered = 0;
+  fSendLatency = LatencyHistogram();
+  fSentBytes = 0;
 }
 
 void FLPSender::Run()
@@ -60,80 +95,195 @@ void FLPSender::Run()
   // base buffer, to be copied from for every timeframe body (zero-copy)
   FairMQMessagePtr baseMsg(NewMessage(fEventSize));
 
-  // store the channel reference to avoid traversing the map on every loop iteration
-  FairMQChannel& dataInChannel = fChannels.at(fInChannelName).at(0);
+  if (!fRegionName.empty() && !attachRegion()) {
+    return;
+  }
 
   while (CheckCurrentState(RUNNING)) {
-    // initialize f2e header
-    f2eHeader* header = new f2eHeader;
+    // while the pacer holds back some sub-timeframes, poll the input to release them in time
+    int timeout = fNumBuffered > 0 ? 1 : 100;
+    int direction = -1;
+    FairMQParts parts;
+
     if (fTestMode > 0) {
-      // test-mode: receive and store id part in the buffer.
+      // test-mode: receive the id (and the target EPN, if assigned by the sampler)
       FairMQMessagePtr id(NewMessage());
-      if (dataInChannel.Receive(id) > 0) {
+      if (Receive(id, fInChannelName, 0, timeout) > 0) {
+        f2eHeader* header = new f2eHeader;
         header->timeFrameId = *(static_cast<uint16_t*>(id->GetData()));
         header->flpIndex = fIndex;
-      } else {
-        // if nothing was received, try again
-        delete header;
-        continue;
+        direction = header->timeFrameId % fNumEPNs;
+        if (id->GetSize() >= sizeof(TimeframeAssignment)) {
+          int assigned = static_cast<TimeframeAssignment*>(id->GetData())->epnIndex;
+          if (assigned < fNumEPNs) {
+            direction = assigned;
+          } else {
+            LOG(ERROR) << "Timeframe #" << header->timeFrameId << " assigned to unknown EPN[" << assigned << "]";
+          }
+        }
+        parts.AddPart(NewMessage(header, sizeof(f2eHeader), [](void* data, void* hint){ delete static_cast<f2eHeader*>(hint); }, header));
+        // initialize data part
+        parts.AddPart(NewMessage());
+        parts.At(1)->Copy(baseMsg);
       }
     } else {
-      // regular mode: use the id generated locally
-      header->timeFrameId = fTimeFrameId;
-      header->flpIndex = fIndex;
+      // regular mode: receive data part from input, use the id generated locally
+      FairMQMessagePtr data(NewMessage());
+      if (Receive(data, fInChannelName, 0, timeout) >= 0) {
+        // a restarted producer replaces the region, the descriptors point into the new one
+        if (fRegion.isStale()) {
+          LOG(WARN) << "The shared memory region " << fRegionName << " was replaced, attaching to it again";
+          if (!attachRegion()) {
+            break;
+          }
+        }
+        if (fRegion.isOpen()) {
+          // the message carries only the location of the payload in the region,
+          // the payload is sent from there and its slot released when the transport is done with it
+          const RegionDescriptor* descriptor = static_cast<RegionDescriptor*>(data->GetData());
+          void* payload = data->GetSize() == sizeof(RegionDescriptor) ? fRegion.getData(*descriptor) : nullptr;
+          if (payload) {
+            fRegionMessages++;
+            data = NewMessage(payload, descriptor->size, &FLPSender::releasePayload, this);
+          } else {
+            LOG(ERROR) << "Received invalid shared memory descriptor, dropping it";
+            data.reset();
+          }
+        }
+
+        if (data) {
+          f2eHeader* header = new f2eHeader;
+          header->timeFrameId = fTimeFrameId;
+          header->flpIndex = fIndex;
+          direction = header->timeFrameId % fNumEPNs;
 
-      if (++fTimeFrameId == UINT16_MAX - 1) {
-        fTimeFrameId = 0;
+          if (++fTimeFrameId == UINT16_MAX - 1) {
+            fTimeFrameId = 0;
+          }
+
+          parts.AddPart(NewMessage(header, sizeof(f2eHeader), [](void* data, void* hint){ delete static_cast<f2eHeader*>(hint); }, header));
+          parts.AddPart(move(data));
+        }
       }
     }
 
-    FairMQParts parts;
+    if (direction >= 0) {
+      bufferData(move(parts), direction);
+    }
 
-    parts.AddPart(NewMessage(header, sizeof(f2eHeader), [](void* data, void* hint){ delete static_cast<f2eHeader*>(hint); }, header));
-    parts.AddPart(NewMessage());
+    sendReadyData();
+  }
 
-    // save the arrival time of the message.
-    fArrivalTime.push(steady_clock::now());
+  PrintStats();
+}
 
-    if (fTestMode > 0) {
-      // test-mode: initialize and store data part in the buffer.
-      parts.At(1)->Copy(baseMsg);
-      fSTFBuffer.push(move(parts));
-    } else {
-      // regular mode: receive data part from input
-      if (dataInChannel.Receive(parts.At(1)) >= 0) {
-        fSTFBuffer.push(move(parts));
-      } else {
-        // if nothing was received, try again
-        continue;
-      }
+bool FLPSender::attachRegion()
+{
+  // attaching unmaps the region of the previous run, the messages still pointing into it must be
+  // released first: the sub-timeframes left in the buffers are dropped, the ones queued by the
+  // transport are waited for
+  if (fRegion.isOpen() && fNumBuffered > 0) {
+    LOG(WARN) << "Dropping " << fNumBuffered << " sub-timeframes buffered in the previous run";
+    fSTFBuffer = vector<queue<FairMQParts>>(fNumEPNs);
+    fArrivalTime = vector<queue<steady_clock::time_point>>(fNumEPNs);
+    fNumBuffered = 0;
+  }
+  bool reported = false;
+  while (fRegion.isOpen() && fRegionMessages > 0) {
+    if (!CheckCurrentState(RUNNING)) {
+      return false;
+    }
+    if (!reported) {
+      LOG(WARN) << "Waiting for the release of " << fRegionMessages << " payloads before attaching to the region again";
+      reported = true;
+    }
+    this_thread::sleep_for(milliseconds(10));
+  }
+
+  // the producer creates the region, it may start after us
+  string error;
+  reported = false;
+  while (CheckCurrentState(RUNNING)) {
+    if (fRegion.attach(fRegionName, &error)) {
+      LOG(INFO) << "Receiving the payloads through the shared memory region " << fRegionName << " ("
+                << fRegion.getNumberOfSlots() << " slots of " << fRegion.getSlotSize() << " bytes)";
+      return true;
     }
+    if (!reported) {
+      LOG(WARN) << "Waiting for the shared memory region " << error;
+      reported = true;
+    }
+    this_thread::sleep_for(milliseconds(100));
+  }
+  return false;
+}
 
-    // if offset is 0 - send data out without staggering.
-    if (fSendOffset == 0 && fSTFBuffer.size() > 0) {
-      sendFrontData();
-    } else if (fSTFBuffer.size() > 0) {
-      if (duration_cast<milliseconds>(steady_clock::now() - fArrivalTime.front()).count() >= (fSendDelay * fSendOffset)) {
-        sendFrontData();
-      } else {
-        // LOG(INFO) << "buffering...";
-      }
+void FLPSender::releasePayload(void* data, void* hint)
+{
+  FLPSender* sender = static_cast<FLPSender*>(hint);
+  sender->fRegion.release(data);
+  sender->fRegionMessages--;
+}
+
+void FLPSender::bufferData(FairMQParts&& parts, int direction)
+{
+  // save the arrival time of the message.
+  steady_clock::time_point now = steady_clock::now();
+  if (fSendLatency.count == 0 && fNumBuffered == 0) {
+    fFirstArrival = now;
+  }
+  fArrivalTime[direction].push(now);
+  fSTFBuffer[direction].push(move(parts));
+  fNumBuffered++;
+}
+
+void FLPSender::sendReadyData()
+{
+  if (fNumBuffered == 0) {
+    return;
+  }
+  steady_clock::time_point now = steady_clock::now();
+  for (int direction = 0; direction < fNumEPNs; ++direction) {
+    queue<FairMQParts>& buffer = fSTFBuffer[direction];
+    while (!buffer.empty() &&
+           fPacer->isReady(direction, buffer.front().At(1)->GetSize(), fArrivalTime[direction].front(), now)) {
+      sendFrontData(direction, now);
     }
   }
 }
 
-inline void FLPSender::sendFrontData()
+inline void FLPSender::sendFrontData(int direction, steady_clock::time_point now)
 {
-  f2eHeader header = *(static_cast<f2eHeader*>(fSTFBuffer.front().At(0)->GetData()));
+  FairMQParts& parts = fSTFBuffer[direction].front();
+  f2eHeader header = *(static_cast<f2eHeader*>(parts.At(0)->GetData()));
   uint16_t currentTimeframeId = header.timeFrameId;
+  size_t bytes = parts.At(1)->GetSize();
 
-  // for which EPN is the message?
-  int direction = currentTimeframeId % fNumEPNs;
   // LOG(INFO) << "Sending event " << currentTimeframeId << " to EPN#" << direction << "...";
 
-  if (Send(fSTFBuffer.front(), fOutChannelName, direction, 0) < 0) {
+  if (Send(parts, fOutChannelName, direction, 0) < 0) {
     LOG(ERROR) << "Failed to queue sub-timeframe #" << currentTimeframeId << " to EPN[" << direction << "]";
+  } else {
+    fPacer->onSent(direction, bytes, now);
+    fSendLatency.add(now - fArrivalTime[direction].front());
+    fSentBytes += bytes;
+    fLastSend = now;
+  }
+  fSTFBuffer[direction].pop();
+  fArrivalTime[direction].pop();
+  fNumBuffered--;
+}
+
+void FLPSender::PrintStats() const
+{
+  double seconds = duration<double>(fLastSend - fFirstArrival).count();
+  LOG(INFO) << "Pacing '" << fPacer->getName() << "': " << fSendLatency.count << " sub-timeframes sent, "
+            << fNumBuffered << " still buffered";
+  if (fSendLatency.count > 0 && seconds > 0) {
+    LOG(INFO) << "Throughput: " << fixed << setprecision(1) << fSendLatency.count / seconds << " sub-timeframes/s, "
+              << fSentBytes / seconds / 1e6 << " MB/s";
+    LOG(INFO) << "Buffering latency [us]: mean " << fSendLatency.meanUs() << ", median < "
+              << fSendLatency.quantileUs(0.5) << ", 99% < " << fSendLatency.quantileUs(0.99) << ", max "
+              << fSendLatency.maxUs;
   }
-  fSTFBuffer.pop();
-  fArrivalTime.pop();
 }
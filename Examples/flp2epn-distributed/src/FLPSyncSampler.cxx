@@ -7,6 +7,7 @@
 
 #include <fstream>
 #include <ctime>
+#include <iomanip>
 
 #include "FairMQLogger.h"
 #include "FairMQProgOptions.h"
@@ -23,7 +24,20 @@ FLPSyncSampler::FLPSyncSampler()
   , fMaxEvents(0)
   , fStoreRTTinFile(0)
   , fEventCounter(0)
+  , fDrainTimeoutInMs(0)
+  , fNumPublished(0)
+  , fNumAcknowledged(0)
   , fTimeFrameId(0)
+  , fNumEPNs(0)
+  , fSchedulerName()
+  , fEPNCredits(0)
+  , fCreditTimeoutInMs(1000)
+  , fScheduler()
+  , fSchedulerMutex()
+  , fRTT()
+  , fFirstSent()
+  , fLastAck()
+  , fThrottledTime(0)
   , fAckListener()
   , fResetEventCounter()
   , fLeaving(false)
@@ -43,24 +57,62 @@ void FLPSyncSampler::InitTask()
   // LOG(INFO) << "Done!";
   fEventRate = fConfig->GetValue<int>("event-rate");
   fMaxEvents = fConfig->GetValue<int>("max-events");
+  fDrainTimeoutInMs = fConfig->GetValue<int>("drain-timeout");
   fStoreRTTinFile = fConfig->GetValue<int>("store-rtt-in-file");
+  fNumEPNs = fConfig->GetValue<int>("num-epns");
+  fSchedulerName = fConfig->GetValue<string>("scheduler");
+  fEPNCredits = fConfig->GetValue<int>("epn-credits");
+  fCreditTimeoutInMs = fConfig->GetValue<int>("credit-timeout");
   fAckChannelName = fConfig->GetValue<string>("ack-chan-name");
   fOutChannelName = fConfig->GetValue<string>("out-chan-name");
+
+  fScheduler.reset();
+  if (fNumEPNs > 0) {
+    fScheduler = EPNScheduler::create(fSchedulerName, fNumEPNs, fEPNCredits, fCreditTimeoutInMs);
+    if (!fScheduler) {
+      LOG(ERROR) << "Unknown scheduler '" << fSchedulerName << "', using round-robin";
+      fScheduler = EPNScheduler::create("round-robin", fNumEPNs, fEPNCredits, fCreditTimeoutInMs);
+    }
+  }
 }
 
 void FLPSyncSampler::PreRun()
 {
   fLeaving = false;
+  fRTT = LatencyHistogram();
+  fNumPublished = 0;
+  fNumAcknowledged = 0;
+  fThrottledTime = steady_clock::duration(0);
+  fFirstSent = steady_clock::now();
   fAckListener = thread(&FLPSyncSampler::ListenForAcks, this);
   fResetEventCounter = thread(&FLPSyncSampler::ResetEventCounter, this);
 }
 
 bool FLPSyncSampler::ConditionalRun()
 {
-  FairMQMessagePtr msg(NewSimpleMessage(fTimeFrameId));
+  FairMQMessagePtr msg;
+
+  if (fScheduler) {
+    steady_clock::time_point now = steady_clock::now();
+    int epn = -1;
+    {
+      lock_guard<mutex> lock(fSchedulerMutex);
+      epn = fScheduler->assign(fTimeFrameId, now);
+    }
+    if (epn < 0) {
+      // no credit left, wait for acknowledgements
+      this_thread::sleep_for(microseconds(100));
+      fThrottledTime += steady_clock::now() - now;
+      return true;
+    }
+    msg = NewSimpleMessage(TimeframeAssignment{ fTimeFrameId, static_cast<uint16_t>(epn) });
+  } else {
+    msg = NewSimpleMessage(fTimeFrameId);
+  }
 
   if (fChannels.at(fOutChannelName).at(0).Send(msg) >= 0) {
     fTimeframeRTT[fTimeFrameId].start = steady_clock::now();
+    fNumPublished++;
 
     if (++fTimeFrameId == UINT16_MAX - 1) {
       fTimeFrameId = 0;
@@ -75,6 +127,11 @@ bool FLPSyncSampler::ConditionalRun()
 
   if (fMaxEvents > 0 && fTimeFrameId >= fMaxEvents) {
     LOG(INFO) << "Reached configured maximum number of events (" << fMaxEvents << "). Exiting Run().";
+    // give the timeframes in flight the chance to be acknowledged
+    steady_clock::time_point deadline = steady_clock::now() + milliseconds(fDrainTimeoutInMs);
+    while (fNumAcknowledged < fNumPublished && steady_clock::now() < deadline) {
+      this_thread::sleep_for(milliseconds(1));
+    }
     return false;
   }
 
@@ -86,6 +143,28 @@ void FLPSyncSampler::PostRun()
     fLeaving = true;
     fResetEventCounter.join();
     fAckListener.join();
+    PrintStats();
+}
+
+void FLPSyncSampler::PrintStats() const
+{
+  LOG(INFO) << "Scheduler '" << (fScheduler ? fScheduler->getName() : "flp") << "': " << fNumPublished
+            << " timeframes published, " << fRTT.count << " acknowledged";
+  if (fScheduler) {
+    const EPNScheduler::Stats& stats = fScheduler->getStats();
+    stringstream perEPN;
+    for (int i = 0; i < fNumEPNs; ++i) {
+      perEPN << " " << stats.assignedPerEPN[i];
+    }
+    LOG(INFO) << "Timeframes per EPN:" << perEPN.str() << ", credits reclaimed after timeout: " << stats.reclaimed
+              << ", waited for credits: " << duration_cast<milliseconds>(fThrottledTime).count() << " ms";
+  }
+  double seconds = duration<double>(fLastAck - fFirstSent).count();
+  if (fRTT.count > 0 && seconds > 0) {
+    LOG(INFO) << "Throughput: " << fixed << setprecision(1) << fRTT.count / seconds << " timeframes/s";
+    LOG(INFO) << "Roundtrip time [us]: mean " << fRTT.meanUs() << ", median < " << fRTT.quantileUs(0.5)
+              << ", 99% < " << fRTT.quantileUs(0.99) << ", max " << fRTT.maxUs;
+  }
 }
 
 void FLPSyncSampler::ListenForAcks()
@@ -112,8 +191,15 @@ void FLPSyncSampler::ListenForAcks()
     if (Receive(idMsg, fAckChannelName, 0, 1000) >= 0) {
       id = *(static_cast<uint16_t*>(idMsg->GetData()));
       fTimeframeRTT.at(id).end = steady_clock::now();
+      if (fScheduler) {
+        lock_guard<mutex> lock(fSchedulerMutex);
+        fScheduler->acknowledge(id);
+      }
       // store values in a file
       auto elapsed = duration_cast<microseconds>(fTimeframeRTT.at(id).end - fTimeframeRTT.at(id).start);
+      fRTT.add(elapsed.count());
+      fLastAck = fTimeframeRTT.at(id).end;
+      fNumAcknowledged++;
 
       if (fStoreRTTinFile > 0) {
         ofsFrames << id << "\n";
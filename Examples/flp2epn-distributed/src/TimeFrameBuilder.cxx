@@ -0,0 +1,137 @@
+/**
+ * TimeFrameBuilder.cxx
+ *
+ * @brief Assembly of full timeframes from the sub-timeframes of all FLPs
+ */
+
+#include "FLP2EPNex_distributed/TimeFrameBuilder.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace AliceO2::Devices;
+
+TimeFrameBuilder::TimeFrameBuilder(int numFLPs, int timeoutMs, int capacity)
+  : mNumFLPs(numFLPs)
+  , mTimeoutMs(timeoutMs > 0 ? timeoutMs : 1)
+  , mNumPending(0)
+  , mSlotMask(0)
+  , mWheelMask(0)
+  , mCurrentTick(0)
+  , mEpoch(Clock::now())
+  , mSlots()
+  , mWheel()
+  , mStats()
+{
+  // the ID is 16 bit, more slots would be never used
+  uint32_t nSlots = 1;
+  while (nSlots < uint32_t(capacity) && nSlots < (1u << 16)) {
+    nSlots <<= 1;
+  }
+  mSlotMask = nSlots - 1;
+  mSlots.resize(nSlots);
+  for (Slot& slot : mSlots) {
+    slot.flpMask.resize((mNumFLPs + 63) / 64);
+    slot.parts.resize(mNumFLPs);
+  }
+
+  // one turn of the wheel must be longer than the timeout
+  uint64_t nBuckets = 1;
+  while (nBuckets <= uint64_t(mTimeoutMs) + 1) {
+    nBuckets <<= 1;
+  }
+  mWheelMask = nBuckets - 1;
+  mWheel.assign(nBuckets, -1);
+}
+
+TimeFrameBuilder::Result TimeFrameBuilder::add(uint16_t id, int flpIndex, FairMQMessagePtr&& part,
+                                               Clock::time_point now, FairMQParts& timeframe)
+{
+  if (flpIndex < 0 || flpIndex >= mNumFLPs) {
+    mStats.invalid++;
+    return kInvalid;
+  }
+
+  int32_t idx = id & mSlotMask;
+  Slot& slot = mSlots[idx];
+
+  if (slot.state == Slot::kDiscarded && slot.id == id) {
+    mStats.lateParts++;
+    return kLate;
+  }
+  if (slot.state == Slot::kBuilding && slot.id != id) {
+    // the ring wrapped around while the old timeframe was still incomplete
+    discard(idx);
+    mStats.evicted++;
+  }
+  if (slot.state != Slot::kBuilding) {
+    slot.state = Slot::kBuilding;
+    slot.id = id;
+    slot.received = 0;
+    fill(slot.flpMask.begin(), slot.flpMask.end(), 0);
+    slot.first = now;
+    slot.deadlineTick = max(tick(now), mCurrentTick) + mTimeoutMs;
+    link(idx);
+    mNumPending++;
+  }
+
+  uint64_t& word = slot.flpMask[flpIndex / 64];
+  uint64_t bit = uint64_t(1) << (flpIndex % 64);
+  if (word & bit) {
+    mStats.duplicates++;
+    return kDuplicate;
+  }
+  word |= bit;
+  slot.parts[flpIndex] = move(part);
+
+  if (++slot.received < mNumFLPs) {
+    return kAdded;
+  }
+
+  for (auto& p : slot.parts) {
+    timeframe.AddPart(move(p));
+  }
+  mStats.latency.add(now - slot.first);
+  mStats.completed++;
+
+  unlink(idx);
+  slot.state = Slot::kFree;
+  mNumPending--;
+  return kCompleted;
+}
+
+void TimeFrameBuilder::link(int32_t idx)
+{
+  Slot& slot = mSlots[idx];
+  int32_t& head = mWheel[slot.deadlineTick & mWheelMask];
+  slot.prev = -1;
+  slot.next = head;
+  if (head >= 0) {
+    mSlots[head].prev = idx;
+  }
+  head = idx;
+}
+
+void TimeFrameBuilder::unlink(int32_t idx)
+{
+  Slot& slot = mSlots[idx];
+  if (slot.prev >= 0) {
+    mSlots[slot.prev].next = slot.next;
+  } else {
+    mWheel[slot.deadlineTick & mWheelMask] = slot.next;
+  }
+  if (slot.next >= 0) {
+    mSlots[slot.next].prev = slot.prev;
+  }
+  slot.prev = slot.next = -1;
+}
+
+void TimeFrameBuilder::discard(int32_t idx)
+{
+  Slot& slot = mSlots[idx];
+  unlink(idx);
+  for (auto& p : slot.parts) {
+    p.reset();
+  }
+  slot.state = Slot::kDiscarded;
+  mNumPending--;
+}
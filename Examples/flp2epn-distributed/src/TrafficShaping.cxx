@@ -0,0 +1,156 @@
+/**
+ * TrafficShaping.cxx
+ *
+ * @brief Scheduling policies for the distribution of the sub-timeframes to the EPNs
+ */
+
+#include <algorithm>
+
+#include "FLP2EPNex_distributed/TrafficShaping.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace AliceO2::Devices;
+
+unique_ptr<SendPacer> SendPacer::create(const string& name, int numEPNs, unsigned int sendOffset,
+                                        unsigned int sendDelay, double rate, double burst)
+{
+  if (name == "staggered") {
+    return unique_ptr<SendPacer>(new StaggeredPacer(sendOffset, sendDelay));
+  }
+  if (name == "token-bucket") {
+    return unique_ptr<SendPacer>(new TokenBucketPacer(numEPNs, rate, burst));
+  }
+  return nullptr;
+}
+
+StaggeredPacer::StaggeredPacer(unsigned int sendOffset, unsigned int sendDelay)
+  : mDelay(milliseconds(sendOffset * sendDelay))
+{
+}
+
+bool StaggeredPacer::isReady(int /*epn*/, size_t /*bytes*/, Clock::time_point arrival, Clock::time_point now)
+{
+  return now - arrival >= mDelay;
+}
+
+TokenBucketPacer::TokenBucketPacer(int numEPNs, double rate, double burst)
+  : mRate(rate)
+  , mBurst(burst)
+  , mBuckets(numEPNs, Bucket{ burst, Clock::now() })
+{
+}
+
+void TokenBucketPacer::refill(Bucket& bucket, Clock::time_point now) const
+{
+  double elapsed = duration<double>(now - bucket.refilled).count();
+  if (elapsed > 0) {
+    bucket.tokens = min(mBurst, bucket.tokens + elapsed * mRate);
+    bucket.refilled = now;
+  }
+}
+
+bool TokenBucketPacer::isReady(int epn, size_t bytes, Clock::time_point /*arrival*/, Clock::time_point now)
+{
+  Bucket& bucket = mBuckets[epn];
+  refill(bucket, now);
+  return bucket.tokens >= min(double(bytes), mBurst);
+}
+
+void TokenBucketPacer::onSent(int epn, size_t bytes, Clock::time_point /*now*/)
+{
+  mBuckets[epn].tokens -= bytes;
+}
+
+unique_ptr<EPNScheduler> EPNScheduler::create(const string& name, int numEPNs, int credits, int creditTimeoutMs)
+{
+  if (name == "round-robin") {
+    return unique_ptr<EPNScheduler>(new RoundRobinScheduler(numEPNs, credits, creditTimeoutMs));
+  }
+  if (name == "least-loaded") {
+    return unique_ptr<EPNScheduler>(new LeastLoadedScheduler(numEPNs, credits, creditTimeoutMs));
+  }
+  return nullptr;
+}
+
+EPNScheduler::EPNScheduler(int numEPNs, int credits, int creditTimeoutMs)
+  : mCredits(credits)
+  , mCreditTimeout(milliseconds(creditTimeoutMs))
+  , mOutstanding(numEPNs, 0)
+  , mEPNOfId(UINT16_MAX + 1, -1)
+  , mDeadlineOfId(UINT16_MAX + 1)
+  , mPending()
+  , mStats()
+{
+  mStats.assignedPerEPN.resize(numEPNs, 0);
+}
+
+int EPNScheduler::assign(uint16_t id, Clock::time_point now)
+{
+  reclaim(now);
+
+  int epn = select(id);
+  if (!hasCredit(epn)) {
+    mStats.throttled++;
+    return -1;
+  }
+
+  // the ID wrapped around while the previous timeframe with it was still unacknowledged
+  if (mEPNOfId[id] >= 0) {
+    mOutstanding[mEPNOfId[id]]--;
+    mStats.reclaimed++;
+  }
+  mEPNOfId[id] = epn;
+  mDeadlineOfId[id] = now + mCreditTimeout;
+  mOutstanding[epn]++;
+  mPending.push_back(Assignment{ id, mDeadlineOfId[id] });
+  mStats.assigned++;
+  mStats.assignedPerEPN[epn]++;
+  return epn;
+}
+
+void EPNScheduler::acknowledge(uint16_t id)
+{
+  int epn = mEPNOfId[id];
+  if (epn < 0) {
+    // already reclaimed
+    return;
+  }
+  mEPNOfId[id] = -1;
+  mOutstanding[epn]--;
+  mStats.acknowledged++;
+}
+
+void EPNScheduler::reclaim(Clock::time_point now)
+{
+  // acknowledged timeframes stay in the queue until their deadline, then they are skipped,
+  // as well as the entries of the IDs which were reassigned in the meantime
+  while (!mPending.empty() && mPending.front().deadline <= now) {
+    Assignment entry = mPending.front();
+    uint16_t id = entry.id;
+    mPending.pop_front();
+    if (mEPNOfId[id] >= 0 && mDeadlineOfId[id] == entry.deadline) {
+      mOutstanding[mEPNOfId[id]]--;
+      mEPNOfId[id] = -1;
+      mStats.reclaimed++;
+    }
+  }
+}
+
+int RoundRobinScheduler::select(uint16_t id) const
+{
+  return id % getNumberOfEPNs();
+}
+
+int LeastLoadedScheduler::select(uint16_t id) const
+{
+  int numEPNs = getNumberOfEPNs();
+  int best = id % numEPNs;
+  for (int i = 1; i < numEPNs; ++i) {
+    int epn = (id + i) % numEPNs;
+    if (getOutstanding(epn) < getOutstanding(best)) {
+      best = epn;
+    }
+  }
+  return best;
+}
@@ -8,8 +8,14 @@
 #ifndef O2FLPEX_H_
 #define O2FLPEX_H_
 
+#include <string>
+
 #include "FairMQDevice.h"
+#include "O2Device/SharedMemoryRegion.h"
 
+/// Generates random payloads. With a shared memory region configured, every payload
+/// is written once into a slot of the region and only its descriptor is sent,
+/// the consumer on the same node releases the slot when done with the payload.
 class O2FLPex : public FairMQDevice
 {
   public:
@@ -19,6 +25,12 @@ class O2FLPex : public FairMQDevice
 
   protected:
     int fNumContent;
+    std::string fRegionName; ///< Name of the shared memory region, empty to send the payloads in the messages
+    int fNumRegionSlots; ///< Number of payloads which can be in flight in the region
+    AliceO2::Base::SharedMemoryRegion fRegion;
+
+    /// Fills the payload with random content
+    void fillPayload(void* buffer) const;
 
     virtual void InitTask();
     virtual bool ConditionalRun();
@@ -5,7 +5,8 @@
  * @author D. Klein, A. Rybalchenko, M.Al-Turany
  */
 
-#include <vector>
+#include <thread>
+#include <chrono>
 #include <stdlib.h>     /* srand, rand */
 #include <time.h>       /* time */
 
@@ -14,8 +15,13 @@
 #include "flp2epn/O2FLPex.h"
 #include "O2FLPExContent.h"
 
+using AliceO2::Base::RegionDescriptor;
+
 O2FLPex::O2FLPex() :
-  fNumContent(10000)
+  fNumContent(10000),
+  fRegionName(),
+  fNumRegionSlots(32),
+  fRegion()
 {
 }
 
@@ -29,23 +35,55 @@ void O2FLPex::InitTask()
 
   fNumContent = fConfig->GetValue<int>("num-content");
   LOG(INFO) << "Message size (num-content * sizeof(O2FLPExContent)): " << fNumContent * sizeof(O2FLPExContent) << " bytes.";
+
+  fRegionName = fConfig->GetValue<std::string>("shm-region");
+  fNumRegionSlots = fConfig->GetValue<int>("shm-slots");
+  if (!fRegionName.empty()) {
+    std::string error;
+    if (fRegion.create(fRegionName, fNumContent * sizeof(O2FLPExContent), fNumRegionSlots, &error)) {
+      LOG(INFO) << "Payloads are passed in the shared memory region " << fRegionName << " (" << fNumRegionSlots << " slots).";
+    } else {
+      LOG(ERROR) << "Could not create the shared memory region " << error << ", sending the payloads in the messages.";
+    }
+  }
 }
 
-bool O2FLPex::ConditionalRun()
+void O2FLPex::fillPayload(void* buffer) const
 {
-  std::vector<O2FLPExContent> payload(fNumContent);
+  O2FLPExContent* payload = static_cast<O2FLPExContent*>(buffer);
 
   for (int i = 0; i < fNumContent; ++i) {
-    payload.at(i).x = rand() % 100 + 1;
-    payload.at(i).y = rand() % 100 + 1;
-    payload.at(i).z = rand() % 100 + 1;
-    payload.at(i).a = (rand() % 100 + 1) / (rand() % 100 + 1);
-    payload.at(i).b = (rand() % 100 + 1) / (rand() % 100 + 1);
+    payload[i].x = rand() % 100 + 1;
+    payload[i].y = rand() % 100 + 1;
+    payload[i].z = rand() % 100 + 1;
+    payload[i].a = (rand() % 100 + 1) / (rand() % 100 + 1);
+    payload[i].b = (rand() % 100 + 1) / (rand() % 100 + 1);
     // LOG(INFO) << (&payload[i])->x << " " << (&payload[i])->y << " " << (&payload[i])->z << " " << (&payload[i])->a << " " << (&payload[i])->b;
   }
+}
+
+bool O2FLPex::ConditionalRun()
+{
+  if (fRegion.isOpen()) {
+    int slot = fRegion.acquire();
+    if (slot < 0) {
+      // all payloads are still in use by the consumer, wait for the releases
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      return true;
+    }
+    // the payload is written once into the region, only its location is sent
+    fillPayload(fRegion.getSlot(slot));
+    RegionDescriptor descriptor = fRegion.describe(slot, fNumContent * sizeof(O2FLPExContent));
+    FairMQMessagePtr msg(NewSimpleMessage(descriptor));
+    if (fChannels.at("data").at(0).Send(msg) < 0) {
+      fRegion.release(descriptor);
+    }
+    return true;
+  }
 
+  // fill the message directly, without an intermediate buffer
   FairMQMessagePtr msg(NewMessage(fNumContent * sizeof(O2FLPExContent)));
-  memcpy(msg->GetData(), payload.data(), fNumContent * sizeof(O2FLPExContent));
+  fillPayload(msg->GetData());
 
   fChannels.at("data").at(0).Send(msg);
 
@@ -6,7 +6,9 @@ namespace bpo = boost::program_options;
 void addCustomOptions(bpo::options_description& options)
 {
   options.add_options()
-    ("num-content", bpo::value<int>()->default_value(1000), "Number of data entries in one message");
+    ("num-content", bpo::value<int>()->default_value(1000), "Number of data entries in one message")
+    ("shm-region", bpo::value<std::string>()->default_value(""), "Name of the shared memory region for the payloads (empty - payloads in the messages)")
+    ("shm-slots", bpo::value<int>()->default_value(32), "Number of payload slots in the shared memory region");
 }
 
 FairMQDevice* getDevice(const FairMQProgOptions& config)
@@ -21,6 +21,7 @@
 
 #include <cstdint>
 #include <cerrno>
+#include <iostream>
 
 namespace AliceO2 {
 
@@ -40,9 +41,15 @@ template<
   >
 class DataDeflater {
  public:
-  DataDeflater() : mBegin(nullptr), mEnd(nullptr), mCurrent(mEnd), mBitPosition(0), mCodec() {}
+  DataDeflater() : mBegin(nullptr), mWriter(), mCodec() {}
+  DataDeflater(const Codec& codec) : mBegin(nullptr), mWriter(), mCodec(codec) {}
   ~DataDeflater() {}
 
+  /// the bits are collected in a 64 bit accumulator and written to the
+  /// target in chunks of 32 bit
+  static_assert(sizeof(_TargetType) <= 4, "target type must not be wider than 32 bit");
+  static constexpr unsigned kTargetBits = 8 * sizeof(_TargetType);
+
   /**
    * Init target
    * TODO: think about other targets than a buffer
@@ -50,24 +57,22 @@ class DataDeflater {
   int Init(_TargetType* buffer, int size) {
     // check if no active buffer according to error policy
     mBegin = buffer;
-    mEnd = mBegin + size;
-    mCurrent = mBegin;
-    mBitPosition = 0;
+    mWriter = BitWriter(buffer, buffer + size);
+    return 0;
   }
 
   /**
    * Flush and close, invalidate output target
    *
-   * @return Number of written elements
+   * @return Number of written elements, or -ENOSPC if bits were lost
+   *         because the target was full
    */
   int Close() {
-    if (mBitPosition > 0) mCurrent++;
-    int nElements = mCurrent - mBegin;
+    int64_t result = Align();
+    int nElements = mWriter.mCurrent - mBegin;
     mBegin = nullptr;
-    mEnd = mBegin;
-    mCurrent = mEnd;
-    mBitPosition = 0;
-    return nElements;
+    mWriter = BitWriter();
+    return result < 0 ? result : nElements;
   }
 
   /**
@@ -81,77 +86,162 @@ class DataDeflater {
    */
   template <typename ValueType>
   int WriteRaw(ValueType value, uint16_t bitlength) {
-    uint16_t bitsWritten = 0;
     if (bitlength > 8*sizeof(ValueType)) {
       // TODO: error policy
       bitlength = 8*sizeof(ValueType);
     }
-    while (bitsWritten < bitlength) {
-      if (mCurrent == mEnd) {
-        //break; // depending on error policy
-        return -ENOSPC;
-      }
-      _TargetType& current = *mCurrent;
-      // write at max what is left to be written
-      uint16_t writeNow = bitlength - bitsWritten;
-      ValueType mask = 1<<(writeNow); mask -= 1;
-      // write one element of the target buffer at a time
-      if (writeNow > 8*sizeof(_TargetType)) writeNow = 8*sizeof(_TargetType);
-      // write the remaining space in the current element
-      uint16_t capacity=8*sizeof(_TargetType)-mBitPosition;
-      if (writeNow > capacity) writeNow = capacity;
-      ValueType activebits=(value&mask)>>(bitlength-bitsWritten-writeNow);
-      activebits<<(capacity-writeNow);
-      mBitPosition+=writeNow;
-      bitsWritten+=writeNow;
-      if (mBitPosition==8*sizeof(_TargetType)) {
-        mBitPosition=0;
-        mCurrent++;
-      } // pedantic check: should never exceed the taget type size
-    }
-    return bitsWritten;
+    if (bitlength == 0) return 0;
+    uint64_t bits = static_cast<uint64_t>(value) & (~uint64_t(0) >> (64 - bitlength));
+    return mWriter.writeCode(bits, bitlength);
   }
 
   int WriteRaw(bool bit) {
     return WriteRaw(bit, 1);
   }
 
+  /**
+   * Write the code in the LSBs of the value, the bits above the code length
+   * have to be zero
+   * @return code length, or -ENOSPC if the target is full
+   */
+  int WriteCode(uint64_t code, uint16_t codeLength) {
+    return mWriter.writeCode(code, codeLength);
+  }
+
   template <typename T>
   int Write(T value) {
     return mCodec.Write(value, _RegType(0),
-                         [this] (_RegType value, uint16_t bitlength) -> int {return this->WriteRaw(value, bitlength);}
-                         );
+                        [this] (uint64_t code, uint16_t codeLength) -> int {return this->mWriter.writeCode(code, codeLength);}
+                        );
+  }
+
+  /**
+   * Encode and write a number of values
+   * @return number of written bits, or -ENOSPC if the target is full;
+   *         a block codec only writes when the output is aligned
+   */
+  template <typename T>
+  int64_t Encode(const T* values, size_t nValues) {
+    // the writer state is kept in a local copy during the loop, the
+    // compiler can keep it in registers as the writes to the target
+    // can not alias with it
+    BitWriter writer = mWriter;
+    int64_t nBits = 0;
+    for (const T* value = values; value != values + nValues; ++value) {
+      int result = mCodec.Write(*value, _RegType(0),
+                                [&writer] (uint64_t code, uint16_t codeLength) -> int {return writer.writeCode(code, codeLength);}
+                                );
+      if (result < 0) {
+        nBits = result;
+        break;
+      }
+      nBits += result;
+    }
+    mWriter = writer;
+    return nBits;
   }
 
   /**
    * Align bit output
-   * @return number of forward bits
+   * A codec encoding blocks of values (e.g. rANS) writes the pending block,
+   * which starts at the aligned position.
+   * @return number of forward bits plus the bits of the block, or -ENOSPC
+   *         if the pending bits or the block do not fit
    */
-  int Align() {
-    if (mBitPosition == 0 || mCurrent == mEnd) return 0;
-    int nforward = sizeof(_TargetType) - mBitPosition;
-    mBitPosition = 0;
-    mCurrent++;
-    return nforward;
+  int64_t Align() {
+    if (mWriter.mFull) return -ENOSPC;
+    unsigned partial = mWriter.mAccumulatorBits % kTargetBits;
+    int nforward = partial > 0 ? kTargetBits - partial : 0;
+    mWriter.mAccumulatorBits += nforward;
+    mWriter.flushWords();
+    int64_t result = mCodec.Flush([this] (uint64_t code, uint16_t codeLength) -> int {return this->mWriter.writeCode(code, codeLength);});
+    mWriter.flushWords();
+    if (mWriter.mAccumulatorBits > 0) {
+      // complete words which did not fit anymore
+      mWriter.mFull = true;
+      return -ENOSPC;
+    }
+    return result < 0 ? -ENOSPC : nforward + result;
   }
 
   void print() {
-    int bufferSize = mEnd - mBegin;
-    int filledSize = mCurrent - mBegin;
-    std::cout << "DataDeflater: " << bufferSize << " elements of bit width " << 8*sizeof(_TargetType) << std::endl;
+    int bufferSize = mWriter.mEnd - mBegin;
+    int filledSize = mWriter.mCurrent - mBegin;
+    std::cout << "DataDeflater: " << bufferSize << " elements of bit width " << kTargetBits << std::endl;
     if (bufferSize > 0)
-      std::cout << "    position: " << filledSize << " (bit " << mBitPosition << ")" << std::endl;
+      std::cout << "    position: " << filledSize << " (" << mWriter.mAccumulatorBits << " bit(s) pending)" << std::endl;
   }
 
  private:
+  /**
+   * The write position and the bits not yet written to the target
+   */
+  struct BitWriter {
+    /// current target position
+    _TargetType* mCurrent;
+    /// end of write target: pointer to just after target
+    _TargetType* mEnd;
+    /// bits not yet written to the target, aligned to the MSB
+    uint64_t     mAccumulator;
+    /// number of bits in the accumulator
+    unsigned     mAccumulatorBits;
+    /// bits were lost at the end of the target, all further writes fail
+    bool         mFull;
+
+    BitWriter(_TargetType* current = nullptr, _TargetType* end = nullptr)
+      : mCurrent(current), mEnd(end), mAccumulator(0), mAccumulatorBits(0), mFull(false) {}
+
+    int writeCode(uint64_t code, uint16_t codeLength) {
+      if (codeLength > 32) {
+        // two steps for long codes to keep the accumulator from overflowing
+        if (writeBits(code >> 32, codeLength - 32) < 0 || writeBits(code & 0xffffffff, 32) < 0) return -ENOSPC;
+        return codeLength;
+      }
+      return writeBits(code, codeLength);
+    }
+
+    /// add up to 32 bits to the accumulator, flush as soon as it holds 32 bits
+    int writeBits(uint64_t bits, uint16_t bitlength) {
+      // the accumulator keeps less than 32 bits, unless the target is full
+      if (mFull) return -ENOSPC;
+      // two shifts, none of them by 64
+      mAccumulator |= (bits << (32 - bitlength)) << (32 - mAccumulatorBits);
+      mAccumulatorBits += bitlength;
+      if (mAccumulatorBits >= 32) {
+        constexpr int nWords = 32 / kTargetBits;
+        if (mEnd - mCurrent >= nWords) {
+          for (int i = 0; i < nWords; i++) {
+            mCurrent[i] = static_cast<_TargetType>(mAccumulator >> (64 - kTargetBits * (i + 1)));
+          }
+          mCurrent += nWords;
+          mAccumulator <<= 32;
+          mAccumulatorBits -= 32;
+        } else {
+          // end of the target, the words which still fit
+          flushWords();
+          if (mAccumulatorBits >= 32) {
+            mFull = true;
+            return -ENOSPC;
+          }
+        }
+      }
+      return bitlength;
+    }
+
+    /// write all complete target words from the accumulator
+    void flushWords() {
+      while (mAccumulatorBits >= kTargetBits && mCurrent != mEnd) {
+        *mCurrent++ = static_cast<_TargetType>(mAccumulator >> (64 - kTargetBits));
+        mAccumulator <<= kTargetBits;
+        mAccumulatorBits -= kTargetBits;
+      }
+    }
+  };
+
   /// start of write target
   _TargetType* mBegin;
-  /// end of write target: pointer to just after target
-  _TargetType* mEnd;
-  /// current target position
-  _TargetType* mCurrent;
-  /// current bit position
-  int           mBitPosition;
+  /// write position and pending bits
+  BitWriter     mWriter;
   /// codec instance
   Codec         mCodec;
 
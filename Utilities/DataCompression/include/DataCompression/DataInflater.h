@@ -0,0 +1,280 @@
+//-*- Mode: C++ -*-
+
+#ifndef DATAINFLATER_H
+#define DATAINFLATER_H
+//****************************************************************************
+//* This file is free software: you can redistribute it and/or modify        *
+//* it under the terms of the GNU General Public License as published by     *
+//* the Free Software Foundation, either version 3 of the License, or        *
+//* (at your option) any later version.                                      *
+//*                                                                          *
+//* Primary Authors: Matthias Richter <richterm@scieq.net>                   *
+//*                                                                          *
+//* The authors make no claims about the suitability of this software for    *
+//* any purpose. It is provided "as is" without express or implied warranty. *
+//****************************************************************************
+
+//  @file   DataInflater.h
+//  @since  2016-12-22
+//  @brief  Bit stream reader, the counterpart of the DataDeflater
+
+#include <cstdint>
+#include <cerrno>
+#include <cstring> // memcpy
+#include <cstddef>
+#include <iostream>
+
+namespace AliceO2 {
+
+/**
+ * @class BitReader
+ * @brief Reads a bit stream through a 64 bit register
+ *
+ * The stream consists of words of _SourceType, which are read MSB to LSB
+ * like the DataDeflater writes them. The register is refilled with one 64 bit
+ * load of whole words, after refill it holds at least kMinValidBits bits.
+ * Peek and consume are plain shifts without branches, the only branch of the
+ * refill is the check for the end of the buffer. Beyond the end, the register
+ * is padded with zeros; the padding is taken into account in the position and
+ * a read beyond the end is indicated by overrun().
+ *
+ * Decoders work on a local copy of the reader in their loops, which the
+ * compiler can keep in registers, and assign it back when done.
+ */
+template<typename _SourceType>
+class BitReader {
+ public:
+  static_assert(sizeof(_SourceType) <= 4, "source type must not be wider than 32 bit");
+  static constexpr unsigned kSourceBits = 8 * sizeof(_SourceType);
+  /// valid bits in the register after refill
+  static constexpr unsigned kMinValidBits = 64 - kSourceBits;
+
+  BitReader(const _SourceType* buffer = nullptr, size_t size = 0)
+    : mBegin(buffer), mCurrent(buffer), mEnd(buffer + size), mBits(0), mNBits(0), mPadding(0) {}
+
+  /// fill the register to at least kMinValidBits bits
+  void refill() {
+    if (mEnd - mCurrent >= kWordsPerLoad) {
+      mBits |= load64(mCurrent) >> mNBits;
+      // whole words only, the register never holds 64 bits
+      unsigned nWords = (63 - mNBits) / kSourceBits;
+      mCurrent += nWords;
+      mNBits += nWords * kSourceBits;
+    } else {
+      refillTail();
+    }
+  }
+
+  /// the next n bits in the LSBs, n must not exceed the valid bits
+  uint64_t peek(unsigned n) const {
+    // two shifts, n = 0 gives 0
+    return (mBits >> 1) >> (63 - n);
+  }
+
+  void consume(unsigned n) {
+    mBits <<= n;
+    mNBits -= n;
+  }
+
+  /// refill, peek and consume n <= kMinValidBits bits
+  uint64_t read(unsigned n) {
+    refill();
+    uint64_t value = peek(n);
+    consume(n);
+    return value;
+  }
+
+  /// number of valid bits in the register
+  unsigned available() const {return mNBits;}
+
+  /// number of consumed bits since the beginning of the buffer
+  size_t position() const {
+    return (mCurrent - mBegin) * kSourceBits + mPadding - mNBits;
+  }
+
+  /// true if more bits have been consumed than the buffer holds
+  bool overrun() const {
+    return position() > static_cast<size_t>(mEnd - mBegin) * kSourceBits;
+  }
+
+  /// skip to the next boundary of a source word, the counterpart of
+  /// DataDeflater::Align
+  /// @return number of skipped bits
+  unsigned align() {
+    unsigned partial = position() % kSourceBits;
+    unsigned nSkip = partial > 0 ? kSourceBits - partial : 0;
+    refill();
+    consume(nSkip);
+    return nSkip;
+  }
+
+ private:
+  static constexpr ptrdiff_t kWordsPerLoad = 8 / sizeof(_SourceType);
+
+  /// 8 bytes from the position as MSB to LSB bit stream
+  static uint64_t load64(const _SourceType* source) {
+    uint64_t value = 0;
+    if (sizeof(_SourceType) == 1) {
+      memcpy(&value, source, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      value = __builtin_bswap64(value);
+#endif
+    } else {
+      for (ptrdiff_t i = 0; i < kWordsPerLoad; i++) {
+        value = (value << (kSourceBits - 1)) << 1;
+        value |= source[i];
+      }
+    }
+    return value;
+  }
+
+  /// word by word at the end of the buffer, zeros after the end
+  void refillTail() {
+    for (; mNBits < kMinValidBits && mCurrent < mEnd; mNBits += kSourceBits) {
+      mBits |= uint64_t(*mCurrent++) << (64 - kSourceBits - mNBits);
+    }
+    if (mNBits < kMinValidBits) {
+      mPadding += kMinValidBits - mNBits;
+      mNBits = kMinValidBits;
+    }
+  }
+
+  /// beginning of the buffer
+  const _SourceType* mBegin;
+  /// next word to be loaded into the register
+  const _SourceType* mCurrent;
+  /// end of the buffer: pointer to just after the buffer
+  const _SourceType* mEnd;
+  /// valid bits aligned to the MSB
+  uint64_t mBits;
+  /// number of valid bits
+  unsigned mNBits;
+  /// number of zero bits added after the end of the buffer
+  size_t mPadding;
+};
+
+/**
+ * @class DataInflater
+ * @brief Reads raw bits and decodes values from a buffer written by the
+ * DataDeflater
+ *
+ * The codec decodes from the BitReader by a method
+ *   int64_t Decode(BitReader<_SourceType>& reader, value_type* target, size_t nValues)
+ * returning the number of consumed bits. A codec encoding blocks of values
+ * (e.g. rANS) reads the block from the aligned position, where the
+ * DataDeflater has written it when aligning the output.
+ */
+template<
+  typename _SourceType,
+  class Codec
+  >
+class DataInflater {
+ public:
+  typedef BitReader<_SourceType> reader_type;
+  static constexpr unsigned kSourceBits = reader_type::kSourceBits;
+
+  DataInflater(const Codec& codec) : mBegin(nullptr), mReader(), mCodec(codec) {}
+  ~DataInflater() {}
+
+  /**
+   * Init source
+   */
+  int Init(const _SourceType* buffer, int size) {
+    mBegin = buffer;
+    mReader = reader_type(buffer, size);
+    return 0;
+  }
+
+  /**
+   * Align and close, invalidate the source
+   *
+   * @return Number of read elements, or -ENODATA if the stream was shorter
+   *         than the reads
+   */
+  int Close() {
+    Align();
+    int nElements = mReader.overrun() ? -ENODATA : mReader.position() / kSourceBits;
+    mBegin = nullptr;
+    mReader = reader_type();
+    return nElements;
+  }
+
+  /**
+   * Read number of bits into the LSBs of the value
+   * @return bitlength, or -ENODATA if the stream is exhausted
+   */
+  template <typename ValueType>
+  int ReadRaw(ValueType& value, uint16_t bitlength) {
+    if (bitlength > 8*sizeof(ValueType)) {
+      bitlength = 8*sizeof(ValueType);
+    }
+    uint64_t bits = 0;
+    unsigned remaining = bitlength;
+    while (remaining > 0) {
+      unsigned n = remaining < 32 ? remaining : 32;
+      bits = (bits << n) | mReader.read(n);
+      remaining -= n;
+    }
+    if (mReader.overrun()) return -ENODATA;
+    value = static_cast<ValueType>(bits);
+    return bitlength;
+  }
+
+  /**
+   * The next bits of the stream without consuming them,
+   * nBits must not exceed BitReader::kMinValidBits
+   */
+  uint64_t Peek(unsigned nBits) {
+    mReader.refill();
+    return mReader.peek(nBits);
+  }
+
+  /**
+   * Consume bits of the stream, the counterpart of Peek
+   */
+  void Consume(unsigned nBits) {
+    mReader.refill();
+    mReader.consume(nBits);
+  }
+
+  /**
+   * Decode a number of values with the codec
+   * @return number of consumed bits, or -ENODATA if the stream is exhausted
+   */
+  template <typename T>
+  int64_t Decode(T* target, size_t nValues) {
+    int64_t nBits = mCodec.Decode(mReader, target, nValues);
+    return mReader.overrun() ? -ENODATA : nBits;
+  }
+
+  /**
+   * Align bit input to the next source word, as written by
+   * DataDeflater::Align
+   * @return number of skipped bits
+   */
+  int Align() {
+    return mReader.align();
+  }
+
+  /// number of consumed bits
+  size_t GetPosition() const {return mReader.position();}
+
+  void print() {
+    std::cout << "DataInflater: position " << mReader.position() << " bit(s), "
+              << mReader.available() << " bit(s) in register" << std::endl;
+  }
+
+ private:
+  DataInflater(); //forbidden
+
+  /// start of read source
+  const _SourceType* mBegin;
+  /// read position and register
+  reader_type mReader;
+  /// codec instance
+  Codec mCodec;
+};
+
+}; // namespace AliceO2
+
+#endif
@@ -21,15 +21,19 @@
 
 #include <cstdint>
 #include <cerrno>
+#include <cstring> // memcpy
+#include <bitset>
 #include <set>
 #include <map>
 #include <vector>
+#include <algorithm> // std::sort
 #include <memory>
 #include <exception>
 #include <stdexcept>
 #include <iostream>
 #include <iomanip>
 #include <sstream> // stringstream in configuration parsing
+#include "DataCompression/DataInflater.h"
 
 namespace AliceO2 {
 
@@ -110,6 +114,278 @@ private:
   uint16_t mCodeLen;
 };
 
+/**
+ * @class HuffmanEncodingTable
+ * @brief Flat array of the codes indexed by the symbol index
+ *
+ * Every entry packs code and code length into one 64 bit word, the code in
+ * the upper bits and the length in the lowest 8 bits, so encoding a value is
+ * one array access instead of going through the leave nodes.
+ */
+template<typename _CodingModel>
+class HuffmanEncodingTable {
+public:
+  typedef typename _CodingModel::value_type value_type;
+  typedef typename _CodingModel::alphabet_type alphabet_type;
+
+  static constexpr unsigned kMaxCodeLength = 56;
+
+  HuffmanEncodingTable() : mEntries() {}
+  ~HuffmanEncodingTable() {}
+
+  bool isValid() const {return !mEntries.empty();}
+
+  /**
+   * Fill the array from the codes of the model, the table stays invalid if
+   * a code exceeds the maximum length
+   */
+  void init(const _CodingModel& model) {
+    std::vector<uint64_t> entries;
+    bool valid = true;
+    model.forEachCode([&entries, &valid](int index, uint64_t code, uint16_t codeLength) {
+        if (codeLength > kMaxCodeLength) valid = false;
+        if (entries.size() <= static_cast<unsigned>(index)) entries.resize(index + 1, kMissing);
+        entries[index] = code << 8 | codeLength;
+      });
+    if (valid) mEntries.swap(entries);
+    else mEntries.clear();
+  }
+
+  /// packed code of the value
+  uint64_t lookup(value_type v) const {
+    unsigned index = alphabet_type::getIndex(v);
+    if (index >= mEntries.size() || mEntries[index] == kMissing) {
+      throwLookupError(v);
+    }
+    return mEntries[index];
+  }
+
+  static uint64_t code(uint64_t entry) {return entry >> 8;}
+  static uint16_t length(uint64_t entry) {return entry & 0xff;}
+
+private:
+  /// entry of the symbols without code
+  static constexpr uint64_t kMissing = ~uint64_t(0);
+
+  __attribute__((noinline, cold)) void throwLookupError(value_type v) const {
+    if (mEntries.empty()) {
+      throw std::logic_error("code table not available, code length exceeds the limit");
+    }
+    std::stringstream msg;
+    msg << "symbol " << v << " not found in the code table";
+    throw std::range_error(msg.str());
+  }
+
+  std::vector<uint64_t> mEntries;
+};
+
+template<typename _CodingModel>
+constexpr uint64_t HuffmanEncodingTable<_CodingModel>::kMissing;
+
+/**
+ * @class HuffmanDecodingTable
+ * @brief Multi-level lookup tables for decoding a Huffman code from a bit stream
+ *
+ * The primary table is indexed by the next _primaryBits bits of the stream.
+ * An entry either holds the symbol(s) of the code(s) starting with these bits
+ * together with the number of bits to consume, or links to a secondary table
+ * for the longer codes sharing the bits as prefix, indexed by the following
+ * bits, and so forth. Where the bits of a primary entry contain two complete
+ * codes, both symbols are stored in the entry and decoded with one lookup.
+ *
+ * The tables are built from the codes of the leave nodes and work for any
+ * complete prefix code, canonical codes only keep the tables compact. The bit
+ * stream is read MSB to LSB from the words of the buffer, so the codes have
+ * to be in MSB to LSB order.
+ */
+template<typename _CodingModel, unsigned _primaryBits = 11>
+class HuffmanDecodingTable {
+public:
+  typedef typename _CodingModel::value_type value_type;
+  typedef typename _CodingModel::alphabet_type alphabet_type;
+
+  /// codes are aligned to the MSB of a 64 bit word when building the tables
+  static constexpr unsigned kMaxCodeLength = 56;
+
+  HuffmanDecodingTable() : mEntries() {}
+  ~HuffmanDecodingTable() {}
+
+  bool isValid() const {return !mEntries.empty();}
+
+  /**
+   * Build the tables from the codes of the model
+   */
+  void init(const _CodingModel& model) {
+    if (!_CodingModel::orderMSB) {
+      throw std::logic_error("decoding tables require codes in MSB to LSB order");
+    }
+    std::vector<CodeDefinition> codes;
+    model.forEachCode([&codes](int index, uint64_t code, uint16_t codeLength) {
+        if (codeLength > kMaxCodeLength) {
+          throw std::range_error("Huffman code length exceeds the limit of the decoding table");
+        }
+        // align the code to the MSB of the register
+        codes.push_back(CodeDefinition{codeLength > 0 ? code << (64 - codeLength) : 0, codeLength, static_cast<uint32_t>(index)});
+      });
+    mEntries.assign(1 << _primaryBits, Entry());
+    build(0, _primaryBits, 0, codes);
+
+    // pairs of codes in the primary table
+    const uint32_t mask = (1 << _primaryBits) - 1;
+    std::vector<Entry> single(mEntries.begin(), mEntries.begin() + (1 << _primaryBits));
+    for (uint32_t i = 0; i <= mask; i++) {
+      const Entry& first = single[i];
+      if (first.mCount != 1 || first.mLength >= _primaryBits || first.mValue > 0xffff) continue;
+      // the entry of the remaining bits, padded with zeros, is only valid if
+      // the code does not reach into the padding
+      const Entry& second = single[(i << first.mLength) & mask];
+      if (second.mCount != 1 || second.mLength > _primaryBits - first.mLength || second.mValue > 0xffff) continue;
+      mEntries[i].mValue = first.mValue | second.mValue << 16;
+      mEntries[i].mLength = first.mLength + second.mLength;
+      mEntries[i].mCount = 2;
+      mEntries[i].mFirstLength = first.mLength;
+    }
+  }
+
+  /**
+   * Decode a number of symbols from the bit stream in the buffer
+   * @arg buffer   [in]  bit stream, MSB to LSB in every byte
+   * @arg size     [in]  size of the buffer in bytes
+   * @arg target   [OUT] decoded values
+   * @arg nSymbols [in]  number of symbols to decode
+   * @return number of consumed bits
+   */
+  size_t decode(const uint8_t* buffer, size_t size, value_type* target, size_t nSymbols) const {
+    BitReader<uint8_t> reader(buffer, size);
+    size_t consumed = decode(reader, target, nSymbols);
+    if (reader.overrun()) {
+      throw std::range_error("bit stream exhausted before decoding all symbols");
+    }
+    return consumed;
+  }
+
+  /**
+   * Decode a number of symbols from the reader
+   *
+   * The reader is refilled once per lookup in the primary table, the bits in
+   * the register are used for further lookups as long as they suffice. A
+   * stream shorter than the symbols is indicated by the overrun of the reader.
+   * @arg reader   [in]  bit reader, see DataInflater.h
+   * @arg target   [OUT] decoded values
+   * @arg nSymbols [in]  number of symbols to decode
+   * @return number of consumed bits
+   */
+  template<typename Reader>
+  size_t decode(Reader& reader, value_type* target, size_t nSymbols) const {
+    static_assert(Reader::kMinValidBits >= _primaryBits, "bit reader register too short for the decoding table");
+    if (!isValid()) {
+      throw std::logic_error("decoding table not initialized");
+    }
+    // local copy, kept in registers during the loop
+    Reader r = reader;
+    const size_t start = r.position();
+    const Entry* primary = mEntries.data();
+    size_t n = 0;
+    while (n < nSymbols) {
+      r.refill();
+      Entry entry = primary[r.peek(_primaryBits)];
+      while (entry.mCount == 0) {
+        if (entry.mTableBits == 0) {
+          throw std::runtime_error("invalid Huffman code in bit stream");
+        }
+        r.consume(entry.mLength);
+        r.refill();
+        entry = primary[entry.mValue + r.peek(entry.mTableBits)];
+      }
+      unsigned length = entry.mLength;
+      if (entry.mCount == 1) {
+        target[n++] = alphabet_type::getSymbol(entry.mValue);
+      } else if (n + 1 < nSymbols) {
+        target[n++] = alphabet_type::getSymbol(entry.mValue & 0xffff);
+        target[n++] = alphabet_type::getSymbol(entry.mValue >> 16);
+      } else {
+        // only the first of the pair is requested
+        target[n++] = alphabet_type::getSymbol(entry.mValue & 0xffff);
+        length = entry.mFirstLength;
+      }
+      r.consume(length);
+
+      // the register usually holds the bits of several more entries of the
+      // primary table, both symbols of an entry are written unconditionally
+      while (r.available() >= _primaryBits && nSymbols - n >= 2) {
+        const Entry& next = primary[r.peek(_primaryBits)];
+        if (next.mCount == 0) break;
+        target[n] = alphabet_type::getSymbol(next.mCount == 1 ? next.mValue : next.mValue & 0xffff);
+        target[n + 1] = alphabet_type::getSymbol(next.mValue >> 16);
+        n += next.mCount;
+        r.consume(next.mLength);
+      }
+    }
+    reader = r;
+    return r.position() - start;
+  }
+
+private:
+  struct CodeDefinition {
+    uint64_t mCode;   // aligned to the MSB
+    uint16_t mLength;
+    uint32_t mIndex;  // symbol index in the alphabet
+  };
+
+  /// table entry: symbol(s) or link to the next level table
+  struct Entry {
+    uint32_t mValue;      // symbol index, two 16 bit indices, or offset of the next level table
+    uint8_t  mLength;     // number of bits to consume
+    uint8_t  mCount;      // number of symbols, 0 for a link
+    uint8_t  mTableBits;  // index bits of the next level table, 0 for an unused entry
+    uint8_t  mFirstLength;// code length of the first of two symbols
+
+    Entry() : mValue(0), mLength(0), mCount(0), mTableBits(0), mFirstLength(0) {}
+  };
+
+  /**
+   * Fill the table at offset with the codes, skipping the first depth bits
+   * which have been consumed by the previous levels
+   */
+  void build(uint32_t offset, unsigned tableBits, unsigned depth, const std::vector<CodeDefinition>& codes) {
+    std::map<uint32_t, std::vector<CodeDefinition>> longCodes;
+    for (const auto& code : codes) {
+      uint32_t slice = (code.mCode << depth) >> (64 - tableBits);
+      unsigned length = code.mLength - depth;
+      if (length > tableBits) {
+        longCodes[slice].push_back(code);
+        continue;
+      }
+      // all entries starting with the code
+      for (uint32_t i = 0; i < (1u << (tableBits - length)); i++) {
+        Entry& entry = mEntries[offset + slice + i];
+        entry.mValue = code.mIndex;
+        entry.mLength = length;
+        entry.mCount = 1;
+        entry.mTableBits = 0;
+      }
+    }
+    for (const auto& group : longCodes) {
+      unsigned maxLength = 0;
+      for (const auto& code : group.second) {
+        if (maxLength < code.mLength) maxLength = code.mLength;
+      }
+      unsigned nextBits = std::min(maxLength - depth - tableBits, _primaryBits);
+      uint32_t nextOffset = mEntries.size();
+      mEntries.resize(nextOffset + (1 << nextBits));
+      Entry& link = mEntries[offset + group.first];
+      link.mValue = nextOffset;
+      link.mLength = tableBits;
+      link.mCount = 0;
+      link.mTableBits = nextBits;
+      build(nextOffset, nextBits, depth + tableBits, group.second);
+    }
+  }
+
+  /// all tables, the primary table first
+  std::vector<Entry> mEntries;
+};
+
 /**
  * @class HuffmanCodec
  * @brief Main class of the Huffman codec implementation
@@ -126,10 +402,17 @@ template<
   >
 class HuffmanCodec {
  public:
-  HuffmanCodec(const _CodingModel& model) : mCodingModel(model) {}
+  /// the lookup tables for decoding from a buffer are prepared if the codes
+  /// of the model are canonical, see HuffmanModel::GenerateCanonicalCodes
+  HuffmanCodec(const _CodingModel& model) : mCodingModel(model), mEncodingTable(), mDecodingTable() {
+    mEncodingTable.init(mCodingModel);
+    if (_CodingModel::orderMSB && mCodingModel.isCanonical()) mDecodingTable.init(mCodingModel);
+  }
   ~HuffmanCodec() {}
 
   typedef _CodingModel model_type;
+  typedef HuffmanEncodingTable<_CodingModel> encoding_table_type;
+  typedef HuffmanDecodingTable<_CodingModel> decoding_table_type;
 
   /// Return Huffman code for a value
   template<typename CodeType, typename ValueType>
@@ -138,15 +421,49 @@ class HuffmanCodec {
     return true;
   }
 
+  /// Encode a value with the code table and pass the code to the writer,
+  /// a function of (code, code length), the code in the LSBs of a uint64_t.
+  /// This is the interface used by the DataDeflater.
+  /// @return return value of the writer
+  template<typename ValueType, typename RegType, typename Writer>
+  int Write(ValueType v, RegType /*unused*/, Writer writer) const {
+    // an invalid table is empty, every lookup fails
+    uint64_t entry = mEncodingTable.lookup(v);
+    return writer(encoding_table_type::code(entry), encoding_table_type::length(entry));
+  }
+
+  /// Huffman codes are written value by value, there is nothing to flush
+  template<typename Writer>
+  int Flush(Writer /*writer*/) const {return 0;}
+
   template<typename ReturnType, typename CodeType, bool orderMSB = true>
   bool Decode(ReturnType& v, CodeType code, uint16_t& codeLength) const {
     v = mCodingModel.Decode(code, codeLength);
     return true;
   }
 
+  /// Decode a number of values from the bit stream in the buffer using the
+  /// lookup tables, requires canonical codes in MSB to LSB order
+  /// @return number of consumed bits
+  size_t DecodeBuffer(const uint8_t* buffer, size_t size, typename _CodingModel::value_type* target, size_t nValues) const {
+    return mDecodingTable.decode(buffer, size, target, nValues);
+  }
+
+  /// Decode a number of values from the bit reader using the lookup tables.
+  /// This is the interface used by the DataInflater.
+  /// @return number of consumed bits
+  template<typename Reader>
+  int64_t Decode(Reader& reader, typename _CodingModel::value_type* target, size_t nValues) const {
+    return mDecodingTable.decode(reader, target, nValues);
+  }
+
+  bool isCanonical() const {return mDecodingTable.isValid();}
+
  private:
   HuffmanCodec(); //forbidden
   _CodingModel mCodingModel;
+  encoding_table_type mEncodingTable;
+  decoding_table_type mDecodingTable;
 };
 
 /**
@@ -168,7 +485,7 @@ class HuffmanCodec {
 template<typename _BASE, typename _NodeType, bool _orderMSB = true>
 class HuffmanModel : public _BASE {
 public:
-  HuffmanModel() : mAlphabet(), mLeaveNodes(), mTreeNodes() {}
+  HuffmanModel() : mAlphabet(), mLeaveNodes(), mTreeNodes(), mCanonical(false) {}
   ~HuffmanModel() {}
 
   typedef _BASE                                base_type;
@@ -286,6 +603,7 @@ public:
    */
   bool GenerateHuffmanTree() {
     mLeaveNodes.clear();
+    mCanonical = false;
 
     // probability model provides map of {symbol, weight}-pairs
     _BASE& model = *this;
@@ -363,6 +681,97 @@ public:
     return retcodelen;
   }
 
+  /**
+   * Reassign the codes canonically
+   *
+   * The code lengths of the Huffman tree are kept, the codes are reassigned
+   * in the order of code length and symbol index by counting up, every code
+   * being shifted to its length. The codes are thus determined by the code
+   * lengths alone, and consecutive codes of the same length belong to
+   * consecutive symbols. The tree is rebuilt from the new codes, so encoding
+   * and decoding by tree are consistent with them.
+   *
+   * @return false if there is no tree or the codes do not fit into 64 bit
+   */
+  bool GenerateCanonicalCodes() {
+    struct leave {
+      uint16_t codeLen;
+      uint16_t index;
+      std::shared_ptr<_NodeType> node;
+      bool operator<(const leave& other) const {
+        return codeLen < other.codeLen || (codeLen == other.codeLen && index < other.index);
+      }
+    };
+    std::vector<leave> leaves;
+    for (const auto& node : mLeaveNodes) {
+      if (!node) continue;
+      if (node->getBinaryCodeLength() > 64) return false;
+      leaves.push_back(leave{node->getBinaryCodeLength(), node->getIndex(), node});
+    }
+    if (leaves.empty()) return false;
+    std::sort(leaves.begin(), leaves.end());
+
+    // codes in MSB to LSB order, built from the code lengths
+    std::vector<uint64_t> codes(leaves.size());
+    uint64_t code = 0;
+    uint16_t codeLen = leaves.front().codeLen;
+    for (unsigned i = 0; i < leaves.size(); i++) {
+      if (i > 0) {
+        code = (code + 1) << (leaves[i].codeLen - codeLen);
+        codeLen = leaves[i].codeLen;
+      }
+      codes[i] = code;
+      uint64_t leaveCode = orderMSB ? code : reverseBits(code, codeLen);
+      leaves[i].node->setBinaryCode(codeLen, code_type(leaveCode));
+    }
+
+    // rebuild the tree from the longest codes upwards: at every code length,
+    // the nodes with codes c and c+1 (c even) are the children of a tree node
+    // with code c>>1, the child with the '1' bit being the left one
+    std::map<uint64_t, std::shared_ptr<_NodeType>> level;
+    unsigned next = leaves.size();
+    for (int len = leaves.back().codeLen; len > 0; len--) {
+      while (next > 0 && leaves[next - 1].codeLen == len) {
+        next--;
+        level[codes[next]] = leaves[next].node;
+      }
+      std::map<uint64_t, std::shared_ptr<_NodeType>> parents;
+      for (auto it = level.begin(); it != level.end(); ++it) {
+        auto sibling = it; ++sibling;
+        if ((it->first & 1) || sibling == level.end() || sibling->first != it->first + 1) {
+          // not a complete code
+          return false;
+        }
+        auto parent = std::make_shared<_NodeType>(sibling->second, it->second);
+        uint64_t parentCode = it->first >> 1;
+        parent->setBinaryCode(len - 1, code_type(orderMSB ? parentCode : reverseBits(parentCode, len - 1)));
+        parents[parentCode] = parent;
+        it = sibling;
+      }
+      level.swap(parents);
+    }
+    if (next > 0) level[codes[0]] = leaves[0].node; // the single leave of a one symbol alphabet
+    if (level.size() != 1) return false;
+    mTreeNodes.clear();
+    mTreeNodes.insert(level.begin()->second);
+    mCanonical = true;
+    return true;
+  }
+
+  bool isCanonical() const {return mCanonical;}
+
+  /**
+   * Call the function for the code of every symbol
+   * with the arguments (symbol index, code, code length)
+   */
+  template<typename F>
+  void forEachCode(F f) const {
+    for (const auto& node : mLeaveNodes) {
+      if (!node) continue;
+      f(node->getIndex(), toInteger(node->getBinaryCode()), node->getBinaryCodeLength());
+    }
+  }
+
   /**
    * @brief Write Huffman table in self-consistent format.
    */
@@ -383,6 +792,7 @@ public:
   int read(std::istream& in) {
     mLeaveNodes.clear();
     mTreeNodes.clear();
+    mCanonical = false;
     int lineNo = -1;
     std::string node, left, right, parameters;
     std::set<int> nodeIndices;
@@ -517,12 +927,27 @@ private:
     return rightIndex + 1;
   }
 
+  template<std::size_t N>
+  static uint64_t toInteger(const std::bitset<N>& code) {return code.to_ullong();}
+  template<typename T>
+  static uint64_t toInteger(const T& code) {return code;}
+
+  static uint64_t reverseBits(uint64_t code, uint16_t codeLen) {
+    uint64_t reversed = 0;
+    for (uint16_t i = 0; i < codeLen; i++, code >>= 1) {
+      reversed = reversed << 1 | (code & 1);
+    }
+    return reversed;
+  }
+
   // the alphabet, determined by template parameter
   typename _BASE::alphabet_type mAlphabet;
   // Huffman leave nodes containing symbol index to code mapping
   std::vector<std::shared_ptr<_NodeType>> mLeaveNodes;
   // multiset, order determined by less functor working on pointers
   std::multiset<std::shared_ptr<_NodeType>, isless<std::shared_ptr<_NodeType>>> mTreeNodes;
+  // codes have been reassigned canonically
+  bool mCanonical;
 };
 
 }; // namespace AliceO2
@@ -0,0 +1,389 @@
+//-*- Mode: C++ -*-
+
+#ifndef RANSCODEC_H
+#define RANSCODEC_H
+//****************************************************************************
+//* This file is free software: you can redistribute it and/or modify        *
+//* it under the terms of the GNU General Public License as published by     *
+//* the Free Software Foundation, either version 3 of the License, or        *
+//* (at your option) any later version.                                      *
+//*                                                                          *
+//* Primary Authors: Matthias Richter <richterm@scieq.net>                   *
+//*                                                                          *
+//* The authors make no claims about the suitability of this software for    *
+//* any purpose. It is provided "as is" without express or implied warranty. *
+//****************************************************************************
+
+//  @file   RANSCodec.h
+//  @since  2016-12-21
+//  @brief  Implementation of an interleaved rANS codec
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+#include "DataCompression/DataInflater.h"
+
+namespace AliceO2 {
+
+/**
+ * @class RANSModel
+ * @brief Probability model quantized to integer frequencies for the rANS codec
+ * This is a mixin class which extends the ProbabilityModel base
+ *
+ * The weights of the symbols are scaled to frequencies summing up to
+ * 2^scaleBits, every symbol with a non-zero weight keeps a frequency of at
+ * least 1. Symbols with zero weight can not be encoded.
+ */
+template<typename _BASE>
+class RANSModel : public _BASE {
+public:
+  RANSModel() : mAlphabet(), mFrequencies(), mCumulative(), mScaleBits(0) {}
+  ~RANSModel() {}
+
+  typedef _BASE                                base_type;
+  typedef typename _BASE::value_type           value_type;
+  typedef typename _BASE::alphabet_type        alphabet_type;
+
+  /// the precision of the frequencies is the number of bits required for the
+  /// number of symbols plus some margin, within these limits
+  static constexpr unsigned kMinScaleBits = 12;
+  static constexpr unsigned kMaxScaleBits = 24;
+
+  int init(double v = 1.) {return _BASE::initWeight(mAlphabet, v);}
+
+  /**
+   * Quantize the weights to frequencies
+   *
+   * Each symbol with a non-zero weight gets a frequency of 1 plus its share
+   * of the remaining range, the rounding remainder goes to the symbols with
+   * the largest fractional parts.
+   * @return false if there are no symbols or too many for the precision
+   */
+  bool GenerateFrequencyTable() {
+    mFrequencies.clear();
+    mCumulative.clear();
+    mScaleBits = 0;
+
+    _BASE& model = *this;
+    double totalWeight = 0.;
+    unsigned nSymbols = 0;
+    int maxIndex = -1;
+    for (auto i : model) {
+      int index = alphabet_type::getIndex(i.first);
+      if (maxIndex < index) maxIndex = index;
+      if (i.second <= 0) continue;
+      totalWeight += i.second;
+      nSymbols++;
+    }
+    if (nSymbols == 0) return false;
+
+    unsigned scaleBits = kMinScaleBits;
+    while (scaleBits < kMaxScaleBits && (1u << (scaleBits - 6)) < nSymbols) scaleBits++;
+    const uint32_t range = 1u << scaleBits;
+    if (nSymbols > range) return false;
+
+    std::vector<uint32_t> frequencies(maxIndex + 1, 0);
+    std::vector<std::pair<double, int>> remainders;
+    uint32_t sum = 0;
+    const double scale = (range - nSymbols) / totalWeight;
+    for (auto i : model) {
+      if (i.second <= 0) continue;
+      int index = alphabet_type::getIndex(i.first);
+      double share = i.second * scale;
+      frequencies[index] = 1 + static_cast<uint32_t>(share);
+      sum += frequencies[index];
+      remainders.push_back(std::make_pair(share - static_cast<uint32_t>(share), index));
+    }
+    std::sort(remainders.begin(), remainders.end(), [](const std::pair<double, int>& a, const std::pair<double, int>& b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+      });
+    for (unsigned i = 0; sum < range; i = (i + 1) % remainders.size(), sum++) {
+      frequencies[remainders[i].second]++;
+    }
+
+    mCumulative.resize(frequencies.size() + 1, 0);
+    for (unsigned i = 0; i < frequencies.size(); i++) {
+      mCumulative[i + 1] = mCumulative[i] + frequencies[i];
+    }
+    mFrequencies.swap(frequencies);
+    mScaleBits = scaleBits;
+    return true;
+  }
+
+  unsigned getScaleBits() const {return mScaleBits;}
+  /// number of symbol indices covered by the frequency table
+  unsigned getNumberOfSymbols() const {return mFrequencies.size();}
+  uint32_t getFrequency(unsigned index) const {return index < mFrequencies.size() ? mFrequencies[index] : 0;}
+  /// sum of the frequencies of the symbols with lower index
+  uint32_t getCumulative(unsigned index) const {return mCumulative[index];}
+
+private:
+  // the alphabet, determined by template parameter
+  typename _BASE::alphabet_type mAlphabet;
+  // frequency of every symbol index
+  std::vector<uint32_t> mFrequencies;
+  // cumulative frequencies, one more entry than the frequencies
+  std::vector<uint32_t> mCumulative;
+  // frequencies sum up to 2^mScaleBits
+  unsigned mScaleBits;
+};
+
+/**
+ * @class RANSCodec
+ * @brief Interleaved range asymmetric numeral system codec
+ *
+ * The codec uses _nStates rANS states of 64 bit, which are renormalized by
+ * 32 bit words. Consecutive values are encoded with consecutive states, so
+ * the dependency chain of every state only covers every _nStates-th value
+ * and the processor can work on several values in parallel. All states
+ * share one stream of words.
+ *
+ * rANS is a LIFO coder, the values are encoded in reverse order. Values
+ * passed to Write are therefore collected, the block is encoded and passed
+ * to the writer by Flush, which the DataDeflater calls when aligning the
+ * output. The block consists of the final states followed by the
+ * renormalization words, all as 32 bit words. DecodeBuffer reads the block
+ * from the beginning of the buffer.
+ *
+ * The division of the encoder is replaced by a multiplication with the
+ * precomputed reciprocal of the frequency (the 'alias-free' rans64 scheme
+ * by F. Giesen).
+ */
+template<
+  typename _CodingModel,
+  unsigned _nStates = 4
+  >
+class RANSCodec {
+ public:
+  typedef _CodingModel model_type;
+  typedef typename _CodingModel::value_type value_type;
+  typedef typename _CodingModel::alphabet_type alphabet_type;
+
+  static_assert(_nStates > 0 && (_nStates & (_nStates - 1)) == 0, "number of states must be a power of 2");
+
+  /// lower bound of the normalized state interval
+  static constexpr uint64_t kLowerBound = uint64_t(1) << 31;
+
+  RANSCodec(const _CodingModel& model) : mScaleBits(model.getScaleBits()), mBucketShift(0), mEncSymbols(), mDecSymbols(), mBuckets(), mPending() {
+    if (mScaleBits == 0) {
+      throw std::logic_error("no frequency table in the model, see RANSModel::GenerateFrequencyTable");
+    }
+    unsigned nSymbols = model.getNumberOfSymbols();
+    mEncSymbols.resize(nSymbols);
+    mDecSymbols.resize(nSymbols + 1);
+    for (unsigned index = 0; index < nSymbols; index++) {
+      initSymbol(index, model.getCumulative(index), model.getFrequency(index));
+    }
+    // sentinel for the search of the symbol of a slot
+    mDecSymbols[nSymbols].mStart = 1u << mScaleBits;
+
+    // the symbol of the first slot of every bucket
+    unsigned bucketBits = std::min(mScaleBits, 16u);
+    mBucketShift = mScaleBits - bucketBits;
+    mBuckets.resize(1u << bucketBits);
+    unsigned index = 0;
+    for (uint32_t bucket = 0; bucket < mBuckets.size(); bucket++) {
+      uint32_t slot = bucket << mBucketShift;
+      while (mDecSymbols[index + 1].mStart <= slot) index++;
+      mBuckets[bucket] = index;
+    }
+  }
+  ~RANSCodec() {}
+
+  /// Collect a value for the block, nothing is passed to the writer before Flush
+  /// @return number of written bits, always 0
+  template<typename ValueType, typename RegType, typename Writer>
+  int Write(ValueType v, RegType /*unused*/, Writer /*writer*/) {
+    mPending.push_back(v);
+    return 0;
+  }
+
+  /// Encode the collected values and pass the block as 32 bit words to the writer
+  /// @return number of written bits, or the negative error code of the writer
+  template<typename Writer>
+  int64_t Flush(Writer writer) {
+    if (mPending.empty()) return 0;
+    std::vector<uint32_t> words;
+    encode(mPending.data(), mPending.size(), words);
+    mPending.clear();
+    for (auto word : words) {
+      int result = writer(word, 32);
+      if (result < 0) return result;
+    }
+    return 32 * static_cast<int64_t>(words.size());
+  }
+
+  /**
+   * Encode a block of values
+   * @arg values   [in]  values to encode
+   * @arg nValues  [in]  number of values
+   * @arg words    [OUT] the block
+   */
+  void encode(const value_type* values, size_t nValues, std::vector<uint32_t>& words) const {
+    // a value produces at most one renormalization word
+    words.resize(nValues + 2 * _nStates);
+    uint32_t* end = words.data() + words.size();
+    uint32_t* current = end;
+    uint64_t states[_nStates];
+    for (auto& state : states) state = kLowerBound;
+
+    for (size_t i = nValues; i-- > 0;) {
+      const EncSymbol& symbol = lookup(values[i]);
+      uint64_t& state = states[i & (_nStates - 1)];
+      if (state >= symbol.mMaxState) {
+        *--current = static_cast<uint32_t>(state);
+        state >>= 32;
+      }
+      uint64_t quotient = mulhi(state, symbol.mReciprocal) >> symbol.mShift;
+      state += symbol.mBias + quotient * symbol.mComplement;
+    }
+    for (unsigned i = _nStates; i-- > 0;) {
+      *--current = static_cast<uint32_t>(states[i]);
+      *--current = static_cast<uint32_t>(states[i] >> 32);
+    }
+    words.erase(words.begin(), words.begin() + (current - words.data()));
+  }
+
+  /**
+   * Decode a number of values from the block at the beginning of the buffer,
+   * the words are read MSB to LSB as written by the DataDeflater
+   * @arg buffer   [in]  block
+   * @arg size     [in]  size of the buffer in bytes
+   * @arg target   [OUT] decoded values
+   * @arg nValues  [in]  number of values, as encoded into the block
+   * @return number of consumed bits
+   */
+  size_t DecodeBuffer(const uint8_t* buffer, size_t size, value_type* target, size_t nValues) const {
+    BitReader<uint8_t> reader(buffer, size);
+    size_t consumed = Decode(reader, target, nValues);
+    if (reader.overrun()) {
+      throw std::range_error("rANS block exceeds the buffer");
+    }
+    return consumed;
+  }
+
+  /**
+   * Decode a number of values from the block at the next aligned position
+   * of the reader. This is the interface used by the DataInflater.
+   * @arg reader   [in]  bit reader, see DataInflater.h
+   * @arg target   [OUT] decoded values
+   * @arg nValues  [in]  number of values, as encoded into the block
+   * @return number of consumed bits including the alignment
+   */
+  template<typename Reader>
+  int64_t Decode(Reader& reader, value_type* target, size_t nValues) const {
+    static_assert(Reader::kMinValidBits >= 32, "bit reader register too short for the renormalization words");
+    // local copy, kept in registers during the loop
+    Reader r = reader;
+    const size_t start = r.position();
+    r.align();
+    uint64_t states[_nStates];
+    for (auto& state : states) {
+      state = r.read(32) << 32;
+      state |= r.read(32);
+    }
+    const uint32_t mask = (1u << mScaleBits) - 1;
+    const DecSymbol* symbols = mDecSymbols.data();
+    for (size_t i = 0; i < nValues; i++) {
+      uint64_t& state = states[i & (_nStates - 1)];
+      uint32_t slot = state & mask;
+      uint32_t index = mBuckets[slot >> mBucketShift];
+      while (symbols[index + 1].mStart <= slot) index++;
+      target[i] = alphabet_type::getSymbol(index);
+      state = symbols[index].mFrequency * (state >> mScaleBits) + slot - symbols[index].mStart;
+      if (state < kLowerBound) {
+        state = state << 32 | r.read(32);
+      }
+    }
+    reader = r;
+    // an exhausted stream is reported by the reader
+    if (r.overrun()) return r.position() - start;
+    for (auto state : states) {
+      if (state != kLowerBound) {
+        throw std::runtime_error("rANS block inconsistent with the number of values");
+      }
+    }
+    return r.position() - start;
+  }
+
+ private:
+  RANSCodec(); //forbidden
+
+  /// encoding parameters of a symbol
+  struct EncSymbol {
+    uint64_t mMaxState;   // renormalize if the state is not below
+    uint64_t mReciprocal; // fixed point reciprocal of the frequency
+    uint32_t mBias;
+    uint32_t mComplement; // 2^scaleBits - frequency
+    uint32_t mShift;
+    uint32_t mFrequency;  // 0 for symbols which can not be encoded
+  };
+
+  /// decoding parameters of a symbol
+  struct DecSymbol {
+    uint32_t mStart;
+    uint32_t mFrequency;
+  };
+
+  void initSymbol(unsigned index, uint32_t start, uint32_t frequency) {
+    EncSymbol& enc = mEncSymbols[index];
+    enc.mFrequency = frequency;
+    enc.mMaxState = ((kLowerBound >> mScaleBits) << 32) * frequency;
+    enc.mComplement = (1u << mScaleBits) - frequency;
+    if (frequency < 2) {
+      // the reciprocal of 1 does not fit, the bias does the job
+      enc.mReciprocal = ~uint64_t(0);
+      enc.mShift = 0;
+      enc.mBias = start + (1u << mScaleBits) - 1;
+    } else {
+      uint32_t shift = 0;
+      while (frequency > (1u << shift)) shift++;
+      uint64_t x0 = frequency - 1;
+      uint64_t x1 = uint64_t(1) << (shift + 31);
+      uint64_t t1 = x1 / frequency;
+      x0 += (x1 % frequency) << 32;
+      uint64_t t0 = x0 / frequency;
+      enc.mReciprocal = t0 + (t1 << 32);
+      enc.mShift = shift - 1;
+      enc.mBias = start;
+    }
+    mDecSymbols[index].mStart = start;
+    mDecSymbols[index].mFrequency = frequency;
+  }
+
+  const EncSymbol& lookup(value_type v) const {
+    unsigned index = alphabet_type::getIndex(v);
+    if (index >= mEncSymbols.size() || mEncSymbols[index].mFrequency == 0) {
+      throwLookupError(v);
+    }
+    return mEncSymbols[index];
+  }
+
+  __attribute__((noinline, cold)) void throwLookupError(value_type v) const {
+    std::stringstream msg;
+    msg << "symbol " << v << " has no frequency in the model";
+    throw std::range_error(msg.str());
+  }
+
+  static uint64_t mulhi(uint64_t a, uint64_t b) {
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+  }
+
+  unsigned mScaleBits;
+  unsigned mBucketShift;
+  std::vector<EncSymbol> mEncSymbols;
+  std::vector<DecSymbol> mDecSymbols;
+  /// first symbol index of every bucket of slots
+  std::vector<uint32_t> mBuckets;
+  /// values collected for the next block
+  std::vector<value_type> mPending;
+};
+
+template<typename _CodingModel, unsigned _nStates>
+constexpr uint64_t RANSCodec<_CodingModel, _nStates>::kLowerBound;
+
+}; // namespace AliceO2
+
+#endif
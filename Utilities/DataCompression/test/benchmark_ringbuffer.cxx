@@ -0,0 +1,127 @@
+//****************************************************************************
+//* This file is free software: you can redistribute it and/or modify        *
+//* it under the terms of the GNU General Public License as published by     *
+//* the Free Software Foundation, either version 3 of the License, or        *
+//* (at your option) any later version.                                      *
+//*                                                                          *
+//* Primary Authors: Matthias Richter <richterm@scieq.net>                   *
+//*                                                                          *
+//* The authors make no claims about the suitability of this software for    *
+//* any purpose. It is provided "as is" without express or implied warranty. *
+//****************************************************************************
+
+//  @file   benchmark_ringbuffer.cxx
+//  @since  2016-12-23
+//  @brief  Hand-off cost of the lock-free ring buffers compared to the Fifo
+
+// Compilation:
+/*
+   g++ --std=c++11 -O2 -I../../O2Device/include -pthread -o benchmark_ringbuffer benchmark_ringbuffer.cxx
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdexcept>
+#include "O2Device/RingBuffer.h"
+#include "Fifo.h"
+
+const uint64_t nValues = 2000000;
+const size_t capacity = 1024;
+
+/// the sum of the values 1 to nValues, checked on the consumer side
+const uint64_t expectedSum = nValues * (nValues + 1) / 2;
+
+void report(const std::string& name, double seconds, uint64_t sum)
+{
+  if (sum != expectedSum) {
+    throw std::runtime_error(name + ": mismatch of the transferred values");
+  }
+  std::cout << std::setw(44) << std::left << name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << nValues / seconds / 1e6 << " M/s"
+            << std::setw(10) << seconds * 1e9 / nValues << " ns/value" << std::endl;
+}
+
+double elapsed(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void benchmarkFifo()
+{
+  AliceO2::Test::Fifo<uint64_t> fifo;
+  uint64_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  std::thread consumer([&]() {
+      while (fifo.pull([&](uint64_t value) {sum += value; return true;})) {}
+    });
+  for (uint64_t value = 1; value <= nValues; value++) {
+    fifo.push(value, value == nValues);
+  }
+  consumer.join();
+  report("Fifo, 1 -> 1", elapsed(start), sum);
+}
+
+/**
+ * nProducers push the values 1 to nValues in batches of batchSize, which the
+ * nConsumers pop in batches of up to batchSize
+ */
+template<typename Queue>
+void benchmarkRingBuffer(const std::string& name, unsigned nProducers, unsigned nConsumers, size_t batchSize)
+{
+  Queue queue(capacity);
+  std::atomic<uint64_t> sum(0);
+  std::atomic<unsigned> activeProducers(nProducers);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (unsigned c = 0; c < nConsumers; c++) {
+    threads.emplace_back([&]() {
+        std::vector<uint64_t> batch(batchSize);
+        uint64_t localSum = 0;
+        size_t count;
+        while ((count = queue.pop(batch.data(), batch.size())) > 0) {
+          for (size_t i = 0; i < count; i++) localSum += batch[i];
+        }
+        sum += localSum;
+      });
+  }
+  for (unsigned p = 0; p < nProducers; p++) {
+    threads.emplace_back([&, p]() {
+        std::vector<uint64_t> batch;
+        // every producer takes every nProducers-th value
+        for (uint64_t value = 1 + p; value <= nValues; value += nProducers) {
+          batch.push_back(value);
+          if (batch.size() == batchSize) {
+            queue.push(batch.data(), batch.size());
+            batch.clear();
+          }
+        }
+        queue.push(batch.data(), batch.size());
+        if (--activeProducers == 0) queue.close();
+      });
+  }
+  for (auto& thread : threads) thread.join();
+  report(name + ", " + std::to_string(nProducers) + " -> " + std::to_string(nConsumers) + ", batch " + std::to_string(batchSize),
+         elapsed(start), sum);
+}
+
+int main()
+{
+  using namespace AliceO2::Base;
+  std::cout << "Transfer of " << nValues << " values of 64 bit between threads, queue capacity " << capacity
+            << ", " << std::thread::hardware_concurrency() << " hardware thread(s)" << std::endl;
+  benchmarkFifo();
+  benchmarkRingBuffer<SPSCRingBuffer<uint64_t>>("SPSCRingBuffer", 1, 1, 1);
+  benchmarkRingBuffer<SPSCRingBuffer<uint64_t>>("SPSCRingBuffer", 1, 1, 64);
+  benchmarkRingBuffer<SPSCRingBuffer<uint64_t, false>>("SPSCRingBuffer, spinning", 1, 1, 1);
+  benchmarkRingBuffer<SPSCRingBuffer<uint64_t, false>>("SPSCRingBuffer, spinning", 1, 1, 64);
+  benchmarkRingBuffer<MPMCRingBuffer<uint64_t>>("MPMCRingBuffer", 1, 1, 1);
+  benchmarkRingBuffer<MPMCRingBuffer<uint64_t>>("MPMCRingBuffer", 1, 1, 64);
+  benchmarkRingBuffer<MPMCRingBuffer<uint64_t>>("MPMCRingBuffer", 4, 4, 1);
+  benchmarkRingBuffer<MPMCRingBuffer<uint64_t>>("MPMCRingBuffer", 4, 4, 64);
+  return 0;
+}
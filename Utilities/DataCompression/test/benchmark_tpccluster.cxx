@@ -0,0 +1,202 @@
+//****************************************************************************
+//* This file is free software: you can redistribute it and/or modify        *
+//* it under the terms of the GNU General Public License as published by     *
+//* the Free Software Foundation, either version 3 of the License, or        *
+//* (at your option) any later version.                                      *
+//*                                                                          *
+//* Primary Authors: Matthias Richter <richterm@scieq.net>                   *
+//*                                                                          *
+//* The authors make no claims about the suitability of this software for    *
+//* any purpose. It is provided "as is" without express or implied warranty. *
+//****************************************************************************
+
+//  @file   benchmark_tpccluster.cxx
+//  @since  2016-12-20
+//  @brief  Benchmark of the entropy coding on the TPC cluster parameter alphabets
+
+// Compilation: make sure variable BOOST_ROOT points to your boost installation
+/*
+   g++ --std=c++11 -O2 -I$BOOST_ROOT/include -I../include -I.. -o benchmark_tpccluster benchmark_tpccluster.cxx
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <map>
+#include <cmath>
+#include <stdexcept>
+#include <boost/type.hpp>
+#include <boost/mpl/for_each.hpp>
+#include "DataCompression/dc_primitives.h"
+#include "DataCompression/HuffmanCodec.h"
+#include "DataCompression/RANSCodec.h"
+#include "DataCompression/DataDeflater.h"
+#include "tpccluster_parameter_model.h"
+
+const int nValues = 1000000;
+
+double elapsed(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Benchmark for one parameter model: the models are trained with a geometric
+ * distribution, either spread over the alphabet or strongly skewed like the
+ * differences of consecutive values, the values of a second sample are encoded
+ * - value by value with the Huffman code of the leave nodes and WriteRaw
+ * - in bulk with the code table of the Huffman codec
+ * - in bulk with the rANS codec
+ * and decoded again with the lookup tables of the canonical Huffman codes
+ * and the rANS decoder, respectively
+ */
+struct EncodingBenchmark
+{
+  /// parameter of the geometric distribution, 0 for 8 / alphabet size
+  double mP;
+
+  EncodingBenchmark(double p) : mP(p) {}
+
+  template<typename ModelT>
+  void operator()(boost::type<ModelT>) {
+    typedef typename ModelT::value_type value_type;
+    typedef typename ModelT::alphabet_type alphabet_type;
+    typedef AliceO2::HuffmanCodec<ModelT> Codec_t;
+    typedef AliceO2::DataDeflater<uint64_t, uint8_t, Codec_t> Deflater_t;
+    typedef AliceO2::RANSModel<typename ModelT::base_type> RANSModel_t;
+    typedef AliceO2::RANSCodec<RANSModel_t> RANSCodec_t;
+    typedef AliceO2::DataDeflater<uint64_t, uint8_t, RANSCodec_t> RANSDeflater_t;
+
+    alphabet_type alphabet;
+    int alphabetSize = 0;
+    value_type maxValue = 0;
+    for (auto s : alphabet) {
+      alphabetSize++;
+      maxValue = s;
+    }
+    std::default_random_engine generator;
+    std::geometric_distribution<int> distribution(mP > 0. ? mP : std::min(0.5, 8. / alphabetSize));
+    auto sample = [&]() {return static_cast<value_type>(std::min<int>(distribution(generator), maxValue));};
+
+    // every symbol gets a minimum weight to keep the code lengths bounded
+    ModelT model;
+    RANSModel_t ransModel;
+    model.init(1.);
+    ransModel.init(1.);
+    for (int i = 0; i < nValues; i++) {
+      value_type value = sample();
+      model.addWeight(value);
+      ransModel.addWeight(value);
+    }
+    model.GenerateHuffmanTree();
+    model.GenerateCanonicalCodes();
+    Codec_t codec(model);
+    ransModel.GenerateFrequencyTable();
+    RANSCodec_t ransCodec(ransModel);
+
+    std::vector<value_type> values(nValues);
+    std::map<value_type, int> counts;
+    for (auto& value : values) {
+      value = sample();
+      counts[value]++;
+    }
+    double entropy = 0.;
+    for (auto count : counts) {
+      double p = double(count.second) / nValues;
+      entropy -= p * std::log2(p);
+    }
+    const size_t bufferSize = nValues * 8;
+    std::vector<uint8_t> reference(bufferSize);
+    std::vector<uint8_t> buffer(bufferSize);
+
+    // value by value, the code as bitset from the leave node
+    Deflater_t deflater(codec);
+    deflater.Init(reference.data(), bufferSize);
+    auto start = std::chrono::steady_clock::now();
+    for (auto value : values) {
+      uint16_t codeLength = 0;
+      typename ModelT::code_type code;
+      codec.Encode(value, code, codeLength);
+      deflater.WriteRaw(code.to_ullong(), codeLength);
+    }
+    int referenceSize = deflater.Close();
+    double referenceTime = elapsed(start);
+
+    // bulk encoding with the code table
+    deflater.Init(buffer.data(), bufferSize);
+    start = std::chrono::steady_clock::now();
+    int64_t nBits = deflater.Encode(values.data(), values.size());
+    int size = deflater.Close();
+    double encodingTime = elapsed(start);
+    if (nBits < 0 || size != referenceSize || !std::equal(buffer.begin(), buffer.begin() + size, reference.begin())) {
+      throw std::runtime_error("bulk encoding differs from the encoding value by value");
+    }
+
+    // decoding with the lookup tables
+    std::vector<value_type> decoded(nValues);
+    start = std::chrono::steady_clock::now();
+    size_t consumed = codec.DecodeBuffer(buffer.data(), size, decoded.data(), decoded.size());
+    double decodingTime = elapsed(start);
+    if (decoded != values || consumed != static_cast<size_t>(nBits)) {
+      throw std::runtime_error("decoding mismatch");
+    }
+
+    // rANS
+    RANSDeflater_t ransDeflater(ransCodec);
+    ransDeflater.Init(buffer.data(), bufferSize);
+    start = std::chrono::steady_clock::now();
+    // the values are collected by Encode, the block is written when aligning
+    int64_t ransBits = ransDeflater.Encode(values.data(), values.size());
+    ransBits += ransDeflater.Align();
+    int ransSize = ransDeflater.Close();
+    double ransEncodingTime = elapsed(start);
+    if (ransSize <= 0 || ransBits != 8 * static_cast<int64_t>(ransSize)) {
+      throw std::runtime_error("rANS encoding failed");
+    }
+    std::fill(decoded.begin(), decoded.end(), 0);
+    start = std::chrono::steady_clock::now();
+    consumed = ransCodec.DecodeBuffer(buffer.data(), ransSize, decoded.data(), decoded.size());
+    double ransDecodingTime = elapsed(start);
+    if (decoded != values || consumed != 8 * static_cast<size_t>(ransSize)) {
+      throw std::runtime_error("rANS decoding mismatch");
+    }
+
+    unsigned nominalBits = 0;
+    while ((1 << nominalBits) < alphabetSize) nominalBits++;
+    double inputMB = nValues * sizeof(value_type) / 1e6;
+    std::cout << std::setw(8) << std::left << model.getName() << std::right
+              << std::fixed << std::setprecision(2)
+              << std::setw(9) << entropy
+              << std::setw(9) << double(nBits) / nValues
+              << std::setw(7) << nominalBits * nValues / double(nBits)
+              << std::setprecision(0)
+              << std::setw(11) << inputMB / referenceTime
+              << std::setw(11) << inputMB / encodingTime
+              << std::setw(11) << inputMB / decodingTime
+              << std::setprecision(2)
+              << std::setw(9) << 8. * ransSize / nValues
+              << std::setw(7) << nominalBits * nValues / (8. * ransSize)
+              << std::setprecision(0)
+              << std::setw(11) << inputMB / ransEncodingTime
+              << std::setw(11) << inputMB / ransDecodingTime
+              << std::endl;
+  }
+};
+
+int main()
+{
+  std::cout << "Entropy coding of " << nValues << " values per TPC cluster parameter" << std::endl
+            << "bits/value and compression ratio with respect to the bit width of the alphabet," << std::endl
+            << "throughput in MB/s of 16 bit values, Huffman encoding value by value with the code" << std::endl
+            << "of the leave nodes and in bulk with the code table" << std::endl
+            << "                  | Huffman                                          | rANS" << std::endl
+            << "parameter  entropy bits/val  ratio  enc nodes  enc table    decode | bits/val  ratio     encode    decode" << std::endl;
+  std::cout << "geometric distribution spread over the alphabet" << std::endl;
+  boost::mpl::for_each<tpccluster_parameter_models, boost::type<boost::mpl::_> >(EncodingBenchmark(0.));
+  std::cout << "skewed geometric distribution, p = 0.7" << std::endl;
+  boost::mpl::for_each<tpccluster_parameter_models, boost::type<boost::mpl::_> >(EncodingBenchmark(0.7));
+  return 0;
+}
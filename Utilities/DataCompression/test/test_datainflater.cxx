@@ -0,0 +1,245 @@
+//****************************************************************************
+//* This file is free software: you can redistribute it and/or modify        *
+//* it under the terms of the GNU General Public License as published by     *
+//* the Free Software Foundation, either version 3 of the License, or        *
+//* (at your option) any later version.                                      *
+//*                                                                          *
+//* Primary Authors: Matthias Richter <richterm@scieq.net>                   *
+//*                                                                          *
+//* The authors make no claims about the suitability of this software for    *
+//* any purpose. It is provided "as is" without express or implied warranty. *
+//****************************************************************************
+
+//  @file   test_datainflater.cxx
+//  @since  2016-12-22
+//  @brief  Test program for the bit stream reader, roundtrip with the DataDeflater
+
+// Compilation: make sure variable BOOST_ROOT points to your boost installation
+/*
+   g++ --std=c++11 -O2 -I$BOOST_ROOT/include -I../include -I.. -o test_datainflater test_datainflater.cxx
+*/
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/mpl/at.hpp>
+#include "DataCompression/dc_primitives.h"
+#include "DataCompression/HuffmanCodec.h"
+#include "DataCompression/RANSCodec.h"
+#include "DataCompression/DataDeflater.h"
+#include "DataCompression/DataInflater.h"
+#include "tpccluster_parameter_model.h"
+
+/// codec for writing and reading raw bits only
+struct RawCodec {
+  template<typename Writer>
+  int Flush(Writer /*writer*/) const {return 0;}
+};
+
+/**
+ * Raw bits of random length, aligned at random positions, are written with
+ * the DataDeflater and read back with the DataInflater
+ */
+template<typename WordType>
+void testRawRoundtrip(int nFields)
+{
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int> lengthDistribution(0, 64);
+  std::uniform_int_distribution<uint64_t> valueDistribution;
+  std::uniform_int_distribution<int> alignDistribution(0, 15);
+
+  struct Field {
+    uint64_t value;
+    uint16_t length;
+    bool align;
+  };
+  std::vector<Field> fields(nFields);
+  for (auto& field : fields) {
+    field.length = lengthDistribution(generator);
+    field.value = field.length > 0 ? valueDistribution(generator) >> (64 - field.length) : 0;
+    field.align = alignDistribution(generator) == 0;
+  }
+
+  std::vector<WordType> buffer(nFields * 16 / sizeof(WordType) + 8);
+  AliceO2::DataDeflater<uint64_t, WordType, RawCodec> deflater;
+  deflater.Init(buffer.data(), buffer.size());
+  for (const auto& field : fields) {
+    if (deflater.WriteRaw(field.value, field.length) < 0) {
+      throw std::runtime_error("buffer too small");
+    }
+    if (field.align) deflater.Align();
+  }
+  int size = deflater.Close();
+
+  AliceO2::DataInflater<WordType, RawCodec> inflater((RawCodec()));
+  inflater.Init(buffer.data(), size);
+  for (const auto& field : fields) {
+    uint64_t value = ~uint64_t(0);
+    if (inflater.ReadRaw(value, field.length) != field.length) {
+      throw std::runtime_error("stream exhausted");
+    }
+    if ((field.length > 0 ? value : 0) != field.value) {
+      throw std::runtime_error("raw bits mismatch");
+    }
+    if (field.align) {
+      inflater.Align();
+      if (inflater.GetPosition() % (8 * sizeof(WordType)) != 0) {
+        throw std::runtime_error("alignment mismatch");
+      }
+    }
+  }
+  if (inflater.Close() != size) {
+    throw std::runtime_error("mismatch of the stream length");
+  }
+
+  // reading beyond the end
+  inflater.Init(buffer.data(), size);
+  uint64_t value = 0;
+  for (int i = 0; i < size; i++) inflater.ReadRaw(value, 8 * sizeof(WordType));
+  if (inflater.ReadRaw(value, 1) >= 0 || inflater.Close() >= 0) {
+    throw std::runtime_error("reading beyond the end of the stream not detected");
+  }
+  std::cout << "    " << 8 * sizeof(WordType) << " bit words: " << nFields << " fields in "
+            << size << " words ... ok" << std::endl;
+}
+
+/**
+ * Writing beyond the end of the target fails, also for all following writes,
+ * and the bits which did not fit are reported when closing
+ */
+template<typename WordType>
+void testTargetFull()
+{
+  const int size = 4;
+  const int nBits = size * 8 * sizeof(WordType);
+  std::vector<WordType> buffer(size);
+  AliceO2::DataDeflater<uint64_t, WordType, RawCodec> deflater;
+  deflater.Init(buffer.data(), size);
+  for (int i = 0; i < nBits / 8; i++) {
+    if (deflater.WriteRaw(i, 8) != 8) {
+      throw std::runtime_error("target full before its end");
+    }
+  }
+  if (deflater.Close() != size) {
+    throw std::runtime_error("completely filled target not closed");
+  }
+
+  deflater.Init(buffer.data(), size);
+  int result = 0;
+  for (int i = 0; i < nBits && result >= 0; i++) {
+    result = deflater.WriteRaw(i, 7);
+  }
+  if (result >= 0 || deflater.WriteRaw(1, 1) >= 0 || deflater.WriteRaw(1, 40) >= 0 ||
+      deflater.Align() >= 0 || deflater.Close() >= 0) {
+    throw std::runtime_error("writing beyond the end of the target not detected");
+  }
+
+  deflater.Init(buffer.data(), size);
+  for (int i = 0; i < nBits / 8 - 1; i++) {
+    deflater.WriteRaw(i, 8);
+  }
+  // the last word fits only partially, detected when aligning
+  deflater.WriteRaw(0, 4);
+  deflater.WriteRaw(0, 7);
+  if (deflater.Close() >= 0) {
+    throw std::runtime_error("bits pending at the end of the target not detected");
+  }
+  std::cout << "    " << 8 * sizeof(WordType) << " bit words: end of the target ... ok" << std::endl;
+}
+
+/**
+ * A raw header, aligned, followed by the encoded values, decoded through the
+ * DataInflater
+ * @return decoding time in seconds
+ */
+template<typename WordType, typename Codec, typename ValueType>
+double testCodecRoundtrip(const Codec& codec, const std::vector<ValueType>& values, const char* name)
+{
+  const uint32_t header = 0x5a5;
+  std::vector<WordType> buffer(values.size() * 4 + 64);
+  AliceO2::DataDeflater<uint64_t, WordType, Codec> deflater(codec);
+  deflater.Init(buffer.data(), buffer.size());
+  deflater.WriteRaw(header, 11);
+  deflater.Align();
+  int64_t nBits = deflater.Encode(values.data(), values.size());
+  int size = deflater.Close();
+  if (nBits < 0 || size <= 0) {
+    throw std::runtime_error("encoding failed");
+  }
+
+  AliceO2::DataInflater<WordType, Codec> inflater(codec);
+  inflater.Init(buffer.data(), size);
+  uint32_t readHeader = 0;
+  inflater.ReadRaw(readHeader, 11);
+  inflater.Align();
+  std::vector<ValueType> decoded(values.size());
+  auto start = std::chrono::steady_clock::now();
+  int64_t consumed = inflater.Decode(decoded.data(), decoded.size());
+  double decodingTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (readHeader != header || consumed < 0 || decoded != values) {
+    throw std::runtime_error(std::string(name) + " decoding mismatch");
+  }
+  if (inflater.Close() != size) {
+    throw std::runtime_error(std::string(name) + " mismatch of the stream length");
+  }
+  std::cout << "    " << name << ", " << 8 * sizeof(WordType) << " bit words: " << values.size()
+            << " values in " << size << " words ... ok" << std::endl;
+  return decodingTime;
+}
+
+int main()
+{
+  std::cout << "Testing raw bits" << std::endl;
+  testRawRoundtrip<uint8_t>(100000);
+  testRawRoundtrip<uint16_t>(100000);
+  testRawRoundtrip<uint32_t>(100000);
+  testTargetFull<uint8_t>();
+  testTargetFull<uint16_t>();
+  testTargetFull<uint32_t>();
+
+  // the qmax parameter
+  typedef boost::mpl::at_c<tpccluster_parameter_models, 6>::type HuffmanModel_t;
+  typedef AliceO2::HuffmanCodec<HuffmanModel_t> HuffmanCodec_t;
+  typedef AliceO2::RANSModel<HuffmanModel_t::base_type> RANSModel_t;
+  typedef AliceO2::RANSCodec<RANSModel_t> RANSCodec_t;
+  typedef HuffmanModel_t::value_type value_type;
+
+  const int nValues = 1000000;
+  std::default_random_engine generator;
+  std::geometric_distribution<int> distribution(0.05);
+  auto sample = [&]() {return static_cast<value_type>(std::min<int>(distribution(generator), 1023));};
+
+  HuffmanModel_t huffmanModel;
+  RANSModel_t ransModel;
+  huffmanModel.init(1.);
+  ransModel.init(1.);
+  for (int i = 0; i < nValues; i++) {
+    value_type value = sample();
+    huffmanModel.addWeight(value);
+    ransModel.addWeight(value);
+  }
+  huffmanModel.GenerateHuffmanTree();
+  huffmanModel.GenerateCanonicalCodes();
+  ransModel.GenerateFrequencyTable();
+  HuffmanCodec_t huffmanCodec(huffmanModel);
+  RANSCodec_t ransCodec(ransModel);
+
+  std::vector<value_type> values(nValues);
+  for (auto& value : values) value = sample();
+
+  std::cout << "Testing codecs" << std::endl;
+  double huffmanTime = testCodecRoundtrip<uint8_t>(huffmanCodec, values, "Huffman");
+  testCodecRoundtrip<uint16_t>(huffmanCodec, values, "Huffman");
+  testCodecRoundtrip<uint32_t>(huffmanCodec, values, "Huffman");
+  double ransTime = testCodecRoundtrip<uint8_t>(ransCodec, values, "rANS");
+  testCodecRoundtrip<uint32_t>(ransCodec, values, "rANS");
+
+  double outputMB = nValues * sizeof(value_type) / 1e6;
+  std::cout << "decoding through the DataInflater" << std::endl
+            << "    Huffman: " << outputMB / huffmanTime << " MB/s" << std::endl
+            << "    rANS:    " << outputMB / ransTime << " MB/s" << std::endl;
+  return 0;
+}
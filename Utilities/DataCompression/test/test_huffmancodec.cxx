@@ -28,6 +28,7 @@
 #include <random> // std::exponential_distribution
 #include <cmath>  // std::exp
 #include <thread>
+#include <chrono>
 #include <stdexcept>  // exeptions, runtime_error
 #include "DataCompression/dc_primitives.h"
 #include "DataCompression/HuffmanCodec.h"
@@ -176,4 +177,70 @@ int main()
 
   decoderThread.join();
   std::cout << "... done" << std::endl;
+
+  ////////////////////////////////////////////////////////////////////////////
+  // canonical codes and decoding of a bit stream by lookup tables
+  //
+  std::cout << std::endl << "Reassigning codes canonically" << std::endl;
+  if (!huffmanmodel.GenerateCanonicalCodes()) {
+    throw std::runtime_error("failed to generate canonical codes");
+  }
+  Codec_t canonicalCodec(huffmanmodel);
+  if (!canonicalCodec.isCanonical()) {
+    throw std::runtime_error("decoding tables not initialized");
+  }
+
+  // encode into a bit stream, MSB to LSB in every byte
+  std::vector<DataGenerator_t::value_type> values(nRolls);
+  std::vector<uint8_t> stream(1);
+  unsigned bitPosition = 0;
+  for (auto& value : values) {
+    value = dg();
+    uint16_t codeLen = 0;
+    HuffmanModel_t::code_type code;
+    canonicalCodec.Encode(value, code, codeLen);
+    for (int bit = codeLen - 1; bit >= 0; bit--) {
+      if (code.test(bit)) stream.back() |= 0x80 >> bitPosition;
+      if (++bitPosition == 8) {
+        bitPosition = 0;
+        stream.push_back(0);
+      }
+    }
+  }
+  size_t streamBits = 8 * stream.size() - (bitPosition > 0 ? 8 - bitPosition : 8);
+
+  // decoding by tree, the code is read from the stream bit by bit
+  std::vector<DataGenerator_t::value_type> decoded(nRolls);
+  auto start = std::chrono::steady_clock::now();
+  size_t position = 0;
+  for (auto& value : decoded) {
+    HuffmanModel_t::code_type code;
+    for (unsigned bit = 0; bit < code.size(); bit++) {
+      size_t streamPosition = position + bit;
+      if (streamPosition < streamBits && (stream[streamPosition / 8] & (0x80 >> streamPosition % 8))) {
+        code.set(code.size() - 1 - bit);
+      }
+    }
+    uint16_t decodedLen = 0;
+    canonicalCodec.Decode(value, code, decodedLen);
+    position += decodedLen;
+  }
+  double treeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (decoded != values || position != streamBits) {
+    throw std::runtime_error("decoding mismatch of canonical codes by tree");
+  }
+
+  // decoding by lookup tables
+  std::fill(decoded.begin(), decoded.end(), 0);
+  start = std::chrono::steady_clock::now();
+  size_t consumed = canonicalCodec.DecodeBuffer(stream.data(), stream.size(), decoded.data(), decoded.size());
+  double tableTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (decoded != values || consumed != streamBits) {
+    throw std::runtime_error("decoding mismatch of canonical codes by lookup tables");
+  }
+
+  double outputMB = nRolls * sizeof(DataGenerator_t::value_type) / 1e6;
+  std::cout << "decoded " << nRolls << " values from " << stream.size() << " bytes" << std::endl
+            << "    tree:          " << outputMB / treeTime << " MB/s" << std::endl
+            << "    lookup tables: " << outputMB / tableTime << " MB/s" << std::endl;
 }
@@ -20,15 +20,12 @@
 
 #include "FairMQDevice.h"
 #include "Headers/DataHeader.h"
+#include "O2Device/O2MessageView.h"
 #include <stdexcept>
 
 namespace AliceO2 {
 namespace Base {
 
-/// just a typedef to express the fact that it is not just a FairMQParts vector,
-/// it has to follow the O2 convention of header-payload-header-payload
-using O2Message = FairMQParts;
-
 class O2Device : public FairMQDevice
 {
 public:
@@ -58,6 +55,7 @@ public:
     return true;
   }
 
+  /// For random access to the pairs and lookup by the data type, see O2MessageView.
   /// The user needs to define a member function with correct signature
   /// currently this is old school: buf,len pairs;
   /// In the end I'd like to move to array_view
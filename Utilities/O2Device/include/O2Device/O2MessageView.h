@@ -0,0 +1,113 @@
+/// @copyright
+/// © Copyright 2014 Copyright Holders of the ALICE O2 collaboration.
+/// See https://aliceinfo.cern.ch/AliceO2 for details on the Copyright holders.
+/// This software is distributed under the terms of the
+/// GNU General Public License version 3 (GPL Version 3).
+///
+/// License text in a separate file.
+///
+/// In applying this license, CERN does not waive the privileges and immunities
+/// granted to it by virtue of its status as an Intergovernmental Organization
+/// or submit itself to any jurisdiction.
+
+/// @headerfile O2MessageView.h
+///
+/// @brief parsed, indexed view of the header-payload pairs of an O2Message
+
+#ifndef O2MESSAGEVIEW_H_
+#define O2MESSAGEVIEW_H_
+
+#include "FairMQParts.h"
+#include "Headers/DataHeader.h"
+#include <cstdint>
+#include <vector>
+
+namespace AliceO2 {
+namespace Base {
+
+/// just a typedef to express the fact that it is not just a FairMQParts vector,
+/// it has to follow the O2 convention of header-payload-header-payload
+using O2Message = FairMQParts;
+
+/// one header-payload pair of an O2Message, pointing into the message parts
+struct O2MessagePart {
+  const byte* headerBuffer = nullptr;
+  size_t headerBufferSize = 0;
+  const byte* dataBuffer = nullptr;
+  size_t dataBufferSize = 0;
+  /// the DataHeader of the header stack, nullptr if there is none
+  const AliceO2::Header::DataHeader* dataHeader = nullptr;
+
+  /// find any other header in the stack of this part
+  template <typename T>
+  const T* getHeader() const {
+    return headerBuffer ? AliceO2::Header::get<T>(headerBuffer, headerBufferSize) : nullptr;
+  }
+};
+
+/// A view of an O2Message, built once per received message:
+/// the header stacks are walked once to find the DataHeader of every pair,
+/// after that the pairs can be accessed randomly and looked up by
+/// (dataOrigin, dataDescription, subSpecification) through a hash index.
+/// The view does not copy anything, the message must outlive it.
+/// The storage is reused when the view is parsed again, so once the number
+/// of parts stabilizes, neither parsing nor lookups allocate memory.
+///
+/// Usage:
+///   O2MessageView view;
+///   ...
+///   view.parse(message);
+///   const O2MessagePart* clusters = view.find(gDataOriginTPC, gDataDescriptionClusters, sector);
+class O2MessageView
+{
+public:
+  O2MessageView() = default;
+  explicit O2MessageView(const O2Message& parts) {
+    parse(parts);
+  }
+
+  /// (re)build the view of the message
+  /// throws std::invalid_argument if the message does not consist of header-payload pairs
+  void parse(const O2Message& parts);
+
+  /// number of header-payload pairs
+  size_t size() const {
+    return mParts.size();
+  }
+
+  const O2MessagePart& operator[](size_t i) const {
+    return mParts[i];
+  }
+
+  std::vector<O2MessagePart>::const_iterator begin() const {
+    return mParts.begin();
+  }
+
+  std::vector<O2MessagePart>::const_iterator end() const {
+    return mParts.end();
+  }
+
+  /// the first pair with given origin, description and sub specification,
+  /// nullptr if there is none
+  const O2MessagePart* find(const AliceO2::Header::DataOrigin& origin,
+                            const AliceO2::Header::DataDescription& description,
+                            uint64_t subSpecification) const;
+
+private:
+  static uint64_t hash(const AliceO2::Header::DataOrigin& origin,
+                       const AliceO2::Header::DataDescription& description,
+                       uint64_t subSpecification) {
+    uint64_t h = description.itg[0] * 0x9E3779B97F4A7C15ull;
+    h ^= (description.itg[1] ^ (uint64_t(origin.itg) << 32)) * 0xC2B2AE3D27D4EB4Full;
+    h ^= subSpecification * 0x165667B19E3779F9ull;
+    return h ^ (h >> 29);
+  }
+
+  std::vector<O2MessagePart> mParts;
+  std::vector<int32_t> mIndex; ///< open addressing hash table of part indices, -1 for empty slots
+  uint64_t mIndexMask = 0;     ///< number of used slots of mIndex - 1
+};
+
+}
+}
+#endif /* O2MESSAGEVIEW_H_ */
@@ -0,0 +1,441 @@
+/// @copyright
+/// © Copyright 2014 Copyright Holders of the ALICE O2 collaboration.
+/// See https://aliceinfo.cern.ch/AliceO2 for details on the Copyright holders.
+/// This software is distributed under the terms of the
+/// GNU General Public License version 3 (GPL Version 3).
+///
+/// License text in a separate file.
+///
+/// In applying this license, CERN does not waive the privileges and immunities
+/// granted to it by virtue of its status as an Intergovernmental Organization
+/// or submit itself to any jurisdiction.
+
+/// @headerfile RingBuffer.h
+///
+/// @brief bounded lock-free queues for handing data between the stages of a pipeline
+
+#ifndef RINGBUFFER_H_
+#define RINGBUFFER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <climits>         // for INT_MAX
+#include <linux/futex.h>   // for FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
+#include <sys/syscall.h>   // for SYS_futex
+#include <unistd.h>        // for syscall
+#endif
+
+namespace AliceO2 {
+namespace Base {
+
+/// the indices of the producer and the consumer side are kept on separate cache lines
+constexpr size_t kCacheLineSize = 64;
+
+/// Blocks the threads waiting for a condition of a queue until the other side
+/// signals a change. The waiting thread announces itself, checks the condition
+/// again and sleeps on a futex if it still does not hold. The signalling side
+/// only makes a system call if threads have announced themselves since the
+/// last notification, so a sleeping consumer is woken once and not on every
+/// push until it runs again.
+///
+///   uint32_t key = event.prepareWait();
+///   if (!condition()) { event.wait(key); }
+class EventCount
+{
+public:
+  EventCount() : mEpoch(0), mWaiters(0) {}
+
+  uint32_t prepareWait() {
+    mWaiters.fetch_add(1, std::memory_order_seq_cst);
+    // the condition checked after this point sees the changes of every
+    // notifier which has not seen the waiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return mEpoch.load(std::memory_order_acquire);
+  }
+
+  /// sleeps until notified after prepareWait returned the key
+  void wait(uint32_t key) {
+#ifdef __linux__
+    static_assert(sizeof(mEpoch) == sizeof(uint32_t), "futex requires a 32 bit word");
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&mEpoch), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+#else
+    while (mEpoch.load(std::memory_order_acquire) == key) {
+      std::this_thread::yield();
+    }
+#endif
+  }
+
+  /// wakes all waiting threads, call after changing the condition
+  void notifyAll() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // the waiters are woken once, also those which found the condition
+    // fulfilled and did not sleep
+    if (mWaiters.load(std::memory_order_relaxed) == 0 || mWaiters.exchange(0, std::memory_order_relaxed) == 0) {
+      return;
+    }
+    mEpoch.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&mEpoch), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+  }
+
+private:
+  std::atomic<uint32_t> mEpoch;
+  std::atomic<uint32_t> mWaiters;
+};
+
+/// The blocking operations of the ring buffers on top of the non-blocking
+/// batch operations tryPush and tryPop of the implementation. With _Blocking
+/// the waiting threads sleep, otherwise they spin and yield, which saves the
+/// notification on every operation if the threads have cores of their own.
+template <typename T, class Derived, bool _Blocking>
+class RingBufferBase
+{
+public:
+  RingBufferBase() : mClosed(false) {}
+
+  /// pushes the value, waits for space, returns false if the queue is closed
+  bool push(const T& value) {
+    return push(&value, 1) == 1;
+  }
+
+  /// pushes all values, waits for space, returns the number of pushed values,
+  /// which is smaller than n only if the queue has been closed
+  size_t push(const T* values, size_t n) {
+    size_t done = 0;
+    while (done < n && !isClosed()) {
+      size_t count = derived().tryPush(values + done, n - done);
+      if (count == 0) {
+        waitFor(mNotFull, [this]() { return !derived().full(); });
+      }
+      done += count;
+    }
+    return done;
+  }
+
+  /// pops one value, waits for data, returns false if the queue is closed and empty
+  bool pop(T& value) {
+    return pop(&value, 1) == 1;
+  }
+
+  /// pops up to n values, waits for at least one, returns the number of popped
+  /// values, 0 only if the queue is closed and empty
+  size_t pop(T* target, size_t n) {
+    while (true) {
+      size_t count = derived().tryPop(target, n);
+      if (count > 0 || n == 0) {
+        return count;
+      }
+      if (isClosed()) {
+        // the values pushed before closing are visible now
+        return derived().tryPop(target, n);
+      }
+      waitFor(mNotEmpty, [this]() { return !derived().empty(); });
+    }
+  }
+
+  /// marks the end of the data, the consumers drain the queue and get the
+  /// end indicated by pop, blocked producers return
+  void close() {
+    mClosed.store(true, std::memory_order_release);
+    mNotEmpty.notifyAll();
+    mNotFull.notifyAll();
+  }
+
+  bool isClosed() const {
+    return mClosed.load(std::memory_order_acquire);
+  }
+
+protected:
+  void notifyNotEmpty() {
+    if (_Blocking) {
+      mNotEmpty.notifyAll();
+    }
+  }
+
+  void notifyNotFull() {
+    if (_Blocking) {
+      mNotFull.notifyAll();
+    }
+  }
+
+private:
+  static constexpr unsigned kSpinCount = 64;
+
+  Derived& derived() {
+    return static_cast<Derived&>(*this);
+  }
+
+  /// returns when the condition holds or the queue is closed
+  template <typename Condition>
+  void waitFor(EventCount& event, Condition condition) {
+    for (unsigned i = 0; i < kSpinCount; ++i) {
+      if (condition() || isClosed()) {
+        return;
+      }
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    }
+    if (!_Blocking) {
+      std::this_thread::yield();
+      return;
+    }
+    uint32_t key = event.prepareWait();
+    if (!condition() && !isClosed()) {
+      event.wait(key);
+    }
+  }
+
+  char mPad0[kCacheLineSize];
+  EventCount mNotEmpty; ///< waited for by the consumers
+  char mPad1[kCacheLineSize - sizeof(EventCount)];
+  EventCount mNotFull; ///< waited for by the producers
+  std::atomic<bool> mClosed;
+};
+
+/// Bounded queue for one producer thread and one consumer thread.
+/// The capacity is rounded up to a power of 2. Each side keeps its index on
+/// a cache line of its own, together with a cached copy of the index of the
+/// other side, which is only reloaded when the cached value does not leave
+/// enough space or data; a batch of values is handed over with one store.
+template <typename T, bool _Blocking = true>
+class SPSCRingBuffer : public RingBufferBase<T, SPSCRingBuffer<T, _Blocking>, _Blocking>
+{
+public:
+  explicit SPSCRingBuffer(size_t capacity)
+    : mBuffer(roundUpToPowerOf2(capacity)), mMask(mBuffer.size() - 1), mTail(0), mHeadCache(0), mHead(0), mTailCache(0)
+  {
+  }
+
+  SPSCRingBuffer(const SPSCRingBuffer&) = delete;
+  SPSCRingBuffer& operator=(const SPSCRingBuffer&) = delete;
+
+  /// producer: pushes up to n values without waiting, returns the number of pushed values
+  size_t tryPush(const T* values, size_t n) {
+    size_t tail = mTail.load(std::memory_order_relaxed);
+    size_t space = capacity() - (tail - mHeadCache);
+    if (space < n) {
+      mHeadCache = mHead.load(std::memory_order_acquire);
+      space = capacity() - (tail - mHeadCache);
+    }
+    n = std::min(n, space);
+    if (n == 0) {
+      return 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      mBuffer[(tail + i) & mMask] = values[i];
+    }
+    mTail.store(tail + n, std::memory_order_release);
+    this->notifyNotEmpty();
+    return n;
+  }
+
+  bool tryPush(const T& value) {
+    return tryPush(&value, 1) == 1;
+  }
+
+  /// consumer: pops up to n values without waiting, returns the number of popped values
+  size_t tryPop(T* target, size_t n) {
+    size_t head = mHead.load(std::memory_order_relaxed);
+    size_t available = mTailCache - head;
+    if (available < n) {
+      mTailCache = mTail.load(std::memory_order_acquire);
+      available = mTailCache - head;
+    }
+    n = std::min(n, available);
+    if (n == 0) {
+      return 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      target[i] = std::move(mBuffer[(head + i) & mMask]);
+    }
+    mHead.store(head + n, std::memory_order_release);
+    this->notifyNotFull();
+    return n;
+  }
+
+  bool tryPop(T& value) {
+    return tryPop(&value, 1) == 1;
+  }
+
+  size_t capacity() const {
+    return mMask + 1;
+  }
+
+  /// the state at the time of the call, may have changed already
+  bool empty() const {
+    return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+  }
+
+  bool full() const {
+    return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire) >= capacity();
+  }
+
+private:
+  static size_t roundUpToPowerOf2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  std::vector<T> mBuffer;
+  size_t mMask;
+  char mPad0[kCacheLineSize];
+  // producer side
+  std::atomic<size_t> mTail;
+  size_t mHeadCache;
+  char mPad1[kCacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+  // consumer side
+  std::atomic<size_t> mHead;
+  size_t mTailCache;
+  char mPad2[kCacheLineSize - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};
+
+/// Bounded queue for any number of producer and consumer threads, after the
+/// queue of D. Vyukov: every cell carries a sequence number telling the
+/// position it is ready for, the producers and the consumers claim positions
+/// by a compare-and-swap of their index. A batch operation claims the
+/// consecutive ready cells with one compare-and-swap.
+template <typename T, bool _Blocking = true>
+class MPMCRingBuffer : public RingBufferBase<T, MPMCRingBuffer<T, _Blocking>, _Blocking>
+{
+public:
+  explicit MPMCRingBuffer(size_t capacity)
+    : mCapacity(roundUpToPowerOf2(std::max<size_t>(capacity, 2))), mMask(mCapacity - 1), mCells(new Cell[mCapacity]),
+      mEnqueuePos(0), mDequeuePos(0)
+  {
+    for (size_t i = 0; i < mCapacity; ++i) {
+      mCells[i].mSequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MPMCRingBuffer(const MPMCRingBuffer&) = delete;
+  MPMCRingBuffer& operator=(const MPMCRingBuffer&) = delete;
+
+  /// pushes up to n values without waiting, returns the number of pushed values
+  size_t tryPush(const T* values, size_t n) {
+    if (n == 0) {
+      return 0;
+    }
+    size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    size_t count = 0;
+    while (true) {
+      // the cells are free for the positions they are ready for
+      count = countReady(pos, n, 0);
+      if (count == 0) {
+        if (distance(pos, 0) < 0) {
+          return 0; // full
+        }
+        pos = mEnqueuePos.load(std::memory_order_relaxed);
+      } else if (mEnqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      Cell& cell = mCells[(pos + i) & mMask];
+      cell.mValue = values[i];
+      cell.mSequence.store(pos + i + 1, std::memory_order_release);
+    }
+    this->notifyNotEmpty();
+    return count;
+  }
+
+  bool tryPush(const T& value) {
+    return tryPush(&value, 1) == 1;
+  }
+
+  /// pops up to n values without waiting, returns the number of popped values
+  size_t tryPop(T* target, size_t n) {
+    if (n == 0) {
+      return 0;
+    }
+    size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+    size_t count = 0;
+    while (true) {
+      // the cells hold data for the position if they are ready for the next one
+      count = countReady(pos, n, 1);
+      if (count == 0) {
+        if (distance(pos, 1) < 0) {
+          return 0; // empty
+        }
+        pos = mDequeuePos.load(std::memory_order_relaxed);
+      } else if (mDequeuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    for (size_t i = 0; i < count; ++i) {
+      Cell& cell = mCells[(pos + i) & mMask];
+      target[i] = std::move(cell.mValue);
+      cell.mSequence.store(pos + i + mCapacity, std::memory_order_release);
+    }
+    this->notifyNotFull();
+    return count;
+  }
+
+  bool tryPop(T& value) {
+    return tryPop(&value, 1) == 1;
+  }
+
+  size_t capacity() const {
+    return mCapacity;
+  }
+
+  /// the state at the time of the call, may have changed already
+  bool empty() const {
+    return distance(mDequeuePos.load(std::memory_order_relaxed), 1) < 0;
+  }
+
+  bool full() const {
+    return distance(mEnqueuePos.load(std::memory_order_relaxed), 0) < 0;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> mSequence;
+    T mValue;
+  };
+
+  static size_t roundUpToPowerOf2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  /// sequence number of the cell of the position relative to position + offset:
+  /// 0 if ready, negative if the cell is still used for an earlier round
+  ptrdiff_t distance(size_t pos, size_t offset) const {
+    return static_cast<ptrdiff_t>(mCells[pos & mMask].mSequence.load(std::memory_order_acquire) - (pos + offset));
+  }
+
+  /// number of consecutive ready cells from the position on, at most n
+  size_t countReady(size_t pos, size_t n, size_t offset) const {
+    size_t count = 0;
+    while (count < n && count < mCapacity && distance(pos + count, offset) == 0) {
+      ++count;
+    }
+    return count;
+  }
+
+  const size_t mCapacity;
+  const size_t mMask;
+  std::unique_ptr<Cell[]> mCells;
+  char mPad0[kCacheLineSize];
+  std::atomic<size_t> mEnqueuePos;
+  char mPad1[kCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> mDequeuePos;
+  char mPad2[kCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+}
+}
+#endif
@@ -0,0 +1,130 @@
+/// @copyright
+/// © Copyright 2014 Copyright Holders of the ALICE O2 collaboration.
+/// See https://aliceinfo.cern.ch/AliceO2 for details on the Copyright holders.
+/// This software is distributed under the terms of the
+/// GNU General Public License version 3 (GPL Version 3).
+///
+/// License text in a separate file.
+///
+/// In applying this license, CERN does not waive the privileges and immunities
+/// granted to it by virtue of its status as an Intergovernmental Organization
+/// or submit itself to any jurisdiction.
+
+/// @headerfile SharedMemoryRegion.h
+///
+/// @brief preallocated shared memory segment for passing payloads between the devices of a node
+
+#ifndef SHAREDMEMORYREGION_H_
+#define SHAREDMEMORYREGION_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace AliceO2 {
+namespace Base {
+
+/// location of a payload in a SharedMemoryRegion,
+/// sent between the devices of a node instead of the payload itself
+struct RegionDescriptor {
+  uint64_t offset;     ///< offset of the payload from the beginning of the region
+  uint64_t size;       ///< size of the payload
+  uint32_t generation; ///< generation of the region the payload was written to
+  uint32_t reserved;
+};
+
+/// A named POSIX shared memory segment divided into fixed size slots.
+/// The producer creates the region, writes every payload once into a free slot
+/// and sends only the RegionDescriptor to the consumer on the same node, which
+/// attaches to the region by name and accesses the payload in place. The consumer
+/// returns the slot when it is done with the payload, e.g. from the free callback
+/// of a message pointing into the region, once the transport has sent it:
+///
+///   void* data = region.getData(descriptor);
+///   FairMQMessagePtr msg(NewMessage(data, descriptor.size, SharedMemoryRegion::freeCallback, &region));
+///
+/// The slot states live in the segment itself and are updated with atomic
+/// operations, so acquiring and releasing needs no locks and works across processes.
+/// Slots taken by a process which crashed are only recovered by recreating the region.
+///
+/// Every region has a generation, stored in its header and in the descriptors of its payloads.
+/// When the creator closes the region, or a restarted creator replaces it, the generation in the
+/// header of the old segment is changed: a consumer still mapping it sees isStale() and attaches
+/// again, and getData() refuses the descriptors of another generation than the mapped one.
+class SharedMemoryRegion
+{
+public:
+  SharedMemoryRegion() = default;
+  ~SharedMemoryRegion();
+
+  SharedMemoryRegion(const SharedMemoryRegion&) = delete;
+  SharedMemoryRegion& operator=(const SharedMemoryRegion&) = delete;
+
+  /// creates the region with numSlots slots of at least slotSize bytes, replacing
+  /// an existing region of the same name; the name is removed when the creator closes it
+  bool create(const std::string& name, size_t slotSize, uint32_t numSlots, std::string* error = nullptr);
+
+  /// attaches to the region created by another process
+  bool attach(const std::string& name, std::string* error = nullptr);
+
+  /// unmaps the region
+  void close();
+
+  bool isOpen() const {
+    return mBase != nullptr;
+  }
+
+  /// the mapped region was closed or replaced by its creator, the consumer has to attach again
+  bool isStale() const;
+
+  uint32_t getGeneration() const {
+    return mGeneration;
+  }
+
+  size_t getSlotSize() const;
+  uint32_t getNumberOfSlots() const;
+
+  /// takes a free slot, returns its index or -1 if all slots are in use
+  int acquire();
+
+  /// beginning of the slot
+  void* getSlot(int slot) const;
+
+  /// descriptor of a payload of the given size written at the beginning of the slot
+  RegionDescriptor describe(int slot, size_t size) const;
+
+  /// address of the described payload, nullptr if the descriptor does not fit into a slot
+  /// or belongs to another generation of the region
+  void* getData(const RegionDescriptor& descriptor) const;
+
+  /// returns the slot of the described payload to the region
+  void release(const RegionDescriptor& descriptor);
+
+  /// returns the slot containing the address to the region
+  void release(const void* data);
+
+  /// free function for the messages pointing into the region, hint is the region
+  static void freeCallback(void* data, void* hint);
+
+private:
+  struct Header;
+
+  Header* header() const {
+    return reinterpret_cast<Header*>(mBase);
+  }
+  std::atomic<uint32_t>* slotStates() const;
+  bool map(int fd, size_t size, std::string& reason);
+  /// changes the generation of the existing region of that name, returns the new generation
+  static uint32_t retire(const std::string& name);
+
+  char* mBase = nullptr;
+  size_t mSize = 0;
+  std::string mName;
+  uint32_t mGeneration = 0; ///< generation of the mapped region
+  bool mOwner = false; ///< created by this instance, the name is removed on close
+};
+
+}
+}
+#endif
@@ -0,0 +1,93 @@
+/// @copyright
+/// © Copyright 2014 Copyright Holders of the ALICE O2 collaboration.
+/// See https://aliceinfo.cern.ch/AliceO2 for details on the Copyright holders.
+/// This software is distributed under the terms of the
+/// GNU General Public License version 3 (GPL Version 3).
+///
+/// License text in a separate file.
+///
+/// In applying this license, CERN does not waive the privileges and immunities
+/// granted to it by virtue of its status as an Intergovernmental Organization
+/// or submit itself to any jurisdiction.
+
+/// @file O2MessageView.cxx
+
+#include "O2Device/O2MessageView.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace AliceO2::Base;
+using namespace AliceO2::Header;
+
+//__________________________________________________________________________________________________
+void O2MessageView::parse(const O2Message& parts)
+{
+  if ((parts.Size() % 2) != 0)
+    throw std::invalid_argument("number of parts in message not even (n%2 != 0)");
+
+  size_t nPairs = parts.Size() / 2;
+  mParts.resize(nPairs);
+  for (size_t i = 0; i < nPairs; ++i) {
+    O2MessagePart& part = mParts[i];
+    part = O2MessagePart();
+    const auto& header = parts.fParts[2 * i];
+    const auto& data = parts.fParts[2 * i + 1];
+    if (header) {
+      part.headerBuffer = reinterpret_cast<const byte*>(header->GetData());
+      part.headerBufferSize = header->GetSize();
+      if (part.headerBuffer && part.headerBufferSize >= sizeof(BaseHeader)) {
+        part.dataHeader = get<DataHeader>(part.headerBuffer, part.headerBufferSize);
+      }
+    }
+    if (data) {
+      part.dataBuffer = reinterpret_cast<const byte*>(data->GetData());
+      part.dataBufferSize = data->GetSize();
+    }
+  }
+
+  // index with load factor below 1/2, the table only grows
+  size_t nSlots = 8;
+  while (nSlots < 2 * nPairs) {
+    nSlots *= 2;
+  }
+  if (mIndex.size() < nSlots) {
+    mIndex.resize(nSlots);
+  }
+  mIndexMask = nSlots - 1;
+  std::fill(mIndex.begin(), mIndex.begin() + nSlots, -1);
+  for (size_t i = 0; i < nPairs; ++i) {
+    const DataHeader* dh = mParts[i].dataHeader;
+    if (!dh) continue;
+    // keep the first of the pairs with the same key
+    for (uint64_t slot = hash(dh->dataOrigin, dh->dataDescription, dh->subSpecification);; ++slot) {
+      int32_t& entry = mIndex[slot & mIndexMask];
+      if (entry < 0) {
+        entry = i;
+        break;
+      }
+      const DataHeader* other = mParts[entry].dataHeader;
+      if (other->dataOrigin == dh->dataOrigin && other->dataDescription == dh->dataDescription &&
+          other->subSpecification == dh->subSpecification) {
+        break;
+      }
+    }
+  }
+}
+
+//__________________________________________________________________________________________________
+const O2MessagePart* O2MessageView::find(const DataOrigin& origin, const DataDescription& description,
+                                         uint64_t subSpecification) const
+{
+  if (mParts.empty()) return nullptr;
+  for (uint64_t slot = hash(origin, description, subSpecification);; ++slot) {
+    int32_t entry = mIndex[slot & mIndexMask];
+    if (entry < 0) {
+      return nullptr;
+    }
+    const O2MessagePart& part = mParts[entry];
+    if (part.dataHeader->dataOrigin == origin && part.dataHeader->dataDescription == description &&
+        part.dataHeader->subSpecification == subSpecification) {
+      return &part;
+    }
+  }
+}
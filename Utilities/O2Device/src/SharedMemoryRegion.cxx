@@ -0,0 +1,307 @@
+/// @copyright
+/// © Copyright 2014 Copyright Holders of the ALICE O2 collaboration.
+/// See https://aliceinfo.cern.ch/AliceO2 for details on the Copyright holders.
+/// This software is distributed under the terms of the
+/// GNU General Public License version 3 (GPL Version 3).
+///
+/// License text in a separate file.
+///
+/// In applying this license, CERN does not waive the privileges and immunities
+/// granted to it by virtue of its status as an Intergovernmental Organization
+/// or submit itself to any jurisdiction.
+
+/// @file SharedMemoryRegion.cxx
+
+#include "O2Device/SharedMemoryRegion.h"
+#include <fcntl.h>    // for O_CREAT, O_RDWR
+#include <sys/mman.h> // for shm_open, mmap
+#include <sys/stat.h> // for fstat
+#include <unistd.h>   // for ftruncate, close
+#include <chrono>     // for the first generation
+#include <cstring>    // for memcmp, memcpy
+#include <new>        // for placement new
+
+using namespace AliceO2::Base;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "the slot states shared between processes must be lock free");
+
+namespace {
+constexpr char gRegionMagic[8] = { 'O', '2', 'S', 'H', 'M', 'R', 'E', 'G' };
+constexpr uint32_t gRegionVersion = 2;
+constexpr size_t gSlotAlignment = 64;    // cache line, slots do not share lines
+constexpr size_t gDataAlignment = 4096;  // page, the payloads start on a fresh page
+enum SlotState : uint32_t { kFree = 0, kUsed = 1 };
+
+size_t alignTo(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+/// layout of the beginning of the segment, followed by the slot states and the slots
+struct SharedMemoryRegion::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t numSlots;
+  uint64_t slotSize;
+  uint64_t slotsOffset; ///< offset of the first slot
+  uint64_t totalSize;
+  std::atomic<uint32_t> nextSlot; ///< where the search for a free slot starts
+  std::atomic<uint32_t> ready;    ///< set by the creator when the segment is initialized
+  std::atomic<uint32_t> generation; ///< changed when the creator closes or replaces the region
+};
+
+//__________________________________________________________________________________________________
+SharedMemoryRegion::~SharedMemoryRegion()
+{
+  close();
+}
+
+//__________________________________________________________________________________________________
+bool SharedMemoryRegion::create(const std::string& name, size_t slotSize, uint32_t numSlots, std::string* error)
+{
+  close();
+  std::string reason;
+  size_t statesOffset = alignTo(sizeof(Header), alignof(std::atomic<uint32_t>));
+  size_t slotsOffset = alignTo(statesOffset + numSlots * sizeof(std::atomic<uint32_t>), gDataAlignment);
+  slotSize = alignTo(slotSize > 0 ? slotSize : 1, gSlotAlignment);
+  size_t totalSize = slotsOffset + slotSize * numSlots;
+
+  // the consumers attached to the previous region keep their mapping until they see its generation
+  // change, new ones get the new region
+  uint32_t generation = retire(name);
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (numSlots == 0) {
+    reason = "no slots requested";
+  } else if (fd < 0) {
+    reason = "cannot create shared memory segment";
+  } else if (ftruncate(fd, totalSize) != 0) {
+    reason = "cannot allocate " + std::to_string(totalSize) + " bytes";
+  } else if (map(fd, totalSize, reason)) {
+    Header* hdr = header();
+    memcpy(hdr->magic, gRegionMagic, sizeof(gRegionMagic));
+    hdr->version = gRegionVersion;
+    hdr->numSlots = numSlots;
+    hdr->slotSize = slotSize;
+    hdr->slotsOffset = slotsOffset;
+    hdr->totalSize = totalSize;
+    new (&hdr->nextSlot) std::atomic<uint32_t>(0);
+    std::atomic<uint32_t>* states = slotStates();
+    for (uint32_t i = 0; i < numSlots; ++i) {
+      new (&states[i]) std::atomic<uint32_t>(kFree);
+    }
+    new (&hdr->generation) std::atomic<uint32_t>(generation);
+    new (&hdr->ready) std::atomic<uint32_t>(0);
+    hdr->ready.store(1, std::memory_order_release);
+    mName = name;
+    mGeneration = generation;
+    mOwner = true;
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  if (!mBase) {
+    if (fd >= 0) {
+      shm_unlink(name.c_str());
+    }
+    if (error) {
+      *error = name + ": " + reason;
+    }
+  }
+  return mBase != nullptr;
+}
+
+//__________________________________________________________________________________________________
+bool SharedMemoryRegion::attach(const std::string& name, std::string* error)
+{
+  close();
+  std::string reason;
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    reason = "no such shared memory segment";
+  } else if (static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    reason = "segment is not initialized yet";
+  } else if (map(fd, st.st_size, reason)) {
+    const Header* hdr = header();
+    if (memcmp(hdr->magic, gRegionMagic, sizeof(gRegionMagic)) != 0 || hdr->version != gRegionVersion) {
+      reason = "not a shared memory region";
+    } else if (hdr->ready.load(std::memory_order_acquire) == 0) {
+      reason = "segment is not initialized yet";
+    } else if (hdr->totalSize != mSize || hdr->slotsOffset + hdr->slotSize * hdr->numSlots != mSize) {
+      reason = "inconsistent segment size";
+    } else {
+      mName = name;
+      mGeneration = hdr->generation.load(std::memory_order_acquire);
+    }
+    if (mName.empty()) {
+      close();
+    }
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  if (!mBase && error) {
+    *error = name + ": " + reason;
+  }
+  return mBase != nullptr;
+}
+
+//__________________________________________________________________________________________________
+bool SharedMemoryRegion::map(int fd, size_t size, std::string& reason)
+{
+  void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    reason = "mmap failed";
+    return false;
+  }
+  mBase = static_cast<char*>(addr);
+  mSize = size;
+  return true;
+}
+
+//__________________________________________________________________________________________________
+uint32_t SharedMemoryRegion::retire(const std::string& name)
+{
+  // the first generation is taken from the clock, as the previous region may be gone already
+  uint32_t generation = static_cast<uint32_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return generation;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+    void* addr = mmap(nullptr, sizeof(Header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr != MAP_FAILED) {
+      Header* hdr = static_cast<Header*>(addr);
+      if (memcmp(hdr->magic, gRegionMagic, sizeof(gRegionMagic)) == 0 && hdr->version == gRegionVersion) {
+        generation = hdr->generation.load(std::memory_order_relaxed) + 1;
+        hdr->generation.store(generation, std::memory_order_release);
+      }
+      munmap(addr, sizeof(Header));
+    }
+  }
+  ::close(fd);
+  return generation;
+}
+
+//__________________________________________________________________________________________________
+void SharedMemoryRegion::close()
+{
+  // the consumers still attached see that the region is gone; a region already replaced by a new
+  // creator leaves the name to the new region
+  bool replaced = !mOwner || isStale();
+  if (mBase && mOwner) {
+    header()->generation.fetch_add(1, std::memory_order_release);
+  }
+  if (mBase) {
+    munmap(mBase, mSize);
+  }
+  if (!replaced) {
+    shm_unlink(mName.c_str());
+  }
+  mBase = nullptr;
+  mSize = 0;
+  mName.clear();
+  mGeneration = 0;
+  mOwner = false;
+}
+
+//__________________________________________________________________________________________________
+bool SharedMemoryRegion::isStale() const
+{
+  return mBase && header()->generation.load(std::memory_order_acquire) != mGeneration;
+}
+
+//__________________________________________________________________________________________________
+std::atomic<uint32_t>* SharedMemoryRegion::slotStates() const
+{
+  return reinterpret_cast<std::atomic<uint32_t>*>(mBase + alignTo(sizeof(Header), alignof(std::atomic<uint32_t>)));
+}
+
+//__________________________________________________________________________________________________
+size_t SharedMemoryRegion::getSlotSize() const
+{
+  return mBase ? header()->slotSize : 0;
+}
+
+//__________________________________________________________________________________________________
+uint32_t SharedMemoryRegion::getNumberOfSlots() const
+{
+  return mBase ? header()->numSlots : 0;
+}
+
+//__________________________________________________________________________________________________
+int SharedMemoryRegion::acquire()
+{
+  if (!mBase) {
+    return -1;
+  }
+  Header* hdr = header();
+  std::atomic<uint32_t>* states = slotStates();
+  uint32_t numSlots = hdr->numSlots;
+  uint32_t start = hdr->nextSlot.load(std::memory_order_relaxed);
+  // the slots are normally released in the order they were taken, so the one
+  // after the last taken is most likely free
+  for (uint32_t i = 0; i < numSlots; ++i) {
+    uint32_t slot = (start + i) % numSlots;
+    uint32_t expected = kFree;
+    if (states[slot].load(std::memory_order_relaxed) == kFree &&
+        states[slot].compare_exchange_strong(expected, kUsed, std::memory_order_acquire)) {
+      hdr->nextSlot.store((slot + 1) % numSlots, std::memory_order_relaxed);
+      return slot;
+    }
+  }
+  return -1;
+}
+
+//__________________________________________________________________________________________________
+void* SharedMemoryRegion::getSlot(int slot) const
+{
+  return mBase + header()->slotsOffset + slot * header()->slotSize;
+}
+
+//__________________________________________________________________________________________________
+RegionDescriptor SharedMemoryRegion::describe(int slot, size_t size) const
+{
+  return RegionDescriptor{ header()->slotsOffset + slot * header()->slotSize, size, mGeneration, 0 };
+}
+
+//__________________________________________________________________________________________________
+void* SharedMemoryRegion::getData(const RegionDescriptor& descriptor) const
+{
+  if (!mBase || descriptor.generation != mGeneration || descriptor.offset < header()->slotsOffset ||
+      descriptor.offset >= mSize) {
+    return nullptr;
+  }
+  // the payload must not cross the end of its slot
+  uint64_t slotSize = header()->slotSize;
+  uint64_t inSlot = (descriptor.offset - header()->slotsOffset) % slotSize;
+  if (descriptor.size > slotSize - inSlot) {
+    return nullptr;
+  }
+  return mBase + descriptor.offset;
+}
+
+//__________________________________________________________________________________________________
+void SharedMemoryRegion::release(const RegionDescriptor& descriptor)
+{
+  release(mBase + descriptor.offset);
+}
+
+//__________________________________________________________________________________________________
+void SharedMemoryRegion::release(const void* data)
+{
+  const char* ptr = static_cast<const char*>(data);
+  if (!mBase || ptr < mBase + header()->slotsOffset || ptr >= mBase + mSize) {
+    return;
+  }
+  uint64_t slot = (ptr - mBase - header()->slotsOffset) / header()->slotSize;
+  slotStates()[slot].store(kFree, std::memory_order_release);
+}
+
+//__________________________________________________________________________________________________
+void SharedMemoryRegion::freeCallback(void* data, void* hint)
+{
+  static_cast<SharedMemoryRegion*>(hint)->release(data);
+}
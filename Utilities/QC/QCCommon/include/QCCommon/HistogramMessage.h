@@ -0,0 +1,686 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <TH1.h>
+#include <TH2.h>
+#include <TH3.h>
+#include <TList.h>
+#include <TArrayD.h>
+#include <TArrayF.h>
+
+/// Compact transport format of the QC histograms, replacing the streaming of TH1F, TH1D, TH2F,
+/// TH2D, TH3F and TH3D with a TMessage. The message holds a fixed size descriptor (name, title,
+/// axes, hash of the binning, entries and statistics) followed by the raw arrays of the bin
+/// contents and of the sums of squares of weights, all aligned to 8 bytes:
+///
+///   Header | bin edges of the axes with variable bins | name | title | axis titles | draw option
+///          | [indices] | contents | [sumw2]
+///
+/// Besides the binning and the contents, only the titles of the three axes, the minimum and maximum
+/// set with SetMinimum and SetMaximum and the draw option are kept. The line, fill and marker
+/// attributes and the other axis attributes are not sent, the viewer draws with its defaults.
+///
+/// A sparse message stores only the cells with a content or an error, with their indices. Two
+/// messages with the same binning hash are added on the arrays, without ROOT objects, which are
+/// only created by the viewer. The first 8 bytes tell the format apart from a TMessage, whose
+/// bytes 4 to 8 hold the message kind.
+class HistogramMessage
+{
+public:
+  static const int MAXIMUM_DIMENSION = 3;
+
+  struct Header
+  {
+    char magic[8];
+    uint64_t binningHash;
+    uint32_t flags;
+    uint32_t dimension;
+    uint32_t numberOfCells;       ///< including the underflow and overflow cells
+    uint32_t numberOfStoredCells; ///< all cells unless the message is sparse
+    uint32_t nameLength;          ///< including the terminating null character
+    uint32_t titleLength;
+    uint32_t axisTitleLengths[MAXIMUM_DIMENSION]; ///< of all three axes, also for a TH1
+    uint32_t optionLength;
+    int32_t numberOfBins[MAXIMUM_DIMENSION];
+    uint32_t numberOfEdges[MAXIMUM_DIMENSION]; ///< 0 for fixed bins
+    double minimum[MAXIMUM_DIMENSION];
+    double maximum[MAXIMUM_DIMENSION];
+    double entries;
+    double storedMinimum; ///< -1111 if not set, as in TH1
+    double storedMaximum;
+    double statistics[TH1::kNstat];
+  };
+
+  /// Whether the object is a histogram which can be sent in the compact format: TH1, TH2 or TH3
+  /// with float or double contents, without bin labels and without functions, profiles are excluded
+  static bool canEncode(const TObject* object);
+
+  static bool isHistogramMessage(const void* data, size_t size)
+  {
+    return size >= sizeof(Header) && memcmp(data, magic(), MAGIC_LENGTH) == 0;
+  }
+
+  /// Copies and validates a received message, nullptr if it is malformed
+  static std::unique_ptr<HistogramMessage> decode(const void* data, size_t size);
+
+  /// Encodes all cells of the histogram
+  explicit HistogramMessage(TH1* histogram);
+
+  const char* getData() const { return mBuffer.data(); }
+  size_t getSize() const { return mBuffer.size(); }
+  const char* getName() const { return mBuffer.data() + mLayout.name; }
+  const char* getTitle() const { return mBuffer.data() + mLayout.title; }
+  uint64_t getBinningHash() const { return header().binningHash; }
+  double getEntries() const { return header().entries; }
+  bool isSparse() const { return (header().flags & SPARSE) != 0; }
+
+  /// Adds the cells, entries and statistics of the message
+  /// @return false if the binnings or the content types differ
+  bool add(const HistogramMessage& other);
+
+  /// Stores only the cells with a content or an error, if this makes the message smaller
+  void compact();
+
+  /// Stores all cells, needed to add messages in place
+  void expand();
+
+  /// Creates the ROOT histogram, owned by the caller and not attached to a directory
+  TH1* createHistogram() const;
+
+private:
+  enum Flags : uint32_t
+  {
+    DOUBLE_CONTENTS = 1,
+    SUMW2 = 2,
+    SPARSE = 4
+  };
+
+  struct Layout
+  {
+    size_t edges[MAXIMUM_DIMENSION];
+    size_t name;
+    size_t title;
+    size_t axisTitles[MAXIMUM_DIMENSION];
+    size_t option;
+    size_t indices;
+    size_t contents;
+    size_t sumw2;
+    size_t size;
+  };
+
+  static const size_t MAGIC_LENGTH = 8;
+  static const char* magic() { return "QCHISTv1"; }
+
+  HistogramMessage() = default;
+
+  static size_t align(size_t size) { return (size + 7) & ~size_t(7); }
+  static Layout computeLayout(const Header& header);
+  static uint64_t computeBinningHash(const Header& header, const char* buffer, const Layout& layout);
+
+  /// Allocates the buffer for the header, copies the edges, name and title of the source
+  void allocate(const Header& header, const HistogramMessage& source);
+  bool validate();
+  void enableSumw2();
+
+  template <typename T>
+  void addCells(const HistogramMessage& other);
+  template <typename T>
+  void rebuild(Header header, bool sparse);
+  template <typename TArrayType, typename T>
+  void fillHistogram(TH1* histogram) const;
+
+  Header& header() { return *reinterpret_cast<Header*>(mBuffer.data()); }
+  const Header& header() const { return *reinterpret_cast<const Header*>(mBuffer.data()); }
+
+  template <typename T>
+  T* array(size_t offset) { return reinterpret_cast<T*>(mBuffer.data() + offset); }
+  template <typename T>
+  const T* array(size_t offset) const { return reinterpret_cast<const T*>(mBuffer.data() + offset); }
+
+  std::vector<char> mBuffer;
+  Layout mLayout;
+};
+
+inline bool HistogramMessage::canEncode(const TObject* object)
+{
+  if (object == nullptr || !object->InheritsFrom(TH1::Class()) || object->InheritsFrom("TProfile") ||
+      object->InheritsFrom("TProfile2D") || object->InheritsFrom("TProfile3D")) {
+    return false;
+  }
+
+  const TH1* histogram = static_cast<const TH1*>(object);
+
+  if (dynamic_cast<const TArrayF*>(histogram) == nullptr && dynamic_cast<const TArrayD*>(histogram) == nullptr) {
+    return false;
+  }
+
+  // the fits and other functions attached to the histogram are not part of the format
+  if (histogram->GetListOfFunctions() != nullptr && histogram->GetListOfFunctions()->GetSize() > 0) {
+    return false;
+  }
+
+  return histogram->GetDimension() <= MAXIMUM_DIMENSION && histogram->GetXaxis()->GetLabels() == nullptr &&
+         histogram->GetYaxis()->GetLabels() == nullptr && histogram->GetZaxis()->GetLabels() == nullptr;
+}
+
+inline HistogramMessage::Layout HistogramMessage::computeLayout(const Header& header)
+{
+  Layout layout;
+  size_t offset = sizeof(Header);
+
+  for (int axis = 0; axis < MAXIMUM_DIMENSION; ++axis) {
+    layout.edges[axis] = offset;
+    offset += header.numberOfEdges[axis] * sizeof(double);
+  }
+
+  layout.name = offset;
+  layout.title = layout.name + header.nameLength;
+  offset = layout.title + header.titleLength;
+
+  for (int axis = 0; axis < MAXIMUM_DIMENSION; ++axis) {
+    layout.axisTitles[axis] = offset;
+    offset += header.axisTitleLengths[axis];
+  }
+
+  layout.option = offset;
+  offset = align(layout.option + header.optionLength);
+
+  layout.indices = offset;
+  if (header.flags & SPARSE) {
+    offset = align(offset + header.numberOfStoredCells * sizeof(uint32_t));
+  }
+
+  layout.contents = offset;
+  offset = align(offset + header.numberOfStoredCells * ((header.flags & DOUBLE_CONTENTS) ? sizeof(double) : sizeof(float)));
+
+  layout.sumw2 = offset;
+  if (header.flags & SUMW2) {
+    offset += header.numberOfStoredCells * sizeof(double);
+  }
+
+  layout.size = offset;
+  return layout;
+}
+
+inline uint64_t HistogramMessage::computeBinningHash(const Header& header, const char* buffer, const Layout& layout)
+{
+  // FNV-1a over the content type and the axes
+  uint64_t hash = 14695981039346656037ULL;
+  auto addBytes = [&hash](const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+  };
+
+  uint32_t contentType = header.flags & DOUBLE_CONTENTS;
+  addBytes(&contentType, sizeof(contentType));
+  addBytes(&header.dimension, sizeof(header.dimension));
+
+  for (uint32_t axis = 0; axis < header.dimension; ++axis) {
+    addBytes(&header.numberOfBins[axis], sizeof(header.numberOfBins[axis]));
+    addBytes(&header.minimum[axis], sizeof(header.minimum[axis]));
+    addBytes(&header.maximum[axis], sizeof(header.maximum[axis]));
+    addBytes(buffer + layout.edges[axis], header.numberOfEdges[axis] * sizeof(double));
+  }
+
+  return hash;
+}
+
+inline HistogramMessage::HistogramMessage(TH1* histogram)
+{
+  histogram->BufferEmpty();
+
+  bool doubleContents = dynamic_cast<TArrayD*>(histogram) != nullptr;
+  const TAxis* axes[MAXIMUM_DIMENSION] = {histogram->GetXaxis(), histogram->GetYaxis(), histogram->GetZaxis()};
+
+  Header newHeader;
+  memset(&newHeader, 0, sizeof(newHeader));
+  memcpy(newHeader.magic, magic(), MAGIC_LENGTH);
+  newHeader.flags = (doubleContents ? uint32_t(DOUBLE_CONTENTS) : 0) | (histogram->GetSumw2N() > 0 ? uint32_t(SUMW2) : 0);
+  newHeader.dimension = histogram->GetDimension();
+  newHeader.numberOfCells = histogram->GetNcells();
+  newHeader.numberOfStoredCells = newHeader.numberOfCells;
+  newHeader.nameLength = strlen(histogram->GetName()) + 1;
+  newHeader.titleLength = strlen(histogram->GetTitle()) + 1;
+  newHeader.optionLength = strlen(histogram->GetOption()) + 1;
+
+  for (int axis = 0; axis < MAXIMUM_DIMENSION; ++axis) {
+    newHeader.axisTitleLengths[axis] = strlen(axes[axis]->GetTitle()) + 1;
+  }
+
+  for (uint32_t axis = 0; axis < newHeader.dimension; ++axis) {
+    newHeader.numberOfBins[axis] = axes[axis]->GetNbins();
+    newHeader.numberOfEdges[axis] = axes[axis]->GetXbins()->GetSize();
+    newHeader.minimum[axis] = axes[axis]->GetXmin();
+    newHeader.maximum[axis] = axes[axis]->GetXmax();
+  }
+
+  newHeader.entries = histogram->GetEntries();
+  newHeader.storedMinimum = histogram->GetMinimumStored();
+  newHeader.storedMaximum = histogram->GetMaximumStored();
+  histogram->GetStats(newHeader.statistics);
+
+  mLayout = computeLayout(newHeader);
+  mBuffer.assign(mLayout.size, 0);
+  header() = newHeader;
+
+  for (uint32_t axis = 0; axis < newHeader.dimension; ++axis) {
+    // the edges array of an axis with fixed bins is empty, with a null pointer
+    if (newHeader.numberOfEdges[axis] > 0) {
+      memcpy(array<double>(mLayout.edges[axis]), axes[axis]->GetXbins()->GetArray(), newHeader.numberOfEdges[axis] * sizeof(double));
+    }
+  }
+
+  memcpy(mBuffer.data() + mLayout.name, histogram->GetName(), newHeader.nameLength);
+  memcpy(mBuffer.data() + mLayout.title, histogram->GetTitle(), newHeader.titleLength);
+
+  for (int axis = 0; axis < MAXIMUM_DIMENSION; ++axis) {
+    memcpy(mBuffer.data() + mLayout.axisTitles[axis], axes[axis]->GetTitle(), newHeader.axisTitleLengths[axis]);
+  }
+
+  memcpy(mBuffer.data() + mLayout.option, histogram->GetOption(), newHeader.optionLength);
+
+  if (doubleContents) {
+    memcpy(array<double>(mLayout.contents), dynamic_cast<TArrayD*>(histogram)->GetArray(), newHeader.numberOfCells * sizeof(double));
+  }
+  else {
+    memcpy(array<float>(mLayout.contents), dynamic_cast<TArrayF*>(histogram)->GetArray(), newHeader.numberOfCells * sizeof(float));
+  }
+
+  if (newHeader.flags & SUMW2) {
+    memcpy(array<double>(mLayout.sumw2), histogram->GetSumw2()->GetArray(), newHeader.numberOfCells * sizeof(double));
+  }
+
+  header().binningHash = computeBinningHash(header(), mBuffer.data(), mLayout);
+}
+
+inline std::unique_ptr<HistogramMessage> HistogramMessage::decode(const void* data, size_t size)
+{
+  if (!isHistogramMessage(data, size)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<HistogramMessage> message(new HistogramMessage());
+  message->mBuffer.assign(static_cast<const char*>(data), static_cast<const char*>(data) + size);
+
+  if (!message->validate()) {
+    return nullptr;
+  }
+
+  return message;
+}
+
+inline bool HistogramMessage::validate()
+{
+  const Header& h = header();
+
+  if (h.dimension < 1 || h.dimension > MAXIMUM_DIMENSION || (h.flags & ~uint32_t(DOUBLE_CONTENTS | SUMW2 | SPARSE)) != 0 ||
+      h.numberOfStoredCells > h.numberOfCells || (!(h.flags & SPARSE) && h.numberOfStoredCells != h.numberOfCells) ||
+      h.nameLength == 0 || h.titleLength == 0 || h.optionLength == 0) {
+    return false;
+  }
+
+  uint64_t numberOfCells = 1;
+
+  for (int axis = 0; axis < MAXIMUM_DIMENSION; ++axis) {
+    bool used = uint32_t(axis) < h.dimension;
+
+    if (used && (h.numberOfBins[axis] < 1 || (h.numberOfEdges[axis] != 0 && h.numberOfEdges[axis] != uint32_t(h.numberOfBins[axis]) + 1))) {
+      return false;
+    }
+    else if (!used && h.numberOfEdges[axis] != 0) {
+      return false;
+    }
+
+    if (h.axisTitleLengths[axis] == 0) {
+      return false;
+    }
+
+    numberOfCells *= used ? uint64_t(h.numberOfBins[axis]) + 2 : 1;
+  }
+
+  if (numberOfCells != h.numberOfCells) {
+    return false;
+  }
+
+  mLayout = computeLayout(h);
+
+  if (mLayout.size != mBuffer.size() || mBuffer[mLayout.name + h.nameLength - 1] != '\0' ||
+      mBuffer[mLayout.title + h.titleLength - 1] != '\0' || mBuffer[mLayout.option + h.optionLength - 1] != '\0' ||
+      computeBinningHash(h, mBuffer.data(), mLayout) != h.binningHash) {
+    return false;
+  }
+
+  for (int axis = 0; axis < MAXIMUM_DIMENSION; ++axis) {
+    if (mBuffer[mLayout.axisTitles[axis] + h.axisTitleLengths[axis] - 1] != '\0') {
+      return false;
+    }
+  }
+
+  if (h.flags & SPARSE) {
+    const uint32_t* indices = array<uint32_t>(mLayout.indices);
+
+    for (uint32_t i = 0; i < h.numberOfStoredCells; ++i) {
+      if (indices[i] >= h.numberOfCells) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+inline void HistogramMessage::allocate(const Header& newHeader, const HistogramMessage& source)
+{
+  mLayout = computeLayout(newHeader);
+  mBuffer.assign(mLayout.size, 0);
+  header() = newHeader;
+  // the edges and the strings are contiguous and unchanged
+  memcpy(mBuffer.data() + sizeof(Header), source.mBuffer.data() + sizeof(Header), mLayout.option + newHeader.optionLength - sizeof(Header));
+}
+
+inline bool HistogramMessage::add(const HistogramMessage& other)
+{
+  const Header& otherHeader = other.header();
+
+  if (header().binningHash != otherHeader.binningHash || header().numberOfCells != otherHeader.numberOfCells ||
+      header().dimension != otherHeader.dimension) {
+    return false;
+  }
+
+  expand();
+
+  if ((otherHeader.flags & SUMW2) && !(header().flags & SUMW2)) {
+    enableSumw2();
+  }
+
+  if (header().flags & DOUBLE_CONTENTS) {
+    addCells<double>(other);
+  }
+  else {
+    addCells<float>(other);
+  }
+
+  header().entries += otherHeader.entries;
+
+  for (int i = 0; i < TH1::kNstat; ++i) {
+    header().statistics[i] += otherHeader.statistics[i];
+  }
+
+  return true;
+}
+
+template <typename T>
+void HistogramMessage::addCells(const HistogramMessage& other)
+{
+  const Header& otherHeader = other.header();
+  const uint32_t numberOfCells = header().numberOfCells;
+  const uint32_t numberOfStoredCells = otherHeader.numberOfStoredCells;
+  T* __restrict__ contents = array<T>(mLayout.contents);
+  const T* __restrict__ otherContents = other.array<T>(other.mLayout.contents);
+  double* __restrict__ sumw2 = (header().flags & SUMW2) ? array<double>(mLayout.sumw2) : nullptr;
+  const double* __restrict__ otherSumw2 = (otherHeader.flags & SUMW2) ? other.array<double>(other.mLayout.sumw2) : nullptr;
+
+  if (!(otherHeader.flags & SPARSE)) {
+    // plain loops over the cells, vectorised by the compiler
+    for (uint32_t i = 0; i < numberOfCells; ++i) {
+      contents[i] += otherContents[i];
+    }
+
+    if (sumw2 != nullptr && otherSumw2 != nullptr) {
+      for (uint32_t i = 0; i < numberOfCells; ++i) {
+        sumw2[i] += otherSumw2[i];
+      }
+    }
+    else if (sumw2 != nullptr) {
+      // the errors of a histogram without weights are the contents
+      for (uint32_t i = 0; i < numberOfCells; ++i) {
+        sumw2[i] += std::fabs(otherContents[i]);
+      }
+    }
+
+    return;
+  }
+
+  const uint32_t* indices = other.array<uint32_t>(other.mLayout.indices);
+
+  for (uint32_t i = 0; i < numberOfStoredCells; ++i) {
+    contents[indices[i]] += otherContents[i];
+  }
+
+  if (sumw2 != nullptr) {
+    for (uint32_t i = 0; i < numberOfStoredCells; ++i) {
+      sumw2[indices[i]] += otherSumw2 != nullptr ? otherSumw2[i] : std::fabs(otherContents[i]);
+    }
+  }
+}
+
+inline void HistogramMessage::enableSumw2()
+{
+  expand();
+  HistogramMessage source;
+  source.mBuffer.swap(mBuffer);
+  source.mLayout = mLayout;
+
+  Header newHeader = source.header();
+  newHeader.flags |= SUMW2;
+  allocate(newHeader, source);
+
+  size_t contentSize = (newHeader.flags & DOUBLE_CONTENTS) ? sizeof(double) : sizeof(float);
+  memcpy(mBuffer.data() + mLayout.contents, source.mBuffer.data() + source.mLayout.contents, newHeader.numberOfCells * contentSize);
+
+  double* sumw2 = array<double>(mLayout.sumw2);
+
+  for (uint32_t i = 0; i < newHeader.numberOfCells; ++i) {
+    sumw2[i] = (newHeader.flags & DOUBLE_CONTENTS) ? std::fabs(array<double>(mLayout.contents)[i]) : std::fabs(array<float>(mLayout.contents)[i]);
+  }
+}
+
+template <typename T>
+void HistogramMessage::rebuild(Header newHeader, bool sparse)
+{
+  HistogramMessage source;
+  source.mBuffer.swap(mBuffer);
+  source.mLayout = mLayout;
+
+  const Header& sourceHeader = source.header();
+  const T* sourceContents = source.array<T>(source.mLayout.contents);
+  const double* sourceSumw2 = (sourceHeader.flags & SUMW2) ? source.array<double>(source.mLayout.sumw2) : nullptr;
+
+  if (sparse) {
+    newHeader.flags |= SPARSE;
+    newHeader.numberOfStoredCells = 0;
+
+    for (uint32_t i = 0; i < sourceHeader.numberOfCells; ++i) {
+      if (sourceContents[i] != 0 || (sourceSumw2 != nullptr && sourceSumw2[i] != 0)) {
+        ++newHeader.numberOfStoredCells;
+      }
+    }
+  }
+  else {
+    newHeader.flags &= ~uint32_t(SPARSE);
+    newHeader.numberOfStoredCells = newHeader.numberOfCells;
+  }
+
+  allocate(newHeader, source);
+
+  uint32_t* indices = array<uint32_t>(mLayout.indices);
+  T* contents = array<T>(mLayout.contents);
+  double* sumw2 = (newHeader.flags & SUMW2) ? array<double>(mLayout.sumw2) : nullptr;
+
+  if (sparse) {
+    uint32_t stored = 0;
+
+    for (uint32_t i = 0; i < sourceHeader.numberOfCells; ++i) {
+      if (sourceContents[i] != 0 || (sourceSumw2 != nullptr && sourceSumw2[i] != 0)) {
+        indices[stored] = i;
+        contents[stored] = sourceContents[i];
+        if (sumw2 != nullptr) {
+          sumw2[stored] = sourceSumw2[i];
+        }
+        ++stored;
+      }
+    }
+  }
+  else {
+    const uint32_t* sourceIndices = source.array<uint32_t>(source.mLayout.indices);
+
+    for (uint32_t i = 0; i < sourceHeader.numberOfStoredCells; ++i) {
+      contents[sourceIndices[i]] = sourceContents[i];
+      if (sumw2 != nullptr) {
+        sumw2[sourceIndices[i]] = sourceSumw2[i];
+      }
+    }
+  }
+}
+
+inline void HistogramMessage::compact()
+{
+  const Header& h = header();
+
+  if (h.flags & SPARSE) {
+    return;
+  }
+
+  size_t contentSize = (h.flags & DOUBLE_CONTENTS) ? sizeof(double) : sizeof(float);
+  size_t cellSize = contentSize + ((h.flags & SUMW2) ? sizeof(double) : 0);
+  size_t numberOfFilledCells = 0;
+
+  for (uint32_t i = 0; i < h.numberOfCells; ++i) {
+    bool filled = (h.flags & DOUBLE_CONTENTS) ? array<double>(mLayout.contents)[i] != 0 : array<float>(mLayout.contents)[i] != 0;
+    filled = filled || ((h.flags & SUMW2) && array<double>(mLayout.sumw2)[i] != 0);
+    numberOfFilledCells += filled;
+  }
+
+  if (numberOfFilledCells * (cellSize + sizeof(uint32_t)) >= h.numberOfCells * cellSize) {
+    return;
+  }
+
+  if (h.flags & DOUBLE_CONTENTS) {
+    rebuild<double>(h, true);
+  }
+  else {
+    rebuild<float>(h, true);
+  }
+}
+
+inline void HistogramMessage::expand()
+{
+  const Header& h = header();
+
+  if (!(h.flags & SPARSE)) {
+    return;
+  }
+
+  if (h.flags & DOUBLE_CONTENTS) {
+    rebuild<double>(h, false);
+  }
+  else {
+    rebuild<float>(h, false);
+  }
+}
+
+template <typename TArrayType, typename T>
+void HistogramMessage::fillHistogram(TH1* histogram) const
+{
+  const Header& h = header();
+  T* contents = dynamic_cast<TArrayType*>(histogram)->GetArray();
+  const T* storedContents = array<T>(mLayout.contents);
+  double* sumw2 = (h.flags & SUMW2) ? histogram->GetSumw2()->GetArray() : nullptr;
+  const double* storedSumw2 = array<double>(mLayout.sumw2);
+
+  if (h.flags & SPARSE) {
+    const uint32_t* indices = array<uint32_t>(mLayout.indices);
+
+    for (uint32_t i = 0; i < h.numberOfStoredCells; ++i) {
+      contents[indices[i]] = storedContents[i];
+      if (sumw2 != nullptr) {
+        sumw2[indices[i]] = storedSumw2[i];
+      }
+    }
+  }
+  else {
+    memcpy(contents, storedContents, h.numberOfCells * sizeof(T));
+    if (sumw2 != nullptr) {
+      memcpy(sumw2, storedSumw2, h.numberOfCells * sizeof(double));
+    }
+  }
+}
+
+inline TH1* HistogramMessage::createHistogram() const
+{
+  const Header& h = header();
+  bool doubleContents = (h.flags & DOUBLE_CONTENTS) != 0;
+  TH1* histogram = nullptr;
+  bool addDirectory = TH1::AddDirectoryStatus();
+  TH1::AddDirectory(kFALSE);
+
+  if (h.dimension == 1) {
+    if (doubleContents) {
+      histogram = new TH1D(getName(), getTitle(), h.numberOfBins[0], h.minimum[0], h.maximum[0]);
+    }
+    else {
+      histogram = new TH1F(getName(), getTitle(), h.numberOfBins[0], h.minimum[0], h.maximum[0]);
+    }
+  }
+  else if (h.dimension == 2) {
+    if (doubleContents) {
+      histogram = new TH2D(getName(), getTitle(), h.numberOfBins[0], h.minimum[0], h.maximum[0], h.numberOfBins[1], h.minimum[1], h.maximum[1]);
+    }
+    else {
+      histogram = new TH2F(getName(), getTitle(), h.numberOfBins[0], h.minimum[0], h.maximum[0], h.numberOfBins[1], h.minimum[1], h.maximum[1]);
+    }
+  }
+  else {
+    if (doubleContents) {
+      histogram = new TH3D(getName(), getTitle(), h.numberOfBins[0], h.minimum[0], h.maximum[0], h.numberOfBins[1], h.minimum[1], h.maximum[1],
+                           h.numberOfBins[2], h.minimum[2], h.maximum[2]);
+    }
+    else {
+      histogram = new TH3F(getName(), getTitle(), h.numberOfBins[0], h.minimum[0], h.maximum[0], h.numberOfBins[1], h.minimum[1], h.maximum[1],
+                           h.numberOfBins[2], h.minimum[2], h.maximum[2]);
+    }
+  }
+
+  TH1::AddDirectory(addDirectory);
+
+  TAxis* axes[MAXIMUM_DIMENSION] = {histogram->GetXaxis(), histogram->GetYaxis(), histogram->GetZaxis()};
+
+  for (uint32_t axis = 0; axis < h.dimension; ++axis) {
+    if (h.numberOfEdges[axis] > 0) {
+      axes[axis]->Set(h.numberOfBins[axis], array<double>(mLayout.edges[axis]));
+    }
+  }
+
+  for (int axis = 0; axis < MAXIMUM_DIMENSION; ++axis) {
+    axes[axis]->SetTitle(mBuffer.data() + mLayout.axisTitles[axis]);
+  }
+
+  histogram->SetMinimum(h.storedMinimum);
+  histogram->SetMaximum(h.storedMaximum);
+  histogram->SetOption(mBuffer.data() + mLayout.option);
+
+  if (h.flags & SUMW2) {
+    histogram->Sumw2();
+  }
+
+  if (doubleContents) {
+    fillHistogram<TArrayD, double>(histogram);
+  }
+  else {
+    fillHistogram<TArrayF, float>(histogram);
+  }
+
+  Double_t statistics[TH1::kNstat];
+  memcpy(statistics, h.statistics, sizeof(statistics));
+  histogram->PutStats(statistics);
+  histogram->SetEntries(h.entries);
+
+  return histogram;
+}
@@ -5,12 +5,22 @@
 
 #include <TList.h>
 
+#include "QCCommon/HistogramMessage.h"
+
+class TH1;
+
 typedef std::unordered_map<std::string, TList*> TCollectionMap;
 
+enum class MergeMode
+{
+  CollectThenMerge, ///< the objects of a title are kept until all arrived and merged at once
+  Streaming         ///< each object is added to the running result of its title when it arrives
+};
+
 class Merger
 {
 public:
-  Merger (const int numberOfQCOgbjectForCompleteData);
+  Merger (const int numberOfQCOgbjectForCompleteData, MergeMode mergeMode = MergeMode::CollectThenMerge);
 	virtual ~Merger();
 	TObject* mergeObject(TObject* object);
 	TObject* mergeObjectWithGivenCollection(TObject* object);
@@ -19,8 +29,39 @@ public:
   void dumpObjectsCollectionToFile(const char* title);
   void eraseCollection(const char* title);
 
+  /// Adds the histogram in the compact transport format to the running result of its title on the
+  /// arrays, in both merge modes. Takes the ownership of the message and returns the merged
+  /// message of the title once complete, owned by the caller, nullptr otherwise.
+  HistogramMessage* mergeMessage(HistogramMessage* message);
+
+  /// Merge of the objects of the title received so far, owned by the caller, nullptr if none was received
+  TObject* getPartialResult(const char* title) const;
+  int getNumberOfReceivedObjects(const char* title) const;
+
 private:
+  struct Accumulator
+  {
+    TObject* result;
+    int numberOfObjects;
+    std::chrono::microseconds mergeTime;
+  };
+
+  struct MessageAccumulator
+  {
+    HistogramMessage* result;
+    int numberOfObjects;
+    std::chrono::microseconds mergeTime;
+  };
+
+  TObject* addObjectToAccumulator(TObject* object);
+  bool addObject(TObject* result, TObject* object) const;
+  bool addHistogramContents(TH1* result, TH1* histogram) const;
+  static bool haveSameBinning(const TH1* first, const TH1* second);
+
+  MergeMode mMergeMode;
   TCollectionMap mTitlesToDataObjectsMap;
+  std::unordered_map<std::string, Accumulator> mTitlesToAccumulatorsMap;
+  std::unordered_map<std::string, MessageAccumulator> mTitlesToMessageAccumulatorsMap;
   std::chrono::microseconds mMergeTime {0};
   unsigned int mNumberOfDumpedObjects {0};
   const int NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA;
@@ -5,6 +5,9 @@
 #include <deque>
 #include <ctime>
 #include <chrono>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #include <boost/property_tree/ptree.hpp>
 
@@ -13,15 +16,25 @@
 #include <FairMQDevice.h>
 #include <dds_intercom.h>
 
+#include "O2Device/RingBuffer.h"
 #include "Merger.h"
 
+/// With more than one merger, the titles are sharded over as many merging threads. The device
+/// thread only receives the messages and sends the merged objects, the merging threads take the
+/// messages from a common queue, deserialize them and pass each object to the thread of its title,
+/// which merges it and serializes the merged object for the device thread.
+///
+/// The histograms in the compact transport format are merged on their arrays and sent on in the
+/// same format, the other objects are streamed with TMessage.
 class MergerDevice : public FairMQDevice
 {
 public:
   MergerDevice(std::unique_ptr<Merger> merger, std::string producerId, int numIoThreads);
+  MergerDevice(std::vector<std::unique_ptr<Merger>> mergers, std::string producerId, int numIoThreads);
   virtual ~MergerDevice();
 
   static void deleteTMessage(void* data, void* hint);
+  static void deleteHistogramMessage(void* data, void* hint);
   void establishChannel(std::string type,
                         std::string method,
                         std::string address,
@@ -30,6 +43,17 @@ public:
                         int sendBuffer);
   void executeRunLoop();
 
+  /// Starts the merging threads of the sharded merge, one per merger
+  void startMergingThreads();
+  /// Stops the merging threads and deletes the objects left in the queues
+  void stopMergingThreads();
+  /// Passes a received message to the merging threads, takes its ownership unless the queue is full
+  bool pushInput(FairMQMessage* input);
+  /// Takes a merged object serialized for the viewer, owned by the caller, false if none is ready
+  bool popMergedObject(TMessage*& message, HistogramMessage*& histogram);
+  /// The merger of the title, all objects of a title are merged by the same thread
+  unsigned getShard(const char * title) const;
+
 protected:
   virtual void Run() override;
 
@@ -40,20 +64,50 @@ private:
   boost::property_tree::ptree createCheckStateResponse(const boost::property_tree::ptree & request);
   boost::property_tree::ptree createGetMetricsResponse(const boost::property_tree::ptree & request);
 
+  /// A received object, either a ROOT object or a histogram in the compact transport format
+  struct ReceivedObject
+  {
+    TObject* object;
+    HistogramMessage* histogram;
+
+    const char* getTitle() const { return histogram != nullptr ? histogram->getTitle() : object->GetTitle(); }
+  };
+
+  /// A merged object serialized for the viewer, in the format it was received in
+  struct MergedObject
+  {
+    TMessage* message;
+    HistogramMessage* histogram;
+    double mergeTime;
+  };
+
   void handleReceivedDataObject();
-  TObject* receiveDataObjectFromProducer();
+  ReceivedObject receiveDataObjectFromProducer();
+  ReceivedObject deserializeDataObject(FairMQMessage * input) const;
+  MergedObject mergeReceivedObject(Merger & merger, const ReceivedObject & receivedObject) const;
   TMessage* createTMessageForViewer(const TObject * objectToSend) const;
-  size_t sendMergedObjectToViewer(TObject * dataObject);
+  size_t sendMergedObjectToViewer(const MergedObject & mergedObject);
+
+  void runShardedMerge();
+  void mergeShard(unsigned shard);
 
   void sendControlResponse(const boost::property_tree::ptree & response, std::string senderId);
   std::string getVmRSSUsage();
   double calculateAvgMegreTime();
   std::string calculateCpuUsage();
   double calculateNumberOfMergedObjectsPerSecond();
-  void updateMetrics();
+  void updateMetrics(double mergeTime);
   inline bool isObjectNotEmpty(const TObject * object) const;
+  inline bool isObjectNotEmpty(const ReceivedObject & object) const;
+  inline bool isObjectNotEmpty(const MergedObject & object) const;
+  void deleteObject(const ReceivedObject & object) const;
 
-  std::unique_ptr<Merger> mMerger;
+  std::vector<std::unique_ptr<Merger>> mMergers;
+  std::vector<std::thread> mMergingThreads;
+  std::unique_ptr<AliceO2::Base::MPMCRingBuffer<FairMQMessage*>> mInputQueue;
+  std::vector<std::unique_ptr<AliceO2::Base::MPMCRingBuffer<ReceivedObject>>> mShardQueues;
+  std::unique_ptr<AliceO2::Base::MPMCRingBuffer<MergedObject>> mOutputQueue;
+  std::atomic<bool> mStopMerging {false};
   dds::intercom_api::CIntercomService mService;
   std::unique_ptr<dds::intercom_api::CCustomCmd> ddsCustomCmd;
   std::deque<double> mMergeTimes;
@@ -65,6 +119,7 @@ private:
   std::ifstream procSelfStatus;
 
   const unsigned LOGGED_MESSAGES {10};
+  const size_t QUEUE_CAPACITY {1024};
   const size_t MESSAGE_MAXIMUM_SIZE = 1000000 * 1000; // Mb
 
   volatile bool mReceiveBufferOverloaded {false};
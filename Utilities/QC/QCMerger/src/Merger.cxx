@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <FairMQLogger.h>
 
 #include <TH1.h>
@@ -5,18 +7,67 @@
 #include <TH3.h>
 #include <THn.h>
 #include <TTree.h>
+#include <TArrayD.h>
+#include <TArrayF.h>
 
 #include "QCMerger/Merger.h"
 
 using namespace std;
 
-Merger::Merger (const int numberOfQCOgbjectForCompleteData) : NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA(numberOfQCOgbjectForCompleteData) 
+namespace
+{
+  template <typename T>
+  void addValues(T* __restrict__ result, const T* __restrict__ values, size_t size)
+  {
+    // plain loop over the bins, vectorised by the compiler
+    for (size_t i = 0; i < size; ++i) {
+      result[i] += values[i];
+    }
+  }
+
+  template <typename TArrayType>
+  bool addBinContents(TH1* result, TH1* histogram)
+  {
+    TArrayType* resultArray = dynamic_cast<TArrayType*>(result);
+    TArrayType* histogramArray = dynamic_cast<TArrayType*>(histogram);
+
+    if (resultArray == nullptr || histogramArray == nullptr || resultArray->GetSize() != histogramArray->GetSize()) {
+      return false;
+    }
+
+    addValues(resultArray->GetArray(), histogramArray->GetArray(), resultArray->GetSize());
+    return true;
+  }
+
+  bool haveSameAxis(const TAxis* first, const TAxis* second)
+  {
+    if (first->GetNbins() != second->GetNbins() || first->GetXmin() != second->GetXmin() ||
+        first->GetXmax() != second->GetXmax() || first->GetLabels() != nullptr || second->GetLabels() != nullptr) {
+      return false;
+    }
+
+    const TArrayD* firstBins = first->GetXbins();
+    const TArrayD* secondBins = second->GetXbins();
+
+    if (firstBins->GetSize() != secondBins->GetSize()) {
+      return false;
+    }
+
+    return equal(firstBins->GetArray(), firstBins->GetArray() + firstBins->GetSize(), secondBins->GetArray());
+  }
+}
+
+Merger::Merger (const int numberOfQCOgbjectForCompleteData, MergeMode mergeMode) : mMergeMode(mergeMode), NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA(numberOfQCOgbjectForCompleteData) 
 {
 
 }
 
 TObject* Merger::mergeObject(TObject* object)
 {
+  if (mMergeMode == MergeMode::Streaming) {
+    return addObjectToAccumulator(object);
+  }
+
   auto foundEntry = mTitlesToDataObjectsMap.find(object->GetTitle());
 
   if (foundEntry != mTitlesToDataObjectsMap.end() && foundEntry->second->GetSize() >= NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA - 1 ) {
@@ -110,6 +161,192 @@ TObject* Merger::mergeObjectWithGivenCollection(TObject* mergedObject)
   return mergedObject;
 }
 
+TObject* Merger::addObjectToAccumulator(TObject* object)
+{
+  auto measureTime = chrono::high_resolution_clock::now();
+  auto foundAccumulator = mTitlesToAccumulatorsMap.find(object->GetTitle());
+
+  if (foundAccumulator == mTitlesToAccumulatorsMap.end()) {
+    foundAccumulator = mTitlesToAccumulatorsMap.insert(make_pair(object->GetTitle(), Accumulator{object, 1, chrono::microseconds(0)})).first;
+  }
+  else {
+    if (!addObject(foundAccumulator->second.result, object)) {
+      LOG(ERROR) << "Object " << object->GetTitle() << " can not be merged, it is dropped";
+      delete object;
+      return nullptr;
+    }
+
+    foundAccumulator->second.numberOfObjects++;
+    delete object;
+  }
+
+  Accumulator& accumulator = foundAccumulator->second;
+  accumulator.mergeTime += chrono::duration_cast<std::chrono::microseconds>(chrono::high_resolution_clock::now() - measureTime);
+
+  if (accumulator.numberOfObjects >= NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA) {
+    TObject* output = accumulator.result;
+    mMergeTime = accumulator.mergeTime;
+    mTitlesToAccumulatorsMap.erase(foundAccumulator);
+    return output;
+  }
+
+  return nullptr;
+}
+
+HistogramMessage* Merger::mergeMessage(HistogramMessage* message)
+{
+  auto measureTime = chrono::high_resolution_clock::now();
+  auto foundAccumulator = mTitlesToMessageAccumulatorsMap.find(message->getTitle());
+
+  if (foundAccumulator == mTitlesToMessageAccumulatorsMap.end()) {
+    // the running result is added to in place, with all cells stored
+    message->expand();
+    foundAccumulator = mTitlesToMessageAccumulatorsMap.insert(make_pair(message->getTitle(), MessageAccumulator{message, 1, chrono::microseconds(0)})).first;
+  }
+  else {
+    if (!foundAccumulator->second.result->add(*message)) {
+      LOG(ERROR) << "Histogram " << message->getTitle() << " with a different binning can not be merged";
+      delete message;
+      return nullptr;
+    }
+
+    foundAccumulator->second.numberOfObjects++;
+    delete message;
+  }
+
+  MessageAccumulator& accumulator = foundAccumulator->second;
+  accumulator.mergeTime += chrono::duration_cast<std::chrono::microseconds>(chrono::high_resolution_clock::now() - measureTime);
+
+  if (accumulator.numberOfObjects >= NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA) {
+    HistogramMessage* output = accumulator.result;
+    output->compact();
+    mMergeTime = accumulator.mergeTime;
+    mTitlesToMessageAccumulatorsMap.erase(foundAccumulator);
+    return output;
+  }
+
+  return nullptr;
+}
+
+bool Merger::addObject(TObject* result, TObject* object) const
+{
+  if (result->IsA() != object->IsA()) {
+    LOG(ERROR) << "Object with type " << object->ClassName() << " can not be merged into " << result->ClassName();
+    return false;
+  }
+
+  if (result->InheritsFrom(TH1::Class())) {
+    TH1* histogram = static_cast<TH1*>(result);
+
+    if (haveSameBinning(histogram, static_cast<TH1*>(object)) && addHistogramContents(histogram, static_cast<TH1*>(object))) {
+      return true;
+    }
+
+    TList mergeList;
+    mergeList.Add(object);
+    return histogram->Merge(&mergeList) >= 0;
+  }
+  else if (result->InheritsFrom(THnBase::Class())) {
+    static_cast<THnBase*>(result)->Add(static_cast<THnBase*>(object));
+    return true;
+  }
+  else if (result->InheritsFrom(TTree::Class())) {
+    TList mergeList;
+    mergeList.Add(object);
+    return static_cast<TTree*>(result)->Merge(&mergeList) >= 0;
+  }
+
+  LOG(ERROR) << "Object with type " << object->ClassName() << " is not one of mergable type.";
+  return false;
+}
+
+bool Merger::haveSameBinning(const TH1* first, const TH1* second)
+{
+  return first->GetDimension() == second->GetDimension() && first->GetNcells() == second->GetNcells() &&
+         haveSameAxis(first->GetXaxis(), second->GetXaxis()) &&
+         (first->GetDimension() < 2 || haveSameAxis(first->GetYaxis(), second->GetYaxis())) &&
+         (first->GetDimension() < 3 || haveSameAxis(first->GetZaxis(), second->GetZaxis()));
+}
+
+bool Merger::addHistogramContents(TH1* result, TH1* histogram) const
+{
+  // the profiles have bin entries besides the contents, they are left to Merge
+  if (result->InheritsFrom("TProfile") || result->InheritsFrom("TProfile2D") || result->InheritsFrom("TProfile3D")) {
+    return false;
+  }
+
+  if (dynamic_cast<TArrayF*>(result) == nullptr && dynamic_cast<TArrayD*>(result) == nullptr) {
+    return false;
+  }
+
+  result->BufferEmpty();
+  histogram->BufferEmpty();
+
+  // both have the errors stored or none, taken from the contents before the addition
+  if (result->GetSumw2N() == 0 && histogram->GetSumw2N() > 0) {
+    result->Sumw2();
+  }
+  else if (result->GetSumw2N() > 0 && histogram->GetSumw2N() == 0) {
+    histogram->Sumw2();
+  }
+
+  Double_t statistics[TH1::kNstat] = {0};
+  Double_t histogramStatistics[TH1::kNstat] = {0};
+  result->GetStats(statistics);
+  histogram->GetStats(histogramStatistics);
+  Double_t entries = result->GetEntries() + histogram->GetEntries();
+
+  if (!addBinContents<TArrayF>(result, histogram) && !addBinContents<TArrayD>(result, histogram)) {
+    return false;
+  }
+
+  if (result->GetSumw2N() > 0) {
+    addValues(result->GetSumw2()->GetArray(), histogram->GetSumw2()->GetArray(), result->GetSumw2N());
+  }
+
+  for (int i = 0; i < TH1::kNstat; ++i) {
+    statistics[i] += histogramStatistics[i];
+  }
+
+  result->PutStats(statistics);
+  result->SetEntries(entries);
+  return true;
+}
+
+TObject* Merger::getPartialResult(const char* title) const
+{
+  if (mMergeMode == MergeMode::Streaming) {
+    auto foundAccumulator = mTitlesToAccumulatorsMap.find(title);
+    return foundAccumulator != mTitlesToAccumulatorsMap.end() ? foundAccumulator->second.result->Clone() : nullptr;
+  }
+
+  auto foundCollection = mTitlesToDataObjectsMap.find(title);
+
+  if (foundCollection == mTitlesToDataObjectsMap.end() || foundCollection->second->GetSize() == 0) {
+    return nullptr;
+  }
+
+  TIter next(foundCollection->second);
+  TObject* result = next()->Clone();
+
+  while (TObject* object = next()) {
+    addObject(result, object);
+  }
+
+  return result;
+}
+
+int Merger::getNumberOfReceivedObjects(const char* title) const
+{
+  if (mMergeMode == MergeMode::Streaming) {
+    auto foundAccumulator = mTitlesToAccumulatorsMap.find(title);
+    return foundAccumulator != mTitlesToAccumulatorsMap.end() ? foundAccumulator->second.numberOfObjects : 0;
+  }
+
+  auto foundCollection = mTitlesToDataObjectsMap.find(title);
+  return foundCollection != mTitlesToDataObjectsMap.end() ? foundCollection->second->GetSize() : 0;
+}
+
 double Merger::getMergeTime()
 {
   return mMergeTime.count() / 1000.0; // in miliseconds
@@ -120,4 +357,12 @@ Merger::~Merger()
   for (auto const & entry : mTitlesToDataObjectsMap) {
     entry.second->Delete();
   }
+
+  for (auto const & entry : mTitlesToAccumulatorsMap) {
+    delete entry.second.result;
+  }
+
+  for (auto const & entry : mTitlesToMessageAccumulatorsMap) {
+    delete entry.second.result;
+  }
 }
@@ -1,5 +1,6 @@
 #include <thread>
 #include <ratio>
+#include <functional>
 
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -8,6 +9,8 @@
 #include <FairMQLogger.h>
 #include <FairMQTransportFactoryZMQ.h>
 
+#include <TROOT.h>
+
 #include <dds_intercom.h>
 
 #include "QCMerger/MergerDevice.h"
@@ -18,9 +21,29 @@ using namespace std::chrono;
 using namespace boost::property_tree;
 using namespace dds;
 using namespace dds::intercom_api;
+using namespace AliceO2::Base;
+
+namespace
+{
+  vector<unique_ptr<Merger>> makeMergers(unique_ptr<Merger> merger)
+  {
+    vector<unique_ptr<Merger>> mergers;
+    mergers.push_back(move(merger));
+    return mergers;
+  }
+}
+
+MergerDevice::MergerDevice(unique_ptr<Merger> merger, string mergerId, int numIoThreads) : MergerDevice(makeMergers(move(merger)), mergerId, numIoThreads)
+{
+}
 
-MergerDevice::MergerDevice(unique_ptr<Merger> merger, string mergerId, int numIoThreads) : mMerger(move(merger)), ddsCustomCmd(new CCustomCmd(mService))
+MergerDevice::MergerDevice(vector<unique_ptr<Merger>> mergers, string mergerId, int numIoThreads) : mMergers(move(mergers)), ddsCustomCmd(new CCustomCmd(mService))
 {
+  if (mMergers.size() > 1) {
+    // the objects are streamed and merged by several threads
+    ROOT::EnableThreadSafety();
+  }
+
   this->SetTransport(new FairMQTransportFactoryZMQ);
   this->SetProperty(Id, mergerId);
   this->SetProperty(NumIoThreads, numIoThreads);
@@ -41,6 +64,11 @@ void MergerDevice::deleteTMessage(void* data, void* hint)
   delete static_cast<TMessage*>(hint);
 }
 
+void MergerDevice::deleteHistogramMessage(void* data, void* hint)
+{
+  delete static_cast<HistogramMessage*>(hint);
+}
+
 void MergerDevice::establishChannel(string type, string method,
                                     string address, 
                                     string channelName, 
@@ -148,6 +176,7 @@ boost::property_tree::ptree MergerDevice::createGetMetricsResponse(const ptree &
   response.put("VmRSS", getVmRSSUsage());
   response.put("cpu_clock", calculateCpuUsage());
   response.put("merged_objects_per_second", calculateNumberOfMergedObjectsPerSecond());
+  response.put("merging_threads", mMergers.size());
 
   mInternalMetricMessageId++;
 
@@ -164,33 +193,234 @@ void MergerDevice::sendControlResponse(const ptree & response, string senderId)
 
 void MergerDevice::Run()
 {
+  if (mMergers.size() > 1) {
+    runShardedMerge();
+    return;
+  }
+
   while (CheckCurrentState(RUNNING)) {
     handleReceivedDataObject();
   }
 }
 
+void MergerDevice::startMergingThreads()
+{
+  mInputQueue.reset(new MPMCRingBuffer<FairMQMessage*>(QUEUE_CAPACITY));
+  mOutputQueue.reset(new MPMCRingBuffer<MergedObject>(QUEUE_CAPACITY));
+  mShardQueues.clear();
+  for (unsigned shard = 0; shard < mMergers.size(); ++shard) {
+    mShardQueues.emplace_back(new MPMCRingBuffer<ReceivedObject>(QUEUE_CAPACITY));
+  }
+  mStopMerging = false;
+  for (unsigned shard = 0; shard < mMergers.size(); ++shard) {
+    mMergingThreads.emplace_back(&MergerDevice::mergeShard, this, shard);
+  }
+}
+
+void MergerDevice::stopMergingThreads()
+{
+  mStopMerging = true;
+  mOutputQueue->close();
+
+  for (auto & thread : mMergingThreads) {
+    thread.join();
+  }
+
+  mMergingThreads.clear();
+
+  FairMQMessage * input;
+  while (mInputQueue->tryPop(input)) {
+    delete input;
+  }
+
+  ReceivedObject object;
+  for (auto & shardQueue : mShardQueues) {
+    while (shardQueue->tryPop(object)) {
+      deleteObject(object);
+    }
+  }
+
+  MergedObject mergedObject;
+  while (mOutputQueue->tryPop(mergedObject)) {
+    delete mergedObject.message;
+    delete mergedObject.histogram;
+  }
+}
+
+bool MergerDevice::pushInput(FairMQMessage * input)
+{
+  return mInputQueue->tryPush(input);
+}
+
+bool MergerDevice::popMergedObject(TMessage *& message, HistogramMessage *& histogram)
+{
+  MergedObject mergedObject;
+
+  if (!mOutputQueue->tryPop(mergedObject)) {
+    return false;
+  }
+
+  message = mergedObject.message;
+  histogram = mergedObject.histogram;
+  return true;
+}
+
+void MergerDevice::runShardedMerge()
+{
+  startMergingThreads();
+
+  // the device thread never blocks on the queues, the merging threads could wait for it
+  FairMQMessage * pendingInput = nullptr;
+
+  while (CheckCurrentState(RUNNING)) {
+    bool idle = true;
+
+    if (pendingInput == nullptr) {
+      unique_ptr<FairMQMessage> input(NewMessage());
+
+      if (fChannels.at("data-in").at(0).ReceiveAsync(input) > 0) {
+        pendingInput = input.release();
+      }
+    }
+
+    if (pendingInput != nullptr) {
+      if (pushInput(pendingInput)) {
+        pendingInput = nullptr;
+        idle = false;
+        mReceiveBufferOverloaded = false;
+      } else {
+        mReceiveBufferOverloaded = true;
+      }
+    }
+
+    MergedObject mergedObject;
+
+    while (mOutputQueue->tryPop(mergedObject)) {
+      idle = false;
+      updateMetrics(mergedObject.mergeTime);
+      sendMergedObjectToViewer(mergedObject);
+    }
+
+    if (idle) {
+      this_thread::sleep_for(chrono::microseconds(100));
+    }
+  }
+
+  stopMergingThreads();
+  delete pendingInput;
+}
+
+void MergerDevice::mergeShard(unsigned shard)
+{
+  Merger & merger = *mMergers.at(shard);
+  MPMCRingBuffer<ReceivedObject> & shardQueue = *mShardQueues.at(shard);
+
+  // deserialized object waiting for space in the queue of its shard, the thread merges its own
+  // objects meanwhile, so that no thread waits for another one
+  ReceivedObject routedObject{nullptr, nullptr};
+
+  while (true) {
+    bool idle = true;
+    ReceivedObject object;
+
+    while (shardQueue.tryPop(object)) {
+      idle = false;
+      MergedObject output = mergeReceivedObject(merger, object);
+
+      if (isObjectNotEmpty(output) && !mOutputQueue->push(output)) {
+        delete output.message;
+        delete output.histogram;
+      }
+    }
+
+    if (!isObjectNotEmpty(routedObject)) {
+      FairMQMessage * input;
+
+      if (mInputQueue->tryPop(input)) {
+        idle = false;
+        routedObject = deserializeDataObject(input);
+        delete input;
+      }
+    }
+
+    if (isObjectNotEmpty(routedObject) && mShardQueues.at(getShard(routedObject.getTitle()))->tryPush(routedObject)) {
+      idle = false;
+      routedObject = ReceivedObject{nullptr, nullptr};
+    }
+
+    if (idle) {
+      if (mStopMerging) {
+        break;
+      }
+
+      this_thread::sleep_for(chrono::microseconds(100));
+    }
+  }
+
+  deleteObject(routedObject);
+}
+
+unsigned MergerDevice::getShard(const char * title) const
+{
+  return hash<string>()(title) % mMergers.size();
+}
+
 void MergerDevice::handleReceivedDataObject()
 {
-  TObject * receivedObject = receiveDataObjectFromProducer();
+  ReceivedObject receivedObject = receiveDataObjectFromProducer();
 
   if (isObjectNotEmpty(receivedObject)) {
-    TObject * mergedObject = mMerger->mergeObject(receivedObject);
+    MergedObject mergedObject = mergeReceivedObject(*mMergers.front(), receivedObject);
 
     if (isObjectNotEmpty(mergedObject)) {
-      updateMetrics();
+      updateMetrics(mergedObject.mergeTime);
       size_t messageSize = sendMergedObjectToViewer(mergedObject);
-      delete mergedObject;
     }
 
   }
 }
 
+MergerDevice::MergedObject MergerDevice::mergeReceivedObject(Merger & merger, const ReceivedObject & receivedObject) const
+{
+  MergedObject mergedObject{nullptr, nullptr, 0.};
+
+  if (receivedObject.histogram != nullptr) {
+    mergedObject.histogram = merger.mergeMessage(receivedObject.histogram);
+  } else {
+    TObject * mergedDataObject = merger.mergeObject(receivedObject.object);
+
+    if (isObjectNotEmpty(mergedDataObject)) {
+      mergedObject.message = createTMessageForViewer(mergedDataObject);
+      delete mergedDataObject;
+    }
+  }
+
+  mergedObject.mergeTime = merger.getMergeTime();
+  return mergedObject;
+}
+
 bool MergerDevice::isObjectNotEmpty(const TObject *  object) const
 {
   return object == nullptr ? false : true;
 }
 
-void MergerDevice::updateMetrics()
+bool MergerDevice::isObjectNotEmpty(const ReceivedObject & object) const
+{
+  return object.object != nullptr || object.histogram != nullptr;
+}
+
+bool MergerDevice::isObjectNotEmpty(const MergedObject & object) const
+{
+  return object.message != nullptr || object.histogram != nullptr;
+}
+
+void MergerDevice::deleteObject(const ReceivedObject & object) const
+{
+  delete object.object;
+  delete object.histogram;
+}
+
+void MergerDevice::updateMetrics(double mergeTime)
 {
   mNumberOfMergedObjects++;
 
@@ -198,7 +428,7 @@ void MergerDevice::updateMetrics()
      mMergeTimes.pop_back();
   }
 
-  mMergeTimes.push_front(mMerger->getMergeTime());
+  mMergeTimes.push_front(mergeTime);
 }
 
 TMessage* MergerDevice::createTMessageForViewer(const TObject * objectToSend) const
@@ -208,10 +438,10 @@ TMessage* MergerDevice::createTMessageForViewer(const TObject * objectToSend) co
   return viewerMessage;
 }
 
-TObject* MergerDevice::receiveDataObjectFromProducer()
+MergerDevice::ReceivedObject MergerDevice::receiveDataObjectFromProducer()
 {
   int respondeCode;
-  TObject* receivedDataObject;
+  ReceivedObject receivedDataObject;
   unique_ptr<FairMQMessage> input(NewMessage());
 
   if ((respondeCode = fChannels.at("data-in").at(0).ReceiveAsync(input)) == -2) {
@@ -230,25 +460,50 @@ TObject* MergerDevice::receiveDataObjectFromProducer()
   }
   
   if (respondeCode >= 0) {
-    TMessage*  message = new TMessageWrapper(input->GetData(), input->GetSize());
-    receivedDataObject = reinterpret_cast<TObject*>(message->ReadObject(message->GetClass()));
-    delete message;
+    receivedDataObject = deserializeDataObject(input.get());
   } else {
     LOG(ERROR) << "Received empty message from producer, nothing to merge";
-    receivedDataObject = nullptr;
+    receivedDataObject = ReceivedObject{nullptr, nullptr};
   }
 
   return receivedDataObject;
 }
 
-size_t MergerDevice::sendMergedObjectToViewer(TObject* dataObject)
+MergerDevice::ReceivedObject MergerDevice::deserializeDataObject(FairMQMessage * input) const
+{
+  if (HistogramMessage::isHistogramMessage(input->GetData(), input->GetSize())) {
+    HistogramMessage * histogram = HistogramMessage::decode(input->GetData(), input->GetSize()).release();
+
+    if (histogram == nullptr) {
+      LOG(ERROR) << "Received malformed histogram message, nothing to merge";
+    }
+
+    return ReceivedObject{nullptr, histogram};
+  }
+
+  TMessage*  message = new TMessageWrapper(input->GetData(), input->GetSize());
+  TObject* receivedDataObject = reinterpret_cast<TObject*>(message->ReadObject(message->GetClass()));
+  delete message;
+  return ReceivedObject{receivedDataObject, nullptr};
+}
+
+size_t MergerDevice::sendMergedObjectToViewer(const MergedObject & mergedObject)
 {
   int respondeCode;
-  TMessage * viewerMessage = createTMessageForViewer(dataObject);
-  unique_ptr<FairMQMessage> viewerRequest(fTransportFactory->CreateMessage(viewerMessage->Buffer(),
-                                                                           viewerMessage->BufferSize(),
-                                                                           deleteTMessage,
-                                                                           viewerMessage));
+  unique_ptr<FairMQMessage> viewerRequest;
+
+  if (mergedObject.histogram != nullptr) {
+    viewerRequest.reset(fTransportFactory->CreateMessage(const_cast<char*>(mergedObject.histogram->getData()),
+                                                         mergedObject.histogram->getSize(),
+                                                         deleteHistogramMessage,
+                                                         mergedObject.histogram));
+  } else {
+    viewerRequest.reset(fTransportFactory->CreateMessage(mergedObject.message->Buffer(),
+                                                         mergedObject.message->BufferSize(),
+                                                         deleteTMessage,
+                                                         mergedObject.message));
+  }
+
   size_t messageSize = viewerRequest->GetSize();
   if ((respondeCode = fChannels.at("data-out").at(0).SendAsync(viewerRequest)) == -2) {
     if ((respondeCode = fChannels.at("data-out").at(0).SendAsync(viewerRequest)) == -2) {
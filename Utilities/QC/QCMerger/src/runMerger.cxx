@@ -1,5 +1,9 @@
 #include <memory>
 #include <limits>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 #include <cstdlib>
 #include <cstdio>
 #include <sstream>
@@ -52,15 +56,42 @@ namespace
 
 int main(int argc, char** argv)
 {
-  CIntercomService service;
-  CKeyValue keyValue(service);
+  if (argc < NUMBER_OF_REQUIRED_PROGRAM_PARAMETERS + 1 || argc > NUMBER_OF_REQUIRED_PROGRAM_PARAMETERS + 3) {
+    LOG(ERROR) << "Not sufficient arguments value: " << NUMBER_OF_REQUIRED_PROGRAM_PARAMETERS;
+    exit(-1);
+  }
 
   const char * inputAddress = argv[1];
+  const char * MERGER_DEVICE_ID = argv[2];
+  const int NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA = atoi(argv[3]);
+  const int INPUT_BUFFER_SIZE = atoi(argv[5]);
+  const char * OUTPUT_HOST = argv[6];
+  const MergeMode MERGE_MODE = argc > NUMBER_OF_REQUIRED_PROGRAM_PARAMETERS + 1 && string(argv[7]) == "streaming" ? MergeMode::Streaming : MergeMode::CollectThenMerge;
+  const int NUMBER_OF_MERGING_THREADS = argc > NUMBER_OF_REQUIRED_PROGRAM_PARAMETERS + 2 ? max(atoi(argv[8]), 1) : 1;
+
+  // an output without protocol is the topology property holding the address of the parent merger
+  const bool OUTPUT_TO_PARENT_MERGER = string(OUTPUT_HOST).find("://") == string::npos;
+  string outputAddress = OUTPUT_HOST;
+  mutex keyMutex;
+  condition_variable keyCondition;
+  bool outputAddressReceived = !OUTPUT_TO_PARENT_MERGER;
+
+  CIntercomService service;
+  CKeyValue keyValue(service);
 
   service.subscribeOnError([](EErrorCode _errorCode, const string& _msg) {
     LOG(ERROR) << "DDS key-value error code: " << _errorCode << ", message: " << _msg;
   });
 
+  keyValue.subscribe([&](const string& _propertyID, const string& _key, const string& _value) {
+    if (OUTPUT_TO_PARENT_MERGER && _propertyID == OUTPUT_HOST) {
+      lock_guard<mutex> lock(keyMutex);
+      outputAddress = _value;
+      outputAddressReceived = true;
+      keyCondition.notify_all();
+    }
+  });
+
   service.start();
 
   localAddress << "tcp://" << exec("hostname -i") << ":" << argv[4];
@@ -69,16 +100,6 @@ int main(int argc, char** argv)
 
   keyValue.putValue(inputAddress, stringLocalAddress.c_str());
 
-  if (argc != NUMBER_OF_REQUIRED_PROGRAM_PARAMETERS + 1) {
-    LOG(ERROR) << "Not sufficient arguments value: " << NUMBER_OF_REQUIRED_PROGRAM_PARAMETERS;
-    exit(-1);
-  }
-
-  const char * MERGER_DEVICE_ID = argv[2];
-  const int NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA = atoi(argv[3]);
-  const int INPUT_BUFFER_SIZE = atoi(argv[5]);
-  const char * OUTPUT_HOST = argv[6];
-
   bpo::options_description options("task-custom-cmd options");
   options.add_options()("help,h", "Produce help message");
 
@@ -86,14 +107,27 @@ int main(int argc, char** argv)
   bpo::store(bpo::command_line_parser(argc, argv).options(options).run(), vm);
   bpo::notify(vm);
 
-  MergerDevice mergerDevice(unique_ptr<Merger>(new Merger(NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA)), MERGER_DEVICE_ID, NUMBER_OF_IO_THREADS);
+  vector<unique_ptr<Merger>> mergers;
+  for (int i = 0; i < NUMBER_OF_MERGING_THREADS; ++i) {
+    mergers.emplace_back(new Merger(NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA, MERGE_MODE));
+  }
+
+  MergerDevice mergerDevice(move(mergers), MERGER_DEVICE_ID, NUMBER_OF_IO_THREADS);
   mergerDevice.CatchSignals();
 
   LOG(INFO) << "PID: " << getpid();
   LOG(INFO) << "Merger id: " << mergerDevice.GetProperty(MergerDevice::Id, "default_id");
+  LOG(INFO) << "Merging threads: " << NUMBER_OF_MERGING_THREADS;
+
+  {
+    unique_lock<mutex> lock(keyMutex);
+    keyCondition.wait(lock, [&outputAddressReceived]() { return outputAddressReceived; });
+  }
+
+  LOG(INFO) << "Output address: " << outputAddress;
 
   mergerDevice.establishChannel("pull", "bind", stringLocalAddress.c_str(), "data-in", INPUT_BUFFER_SIZE, INPUT_BUFFER_SIZE);
-  mergerDevice.establishChannel("push", "connect", OUTPUT_HOST, "data-out", numeric_limits<int>::max(), numeric_limits<int>::max());
+  mergerDevice.establishChannel("push", "connect", outputAddress, "data-out", numeric_limits<int>::max(), numeric_limits<int>::max());
 
   mergerDevice.executeRunLoop();
 }
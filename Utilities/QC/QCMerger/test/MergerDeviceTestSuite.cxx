@@ -1,11 +1,20 @@
 #define BOOST_TEST_MODULE MergerDevice
 #define BOOST_TEST_MAIN
 
+#include <algorithm>
+#include <chrono>
+#include <map>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <boost/test/unit_test.hpp>
+#include <FairMQTransportFactoryZMQ.h>
+#include <TH1F.h>
 
 #include "QCMerger/MergerDevice.h"
+#include "QCCommon/TMessageWrapper.h"
 
 using namespace std;
 
@@ -31,6 +40,90 @@ BOOST_AUTO_TEST_CASE(createMergerDevice)
   BOOST_CHECK(mrgerDevice->GetProperty(MergerDevice::NumIoThreads, 0) == NUMBER_OF_IO_THREADS);
 }
 
+BOOST_AUTO_TEST_CASE(createShardedMergerDevice)
+{
+  vector<unique_ptr<Merger>> mergers;
+  for (int i = 0; i < 4; ++i) {
+    mergers.push_back(unique_ptr<Merger>(new Merger(NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA, MergeMode::Streaming)));
+  }
+  unique_ptr<MergerDevice> mrgerDevice(new MergerDevice(move(mergers), MERGER_DEVICE_ID, NUMBER_OF_IO_THREADS));
+
+  BOOST_CHECK(mrgerDevice->GetProperty(MergerDevice::Id, "default_id") == MERGER_DEVICE_ID);
+  BOOST_CHECK(mrgerDevice->GetProperty(MergerDevice::NumIoThreads, 0) == NUMBER_OF_IO_THREADS);
+}
+
+BOOST_AUTO_TEST_CASE(routeTitlesToShards)
+{
+  const unsigned NUMBER_OF_SHARDS = 4;
+  const int NUMBER_OF_TITLES = 16;
+  const int NUMBER_OF_ENTRIES = 100;
+
+  vector<unique_ptr<Merger>> mergers;
+  for (unsigned i = 0; i < NUMBER_OF_SHARDS; ++i) {
+    mergers.push_back(unique_ptr<Merger>(new Merger(NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA, MergeMode::Streaming)));
+  }
+  unique_ptr<MergerDevice> mrgerDevice(new MergerDevice(move(mergers), MERGER_DEVICE_ID, NUMBER_OF_IO_THREADS));
+
+  vector<string> titles;
+  vector<int> titlesPerShard(NUMBER_OF_SHARDS, 0);
+  for (int i = 0; i < NUMBER_OF_TITLES; ++i) {
+    titles.push_back("HISTOGRAM_TITLE_" + to_string(i));
+    unsigned shard = mrgerDevice->getShard(titles.back().c_str());
+    BOOST_TEST(shard < NUMBER_OF_SHARDS);
+    BOOST_TEST(mrgerDevice->getShard(titles.back().c_str()) == shard, "Shard of " << titles.back() << " is not stable");
+    titlesPerShard[shard]++;
+  }
+  BOOST_TEST(count(titlesPerShard.begin(), titlesPerShard.end(), 0) < NUMBER_OF_SHARDS - 1, "Titles not spread over the shards");
+
+  // every title is complete once all its objects went through the merging thread of its shard
+  mrgerDevice->startMergingThreads();
+  FairMQTransportFactoryZMQ transportFactory;
+
+  for (int copy = 0; copy < NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA; ++copy) {
+    for (const auto & title : titles) {
+      TH1F histogram(("HISTOGRAM_NAME_" + title).c_str(), title.c_str(), 100, -10.0, 10.0);
+      histogram.FillRandom("gaus", NUMBER_OF_ENTRIES);
+
+      TMessage * message = new TMessage(kMESS_OBJECT);
+      message->WriteObject(&histogram);
+      unique_ptr<FairMQMessage> input(transportFactory.CreateMessage(message->Buffer(), message->BufferSize(), MergerDevice::deleteTMessage, message));
+
+      BOOST_REQUIRE(mrgerDevice->pushInput(input.get()));
+      input.release();
+    }
+  }
+
+  map<string, double> mergedEntries;
+  int numberOfMergedObjects = 0;
+  auto deadline = chrono::steady_clock::now() + chrono::seconds(10);
+
+  while (numberOfMergedObjects < NUMBER_OF_TITLES && chrono::steady_clock::now() < deadline) {
+    TMessage * message = nullptr;
+    HistogramMessage * histogram = nullptr;
+
+    if (!mrgerDevice->popMergedObject(message, histogram)) {
+      this_thread::sleep_for(chrono::milliseconds(1));
+      continue;
+    }
+
+    BOOST_REQUIRE(message != nullptr);
+    TMessageWrapper wrapper(message->Buffer(), message->BufferSize());
+    unique_ptr<TObject> mergedObject(static_cast<TObject*>(wrapper.ReadObject(wrapper.GetClass())));
+    mergedEntries[mergedObject->GetTitle()] += static_cast<TH1*>(mergedObject.get())->GetEntries();
+    numberOfMergedObjects++;
+
+    delete message;
+    delete histogram;
+  }
+
+  mrgerDevice->stopMergingThreads();
+
+  BOOST_TEST(numberOfMergedObjects == NUMBER_OF_TITLES);
+  for (const auto & title : titles) {
+    BOOST_TEST(mergedEntries[title] == NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA * NUMBER_OF_ENTRIES, "Title " << title << " not merged completely");
+  }
+}
+
 BOOST_AUTO_TEST_CASE(establishChannelByMergerDevice)
 {
   unique_ptr<MergerDevice> mrgerDevice(new MergerDevice(unique_ptr<Merger>(new Merger(NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA)), MERGER_DEVICE_ID, NUMBER_OF_IO_THREADS));
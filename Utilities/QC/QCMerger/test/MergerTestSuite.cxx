@@ -3,8 +3,10 @@
 
 #include <boost/test/unit_test.hpp>
 #include <memory>
+#include <string>
 #include <vector>
 #include <TH1F.h>
+#include <TH2F.h>
 
 #include "QCMerger/MergerDevice.h"
 #include "QCMerger/Merger.h"
@@ -53,4 +55,156 @@ BOOST_AUTO_TEST_CASE(mergeTenHistograms)
 
 }
 
+BOOST_AUTO_TEST_CASE(streamTenHistograms)
+{
+  const unsigned HISTOGRAMS_TO_TEST = 10;
+  unique_ptr<Merger> merger(new Merger(NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA, MergeMode::Streaming));
+  unique_ptr<TH1F> expected(new TH1F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP));
+
+  for (int i = 0; i < HISTOGRAMS_TO_TEST; ++i) {
+    TH1F * histogram = new TH1F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP);
+    histogram->FillRandom(RANDOM_GENERATION_TYPE, NUMBER_OF_ENTRIES);
+    expected->Add(histogram);
+
+    TObject * mergedObject = merger->mergeObject(histogram);
+
+    if (i % NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA != 0) {
+      TH1F * mergedHistogram = reinterpret_cast<TH1F*>(mergedObject);
+      BOOST_TEST(mergedHistogram->GetEntries() == (NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA * NUMBER_OF_ENTRIES));
+      BOOST_TEST(mergedHistogram->GetMean() == expected->GetMean(), boost::test_tools::tolerance(1e-9));
+
+      for (int bin = 0; bin <= NUMBER_OF_BINS + 1; ++bin) {
+        BOOST_TEST(mergedHistogram->GetBinContent(bin) == expected->GetBinContent(bin));
+      }
+
+      delete mergedObject;
+      expected->Reset();
+    } else {
+      if (mergedObject != nullptr) {
+        BOOST_FAIL("Object should not be merged " << mergedObject->GetName());
+      }
+
+      unique_ptr<TObject> partialResult(merger->getPartialResult(HISTOGRAM_TITLE));
+      BOOST_TEST(reinterpret_cast<TH1F*>(partialResult.get())->GetEntries() == NUMBER_OF_ENTRIES);
+      BOOST_TEST(merger->getNumberOfReceivedObjects(HISTOGRAM_TITLE) == 1);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(streamDropsObjectsOfOtherType)
+{
+  unique_ptr<Merger> merger(new Merger(NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA, MergeMode::Streaming));
+
+  TH1F * first = new TH1F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP);
+  first->FillRandom(RANDOM_GENERATION_TYPE, NUMBER_OF_ENTRIES);
+  BOOST_TEST(merger->mergeObject(first) == nullptr);
+
+  TH2F * otherType = new TH2F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP, NUMBER_OF_BINS, X_LOW, X_UP);
+  BOOST_TEST(merger->mergeObject(otherType) == nullptr);
+
+  TH1F * second = new TH1F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP);
+  second->FillRandom(RANDOM_GENERATION_TYPE, NUMBER_OF_ENTRIES);
+  unique_ptr<TObject> mergedObject(merger->mergeObject(second));
+
+  BOOST_REQUIRE(mergedObject != nullptr);
+  BOOST_TEST(reinterpret_cast<TH1F*>(mergedObject.get())->GetEntries() == (NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA * NUMBER_OF_ENTRIES));
+}
+
+BOOST_AUTO_TEST_CASE(mergeTenHistogramMessages)
+{
+  const unsigned HISTOGRAMS_TO_TEST = 10;
+  unique_ptr<Merger> merger(new Merger(NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA));
+  unique_ptr<TH1F> expected(new TH1F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP));
+
+  for (int i = 0; i < HISTOGRAMS_TO_TEST; ++i) {
+    unique_ptr<TH1F> histogram(new TH1F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP));
+    histogram->FillRandom(RANDOM_GENERATION_TYPE, NUMBER_OF_ENTRIES);
+    expected->Add(histogram.get());
+
+    unique_ptr<HistogramMessage> sentMessage(new HistogramMessage(histogram.get()));
+    sentMessage->compact();
+    BOOST_TEST(HistogramMessage::isHistogramMessage(sentMessage->getData(), sentMessage->getSize()));
+
+    HistogramMessage * receivedMessage = HistogramMessage::decode(sentMessage->getData(), sentMessage->getSize()).release();
+    BOOST_REQUIRE(receivedMessage != nullptr);
+
+    unique_ptr<HistogramMessage> mergedMessage(merger->mergeMessage(receivedMessage));
+
+    if (i % NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA != 0) {
+      BOOST_REQUIRE(mergedMessage != nullptr);
+      unique_ptr<TH1> mergedHistogram(mergedMessage->createHistogram());
+
+      BOOST_TEST(mergedHistogram->GetName() == HISTOGRAM_NAME);
+      BOOST_TEST(mergedHistogram->GetEntries() == (NUMBER_OF_QC_OBJECTS_FOR_COMPLETE_DATA * NUMBER_OF_ENTRIES));
+      BOOST_TEST(mergedHistogram->GetMean() == expected->GetMean(), boost::test_tools::tolerance(1e-9));
+
+      for (int bin = 0; bin <= NUMBER_OF_BINS + 1; ++bin) {
+        BOOST_TEST(mergedHistogram->GetBinContent(bin) == expected->GetBinContent(bin));
+      }
+
+      expected->Reset();
+    } else {
+      BOOST_TEST(mergedMessage.get() == nullptr);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(addSparseHistogramMessages)
+{
+  unique_ptr<TH2F> first(new TH2F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP, NUMBER_OF_BINS, X_LOW, X_UP));
+  first->Fill(1.0, 1.0);
+  unique_ptr<HistogramMessage> firstMessage(new HistogramMessage(first.get()));
+  firstMessage->compact();
+  BOOST_TEST(firstMessage->isSparse());
+
+  unique_ptr<TH2F> second(new TH2F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP, NUMBER_OF_BINS, X_LOW, X_UP));
+  second->Fill(2.0, 2.0, 3.0);
+  unique_ptr<HistogramMessage> secondMessage(new HistogramMessage(second.get()));
+  secondMessage->compact();
+  BOOST_TEST(secondMessage->isSparse());
+
+  BOOST_TEST(firstMessage->add(*secondMessage));
+  BOOST_TEST(!firstMessage->isSparse());
+  unique_ptr<TH1> sum(firstMessage->createHistogram());
+  BOOST_TEST(sum->GetBinContent(sum->FindBin(1.0, 1.0)) == 1.0);
+  BOOST_TEST(sum->GetBinContent(sum->FindBin(2.0, 2.0)) == 3.0);
+  BOOST_TEST(sum->GetEntries() == 2);
+
+  unique_ptr<TH1F> otherBinning(new TH1F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS / 2, X_LOW, X_UP));
+  HistogramMessage otherMessage(otherBinning.get());
+  BOOST_TEST(!firstMessage->add(otherMessage));
+}
+
+BOOST_AUTO_TEST_CASE(keepDrawingAttributesInHistogramMessages)
+{
+  unique_ptr<TH2F> histogram(new TH2F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP, NUMBER_OF_BINS, X_LOW, X_UP));
+  histogram->GetXaxis()->SetTitle("x [cm]");
+  histogram->GetYaxis()->SetTitle("y [cm]");
+  histogram->GetZaxis()->SetTitle("entries");
+  histogram->SetMaximum(50.0);
+  histogram->SetOption("colz");
+  histogram->Fill(1.0, 1.0);
+
+  HistogramMessage message(histogram.get());
+  message.compact();
+  unique_ptr<HistogramMessage> receivedMessage(HistogramMessage::decode(message.getData(), message.getSize()));
+  BOOST_REQUIRE(receivedMessage != nullptr);
+  BOOST_TEST(receivedMessage->add(message));
+
+  unique_ptr<TH1> mergedHistogram(receivedMessage->createHistogram());
+  BOOST_TEST(mergedHistogram->GetXaxis()->GetTitle() == string("x [cm]"));
+  BOOST_TEST(mergedHistogram->GetYaxis()->GetTitle() == string("y [cm]"));
+  BOOST_TEST(mergedHistogram->GetZaxis()->GetTitle() == string("entries"));
+  BOOST_TEST(mergedHistogram->GetMaximumStored() == 50.0);
+  BOOST_TEST(mergedHistogram->GetMinimumStored() == histogram->GetMinimumStored());
+  BOOST_TEST(mergedHistogram->GetOption() == string("colz"));
+
+  // the fitted functions are not kept, such histograms are streamed
+  unique_ptr<TH1F> fitted(new TH1F(HISTOGRAM_NAME, HISTOGRAM_TITLE, NUMBER_OF_BINS, X_LOW, X_UP));
+  fitted->FillRandom(RANDOM_GENERATION_TYPE, NUMBER_OF_ENTRIES);
+  BOOST_TEST(HistogramMessage::canEncode(fitted.get()));
+  fitted->Fit(RANDOM_GENERATION_TYPE, "Q0");
+  BOOST_TEST(!HistogramMessage::canEncode(fitted.get()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #include <dds_intercom.h>
 
 #include "QCProducer/Producer.h"
+#include "QCCommon/HistogramMessage.h"
 
 class ProducerDevice : public FairMQDevice
 {
@@ -16,6 +17,7 @@ public:
   virtual ~ProducerDevice() = default;
 
   static void deleteTMessage(void* data, void* hint);
+  static void deleteHistogramMessage(void* data, void* hint);
   void executeRunLoop();
   void establishChannel(std::string type, std::string method, std::string address, std::string channelName, const int bufferSize);
 
@@ -34,6 +36,7 @@ private:
 
   void subscribeDdsCommands();
   void sendDataToMerger(std::unique_ptr<FairMQMessage> request);
+  std::unique_ptr<FairMQMessage> createMessageForMerger(TObject* dataObject);
   bool outputLimitReached();
   int getCurrentSecond() const;
   void waitForLimitUnlock();
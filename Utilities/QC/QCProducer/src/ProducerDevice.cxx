@@ -30,14 +30,16 @@ void ProducerDevice::deleteTMessage(void* data, void* hint)
   delete static_cast<TMessage*>(hint);
 }
 
+void ProducerDevice::deleteHistogramMessage(void* data, void* hint)
+{
+  delete static_cast<HistogramMessage*>(hint);
+}
+
 void ProducerDevice::Run()
 {
   while (CheckCurrentState(RUNNING)) {
     TObject* newDataObject = mProducer->produceData();
-    TMessage* message = new TMessage(kMESS_OBJECT);
-    message->WriteObject(newDataObject);
-
-    unique_ptr<FairMQMessage> request(NewMessage(message->Buffer(), message->BufferSize(), deleteTMessage, message));
+    unique_ptr<FairMQMessage> request(createMessageForMerger(newDataObject));
 
     if (outputLimitReached()) {
       waitForLimitUnlock();
@@ -50,6 +52,20 @@ void ProducerDevice::Run()
   }
 }
 
+unique_ptr<FairMQMessage> ProducerDevice::createMessageForMerger(TObject* dataObject)
+{
+  // the histograms are sent in the compact format, merged without ROOT objects
+  if (HistogramMessage::canEncode(dataObject)) {
+    HistogramMessage* histogram = new HistogramMessage(static_cast<TH1*>(dataObject));
+    histogram->compact();
+    return unique_ptr<FairMQMessage>(NewMessage(const_cast<char*>(histogram->getData()), histogram->getSize(), deleteHistogramMessage, histogram));
+  }
+
+  TMessage* message = new TMessage(kMESS_OBJECT);
+  message->WriteObject(dataObject);
+  return unique_ptr<FairMQMessage>(NewMessage(message->Buffer(), message->BufferSize(), deleteTMessage, message));
+}
+
 bool ProducerDevice::outputLimitReached()
 {
   bool output;
@@ -8,6 +8,7 @@
 
 #include "QCViewer/ViewerDevice.h"
 #include "QCCommon/TMessageWrapper.h"
+#include "QCCommon/HistogramMessage.h"
 
 using namespace std;
 
@@ -57,12 +58,17 @@ TObject* ViewerDevice::receiveDataObjectFromMerger()
   TObject* receivedObject;
   unique_ptr<FairMQMessage> request(NewMessage());
 
-  if (fChannels.at("data-in").at(0).ReceiveAsync(request) >= 0) {
-    TMessageWrapper tm(request->GetData(), request->GetSize());
-    receivedObject = static_cast<TObject*>(tm.ReadObject(tm.GetClass()));
+  if (fChannels.at("data-in").at(0).ReceiveAsync(request) < 0) {
+    receivedObject = nullptr;
+  }
+  else if (HistogramMessage::isHistogramMessage(request->GetData(), request->GetSize())) {
+    // the histograms merged in the compact format are only turned into ROOT objects here
+    unique_ptr<HistogramMessage> histogram(HistogramMessage::decode(request->GetData(), request->GetSize()));
+    receivedObject = histogram != nullptr ? histogram->createHistogram() : nullptr;
   }
   else {
-    receivedObject = nullptr;
+    TMessageWrapper tm(request->GetData(), request->GetSize());
+    receivedObject = static_cast<TObject*>(tm.ReadObject(tm.GetClass()));
   }
 
   return receivedObject;
@@ -58,6 +58,10 @@ class SystemInterface;
 ///                 0  HOMER format
 ///                 1  blocks in multiple messages
 ///                 2  blocks concatenated in one message (default)
+///                 3  block descriptors and payloads in multiple messages,
+///                    with an allocation callback the output buffer of the
+///                    component is allocated as message memory and the
+///                    payloads are sent from there without copy
 ///
 class Component {
 public:
@@ -89,6 +93,8 @@ private:
 
   /// output buffer to receive the data produced by component
   std::vector<AliHLTUInt8_t> mOutputBuffer;
+  /// size of the output buffer, the largest size requested so far
+  unsigned mOutputBufferSize;
 
   /// instance of the system interface
   SystemInterface* mpSystem;
@@ -63,6 +63,9 @@ public:
     kOutputModeMultiPart,
     // all blocks as sequence of header and payload
     kOutputModeSequence,
+    // each block as two parts of a multi-part output, the block descriptor and the
+    // payload, which is not copied but referenced where the component has written it
+    kOutputModeInPlace,
     kOutputModeLast
   };
 
@@ -72,6 +75,9 @@ public:
   // set output mode
   void setOutputMode(unsigned mode) {mOutputMode=mode;}
 
+  // get output mode
+  int getOutputMode() const {return mOutputMode;}
+
   // add message
   // this will extract the block descriptors from the message
   // the descriptors refer to data in the original message buffer
@@ -82,6 +88,11 @@ public:
   // the descriptors refer to data in the original message buffer
   int addMessages(const std::vector<BufferDesc_t>& list);
 
+  // add a message with a single block descriptor, optionally preceded by the event
+  // header, the payload of the block is the following message (kOutputModeInPlace)
+  // return number of payload messages used, 0 or 1, negative if not in this format
+  int addBlockDescriptor(AliHLTUInt8_t* buffer, unsigned size, const BufferDesc_t* payload);
+
   // add a block descriptor and its payload to the message
   // planned for future extension
   //int AddOutput(AliHLTComponentBlockData* db);
@@ -98,6 +109,8 @@ public:
 
   // create message payloads in the internal buffer and return list
   // of decriptors
+  // in kOutputModeInPlace only the block descriptors are written, the payload
+  // descriptors point to the blocks in the output buffer of the component
   std::vector<BufferDesc_t> createMessages(const AliHLTComponentBlockData* blocks, unsigned count,
                                            unsigned totalPayloadSize, const AliHLTComponentEventData& evtData,
                                            boost::signals2::signal<unsigned char* (unsigned int)> *cbAllocate=nullptr);
@@ -20,6 +20,7 @@
 //  @brief  FairRoot/ALFA device running ALICE HLT code
 
 #include "FairMQDevice.h"
+#include <memory>
 #include <vector>
 
 class FairMQMessage;
@@ -81,9 +82,17 @@ private:
   /// create a new message with data buffer of specified size
   unsigned char* createMessageBuffer(unsigned size);
 
+  /// create an output message referring to data in one of the buffers, which is
+  /// kept until the message has been sent, nullptr if the data is in none of them
+  std::unique_ptr<FairMQMessage> createMessageInBuffer(unsigned char* data, unsigned size);
+
+  /// release the reference to the buffer of a sent message
+  static void releaseMessageBuffer(void* data, void* hint);
+
   Component* mComponent;     // component instance
   std::vector<char*> mArgv;       // array of arguments for the component
   std::vector<std::unique_ptr<FairMQMessage>> mMessages; // array of output messages
+  std::vector<std::shared_ptr<FairMQMessage>> mBuffers; // messages allocated for the component and input messages
 
   int mPollingPeriod;        // period of polling on input sockets in ms
   int mSkipProcessing;       // skip component processing
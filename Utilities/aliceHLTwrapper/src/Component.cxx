@@ -37,6 +37,7 @@ using std::vector;
 
 Component::Component()
   : mOutputBuffer()
+  , mOutputBufferSize(0)
   , mpSystem(NULL)
   , mProcessor(kEmptyHLTComponentHandle)
   , mFormatHandler()
@@ -98,9 +99,7 @@ int Component::init(int argc, char** argv)
         std::stringstream(optarg) >> runNumber;
         break;
       case 's': {
-        unsigned size = 0;
-        std::stringstream(optarg) >> size;
-        mOutputBuffer.resize(size);
+        std::stringstream(optarg) >> mOutputBufferSize;
       } break;
       case 'm': {
         unsigned outputMode;
@@ -224,6 +223,12 @@ int Component::process(vector<MessageFormat::BufferDesc_t>& dataArray,
   eventTypeBlock.fSpecification = gkAliEventTypeData;
   inputBlocks.push_back(eventTypeBlock);
 
+  // in the in place output mode the component writes to message memory allocated
+  // through the callback, from where the output blocks are sent without copy
+  bool outputInPlace = cbAllocate != nullptr && mFormatHandler.getOutputMode() == MessageFormat::kOutputModeInPlace;
+  AliHLTUInt8_t* pOutputBuffer = NULL;
+  unsigned outputBufferCapacity = 0;
+
   // process
   evtData.fBlockCnt = inputBlocks.size();
   int nofTrials = 2;
@@ -236,14 +241,25 @@ int Component::process(vector<MessageFormat::BufferDesc_t>& dataArray,
     outputBufferSize+=sizeof(AliHLTComponentStatistics) + sizeof(AliHLTComponentTableEntry);
     // take the full available buffer and increase if that
     // is too little
-    mOutputBuffer.resize(mOutputBuffer.capacity());
-    if (mOutputBuffer.size() < outputBufferSize) {
-      mOutputBuffer.resize(outputBufferSize);
+    if (mOutputBufferSize < outputBufferSize) {
+      mOutputBufferSize = outputBufferSize;
     } else if (nofTrials < 2) {
       // component did not update the output size
       break;
     }
-    outputBufferSize = mOutputBuffer.size();
+    outputBufferSize = mOutputBufferSize;
+    if (outputInPlace) {
+      // a buffer allocated in an earlier trial is released by the device
+      pOutputBuffer = *(*cbAllocate)(outputBufferSize);
+      if (pOutputBuffer == NULL) {
+        cerr << "error: can not allocate output buffer of size " << outputBufferSize << endl;
+        return -ENOMEM;
+      }
+    } else {
+      mOutputBuffer.resize(outputBufferSize);
+      pOutputBuffer = &mOutputBuffer[0];
+    }
+    outputBufferCapacity = outputBufferSize;
     outputBlockCnt = 0;
     // TODO: check if that is working with the corresponding allocation method of the
     // component environment
@@ -253,26 +269,20 @@ int Component::process(vector<MessageFormat::BufferDesc_t>& dataArray,
     pEventDoneData = NULL;
 
     iResult = mpSystem->processEvent(mProcessor, &evtData, &inputBlocks[0], &trigData,
-                                     &mOutputBuffer[0], &outputBufferSize,
+                                     pOutputBuffer, &outputBufferSize,
                                      &outputBlockCnt, &pOutputBlocks,
                                      &pEventDoneData);
-    if (outputBufferSize > 0) {
-      if (outputBufferSize > mOutputBuffer.size()) {
-        cerr << "fatal error: component writing beyond buffer capacity" << endl;
-        return -EFAULT;
-      } else if (outputBufferSize < mOutputBuffer.size()) {
-        mOutputBuffer.resize(outputBufferSize);
-      }
-    } else {
-      mOutputBuffer.clear();
+    if (outputBufferSize > outputBufferCapacity) {
+      cerr << "fatal error: component writing beyond buffer capacity" << endl;
+      return -EFAULT;
     }
 
   } while (iResult == ENOSPC && --nofTrials > 0);
 
   // prepare output
   { // keep this after removing condition to preserve formatting
-    AliHLTUInt8_t* pOutputBufferStart = &mOutputBuffer[0];
-    AliHLTUInt8_t* pOutputBufferEnd = pOutputBufferStart + mOutputBuffer.size();
+    AliHLTUInt8_t* pOutputBufferStart = pOutputBuffer;
+    AliHLTUInt8_t* pOutputBufferEnd = pOutputBufferStart + outputBufferSize;
     // consistency check for data blocks
     // 1) all specified data must be either inside the output buffer given
     //    to the component or in one of the input buffers
@@ -296,7 +306,7 @@ int Component::process(vector<MessageFormat::BufferDesc_t>& dataArray,
 
       // calculate the data reference
       AliHLTUInt8_t* pStart =
-        pOutputBlock->fPtr != NULL ? reinterpret_cast<AliHLTUInt8_t*>(pOutputBlock->fPtr) : &mOutputBuffer[0];
+        pOutputBlock->fPtr != NULL ? reinterpret_cast<AliHLTUInt8_t*>(pOutputBlock->fPtr) : pOutputBuffer;
       pStart += pOutputBlock->fOffset;
       AliHLTUInt8_t* pEnd = pStart + pOutputBlock->fSize;
       pOutputBlock->fPtr = pStart;
@@ -329,8 +339,7 @@ int Component::process(vector<MessageFormat::BufferDesc_t>& dataArray,
     evtData.fBlockCnt=validBlocks;
 
     // create the messages
-    // TODO: for now there is an extra copy of the data, but it should be
-    // handled in place
+    // the data is copied to the messages, except in the in place output mode
     vector<MessageFormat::BufferDesc_t> outputMessages =
       mFormatHandler.createMessages(pOutputBlocks, validBlocks, totalPayloadSize, evtData, cbAllocate);
     dataArray.insert(dataArray.end(), outputMessages.begin(), outputMessages.end());
@@ -121,7 +121,16 @@ int MessageFormat::addMessages(const vector<BufferDesc_t>& list)
   for (vector<BufferDesc_t>::const_iterator data = list.begin(); data != list.end(); data++, i++) {
     if (data->mSize > 0) {
       unsigned nofEventHeaders=mListEvtData.size();
-      int result = addMessage(data->mP, data->mSize);
+      // block descriptor and payload in separate messages
+      const BufferDesc_t* payload = (data + 1 != list.end()) ? &*(data + 1) : NULL;
+      int result = addBlockDescriptor(data->mP, data->mSize, payload);
+      if (result >= 0) {
+        totalCount++;
+        data += result;
+        i += result;
+        continue;
+      }
+      result = addMessage(data->mP, data->mSize);
       if (result >= 0)
         totalCount += result;
       else {
@@ -134,6 +143,37 @@ int MessageFormat::addMessages(const vector<BufferDesc_t>& list)
   return 0;
 }
 
+int MessageFormat::addBlockDescriptor(AliHLTUInt8_t* buffer, unsigned size, const BufferDesc_t* payload)
+{
+  // add a message with a single block descriptor, the payload of the block is
+  // the following message
+  // a descriptor without its payload is not valid in any of the other formats
+  unsigned position=0;
+  AliHLTComponentEventData* evtData=reinterpret_cast<AliHLTComponentEventData*>(buffer);
+  if (size==sizeof(AliHLTComponentEventData)+sizeof(AliHLTComponentBlockData) &&
+      evtData->fStructSize==sizeof(AliHLTComponentEventData)) {
+    position += sizeof(AliHLTComponentEventData);
+  } else {
+    evtData=NULL;
+  }
+  if (size != position + sizeof(AliHLTComponentBlockData)) return -ENODATA;
+
+  AliHLTComponentBlockData block;
+  memcpy(&block, buffer + position, sizeof(AliHLTComponentBlockData));
+  if (block.fStructSize != sizeof(AliHLTComponentBlockData)) return -ENODATA;
+  if (block.fSize > 0 && (payload == NULL || payload->mSize != block.fSize)) return -ENODATA;
+
+  int result=0;
+  if (evtData && (result=insertEvtData(*evtData))<0) {
+    return result;
+  }
+
+  block.fPtr = block.fSize > 0 ? payload->mP : NULL;
+  block.fOffset = 0;
+  mBlockDescriptors.push_back(block);
+  return block.fSize > 0 ? 1 : 0;
+}
+
 int MessageFormat::readBlockSequence(AliHLTUInt8_t* buffer, unsigned size,
                                      vector<AliHLTComponentBlockData>& descriptorList) const
 {
@@ -334,6 +374,52 @@ vector<MessageFormat::BufferDesc_t> MessageFormat::createMessages(const AliHLTCo
       // send one single descriptor for all concatenated blocks
       mMessages.push_back(MessageFormat::BufferDesc_t(pTarget, offset));
     }
+  } else if (mOutputMode == kOutputModeInPlace) {
+    // only the block descriptors are written, all of them to one buffer, the event
+    // data in front of the first one. Every descriptor is handed over to the device
+    // followed by the payload of its block, which stays in the output buffer of the
+    // component. With the buffer allocated via the callback, the device sends the
+    // payload from there without copy.
+    auto bufferSize = sizeof(evtData) + count * sizeof(AliHLTComponentBlockData);
+    AliHLTUInt8_t* pTarget = nullptr;
+    if (cbAllocate==nullptr) {
+      mDataBuffer.resize(bufferSize);
+      pTarget=&mDataBuffer[0];
+    } else {
+      pTarget=*(*cbAllocate)(bufferSize);
+      if (pTarget==nullptr) {
+        throw std::bad_alloc();
+      }
+    }
+
+    memcpy(pTarget, &evtData, sizeof(evtData));
+    if (count > 0) {
+      // the message with the event data holds one block
+      auto* pEvtData = reinterpret_cast<AliHLTComponentEventData*>(pTarget);
+      pEvtData->fBlockCnt=1;
+    }
+    AliHLTUInt32_t offset = 0;
+    AliHLTUInt32_t msgSize = sizeof(evtData);
+    const auto* pOutputBlock = pOutputBlocks;
+    for (unsigned bi = 0; bi < count; bi++, pOutputBlock++) {
+      auto* bdTarget = reinterpret_cast<AliHLTComponentBlockData*>(pTarget + offset + msgSize);
+      memcpy(bdTarget, pOutputBlock, sizeof(AliHLTComponentBlockData));
+      bdTarget->fOffset = 0;
+      bdTarget->fPtr = NULL;
+      msgSize += sizeof(AliHLTComponentBlockData);
+      mMessages.push_back(MessageFormat::BufferDesc_t(pTarget + offset, msgSize));
+      offset += msgSize;
+      msgSize = 0;
+      if (pOutputBlock->fSize > 0) {
+        AliHLTUInt8_t* pData = reinterpret_cast<AliHLTUInt8_t*>(pOutputBlock->fPtr);
+        pData += pOutputBlock->fOffset;
+        mMessages.push_back(MessageFormat::BufferDesc_t(pData, pOutputBlock->fSize));
+      }
+    }
+    if (count == 0) {
+      // only the event data
+      mMessages.push_back(MessageFormat::BufferDesc_t(pTarget, msgSize));
+    }
   } else {
     // invalid output mode
     cerr << "error ALICE::HLT::Component: invalid output mode " << mOutputMode << endl;
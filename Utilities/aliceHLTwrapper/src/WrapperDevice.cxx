@@ -49,6 +49,7 @@ WrapperDevice::WrapperDevice(int argc, char** argv, int verbosity)
   : mComponent(NULL)
   , mArgv()
   , mMessages()
+  , mBuffers()
   , mPollingPeriod(10)
   , mSkipProcessing(0)
   , mLastCalcTime(-1)
@@ -206,31 +207,32 @@ void WrapperDevice::Run()
       cballoc_signal_t cbsignal;
       cbsignal.connect([this](unsigned int size){return this->createMessageBuffer(size);} );
       mMessages.clear();
+      mBuffers.clear();
 
       // call the component
       if ((iResult=mComponent->process(dataArray, &cbsignal))<0) {
         LOG(ERROR) << "component processing failed with error code " << iResult;
       }
 
+      // blocks forwarded from the input are sent from the input messages
+      for (auto& msg : inputMessages) {
+        mBuffers.push_back(std::shared_ptr<FairMQMessage>(move(msg)));
+      }
+
       // build messages from output data
       if (dataArray.size() > 0) {
         if (mVerbosity > 2) {
           LOG(INFO) << "processing " << dataArray.size() << " buffer(s)";
         }
         for (auto opayload : dataArray) {
-          FairMQMessage* omsg=nullptr;
-          // loop over pre-allocated messages
-          for (auto premsg = begin(mMessages); premsg != end(mMessages); premsg++) {
-            if ((*premsg)->GetData() == opayload.mP &&
-                (*premsg)->GetSize() == opayload.mSize) {
-              omsg=(*premsg).get();
-              if (mVerbosity > 2) {
-                LOG(DEBUG) << "using pre-allocated message of size " << opayload.mSize;
-              }
-              break;
+          // data in the pre-allocated messages or the input messages is not copied
+          unique_ptr<FairMQMessage> omsg(createMessageInBuffer(opayload.mP, opayload.mSize));
+          if (omsg.get()) {
+            if (mVerbosity > 2) {
+              LOG(DEBUG) << "using pre-allocated buffer for message of size " << opayload.mSize;
             }
-          }
-          if (omsg==nullptr) {
+            mMessages.push_back(move(omsg));
+          } else {
             unique_ptr<FairMQMessage> msg(fTransportFactory->CreateMessage());
             if (msg.get()) {
               msg->Rebuild(opayload.mSize);
@@ -270,6 +272,7 @@ void WrapperDevice::Run()
         }
         mMessages.clear();
       }
+      mBuffers.clear();
     }
 
     // cleanup
@@ -344,6 +347,31 @@ unsigned char* WrapperDevice::createMessageBuffer(unsigned size)
   if (mVerbosity > 2) {
     LOG(DEBUG) << "allocating message of size " << size;
   }
-  mMessages.push_back(move(msg));
-  return reinterpret_cast<AliHLTUInt8_t*>(mMessages.back()->GetData());
+  mBuffers.push_back(std::shared_ptr<FairMQMessage>(move(msg)));
+  return reinterpret_cast<AliHLTUInt8_t*>(mBuffers.back()->GetData());
+}
+
+unique_ptr<FairMQMessage> WrapperDevice::createMessageInBuffer(unsigned char* data, unsigned size)
+{
+  /// create an output message referring to data in one of the buffers
+  for (auto& buffer : mBuffers) {
+    unsigned char* bufferStart = reinterpret_cast<unsigned char*>(buffer->GetData());
+    if (bufferStart == nullptr || data < bufferStart || data + size > bufferStart + buffer->GetSize()) {
+      continue;
+    }
+    // the message holds a reference to the buffer until it has been sent
+    std::shared_ptr<FairMQMessage>* hint = new std::shared_ptr<FairMQMessage>(buffer);
+    unique_ptr<FairMQMessage> msg(fTransportFactory->CreateMessage(data, size, releaseMessageBuffer, hint));
+    if (msg.get() == nullptr) {
+      delete hint;
+    }
+    return msg;
+  }
+  return nullptr;
+}
+
+void WrapperDevice::releaseMessageBuffer(void* data, void* hint)
+{
+  /// release the reference to the buffer of a sent message
+  delete static_cast<std::shared_ptr<FairMQMessage>*>(hint);
 }
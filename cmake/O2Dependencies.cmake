@@ -59,6 +59,7 @@ if(APPLE)
   set(CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} -Wl,-undefined,error") # avoid undefined in our libs
 elseif(UNIX)
   set(CMAKE_SHARED_LINKER_FLAGS "${CMAKE_SHARED_LINKER_FLAGS} -Wl,--no-undefined") # avoid undefined in our libs
+  set(OPTIONAL_RT_LIBRARY rt) # shm_open and shm_unlink live in librt before glibc 2.17
 endif()
 
 ########## Bucket definitions ############
@@ -121,6 +122,7 @@ o2_define_bucket(
     fairmq_logger
     pthread
     dl
+    ${OPTIONAL_RT_LIBRARY}
 
     INCLUDE_DIRECTORIES
     ${FAIRROOT_INCLUDE_DIR}
@@ -150,6 +152,7 @@ o2_define_bucket(
     ${OPTIONAL_DDS_LIBRARIES}
     Base
     Headers
+    O2Device
     FairTools
     FairMQ
     fairmq_logger
@@ -433,6 +436,7 @@ o2_define_bucket(
     ${ROOT_INCLUDE_DIR}
     ${FAIRROOT_INCLUDE_DIR}
     ${ZMQ_INCLUDE_DIR}
+    ${CMAKE_SOURCE_DIR}/Utilities/O2Device/include
 )
 
 o2_define_bucket(